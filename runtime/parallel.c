@@ -0,0 +1,275 @@
+#include "parallel.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define REND_MAX_THREADS 256
+// a thread's share is split in this many chunks so there is something left to steal
+#define REND_CHUNKS_PER_THREAD 8
+
+// Iterations nobody has started yet. The owner takes chunks from the front, a thief takes the
+// back half. Kept on separate cache lines so owners do not slow each other down
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+    int64_t begin;
+    int64_t end;
+} rend_range;
+
+typedef struct {
+    rend_chunk_fn body;
+    void* context;
+    size_t reductions;
+    int64_t* partials; // reductions values per thread
+    int64_t grain;
+} rend_job;
+
+static struct {
+    pthread_once_t once;
+    size_t threads;
+    rend_range ranges[REND_MAX_THREADS];
+    pthread_mutex_t submit; // one job runs at a time
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint64_t generation;
+    size_t finished;
+    rend_job* job;
+} pool = {
+    .once = PTHREAD_ONCE_INIT,
+    .submit = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .start = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+// set on pool threads and on a caller while it runs a job
+static _Thread_local int in_pool = 0;
+
+static int64_t identity(rend_reduce_op op)
+{
+    switch(op)
+    {
+    case REND_REDUCE_MUL:
+        return 1;
+    case REND_REDUCE_AND:
+        return ~(int64_t)0;
+    default:
+        return 0;
+    }
+}
+
+// Unsigned so ADD and MUL wrap like the compiled code, the variable keeps the low bits
+static int64_t combine(rend_reduce_op op, int64_t a, int64_t b)
+{
+    switch(op)
+    {
+    case REND_REDUCE_ADD:
+        return (int64_t)((uint64_t)a + (uint64_t)b);
+    case REND_REDUCE_MUL:
+        return (int64_t)((uint64_t)a * (uint64_t)b);
+    case REND_REDUCE_AND:
+        return a & b;
+    case REND_REDUCE_OR:
+        return a | b;
+    case REND_REDUCE_XOR:
+        return a ^ b;
+    }
+    return a;
+}
+
+static int take(size_t self, int64_t grain, int64_t* begin, int64_t* end)
+{
+    rend_range* range = &pool.ranges[self];
+    pthread_mutex_lock(&range->lock);
+    int found = range->begin < range->end;
+    if(found)
+    {
+        *begin = range->begin;
+        *end = range->end - range->begin > grain ? range->begin + grain : range->end;
+        range->begin = *end;
+    }
+    pthread_mutex_unlock(&range->lock);
+    return found;
+}
+
+// Moves the back half of another thread's iterations into our own range. Failing means every
+// range was empty when we looked, the iterations left are already being run by someone
+static int steal(size_t self)
+{
+    for(size_t i = 1; i < pool.threads; i++)
+    {
+        rend_range* victim = &pool.ranges[(self + i) % pool.threads];
+        pthread_mutex_lock(&victim->lock);
+        int64_t remaining = victim->end - victim->begin;
+        if(remaining <= 0)
+        {
+            pthread_mutex_unlock(&victim->lock);
+            continue;
+        }
+        int64_t begin = victim->end - (remaining + 1) / 2;
+        int64_t end = victim->end;
+        victim->end = begin;
+        pthread_mutex_unlock(&victim->lock);
+
+        rend_range* own = &pool.ranges[self];
+        pthread_mutex_lock(&own->lock);
+        own->begin = begin;
+        own->end = end;
+        pthread_mutex_unlock(&own->lock);
+        return 1;
+    }
+    return 0;
+}
+
+static void run_job(rend_job* job, size_t self)
+{
+    int64_t* partials = job->partials + self * job->reductions;
+    int64_t begin;
+    int64_t end;
+    for(;;)
+    {
+        if(!take(self, job->grain, &begin, &end) &&
+           !(steal(self) && take(self, job->grain, &begin, &end)))
+            return;
+        job->body(begin, end, job->context, partials);
+    }
+}
+
+static void* worker_main(void* arg)
+{
+    size_t self = (size_t)arg;
+    uint64_t seen = 0;
+    in_pool = 1;
+    for(;;)
+    {
+        pthread_mutex_lock(&pool.lock);
+        while(pool.generation == seen) { pthread_cond_wait(&pool.start, &pool.lock); }
+        seen = pool.generation;
+        rend_job* job = pool.job;
+        pthread_mutex_unlock(&pool.lock);
+
+        run_job(job, self);
+
+        pthread_mutex_lock(&pool.lock);
+        if(++pool.finished == pool.threads - 1)
+            pthread_cond_signal(&pool.done);
+        pthread_mutex_unlock(&pool.lock);
+    }
+    return NULL;
+}
+
+// Thread 0 is whichever thread calls rend_parallel_for, the others wait for jobs
+static void start_pool(void)
+{
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char* requested = getenv("REND_THREADS");
+    if(requested && atol(requested) > 0)
+        threads = atol(requested);
+    if(threads < 1)
+        threads = 1;
+    if(threads > REND_MAX_THREADS)
+        threads = REND_MAX_THREADS;
+    pool.threads = (size_t)threads;
+
+    for(size_t i = 0; i < pool.threads; i++) { pthread_mutex_init(&pool.ranges[i].lock, NULL); }
+    for(size_t i = 1; i < pool.threads; i++)
+    {
+        pthread_t thread;
+        if(pthread_create(&thread, NULL, worker_main, (void*)i) != 0)
+        {
+            // run with the workers we have, later ranges stay empty
+            pool.threads = i;
+            break;
+        }
+        pthread_detach(thread);
+    }
+}
+
+size_t rend_thread_count(void)
+{
+    pthread_once(&pool.once, start_pool);
+    return pool.threads;
+}
+
+static void run_serial(int64_t count, rend_chunk_fn body, void* context,
+                       const rend_reduce_op* ops, int64_t* results, size_t reductions)
+{
+    int64_t partials[reductions + 1];
+    for(size_t r = 0; r < reductions; r++) { partials[r] = identity(ops[r]); }
+    body(0, count, context, partials);
+    for(size_t r = 0; r < reductions; r++)
+    {
+        results[r] = combine(ops[r], results[r], partials[r]);
+    }
+}
+
+void rend_parallel_for(int64_t count, rend_chunk_fn body, void* context,
+                       const rend_reduce_op* ops, int64_t* results, size_t reductions)
+{
+    if(count <= 0)
+        return;
+    pthread_once(&pool.once, start_pool);
+    if(in_pool || pool.threads == 1 || count == 1)
+    {
+        run_serial(count, body, context, ops, results, reductions);
+        return;
+    }
+
+    pthread_mutex_lock(&pool.submit);
+    const size_t threads = pool.threads;
+    int64_t* partials = malloc(sizeof(int64_t) * threads * (reductions + 1));
+    if(!partials)
+    {
+        pthread_mutex_unlock(&pool.submit);
+        run_serial(count, body, context, ops, results, reductions);
+        return;
+    }
+    for(size_t t = 0; t < threads; t++)
+    {
+        for(size_t r = 0; r < reductions; r++)
+        {
+            partials[t * reductions + r] = identity(ops[r]);
+        }
+    }
+
+    int64_t grain = count / (int64_t)(threads * REND_CHUNKS_PER_THREAD);
+    rend_job job = {body, context, reductions, partials, grain > 0 ? grain : 1};
+    // the first count % threads threads get one iteration more
+    const int64_t share = count / (int64_t)threads;
+    const int64_t extra = count % (int64_t)threads;
+    int64_t begin = 0;
+    for(size_t t = 0; t < threads; t++)
+    {
+        rend_range* range = &pool.ranges[t];
+        pthread_mutex_lock(&range->lock);
+        range->begin = begin;
+        begin += share + ((int64_t)t < extra ? 1 : 0);
+        range->end = begin;
+        pthread_mutex_unlock(&range->lock);
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.job = &job;
+    pool.finished = 0;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.start);
+    pthread_mutex_unlock(&pool.lock);
+
+    in_pool = 1;
+    run_job(&job, 0);
+    in_pool = 0;
+
+    pthread_mutex_lock(&pool.lock);
+    while(pool.finished < threads - 1) { pthread_cond_wait(&pool.done, &pool.lock); }
+    pthread_mutex_unlock(&pool.lock);
+
+    for(size_t r = 0; r < reductions; r++)
+    {
+        for(size_t t = 0; t < threads; t++)
+        {
+            results[r] = combine(ops[r], results[r], partials[t * reductions + r]);
+        }
+    }
+    free(partials);
+    pthread_mutex_unlock(&pool.submit);
+}
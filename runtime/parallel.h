@@ -0,0 +1,29 @@
+#ifndef REND_PARALLEL_H
+#define REND_PARALLEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Operators a parallel loop can reduce with. Bool && and || reduce as AND and OR of 0 and 1
+typedef enum {
+    REND_REDUCE_ADD,
+    REND_REDUCE_MUL,
+    REND_REDUCE_AND,
+    REND_REDUCE_OR,
+    REND_REDUCE_XOR,
+} rend_reduce_op;
+
+// Runs iterations [begin, end) of a parallel loop body. partials holds the running value of
+// every reduction for the calling thread, the body combines into it instead of the variables
+typedef void (*rend_chunk_fn)(int64_t begin, int64_t end, void* context, int64_t* partials);
+
+// Runs iterations [0, count) of body on the thread pool and returns when all of them are done.
+// results holds the value of each reduction before the loop and receives its value after it.
+// A parallel loop inside another one runs on the thread that reaches it
+void rend_parallel_for(int64_t count, rend_chunk_fn body, void* context,
+                       const rend_reduce_op* ops, int64_t* results, size_t reductions);
+
+// Threads in the pool including the caller, REND_THREADS overrides the number of online cores
+size_t rend_thread_count(void);
+
+#endif // REND_PARALLEL_H
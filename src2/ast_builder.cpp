@@ -15,6 +15,11 @@ return_ptr ASTBuilder::build_return(SourceLocation& loc, expression_ptr_var&& va
     return std::make_unique<ASTReturn>(loc, std::move(val));
 }
 
+callstmt_ptr ASTBuilder::build_call_statement(SourceLocation& loc, expression_ptr_var&& call) const
+{
+    return std::make_unique<ASTCallStatement>(loc, std::move(call));
+}
+
 if_ptr ASTBuilder::build_if(SourceLocation& loc, expression_ptr_var&& cond,
                             scope_err_ptr_var&& scope,
                             std::optional<else_ptr_var>&& else_body) const
@@ -29,28 +34,35 @@ else_ptr ASTBuilder::build_else(SourceLocation& loc, std::optional<expression_pt
 }
 
 assign_ptr ASTBuilder::build_assign(SourceLocation& loc, std::string_view name,
-                                    expression_ptr_var&& expr) const
+                                    expression_ptr_var&& expr,
+                                    std::optional<expression_ptr_var>&& index) const
 {
-    return std::make_unique<ASTAssign>(loc, std::move(name), std::move(expr));
+    return std::make_unique<ASTAssign>(loc, std::move(name), std::move(expr), std::move(index));
 }
 
 declare_ptr ASTBuilder::build_declare(SourceLocation& loc, std::string_view type_name,
-                                      std::string_view name) const
+                                      std::string_view name,
+                                      std::optional<size_t> array_size) const
 {
-    return std::make_unique<ASTDeclaration>(loc, std::move(type_name), std::move(name));
+    return std::make_unique<ASTDeclaration>(loc,
+                                            std::move(type_name),
+                                            std::move(name),
+                                            array_size);
 }
 
 declareassign_ptr ASTBuilder::build_declareassign(SourceLocation& loc, std::string_view type_name,
                                                   std::string_view name,
-                                                  expression_ptr_var&& expr) const
+                                                  expression_ptr_var&& expr,
+                                                  std::optional<size_t> array_size) const
 {
     return std::make_unique<ASTDeclareAssign>(loc,
                                               std::move(type_name),
                                               std::move(name),
-                                              std::move(expr));
+                                              std::move(expr),
+                                              array_size);
 }
 
-integer_ptr ASTBuilder::build_integer(SourceLocation& loc, int value) const
+integer_ptr ASTBuilder::build_integer(SourceLocation& loc, int64_t value) const
 {
     return std::make_unique<ASTInteger>(loc, value);
 }
@@ -60,12 +72,25 @@ boolean_ptr ASTBuilder::build_boolean(SourceLocation& loc, bool value) const
     return std::make_unique<ASTBoolean>(loc, value);
 }
 
+float_ptr ASTBuilder::build_float(SourceLocation& loc, double value, bool single) const
+{
+    return std::make_unique<ASTFloat>(loc, value, single);
+}
+
 while_ptr ASTBuilder::build_while(SourceLocation& loc, expression_ptr_var&& cond,
                                   scope_err_ptr_var&& scope) const
 {
     return std::make_unique<ASTWhile>(loc, std::move(cond), std::move(scope));
 }
 
+for_ptr ASTBuilder::build_for(SourceLocation& loc, std::optional<statements_ptr_var>&& init,
+                              expression_ptr_var&& cond, std::optional<statements_ptr_var>&& step,
+                              scope_err_ptr_var&& scope) const
+{
+    return std::make_unique<ASTFor>(loc, std::move(init), std::move(cond), std::move(step),
+                                    std::move(scope));
+}
+
 scope_ptr ASTBuilder::build_scope(SourceLocation& loc,
                                   scope_err_vec_ptr&& stmts) const
 {
@@ -73,9 +98,17 @@ scope_ptr ASTBuilder::build_scope(SourceLocation& loc,
 }
 
 struct_ptr ASTBuilder::build_struct(SourceLocation& loc, std::string_view& name,
-                                    struct_ptr_var&& body) const
+                                    struct_ptr_var&& body, type::StructLayout layout) const
 {
-    return std::make_unique<ASTStruct>(loc, std::move(body), name);
+    return std::make_unique<ASTStruct>(loc, std::move(body), name, layout);
+}
+
+function_ptr ASTBuilder::build_function(SourceLocation& loc, std::string_view return_type_name,
+                                        std::string_view name, std::vector<ASTParameter>&& params,
+                                        scope_err_ptr_var&& body) const
+{
+    return std::make_unique<ASTFunction>(loc, return_type_name, name, std::move(params),
+                                         std::move(body));
 }
 
 program_ptr ASTBuilder::build_program(SourceLocation& loc,
@@ -89,6 +122,18 @@ identifier_ptr ASTBuilder::build_identifier(SourceLocation& loc, std::string_vie
     return std::make_unique<ASTIdentifier>(loc, name);
 }
 
+index_ptr ASTBuilder::build_index(SourceLocation& loc, std::string_view name,
+                                  expression_ptr_var&& index) const
+{
+    return std::make_unique<ASTIndex>(loc, name, std::move(index));
+}
+
+call_ptr ASTBuilder::build_call(SourceLocation& loc, std::string_view callee,
+                                std::vector<expression_ptr_var>&& args) const
+{
+    return std::make_unique<ASTCall>(loc, callee, std::move(args));
+}
+
 expression_ptr ASTBuilder::build_expression(SourceLocation& loc,
                                             expression_ptr_var&& lhs,
                                             expression_ptr_var&& rhs,
@@ -13,6 +13,8 @@ class ASTBuilder {
 
     return_ptr build_return(SourceLocation& loc, expression_ptr_var&& val) const;
 
+    callstmt_ptr build_call_statement(SourceLocation& loc, expression_ptr_var&& call) const;
+
     if_ptr build_if(SourceLocation& loc, expression_ptr_var&& cond, scope_err_ptr_var&& scope,
                     std::optional<else_ptr_var>&& else_body) const;
 
@@ -20,30 +22,49 @@ class ASTBuilder {
                         scope_err_ptr_var&& scope) const;
 
     assign_ptr build_assign(SourceLocation& loc, std::string_view name,
-                            expression_ptr_var&& expr) const;
+                            expression_ptr_var&& expr,
+                            std::optional<expression_ptr_var>&& index = std::nullopt) const;
 
     declare_ptr build_declare(SourceLocation& loc, std::string_view type_name,
-                              std::string_view name) const;
+                              std::string_view name,
+                              std::optional<size_t> array_size = std::nullopt) const;
 
     declareassign_ptr build_declareassign(SourceLocation& loc, std::string_view type_name,
                                           std::string_view name,
-                                          expression_ptr_var&& expr) const;
+                                          expression_ptr_var&& expr,
+                                          std::optional<size_t> array_size = std::nullopt) const;
 
-    integer_ptr build_integer(SourceLocation& loc, int value) const;
+    integer_ptr build_integer(SourceLocation& loc, int64_t value) const;
 
     boolean_ptr build_boolean(SourceLocation& loc, bool value) const;
 
+    float_ptr build_float(SourceLocation& loc, double value, bool single) const;
+
     while_ptr build_while(SourceLocation& loc, expression_ptr_var&& cond,
                           scope_err_ptr_var&& scope) const;
 
+    for_ptr build_for(SourceLocation& loc, std::optional<statements_ptr_var>&& init,
+                      expression_ptr_var&& cond, std::optional<statements_ptr_var>&& step,
+                      scope_err_ptr_var&& scope) const;
+
     scope_ptr build_scope(SourceLocation& loc, scope_err_vec_ptr&& stmts) const;
 
     identifier_ptr build_identifier(SourceLocation& loc, std::string_view& name) const;
 
+    index_ptr build_index(SourceLocation& loc, std::string_view name,
+                          expression_ptr_var&& index) const;
+
+    call_ptr build_call(SourceLocation& loc, std::string_view callee,
+                        std::vector<expression_ptr_var>&& args) const;
+
     expression_ptr build_expression(SourceLocation& loc, expression_ptr_var&& lhs,
                                     expression_ptr_var&&  rhs, Operator op) const;
     struct_ptr build_struct(SourceLocation& loc, std::string_view& name,
-                                  struct_ptr_var&& body) const;
+                                  struct_ptr_var&& body, type::StructLayout layout) const;
+
+    function_ptr build_function(SourceLocation& loc, std::string_view return_type_name,
+                                std::string_view name, std::vector<ASTParameter>&& params,
+                                scope_err_ptr_var&& body) const;
 
     program_ptr build_program(SourceLocation& loc,
                               std::vector<statements_ptr_var>&& stmts) const;
@@ -0,0 +1,252 @@
+#include "ast_clone.hpp"
+
+ASTCloner::ASTCloner(Substitution substitute) : substitute_(std::move(substitute)) {}
+
+expression_ptr_var ASTCloner::clone(expression_ptr_var& node) const
+{
+    return std::visit(
+        Overload{[this](expression_ptr& expr) -> expression_ptr_var
+                 {
+                     auto copy = builder_.build_expression(expr->loc,
+                                                           clone(expr->lhs),
+                                                           clone(expr->rhs),
+                                                           expr->op);
+                     copy->type = expr->type;
+                     copy->operand_type = expr->operand_type;
+                     copy->checked = expr->checked;
+                     copy->non_negative = expr->non_negative;
+                     copy->label = expr->label;
+                     return copy;
+                 },
+                 [this](identifier_ptr& ident) -> expression_ptr_var
+                 {
+                     if(substitute_)
+                     {
+                         auto replacement = substitute_(*ident);
+                         if(replacement.has_value())
+                             return std::move(replacement.value());
+                     }
+                     auto copy = builder_.build_identifier(ident->loc, ident->name);
+                     copy->type = ident->type;
+                     copy->label = ident->label;
+                     return copy;
+                 },
+                 [this](integer_ptr& integer) -> expression_ptr_var
+                 {
+                     auto copy = builder_.build_integer(integer->loc, integer->value);
+                     copy->type = integer->type;
+                     copy->above_i64 = integer->above_i64;
+                     return copy;
+                 },
+                 [this](boolean_ptr& boolean) -> expression_ptr_var
+                 {
+                     auto copy = builder_.build_boolean(boolean->loc, boolean->value);
+                     copy->type = boolean->type;
+                     return copy;
+                 },
+                 [this](float_ptr& floating) -> expression_ptr_var
+                 {
+                     auto copy =
+                         builder_.build_float(floating->loc, floating->value, floating->single);
+                     copy->type = floating->type;
+                     return copy;
+                 },
+                 [this](call_ptr& call) -> expression_ptr_var
+                 {
+                     std::vector<expression_ptr_var> args;
+                     for(auto& arg : call->args) { args.push_back(clone(arg)); }
+                     auto copy = builder_.build_call(call->loc, call->callee, std::move(args));
+                     copy->type = call->type;
+                     copy->intrinsic = call->intrinsic;
+                     copy->tail_call = call->tail_call;
+                     copy->order = call->order;
+                     return copy;
+                 },
+                 [this](index_ptr& index) -> expression_ptr_var
+                 {
+                     auto copy =
+                         builder_.build_index(index->loc, index->name, clone(index->index));
+                     copy->type = index->type;
+                     copy->bounds_checked = index->bounds_checked;
+                     return copy;
+                 },
+                 [this](expr_err_ptr& err) -> expression_ptr_var
+                 { return builder_.build_expr_err(err->loc); }},
+        node);
+}
+
+statements_ptr_var ASTCloner::clone(statements_ptr_var& node) const
+{
+    return std::visit(
+        Overload{[this](scope_ptr& scope) -> statements_ptr_var { return clone(scope); },
+                 [this](break_ptr& _break) -> statements_ptr_var
+                 { return builder_.build_break(_break->loc); },
+                 [this](continue_ptr& _continue) -> statements_ptr_var
+                 { return builder_.build_continue(_continue->loc); },
+                 [this](return_ptr& _return) -> statements_ptr_var
+                 { return builder_.build_return(_return->loc, clone(_return->val)); },
+                 [this](else_ptr& _else) -> statements_ptr_var { return clone(_else); },
+                 [this](if_ptr& _if) -> statements_ptr_var
+                 {
+                     std::optional<else_ptr_var> else_clause = std::nullopt;
+                     if(_if->else_clause.has_value())
+                         else_clause = clone(_if->else_clause.value());
+                     return builder_.build_if(_if->loc,
+                                              clone(_if->condition),
+                                              clone(_if->scope),
+                                              std::move(else_clause));
+                 },
+                 [this](while_ptr& _while) -> statements_ptr_var
+                 {
+                     auto copy = builder_.build_while(_while->loc,
+                                                      clone(_while->condition),
+                                                      clone(_while->scope));
+                     copy->assigned = _while->assigned;
+                     return copy;
+                 },
+                 [this](for_ptr& _for) -> statements_ptr_var
+                 {
+                     std::optional<statements_ptr_var> init = std::nullopt;
+                     std::optional<statements_ptr_var> step = std::nullopt;
+                     if(_for->init.has_value())
+                         init = clone(_for->init.value());
+                     if(_for->step.has_value())
+                         step = clone(_for->step.value());
+                     auto copy = builder_.build_for(_for->loc,
+                                                    std::move(init),
+                                                    clone(_for->condition),
+                                                    std::move(step),
+                                                    clone(_for->scope));
+                     copy->induction = _for->induction;
+                     copy->parallel = _for->parallel;
+                     copy->reductions = _for->reductions;
+                     return copy;
+                 },
+                 [this](struct_ptr& _struct) -> statements_ptr_var
+                 {
+                     struct_ptr_var members = std::visit(
+                         Overload{[this](std::vector<struct_body_var>& body) -> struct_ptr_var
+                                  {
+                                      std::vector<struct_body_var> copy;
+                                      for(auto& member : body) { copy.push_back(clone(member)); }
+                                      return copy;
+                                  },
+                                  [this](stmt_err_ptr& err) -> struct_ptr_var
+                                  { return builder_.build_stmt_err(err->loc); }},
+                         _struct->members);
+                     std::string_view name = _struct->name;
+                     auto copy = builder_.build_struct(_struct->loc,
+                                                       name,
+                                                       std::move(members),
+                                                       _struct->layout);
+                     copy->type_params = _struct->type_params;
+                     return copy;
+                 },
+                 [this](function_ptr& function) -> statements_ptr_var
+                 {
+                     auto params = function->params;
+                     auto copy = builder_.build_function(function->loc,
+                                                         function->return_type_name,
+                                                         function->name,
+                                                         std::move(params),
+                                                         clone(function->body));
+                     copy->return_type = function->return_type;
+                     copy->leaf = function->leaf;
+                     return copy;
+                 },
+                 [this](declareassign_ptr& declassign) -> statements_ptr_var
+                 { return clone(declassign); },
+                 [this](declare_ptr& declare) -> statements_ptr_var { return clone(declare); },
+                 [this](assign_ptr& assign) -> statements_ptr_var
+                 {
+                     std::optional<expression_ptr_var> index = std::nullopt;
+                     if(assign->index.has_value())
+                         index = clone(assign->index.value());
+                     auto copy = builder_.build_assign(assign->loc,
+                                                       assign->name,
+                                                       clone(assign->expr),
+                                                       std::move(index));
+                     copy->bounds_checked = assign->bounds_checked;
+                     return copy;
+                 },
+                 [this](callstmt_ptr& stmt) -> statements_ptr_var
+                 { return builder_.build_call_statement(stmt->loc, clone(stmt->call)); },
+                 [this](stmt_err_ptr& err) -> statements_ptr_var
+                 { return builder_.build_stmt_err(err->loc); }},
+        node);
+}
+
+scope_err_ptr_var ASTCloner::clone(scope_err_ptr_var& node) const
+{
+    return std::visit(Overload{[this](scope_ptr& scope) -> scope_err_ptr_var
+                               { return clone(scope); },
+                               [this](stmt_err_ptr& err) -> scope_err_ptr_var
+                               { return builder_.build_stmt_err(err->loc); }},
+                      node);
+}
+
+scope_ptr ASTCloner::clone(scope_ptr& scope) const
+{
+    scope_err_vec_ptr stmts = std::visit(
+        Overload{[this](std::vector<statements_ptr_var>& vec) -> scope_err_vec_ptr
+                 {
+                     std::vector<statements_ptr_var> copy;
+                     for(auto& stmt : vec) { copy.push_back(clone(stmt)); }
+                     return copy;
+                 },
+                 [this](stmt_err_ptr& err) -> scope_err_vec_ptr
+                 { return builder_.build_stmt_err(err->loc); }},
+        scope->stmts);
+    return builder_.build_scope(scope->loc, std::move(stmts));
+}
+
+else_ptr_var ASTCloner::clone(else_ptr_var& node) const
+{
+    return std::visit(Overload{[this](else_ptr& _else) -> else_ptr_var { return clone(_else); },
+                               [this](stmt_err_ptr& err) -> else_ptr_var
+                               { return builder_.build_stmt_err(err->loc); }},
+                      node);
+}
+
+else_ptr ASTCloner::clone(else_ptr& _else) const
+{
+    std::optional<expression_ptr_var> cond = std::nullopt;
+    if(_else->condition.has_value())
+        cond = clone(_else->condition.value());
+    return builder_.build_else(_else->loc, std::move(cond), clone(_else->scope));
+}
+
+declare_ptr ASTCloner::clone(declare_ptr& declare) const
+{
+    auto copy = builder_.build_declare(declare->loc,
+                                       declare->type_name,
+                                       declare->name,
+                                       declare->array_size);
+    copy->type = declare->type;
+    copy->type_args = declare->type_args;
+    return copy;
+}
+
+declareassign_ptr ASTCloner::clone(declareassign_ptr& declassign) const
+{
+    auto copy = builder_.build_declareassign(declassign->loc,
+                                             declassign->type_name,
+                                             declassign->name,
+                                             clone(declassign->expr),
+                                             declassign->array_size);
+    copy->type = declassign->type;
+    copy->type_args = declassign->type_args;
+    copy->is_const = declassign->is_const;
+    return copy;
+}
+
+struct_body_var ASTCloner::clone(struct_body_var& node) const
+{
+    return std::visit(Overload{[this](declare_ptr& member) -> struct_body_var
+                               { return clone(member); },
+                               [this](declareassign_ptr& member) -> struct_body_var
+                               { return clone(member); },
+                               [this](stmt_err_ptr& err) -> struct_body_var
+                               { return builder_.build_stmt_err(err->loc); }},
+                      node);
+}
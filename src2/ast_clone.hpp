@@ -0,0 +1,41 @@
+#ifndef AST_CLONE_HPP
+#define AST_CLONE_HPP
+
+#pragma once
+#include "ast_builder.hpp"
+#include "ast_def.hpp"
+#include "semantics.hpp"
+#include <functional>
+
+// Deep copies analyzed subtrees, keeping the types and flags set by earlier passes.
+// Identifiers the substitution returns an expression for are replaced by that expression
+class ASTCloner {
+  public:
+    using Substitution = std::function<std::optional<expression_ptr_var>(ASTIdentifier&)>;
+
+    ASTCloner(Substitution substitute = nullptr);
+
+    expression_ptr_var clone(expression_ptr_var& node) const;
+
+    statements_ptr_var clone(statements_ptr_var& node) const;
+
+    scope_err_ptr_var clone(scope_err_ptr_var& node) const;
+
+  private:
+    Substitution substitute_;
+    ASTBuilder builder_;
+
+    scope_ptr clone(scope_ptr& scope) const;
+
+    else_ptr_var clone(else_ptr_var& node) const;
+
+    else_ptr clone(else_ptr& _else) const;
+
+    declare_ptr clone(declare_ptr& declare) const;
+
+    declareassign_ptr clone(declareassign_ptr& declassign) const;
+
+    struct_body_var clone(struct_body_var& node) const;
+};
+
+#endif // AST_CLONE_HPP
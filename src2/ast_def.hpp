@@ -5,7 +5,9 @@
 #include "tokens.hpp"
 #include "type.hpp"
 #include <memory>
+#include <deque>
 #include <optional>
+#include <set>
 #include <string>
 #include <variant>
 #include <vector>
@@ -13,6 +15,16 @@
 enum class BuiltinType : char {
     INT,
     BOOL,
+    I8,
+    I16,
+    I32,
+    I64,
+    U8,
+    U16,
+    U32,
+    U64,
+    FLOAT,
+    DOUBLE,
 };
 
 enum class Operator {
@@ -38,6 +50,82 @@ enum class Operator {
     UNDEFINED,
 };
 
+// The comparison that gives the same result with its operands swapped
+inline Operator mirror_operator(Operator op)
+{
+    switch(op)
+    {
+    case Operator::LESS:
+        return Operator::GREATER;
+    case Operator::GREATER:
+        return Operator::LESS;
+    case Operator::LESSEQ:
+        return Operator::GREATEREQ;
+    case Operator::GREATEREQ:
+        return Operator::LESSEQ;
+    default:
+        return op;
+    }
+}
+
+// The comparison that holds exactly when op does not, UNDEFINED for other operators
+inline Operator negate_operator(Operator op)
+{
+    switch(op)
+    {
+    case Operator::LESS:
+        return Operator::GREATEREQ;
+    case Operator::GREATER:
+        return Operator::LESSEQ;
+    case Operator::LESSEQ:
+        return Operator::GREATER;
+    case Operator::GREATEREQ:
+        return Operator::LESS;
+    case Operator::EQ:
+        return Operator::NEQ;
+    case Operator::NEQ:
+        return Operator::EQ;
+    default:
+        return Operator::UNDEFINED;
+    }
+}
+
+// Builtin functions resolved by the semantic analyzer, lowered directly by the backend
+enum class Intrinsic : char {
+    NONE,
+    VEC_SPLAT,
+    VEC_BUILD,
+    VEC_EXTRACT,
+    VEC_INSERT,
+    VEC_REDUCE_ADD,
+    VEC_REDUCE_MIN,
+    VEC_REDUCE_MAX,
+    VEC_REDUCE_AND,
+    VEC_REDUCE_OR,
+    VEC_REDUCE_XOR,
+    BIT_POPCOUNT,
+    BIT_CLZ,
+    BIT_CTZ,
+    BIT_BSWAP,
+    BIT_ROTL,
+    BIT_ROTR,
+    ATOMIC_LOAD,
+    ATOMIC_STORE,
+    ATOMIC_FETCH_ADD,
+    ATOMIC_EXCHANGE,
+    ATOMIC_COMPARE_EXCHANGE,
+};
+
+// Ordering of an atomic intrinsic against the other memory accesses of its thread, the same
+// orderings as C++11
+enum class MemoryOrder : char {
+    RELAXED,
+    ACQUIRE,
+    RELEASE,
+    ACQ_REL,
+    SEQ_CST,
+};
+
 struct ASTNode {
     SourceLocation loc;
     ASTNode(SourceLocation& loc) : loc(loc) {}
@@ -78,8 +166,10 @@ struct ASTIdentifier : public ASTExpressionBase {
 using identifier_ptr = std::unique_ptr<ASTIdentifier>;
 
 struct ASTInteger : public ASTExpressionBase {
-    int value;
-    ASTInteger(SourceLocation& loc, int value) : ASTExpressionBase(loc), value(value) {}
+    int64_t value;
+    // above INT64_MAX, value holds the bits and only u64 can hold it
+    bool above_i64 = false;
+    ASTInteger(SourceLocation& loc, int64_t value) : ASTExpressionBase(loc), value(value) {}
 };
 
 using integer_ptr = std::unique_ptr<ASTInteger>;
@@ -91,22 +181,74 @@ struct ASTBoolean : public ASTExpressionBase {
 
 using boolean_ptr = std::unique_ptr<ASTBoolean>;
 
+struct ASTFloat : public ASTExpressionBase {
+    double value;
+    bool single; // written with an 'f' suffix
+    ASTFloat(SourceLocation& loc, double value, bool single)
+        : ASTExpressionBase(loc), value(value), single(single)
+    {
+    }
+};
+
+using float_ptr = std::unique_ptr<ASTFloat>;
+
 struct ASTExpression;
 
 using expression_ptr = std::unique_ptr<ASTExpression>;
 
+struct ASTIndex;
+
+using index_ptr = std::unique_ptr<ASTIndex>;
+
+struct ASTCall;
+
+using call_ptr = std::unique_ptr<ASTCall>;
+
 using expression_ptr_var =
     std::variant<expression_ptr, identifier_ptr,
-                 integer_ptr, boolean_ptr,
-                 expr_err_ptr>;
+                 integer_ptr, boolean_ptr, float_ptr,
+                 call_ptr, index_ptr, expr_err_ptr>;
+
+struct ASTCall : public ASTExpressionBase {
+    std::string_view callee;
+    std::vector<expression_ptr_var> args;
+    Intrinsic intrinsic;
+    bool tail_call; // the caller returns the result directly, a backend can jump instead
+    MemoryOrder order; // only used by the atomic intrinsics
+    ASTCall(SourceLocation& loc, std::string_view callee, std::vector<expression_ptr_var>&& args)
+        : ASTExpressionBase(loc), callee(callee), args(std::move(args)), intrinsic(Intrinsic::NONE),
+          tail_call(false), order(MemoryOrder::SEQ_CST)
+    {
+    }
+};
+
+// Element of an array variable, checked against the array length unless the
+// bounds check pass proves the index is always in range
+struct ASTIndex : public ASTExpressionBase {
+    std::string_view name;
+    expression_ptr_var index;
+    bool bounds_checked;
+    ASTIndex(SourceLocation& loc, std::string_view name, expression_ptr_var&& index)
+        : ASTExpressionBase(loc), name(name), index(std::move(index)), bounds_checked(true)
+    {
+    }
+};
 
 struct ASTExpression : public ASTExpressionBase {
     expression_ptr_var lhs;
     expression_ptr_var rhs;
     Operator op;
+    // type both operands are converted to, decides operand size and signedness in codegen
+    std::shared_ptr<type::BuiltinType> operand_type;
+    // DIV and MOD check the divisor for 0 and MIN / -1 and shifts their count, unless the
+    // bounds check pass proves the operands are always in range
+    bool checked;
+    // signed operands that are never negative, DIV, MOD and RSH may use unsigned instructions
+    bool non_negative;
     ASTExpression(SourceLocation& loc, expression_ptr_var&& lhs, expression_ptr_var&& rhs,
                   Operator& op)
-        : ASTExpressionBase(loc), lhs(std::move(lhs)), rhs(std::move(rhs)), op(op)
+        : ASTExpressionBase(loc), lhs(std::move(lhs)), rhs(std::move(rhs)), op(op),
+          operand_type(nullptr), checked(true), non_negative(false)
     {
     }
 };
@@ -122,11 +264,26 @@ struct ASTReturn : public ASTStatementBase {
 
 using return_ptr = std::unique_ptr<ASTReturn>;
 
+// A call whose result is discarded, e.g. atomic_store(flag, 1, release);
+struct ASTCallStatement : public ASTStatementBase {
+    expression_ptr_var call;
+    ASTCallStatement(SourceLocation& loc, expression_ptr_var&& call)
+        : ASTStatementBase(loc), call(std::move(call))
+    {
+    }
+};
+
+using callstmt_ptr = std::unique_ptr<ASTCallStatement>;
+
 struct ASTAssign : public ASTStatementBase {
     std::string_view name;
     expression_ptr_var expr;
-    ASTAssign(SourceLocation& loc, std::string_view name, expression_ptr_var&& expr)
-        : ASTStatementBase(loc), name(std::move(name)), expr(std::move(expr))
+    std::optional<expression_ptr_var> index; // set when assigning to an array element
+    bool bounds_checked;
+    ASTAssign(SourceLocation& loc, std::string_view name, expression_ptr_var&& expr,
+              std::optional<expression_ptr_var>&& index = std::nullopt)
+        : ASTStatementBase(loc), name(std::move(name)), expr(std::move(expr)),
+          index(std::move(index)), bounds_checked(true)
     {
     }
 };
@@ -136,11 +293,16 @@ using assign_ptr = std::unique_ptr<ASTAssign>;
 struct ASTDeclareAssign : public ASTStatementBase {
     std::shared_ptr<type::BuiltinType> type;
     std::string_view type_name;
+    std::vector<type::TypeName> type_args; // Pair<int, bool> x = ... instantiates Pair
     std::string_view name;
     expression_ptr_var expr;
+    std::optional<size_t> array_size;
+    bool is_const; // expr is folded to a literal and every use of name is replaced by it
     ASTDeclareAssign(SourceLocation& loc, std::string_view type,
-                     std::string_view name, expression_ptr_var&& expr)
-        : ASTStatementBase(loc), type_name(std::move(type)), name(std::move(name)), expr(std::move(expr)), type(nullptr)
+                     std::string_view name, expression_ptr_var&& expr,
+                     std::optional<size_t> array_size = std::nullopt)
+        : ASTStatementBase(loc), type_name(std::move(type)), name(std::move(name)), expr(std::move(expr)), type(nullptr),
+          array_size(array_size), is_const(false)
     {
     }
 };
@@ -150,9 +312,13 @@ using declareassign_ptr = std::unique_ptr<ASTDeclareAssign>;
 struct ASTDeclaration : public ASTStatementBase {
     std::shared_ptr<type::BuiltinType> type;
     std::string_view type_name;
+    std::vector<type::TypeName> type_args;
     std::string_view name;
-    ASTDeclaration(SourceLocation& loc, std::string_view type, std::string_view&& name)
-        : ASTStatementBase(loc), type_name(std::move(type)), name(std::move(name)), type(nullptr)
+    std::optional<size_t> array_size;
+    ASTDeclaration(SourceLocation& loc, std::string_view type, std::string_view&& name,
+                   std::optional<size_t> array_size = std::nullopt)
+        : ASTStatementBase(loc), type_name(std::move(type)), name(std::move(name)), type(nullptr),
+          array_size(array_size)
     {
     }
 };
@@ -168,14 +334,16 @@ using scope_err_ptr_var = std::variant<scope_ptr, stmt_err_ptr>;
 struct ASTWhile : public ASTStatementBase {
     expression_ptr_var condition;
     scope_err_ptr_var scope;
+    // variables and arrays written in the body, filled in by semantic analysis
+    std::set<std::string_view> assigned;
     ASTWhile(SourceLocation& loc, expression_ptr_var&& condition, scope_err_ptr_var&& scope)
         : ASTStatementBase(loc), condition(std::move(condition)), scope(std::move(scope))
     {
     }
 
     ASTWhile(std::unique_ptr<ASTWhile>&& _while)
-        : condition(std::move(_while->condition)), scope(std::move(_while->scope)),
-          ASTStatementBase(_while->loc)
+        : ASTStatementBase(_while->loc), condition(std::move(_while->condition)),
+          scope(std::move(_while->scope)), assigned(std::move(_while->assigned))
     {
     }
 };
@@ -239,9 +407,50 @@ struct ASTIf : public ASTStatementBase {
 struct ASTStruct;
 using struct_ptr = std::unique_ptr<ASTStruct>;
 
+struct ASTFunction;
+using function_ptr = std::unique_ptr<ASTFunction>;
+
+struct ASTFor;
+using for_ptr = std::unique_ptr<ASTFor>;
+
 using statements_ptr_var =
     std::variant<scope_ptr, break_ptr, continue_ptr, return_ptr, else_ptr, if_ptr, while_ptr,
-                 struct_ptr, declareassign_ptr, declare_ptr, assign_ptr, stmt_err_ptr>;
+                 for_ptr, struct_ptr, function_ptr, declareassign_ptr, declare_ptr, assign_ptr,
+                 callstmt_ptr, stmt_err_ptr>;
+
+// Found by the loop unroller: name changes by step every iteration, trip_count is set when
+// the number of iterations is known at compile time
+struct InductionVariable {
+    std::string_view name;
+    int64_t step;
+    std::optional<uint64_t> trip_count;
+};
+
+// Variable of the enclosing scope that the chunks of a parallel loop each accumulate
+// privately, combined with op when the loop ends. Every write to it is name = name op value
+struct Reduction {
+    std::string_view name;
+    Operator op;
+};
+
+// init runs once before the loop, step after every iteration and on continue.
+// The iterations of a parallel loop run in chunks spread over the runtime's thread pool
+struct ASTFor : public ASTStatementBase {
+    std::optional<statements_ptr_var> init;
+    expression_ptr_var condition;
+    std::optional<statements_ptr_var> step;
+    scope_err_ptr_var scope;
+    std::optional<InductionVariable> induction;
+    bool parallel;
+    std::vector<Reduction> reductions;
+    ASTFor(SourceLocation& loc, std::optional<statements_ptr_var>&& init,
+           expression_ptr_var&& condition, std::optional<statements_ptr_var>&& step,
+           scope_err_ptr_var&& scope)
+        : ASTStatementBase(loc), init(std::move(init)), condition(std::move(condition)),
+          step(std::move(step)), scope(std::move(scope)), parallel(false)
+    {
+    }
+};
 
 // Struct body will change in future
 using struct_body_var = std::variant<declare_ptr, declareassign_ptr, stmt_err_ptr>;
@@ -250,9 +459,37 @@ using struct_ptr_var = std::variant<std::vector<struct_body_var>, stmt_err_ptr>;
 
 struct ASTStruct : public ASTStatementBase {
     std::string_view name;
+    std::vector<std::string_view> type_params; // a generic struct is a template, not a type
     struct_ptr_var members;
-    ASTStruct(SourceLocation& loc, struct_ptr_var&& members, std::string_view& name)
-        : ASTStatementBase(loc), members(std::move(members)), name(name)
+    type::StructLayout layout;
+    ASTStruct(SourceLocation& loc, struct_ptr_var&& members, std::string_view& name,
+              type::StructLayout layout)
+        : ASTStatementBase(loc), members(std::move(members)), name(name), layout(layout)
+    {
+    }
+};
+
+struct ASTParameter : public ASTNode {
+    std::string_view type_name;
+    std::string_view name;
+    std::shared_ptr<type::BuiltinType> type;
+    ASTParameter(SourceLocation& loc, std::string_view type_name, std::string_view name)
+        : ASTNode(loc), type_name(type_name), name(name), type(nullptr)
+    {
+    }
+};
+
+struct ASTFunction : public ASTStatementBase {
+    std::string_view return_type_name;
+    std::string_view name;
+    std::vector<ASTParameter> params;
+    scope_err_ptr_var body;
+    std::shared_ptr<type::BuiltinType> return_type;
+    bool leaf; // makes no calls that return to it, a backend can skip frame setup
+    ASTFunction(SourceLocation& loc, std::string_view return_type_name, std::string_view name,
+                std::vector<ASTParameter>&& params, scope_err_ptr_var&& body)
+        : ASTStatementBase(loc), return_type_name(return_type_name), name(name),
+          params(std::move(params)), body(std::move(body)), return_type(nullptr), leaf(false)
     {
     }
 };
@@ -273,6 +510,8 @@ struct ASTScope : public ASTStatementBase {
 
 struct ASTProgram : public ASTNode {
     std::vector<statements_ptr_var> stmts;
+    // names of variables introduced by passes, a deque keeps the views into it valid
+    std::deque<std::string> generated_names;
     ASTProgram(SourceLocation& loc, std::vector<statements_ptr_var>&& stmts)
         : ASTNode(loc), stmts(std::move(stmts))
     {
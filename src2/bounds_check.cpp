@@ -0,0 +1,679 @@
+#include "bounds_check.hpp"
+#include <utility>
+
+namespace
+{
+    std::shared_ptr<type::BuiltinType> type_of(expression_ptr_var& node)
+    {
+        return std::visit([](auto& expr) -> std::shared_ptr<type::BuiltinType>
+                          { return expr->type; },
+                          node);
+    }
+
+    std::pair<std::optional<int64_t>, std::optional<int64_t>>
+    type_bounds(const std::shared_ptr<type::BuiltinType>& type)
+    {
+        if(!type)
+            return {std::nullopt, std::nullopt};
+        return {type->min_value(), type->max_value()};
+    }
+
+    std::optional<int64_t> checked_add(std::optional<int64_t> a, std::optional<int64_t> b)
+    {
+        int64_t result;
+        if(!a || !b || __builtin_add_overflow(*a, *b, &result))
+            return std::nullopt;
+        return result;
+    }
+
+    std::optional<int64_t> checked_sub(std::optional<int64_t> a, std::optional<int64_t> b)
+    {
+        int64_t result;
+        if(!a || !b || __builtin_sub_overflow(*a, *b, &result))
+            return std::nullopt;
+        return result;
+    }
+
+    std::optional<int64_t> checked_mul(std::optional<int64_t> a, std::optional<int64_t> b)
+    {
+        int64_t result;
+        if(!a || !b || __builtin_mul_overflow(*a, *b, &result))
+            return std::nullopt;
+        return result;
+    }
+
+    std::optional<int64_t> checked_div(std::optional<int64_t> a, std::optional<int64_t> b)
+    {
+        if(!a || !b || *b == 0 || (*a == INT64_MIN && *b == -1))
+            return std::nullopt;
+        return *a / *b;
+    }
+
+    // Smallest and largest result of f at the corners of the ranges, unknown if any is
+    template<class F>
+    std::pair<std::optional<int64_t>, std::optional<int64_t>>
+    corners(F f, std::optional<int64_t> a_lo, std::optional<int64_t> a_hi,
+            std::optional<int64_t> b_lo, std::optional<int64_t> b_hi)
+    {
+        std::optional<int64_t> lo, hi;
+        for(auto a : {a_lo, a_hi})
+        {
+            for(auto b : {b_lo, b_hi})
+            {
+                auto value = f(a, b);
+                if(!value.has_value())
+                    return {std::nullopt, std::nullopt};
+                lo = lo.has_value() ? std::min(*lo, *value) : *value;
+                hi = hi.has_value() ? std::max(*hi, *value) : *value;
+            }
+        }
+        return {lo, hi};
+    }
+} // namespace
+
+BoundsCheckEliminator::BoundsCheckEliminator(program_ptr&& program) : program_(std::move(program))
+{
+}
+
+program_ptr&& BoundsCheckEliminator::run()
+{
+    Facts facts;
+    for(auto& stmt : program_->stmts) { visit_stmt(stmt, facts); }
+    return std::move(program_);
+}
+
+size_t BoundsCheckEliminator::removed_checks() const
+{
+    return removed_;
+}
+
+size_t BoundsCheckEliminator::removed_guards() const
+{
+    return removed_guards_;
+}
+
+// Will return false when control never reaches the statement after node
+bool BoundsCheckEliminator::visit_stmt(statements_ptr_var& node, Facts& facts)
+{
+    return std::visit(
+        Overload{[this, &facts](scope_ptr& scope) -> bool
+                 {
+                     auto* stmts = std::get_if<std::vector<statements_ptr_var>>(&scope->stmts);
+                     if(!stmts)
+                         return true;
+                     bool falls_through = true;
+                     for(auto& stmt : *stmts) { falls_through &= visit_stmt(stmt, facts); }
+                     return falls_through;
+                 },
+                 [](break_ptr&) -> bool { return false; },
+                 [](continue_ptr&) -> bool { return false; },
+                 [this, &facts](return_ptr& _return) -> bool
+                 {
+                     visit_expr(_return->val, facts);
+                     return false;
+                 },
+                 [this, &facts](if_ptr& _if) -> bool
+                 {
+                     visit_expr(_if->condition, facts);
+                     Facts then_facts = facts;
+                     refine(_if->condition, then_facts);
+                     const bool then_falls = visit_scope(_if->scope, then_facts);
+
+                     Facts else_facts = facts;
+                     refine(_if->condition, else_facts, false);
+                     bool else_falls = true;
+                     auto* _else = _if->else_clause.has_value()
+                                       ? std::get_if<else_ptr>(&_if->else_clause.value())
+                                       : nullptr;
+                     if(_else)
+                     {
+                         Facts taken = else_facts;
+                         if((*_else)->condition.has_value())
+                         {
+                             visit_expr((*_else)->condition.value(), else_facts);
+                             refine((*_else)->condition.value(), taken);
+                             refine((*_else)->condition.value(), else_facts, false);
+                         }
+                         const bool taken_falls = visit_scope((*_else)->scope, taken);
+                         // else if without a final else may run neither branch
+                         if(!(*_else)->condition.has_value())
+                         {
+                             else_facts = std::move(taken);
+                             else_falls = taken_falls;
+                         }
+                         else if(taken_falls)
+                             else_facts = merge(taken, else_facts);
+                     }
+
+                     if(then_falls && else_falls)
+                         facts = merge(then_facts, else_facts);
+                     else if(then_falls)
+                         facts = std::move(then_facts);
+                     else if(else_falls)
+                         facts = std::move(else_facts);
+                     return then_falls || else_falls;
+                 },
+                 [this, &facts](while_ptr& _while) -> bool
+                 {
+                     visit_loop(_while->condition, _while->scope, nullptr, facts);
+                     return true;
+                 },
+                 [this, &facts](for_ptr& _for) -> bool
+                 {
+                     if(_for->init.has_value())
+                         visit_stmt(_for->init.value(), facts);
+                     auto* step = _for->step.has_value() ? &_for->step.value() : nullptr;
+                     visit_loop(_for->condition, _for->scope, step, facts);
+                     return true;
+                 },
+                 [this](function_ptr& function) -> bool
+                 {
+                     // nothing is known about the arguments on entry, and the arrays outside
+                     // are not visible, a local one may reuse their names
+                     auto lengths = std::exchange(lengths_, {});
+                     auto types = std::exchange(types_, {});
+                     Facts entry;
+                     for(auto& param : function->params) { types_[param.name] = param.type; }
+                     visit_scope(function->body, entry);
+                     lengths_ = std::move(lengths);
+                     types_ = std::move(types);
+                     return true;
+                 },
+                 [this, &facts](declareassign_ptr& declassign) -> bool
+                 {
+                     visit_expr(declassign->expr, facts);
+                     types_[declassign->name] = declassign->type;
+                     if(declassign->type && declassign->type->is_array())
+                     {
+                         auto& array = static_cast<type::ArrayType&>(*declassign->type);
+                         lengths_[declassign->name] = array.length;
+                         facts.erase(declassign->name);
+                     }
+                     else
+                         assign(declassign->name, declassign->expr, facts);
+                     return true;
+                 },
+                 [this, &facts](declare_ptr& declare) -> bool
+                 {
+                     types_[declare->name] = declare->type;
+                     if(declare->type && declare->type->is_array())
+                     {
+                         auto& array = static_cast<type::ArrayType&>(*declare->type);
+                         lengths_[declare->name] = array.length;
+                     }
+                     facts.erase(declare->name);
+                     return true;
+                 },
+                 [this, &facts](assign_ptr& _assign) -> bool
+                 {
+                     visit_expr(_assign->expr, facts);
+                     if(!_assign->index.has_value())
+                     {
+                         assign(_assign->name, _assign->expr, facts);
+                         return true;
+                     }
+                     visit_expr(_assign->index.value(), facts);
+                     if(_assign->bounds_checked &&
+                        in_bounds(_assign->name, _assign->index.value(), facts))
+                     {
+                         _assign->bounds_checked = false;
+                         removed_++;
+                     }
+                     return true;
+                 },
+                 [this, &facts](callstmt_ptr& stmt) -> bool
+                 {
+                     visit_expr(stmt->call, facts);
+                     return true;
+                 },
+                 [](auto&&) -> bool { return true; }},
+        node);
+}
+
+// Loop bounds only hold if every assignment to them in the body moves them one way
+void BoundsCheckEliminator::visit_loop(expression_ptr_var& cond, scope_err_ptr_var& scope,
+                                       statements_ptr_var* step, Facts& facts)
+{
+    Steps steps;
+    collect_steps(scope, steps, false);
+    if(step)
+        collect_steps(*step, steps, false);
+
+    // facts that hold every time the condition is evaluated
+    Facts invariant = facts;
+    for(const auto& [name, change] : steps)
+    {
+        auto it = invariant.find(name);
+        if(it == invariant.end())
+            continue;
+        if(change.direction == Step::Direction::INCREASING)
+            it->second.hi = std::nullopt;
+        else if(change.direction == Step::Direction::DECREASING)
+            it->second.lo = std::nullopt;
+        else
+            invariant.erase(it);
+    }
+
+    // the kept bound only holds if stepping past the condition cannot wrap
+    Facts body = invariant;
+    refine(cond, body);
+    for(const auto& [name, change] : steps)
+    {
+        auto it = invariant.find(name);
+        auto entry = body.find(name);
+        if(it == invariant.end() || entry == body.end())
+            continue;
+        if(change.direction == Step::Direction::INCREASING &&
+           !fits(name, checked_add(entry->second.hi, change.total)))
+            it->second.lo = std::nullopt;
+        if(change.direction == Step::Direction::DECREASING &&
+           !fits(name, checked_sub(entry->second.lo, change.total)))
+            it->second.hi = std::nullopt;
+    }
+
+    visit_expr(cond, invariant);
+    body = invariant;
+    refine(cond, body);
+    visit_scope(scope, body);
+    // continue also reaches the step, so nothing is assumed there
+    Facts unknown;
+    if(step)
+        visit_stmt(*step, unknown);
+    facts = std::move(invariant);
+}
+
+bool BoundsCheckEliminator::visit_scope(scope_err_ptr_var& node, Facts& facts)
+{
+    auto* scope = std::get_if<scope_ptr>(&node);
+    if(!scope)
+        return true;
+    auto* stmts = std::get_if<std::vector<statements_ptr_var>>(&(*scope)->stmts);
+    if(!stmts)
+        return true;
+    bool falls_through = true;
+    for(auto& stmt : *stmts) { falls_through &= visit_stmt(stmt, facts); }
+    return falls_through;
+}
+
+void BoundsCheckEliminator::visit_expr(expression_ptr_var& node, const Facts& facts)
+{
+    std::visit(Overload{[this, &facts](expression_ptr& expr)
+                        {
+                            visit_expr(expr->lhs, facts);
+                            visit_expr(expr->rhs, facts);
+                            check_operands(*expr, facts);
+                        },
+                        [this, &facts](call_ptr& call)
+                        {
+                            for(auto& arg : call->args) { visit_expr(arg, facts); }
+                        },
+                        [this, &facts](index_ptr& index)
+                        {
+                            visit_expr(index->index, facts);
+                            if(index->bounds_checked && in_bounds(index->name, index->index, facts))
+                            {
+                                index->bounds_checked = false;
+                                removed_++;
+                            }
+                        },
+                        [](auto&&) {}},
+               node);
+}
+
+bool BoundsCheckEliminator::in_bounds(std::string_view name, expression_ptr_var& index,
+                                      const Facts& facts) const
+{
+    auto it = lengths_.find(name);
+    if(it == lengths_.end())
+        return false;
+    auto range = range_of(index, facts);
+    return range.lo.has_value() && range.hi.has_value() && *range.lo >= 0 &&
+           static_cast<uint64_t>(*range.hi) < it->second;
+}
+
+// A divisor that is never 0, nor -1 with a dividend that can be the smallest value of a
+// signed type, needs no check. Neither does a shift count below the width
+void BoundsCheckEliminator::check_operands(ASTExpression& expr, const Facts& facts)
+{
+    const bool shift = expr.op == Operator::LSH || expr.op == Operator::RSH;
+    if(!shift && expr.op != Operator::DIV && expr.op != Operator::MOD)
+        return;
+    auto type = expr.operand_type ? expr.operand_type : expr.type;
+    if(!type || !type->is_integer())
+        return;
+    const auto lhs = range_of(expr.lhs, facts);
+    const auto rhs = range_of(expr.rhs, facts);
+
+    bool safe;
+    if(shift)
+        safe = rhs.lo.has_value() && *rhs.lo >= 0 && rhs.hi.has_value() &&
+               static_cast<uint64_t>(*rhs.hi) < type->size() * 8;
+    else
+    {
+        const bool nonzero = (rhs.lo.has_value() && *rhs.lo > 0) ||
+                             (rhs.hi.has_value() && *rhs.hi < 0);
+        const bool no_overflow = !type->is_signed() || (rhs.lo.has_value() && *rhs.lo > -1) ||
+                                 (rhs.hi.has_value() && *rhs.hi < -1) ||
+                                 (lhs.lo.has_value() && type->min_value().has_value() &&
+                                  *lhs.lo > *type->min_value());
+        safe = nonzero && no_overflow;
+    }
+    if(expr.checked && safe)
+    {
+        expr.checked = false;
+        removed_guards_++;
+    }
+
+    const bool lhs_non_negative = lhs.lo.has_value() && *lhs.lo >= 0;
+    const bool rhs_non_negative = shift || (rhs.lo.has_value() && *rhs.lo >= 0);
+    if(type->is_signed() && expr.op != Operator::LSH && lhs_non_negative && rhs_non_negative)
+        expr.non_negative = true;
+}
+
+// Values node may evaluate to, always within the bounds of its type
+BoundsCheckEliminator::Range BoundsCheckEliminator::range_of(expression_ptr_var& node,
+                                                             const Facts& facts) const
+{
+    auto [type_lo, type_hi] = type_bounds(type_of(node));
+    Range range = std::visit(
+        Overload{[](integer_ptr& integer) -> Range
+                 {
+                     if(integer->above_i64)
+                         return {};
+                     return {integer->value, integer->value};
+                 },
+                 [&facts](identifier_ptr& ident) -> Range
+                 {
+                     auto it = facts.find(ident->name);
+                     if(it == facts.end())
+                         return {};
+                     return it->second;
+                 },
+                 [this, &facts](expression_ptr& expr) -> Range
+                 {
+                     auto lhs = range_of(expr->lhs, facts);
+                     auto rhs = range_of(expr->rhs, facts);
+                     switch(expr->op)
+                     {
+                     case Operator::ADD:
+                         return {checked_add(lhs.lo, rhs.lo), checked_add(lhs.hi, rhs.hi)};
+                     case Operator::SUB:
+                         return {checked_sub(lhs.lo, rhs.hi), checked_sub(lhs.hi, rhs.lo)};
+                     case Operator::BAND:
+                         // masking with a non-negative value clears the sign bit
+                         if(rhs.lo.has_value() && *rhs.lo >= 0)
+                             return {0, rhs.hi};
+                         if(lhs.lo.has_value() && *lhs.lo >= 0)
+                             return {0, lhs.hi};
+                         return {};
+                     case Operator::MUL:
+                         {
+                             auto [lo, hi] = corners(checked_mul, lhs.lo, lhs.hi, rhs.lo, rhs.hi);
+                             return {lo, hi};
+                         }
+                     case Operator::DIV:
+                         {
+                             // the quotient is monotonic in both operands while the divisor
+                             // keeps its sign
+                             if(!rhs.lo.has_value() || !rhs.hi.has_value() ||
+                                (*rhs.lo <= 0 && *rhs.hi >= 0))
+                                 return {};
+                             auto [lo, hi] = corners(checked_div, lhs.lo, lhs.hi, rhs.lo, rhs.hi);
+                             return {lo, hi};
+                         }
+                     case Operator::MOD:
+                         // the remainder takes the sign of the dividend
+                         if(!rhs.lo.has_value() || *rhs.lo <= 0 || !rhs.hi.has_value())
+                             return {};
+                         if(lhs.lo.has_value() && *lhs.lo >= 0)
+                             return {0, *rhs.hi - 1};
+                         return {1 - *rhs.hi, *rhs.hi - 1};
+                     case Operator::RSH:
+                         {
+                             // a count of the width or more is masked, not a shift to zero
+                             auto type = expr->operand_type ? expr->operand_type : expr->type;
+                             if(!type || !lhs.lo.has_value() || *lhs.lo < 0 ||
+                                !lhs.hi.has_value() || !rhs.lo.has_value() || *rhs.lo < 0 ||
+                                !rhs.hi.has_value() ||
+                                static_cast<uint64_t>(*rhs.hi) >= type->size() * 8)
+                                 return {};
+                             return {*lhs.lo >> *rhs.hi, *lhs.hi >> *rhs.lo};
+                         }
+                     default:
+                         return {};
+                     }
+                 },
+                 [](auto&&) -> Range { return {}; }},
+        node);
+
+    // a result outside the type wraps around, so nothing is known about it
+    auto outside = [&](std::optional<int64_t> value)
+    {
+        return value.has_value() && ((type_lo.has_value() && *value < *type_lo) ||
+                                     (type_hi.has_value() && *value > *type_hi));
+    };
+    if(outside(range.lo) || outside(range.hi))
+        range = {};
+    if(!range.lo.has_value())
+        range.lo = type_lo;
+    if(!range.hi.has_value())
+        range.hi = type_hi;
+    return range;
+}
+
+// A false condition tells as much as a true one, !(a || b) narrows by both !a and !b
+void BoundsCheckEliminator::refine(expression_ptr_var& cond, Facts& facts, bool holds) const
+{
+    auto* expr = std::get_if<expression_ptr>(&cond);
+    if(!expr)
+        return;
+    if((*expr)->op == Operator::NOT)
+    {
+        refine((*expr)->lhs, facts, !holds);
+        return;
+    }
+    if((*expr)->op == (holds ? Operator::AND : Operator::OR))
+    {
+        refine((*expr)->lhs, facts, holds);
+        refine((*expr)->rhs, facts, holds);
+        return;
+    }
+
+    auto* ident = std::get_if<identifier_ptr>(&(*expr)->lhs);
+    expression_ptr_var* other = &(*expr)->rhs;
+    Operator op = holds ? (*expr)->op : negate_operator((*expr)->op);
+    if(!ident)
+    {
+        ident = std::get_if<identifier_ptr>(&(*expr)->rhs);
+        other = &(*expr)->lhs;
+        op = mirror_operator(op);
+    }
+    if(!ident || !(*ident)->type || !(*ident)->type->is_integer())
+        return;
+
+    const auto bound = range_of(*other, facts);
+    Range& range = facts[(*ident)->name];
+    auto tighten_hi = [&range](std::optional<int64_t> hi)
+    {
+        if(hi.has_value() && (!range.hi.has_value() || *hi < *range.hi))
+            range.hi = hi;
+    };
+    auto tighten_lo = [&range](std::optional<int64_t> lo)
+    {
+        if(lo.has_value() && (!range.lo.has_value() || *lo > *range.lo))
+            range.lo = lo;
+    };
+    switch(op)
+    {
+    case Operator::LESS:
+        tighten_hi(checked_sub(bound.hi, 1));
+        break;
+    case Operator::LESSEQ:
+        tighten_hi(bound.hi);
+        break;
+    case Operator::GREATER:
+        tighten_lo(checked_add(bound.lo, 1));
+        break;
+    case Operator::GREATEREQ:
+        tighten_lo(bound.lo);
+        break;
+    case Operator::EQ:
+        tighten_lo(bound.lo);
+        tighten_hi(bound.hi);
+        break;
+    case Operator::NEQ:
+        {
+            // only a value at either end of the range can be excluded
+            if(!bound.lo.has_value() || bound.lo != bound.hi)
+                break;
+            auto [type_lo, type_hi] = type_bounds((*ident)->type);
+            tighten_lo(type_lo);
+            tighten_hi(type_hi);
+            if(range.lo == bound.lo)
+                range.lo = checked_add(range.lo, 1);
+            else if(range.hi == bound.hi)
+                range.hi = checked_sub(range.hi, 1);
+            break;
+        }
+    default:
+        break;
+    }
+}
+
+void BoundsCheckEliminator::assign(std::string_view name, expression_ptr_var& value,
+                                   Facts& facts) const
+{
+    auto range = range_of(value, facts);
+    if(!range.lo.has_value() && !range.hi.has_value())
+        facts.erase(name);
+    else
+        facts[name] = range;
+}
+
+// Records how each variable assigned in a loop body changes per iteration. Only v = v + c
+// and v = v - c outside nested loops have a direction, anything else makes v unknown
+void BoundsCheckEliminator::collect_steps(statements_ptr_var& node, Steps& steps,
+                                          bool nested) const
+{
+    std::visit(Overload{[this, &steps, nested](scope_ptr& scope)
+                        {
+                            auto* stmts =
+                                std::get_if<std::vector<statements_ptr_var>>(&scope->stmts);
+                            if(!stmts)
+                                return;
+                            for(auto& stmt : *stmts) { collect_steps(stmt, steps, nested); }
+                        },
+                        [this, &steps, nested](if_ptr& _if)
+                        {
+                            collect_steps(_if->scope, steps, nested);
+                            if(!_if->else_clause.has_value())
+                                return;
+                            if(auto* _else = std::get_if<else_ptr>(&_if->else_clause.value()))
+                                collect_steps((*_else)->scope, steps, nested);
+                        },
+                        [this, &steps](while_ptr& _while)
+                        { collect_steps(_while->scope, steps, true); },
+                        [this, &steps](for_ptr& _for)
+                        {
+                            if(_for->init.has_value())
+                                collect_steps(_for->init.value(), steps, true);
+                            if(_for->step.has_value())
+                                collect_steps(_for->step.value(), steps, true);
+                            collect_steps(_for->scope, steps, true);
+                        },
+                        [&steps](declareassign_ptr& declassign)
+                        { steps[declassign->name] = {Step::Direction::UNKNOWN, 0}; },
+                        [&steps](declare_ptr& declare)
+                        { steps[declare->name] = {Step::Direction::UNKNOWN, 0}; },
+                        [this, &steps, nested](assign_ptr& _assign)
+                        {
+                            if(!_assign->index.has_value())
+                                add_step(_assign->name, _assign->expr, steps, nested);
+                        },
+                        [](auto&&) {}},
+               node);
+}
+
+void BoundsCheckEliminator::collect_steps(scope_err_ptr_var& node, Steps& steps, bool nested) const
+{
+    auto* scope = std::get_if<scope_ptr>(&node);
+    if(!scope)
+        return;
+    auto* stmts = std::get_if<std::vector<statements_ptr_var>>(&(*scope)->stmts);
+    if(!stmts)
+        return;
+    for(auto& stmt : *stmts) { collect_steps(stmt, steps, nested); }
+}
+
+void BoundsCheckEliminator::add_step(std::string_view name, expression_ptr_var& value,
+                                     Steps& steps, bool nested) const
+{
+    std::optional<int64_t> delta;
+    auto is_self = [name](expression_ptr_var& operand)
+    {
+        auto* ident = std::get_if<identifier_ptr>(&operand);
+        return ident && (*ident)->name == name;
+    };
+    auto constant = [](expression_ptr_var& operand) -> std::optional<int64_t>
+    {
+        auto* literal = std::get_if<integer_ptr>(&operand);
+        if(!literal || (*literal)->above_i64)
+            return std::nullopt;
+        return (*literal)->value;
+    };
+    if(auto* expr = std::get_if<expression_ptr>(&value))
+    {
+        if((*expr)->op == Operator::ADD && is_self((*expr)->lhs))
+            delta = constant((*expr)->rhs);
+        else if((*expr)->op == Operator::ADD && is_self((*expr)->rhs))
+            delta = constant((*expr)->lhs);
+        else if((*expr)->op == Operator::SUB && is_self((*expr)->lhs))
+            delta = checked_sub(0, constant((*expr)->rhs));
+    }
+
+    auto it = steps.find(name);
+    if(nested || !delta.has_value() || *delta == INT64_MIN)
+    {
+        steps[name] = {Step::Direction::UNKNOWN, 0};
+        return;
+    }
+    const auto direction = *delta >= 0 ? Step::Direction::INCREASING : Step::Direction::DECREASING;
+    const int64_t magnitude = *delta >= 0 ? *delta : -*delta;
+    if(it == steps.end())
+    {
+        steps[name] = {direction, magnitude};
+        return;
+    }
+    auto total = checked_add(it->second.total, magnitude);
+    if(it->second.direction != direction || !total.has_value())
+        it->second = {Step::Direction::UNKNOWN, 0};
+    else
+        it->second.total = *total;
+}
+
+// Will return true when value is known and fits the declared type of name
+bool BoundsCheckEliminator::fits(std::string_view name, std::optional<int64_t> value) const
+{
+    auto it = types_.find(name);
+    if(!value.has_value() || it == types_.end() || !it->second)
+        return false;
+    return it->second->can_represent(*value);
+}
+
+BoundsCheckEliminator::Facts BoundsCheckEliminator::merge(const Facts& a, const Facts& b)
+{
+    Facts merged;
+    for(const auto& [name, range] : a)
+    {
+        auto it = b.find(name);
+        if(it == b.end())
+            continue;
+        Range hull;
+        if(range.lo.has_value() && it->second.lo.has_value())
+            hull.lo = std::min(*range.lo, *it->second.lo);
+        if(range.hi.has_value() && it->second.hi.has_value())
+            hull.hi = std::max(*range.hi, *it->second.hi);
+        merged[name] = hull;
+    }
+    return merged;
+}
@@ -0,0 +1,82 @@
+#ifndef BOUNDS_CHECK_HPP
+#define BOUNDS_CHECK_HPP
+
+#pragma once
+#include "ast_def.hpp"
+#include "semantics.hpp"
+#include <map>
+#include <optional>
+
+// Runs after semantic analysis. Tracks the range of integer variables through the program and
+// clears bounds_checked on array accesses whose index is always inside the array, e.g. a[i]
+// in the body of while(i < 8) when i starts at 0 and only ever increases. Divisions and
+// shifts whose operands are always in range lose their checks the same way
+class BoundsCheckEliminator {
+  public:
+    BoundsCheckEliminator(program_ptr&& program);
+
+    program_ptr&& run();
+
+    size_t removed_checks() const;
+
+    size_t removed_guards() const;
+
+  private:
+    struct Range {
+        std::optional<int64_t> lo;
+        std::optional<int64_t> hi;
+    };
+
+    // how one iteration of a loop body changes a variable
+    struct Step {
+        enum class Direction : char {
+            INCREASING,
+            DECREASING,
+            UNKNOWN,
+        } direction;
+        int64_t total; // largest change in one iteration
+    };
+
+    using Steps = std::map<std::string_view, Step, std::less<>>;
+
+    using Facts = std::map<std::string_view, Range, std::less<>>;
+
+    program_ptr program_;
+    std::map<std::string_view, size_t, std::less<>> lengths_;
+    std::map<std::string_view, std::shared_ptr<type::BuiltinType>, std::less<>> types_;
+    size_t removed_ = 0;
+    size_t removed_guards_ = 0;
+
+    bool visit_stmt(statements_ptr_var& node, Facts& facts);
+
+    bool visit_scope(scope_err_ptr_var& node, Facts& facts);
+
+    void visit_loop(expression_ptr_var& cond, scope_err_ptr_var& scope, statements_ptr_var* step,
+                    Facts& facts);
+
+    void visit_expr(expression_ptr_var& node, const Facts& facts);
+
+    bool in_bounds(std::string_view name, expression_ptr_var& index, const Facts& facts) const;
+
+    void check_operands(ASTExpression& expr, const Facts& facts);
+
+    Range range_of(expression_ptr_var& node, const Facts& facts) const;
+
+    // Narrows facts to what holds when cond evaluates to holds
+    void refine(expression_ptr_var& cond, Facts& facts, bool holds = true) const;
+
+    void assign(std::string_view name, expression_ptr_var& value, Facts& facts) const;
+
+    void collect_steps(statements_ptr_var& node, Steps& steps, bool nested) const;
+
+    void collect_steps(scope_err_ptr_var& node, Steps& steps, bool nested) const;
+
+    void add_step(std::string_view name, expression_ptr_var& value, Steps& steps,
+                  bool nested) const;
+
+    bool fits(std::string_view name, std::optional<int64_t> value) const;
+
+    static Facts merge(const Facts& a, const Facts& b);
+};
+
+#endif // BOUNDS_CHECK_HPP
@@ -0,0 +1,174 @@
+#include "calls.hpp"
+
+CallAnalyzer::CallAnalyzer(program_ptr&& program) : program_(std::move(program)) {}
+
+program_ptr&& CallAnalyzer::run()
+{
+    for(auto& stmt : program_->stmts)
+    {
+        auto* function = std::get_if<function_ptr>(&stmt);
+        if(!function || !(*function)->return_type)
+            continue;
+        std::vector<std::shared_ptr<type::BuiltinType>> params;
+        for(auto& param : (*function)->params) { params.push_back(param.type); }
+        layouts_[(*function)->name] = target::assign_arguments(params, (*function)->return_type);
+    }
+
+    for(auto& stmt : program_->stmts)
+    {
+        auto* function = std::get_if<function_ptr>(&stmt);
+        if(!function || !layouts_.contains((*function)->name))
+            continue;
+        mark_tail_calls((*function)->body, **function);
+        (*function)->leaf = count_calls((*function)->body) == 0;
+    }
+    return std::move(program_);
+}
+
+const target::CallLayout* CallAnalyzer::layout(std::string_view function) const
+{
+    auto it = layouts_.find(function);
+    if(it == layouts_.end())
+        return nullptr;
+    return &it->second;
+}
+
+// Every return leaves the function, so a call that is returned directly is in tail position
+void CallAnalyzer::mark_tail_calls(statements_ptr_var& node, const ASTFunction& caller)
+{
+    std::visit(Overload{[this, &caller](scope_ptr& scope)
+                        {
+                            auto* stmts =
+                                std::get_if<std::vector<statements_ptr_var>>(&scope->stmts);
+                            if(!stmts)
+                                return;
+                            for(auto& stmt : *stmts) { mark_tail_calls(stmt, caller); }
+                        },
+                        [this, &caller](return_ptr& _return)
+                        {
+                            auto* call = std::get_if<call_ptr>(&_return->val);
+                            if(call && is_tail_call(**call, caller))
+                                (*call)->tail_call = true;
+                        },
+                        [this, &caller](if_ptr& _if)
+                        {
+                            mark_tail_calls(_if->scope, caller);
+                            if(!_if->else_clause.has_value())
+                                return;
+                            if(auto* _else = std::get_if<else_ptr>(&_if->else_clause.value()))
+                                mark_tail_calls((*_else)->scope, caller);
+                        },
+                        [this, &caller](while_ptr& _while)
+                        { mark_tail_calls(_while->scope, caller); },
+                        [this, &caller](for_ptr& _for)
+                        { mark_tail_calls(_for->scope, caller); },
+                        [](auto&&) {}},
+               node);
+}
+
+void CallAnalyzer::mark_tail_calls(scope_err_ptr_var& node, const ASTFunction& caller)
+{
+    auto* scope = std::get_if<scope_ptr>(&node);
+    if(!scope)
+        return;
+    auto* stmts = std::get_if<std::vector<statements_ptr_var>>(&(*scope)->stmts);
+    if(!stmts)
+        return;
+    for(auto& stmt : *stmts) { mark_tail_calls(stmt, caller); }
+}
+
+// The jump reuses the caller's incoming stack argument area and returns straight to the
+// caller's caller, so the callee's stack arguments must fit in it and no conversion of the
+// result may be left to do
+bool CallAnalyzer::is_tail_call(const ASTCall& call, const ASTFunction& caller) const
+{
+    if(call.intrinsic != Intrinsic::NONE || call.type != caller.return_type)
+        return false;
+    auto callee = layouts_.find(call.callee);
+    auto own = layouts_.find(caller.name);
+    if(callee == layouts_.end() || own == layouts_.end())
+        return false;
+    return callee->second.stack_bytes <= own->second.stack_bytes;
+}
+
+// Counts calls that return to the function, intrinsics are emitted inline and are not calls
+size_t CallAnalyzer::count_calls(statements_ptr_var& node) const
+{
+    return std::visit(
+        Overload{[this](scope_ptr& scope) -> size_t
+                 {
+                     auto* stmts = std::get_if<std::vector<statements_ptr_var>>(&scope->stmts);
+                     size_t calls = 0;
+                     if(stmts)
+                         for(auto& stmt : *stmts) { calls += count_calls(stmt); }
+                     return calls;
+                 },
+                 [this](return_ptr& _return) -> size_t { return count_calls(_return->val); },
+                 [this](if_ptr& _if) -> size_t
+                 {
+                     size_t calls = count_calls(_if->condition) + count_calls(_if->scope);
+                     if(!_if->else_clause.has_value())
+                         return calls;
+                     if(auto* _else = std::get_if<else_ptr>(&_if->else_clause.value()))
+                     {
+                         if((*_else)->condition.has_value())
+                             calls += count_calls((*_else)->condition.value());
+                         calls += count_calls((*_else)->scope);
+                     }
+                     return calls;
+                 },
+                 [this](while_ptr& _while) -> size_t
+                 { return count_calls(_while->condition) + count_calls(_while->scope); },
+                 [this](for_ptr& _for) -> size_t
+                 {
+                     size_t calls = count_calls(_for->condition) + count_calls(_for->scope);
+                     if(_for->init.has_value())
+                         calls += count_calls(_for->init.value());
+                     if(_for->step.has_value())
+                         calls += count_calls(_for->step.value());
+                     return calls;
+                 },
+                 [this](declareassign_ptr& declassign) -> size_t
+                 { return count_calls(declassign->expr); },
+                 [this](assign_ptr& assign) -> size_t
+                 {
+                     size_t calls = count_calls(assign->expr);
+                     if(assign->index.has_value())
+                         calls += count_calls(assign->index.value());
+                     return calls;
+                 },
+                 [this](callstmt_ptr& stmt) -> size_t { return count_calls(stmt->call); },
+                 [](auto&&) -> size_t { return 0; }},
+        node);
+}
+
+size_t CallAnalyzer::count_calls(scope_err_ptr_var& node) const
+{
+    auto* scope = std::get_if<scope_ptr>(&node);
+    if(!scope)
+        return 0;
+    auto* stmts = std::get_if<std::vector<statements_ptr_var>>(&(*scope)->stmts);
+    if(!stmts)
+        return 0;
+    size_t calls = 0;
+    for(auto& stmt : *stmts) { calls += count_calls(stmt); }
+    return calls;
+}
+
+size_t CallAnalyzer::count_calls(expression_ptr_var& node) const
+{
+    return std::visit(
+        Overload{[this](expression_ptr& expr) -> size_t
+                 { return count_calls(expr->lhs) + count_calls(expr->rhs); },
+                 [this](index_ptr& index) -> size_t { return count_calls(index->index); },
+                 [this](call_ptr& call) -> size_t
+                 {
+                     size_t calls = 0;
+                     for(auto& arg : call->args) { calls += count_calls(arg); }
+                     if(call->intrinsic == Intrinsic::NONE && !call->tail_call)
+                         calls++;
+                     return calls;
+                 },
+                 [](auto&&) -> size_t { return 0; }},
+        node);
+}
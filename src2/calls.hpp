@@ -0,0 +1,38 @@
+#ifndef CALLS_HPP
+#define CALLS_HPP
+
+#pragma once
+#include "ast_def.hpp"
+#include "semantics.hpp"
+#include "target.hpp"
+#include <map>
+
+// Runs after semantic analysis. Assigns argument registers to every function, marks calls in
+// return position as tail calls and marks functions that make no other calls as leaves
+class CallAnalyzer {
+  public:
+    CallAnalyzer(program_ptr&& program);
+
+    program_ptr&& run();
+
+    // nullptr for names that are not user functions
+    const target::CallLayout* layout(std::string_view function) const;
+
+  private:
+    program_ptr program_;
+    std::map<std::string_view, target::CallLayout, std::less<>> layouts_;
+
+    void mark_tail_calls(statements_ptr_var& node, const ASTFunction& caller);
+
+    void mark_tail_calls(scope_err_ptr_var& node, const ASTFunction& caller);
+
+    bool is_tail_call(const ASTCall& call, const ASTFunction& caller) const;
+
+    size_t count_calls(statements_ptr_var& node) const;
+
+    size_t count_calls(scope_err_ptr_var& node) const;
+
+    size_t count_calls(expression_ptr_var& node) const;
+};
+
+#endif // CALLS_HPP
@@ -0,0 +1,237 @@
+#include "const_eval.hpp"
+
+ConstantEvaluator::ConstantEvaluator(const Constants& constants, ErrorReporter& reporter)
+    : constants_(constants), reporter_(&reporter)
+{
+}
+
+ConstantEvaluator::ConstantEvaluator(const Constants& constants)
+    : constants_(constants), reporter_(nullptr)
+{
+}
+
+void ConstantEvaluator::fold(expression_ptr_var& node) const
+{
+    if(auto* call = std::get_if<call_ptr>(&node))
+    {
+        for(auto& arg : (*call)->args) { fold(arg); }
+        return;
+    }
+    if(auto* index = std::get_if<index_ptr>(&node))
+    {
+        fold((*index)->index);
+        return;
+    }
+    if(auto* ident = std::get_if<identifier_ptr>(&node))
+    {
+        auto it = constants_.find((*ident)->name);
+        if(it == constants_.end())
+            return;
+        auto folded = literal((*ident)->loc, it->second);
+        if(folded.has_value())
+            node = std::move(folded.value());
+        return;
+    }
+
+    auto* expr = std::get_if<expression_ptr>(&node);
+    if(!expr)
+        return;
+    fold((*expr)->lhs);
+    fold((*expr)->rhs);
+    if(!(*expr)->operand_type || !(*expr)->type)
+        return;
+
+    // NOT is unary, its right hand side is left empty by the parser
+    auto lhs = value_of((*expr)->lhs);
+    auto rhs = (*expr)->op == Operator::NOT ? lhs : value_of((*expr)->rhs);
+    if(!lhs.has_value() || !rhs.has_value())
+        return;
+    auto result = evaluate(**expr, lhs.value(), rhs.value());
+    if(!result.has_value())
+        return;
+    auto folded = literal((*expr)->loc, result.value());
+    if(folded.has_value())
+        node = std::move(folded.value());
+}
+
+std::optional<ConstantEvaluator::Value> ConstantEvaluator::value_of(expression_ptr_var& node)
+{
+    auto& registry = type::TypeRegistry::instance();
+    if(auto* boolean = std::get_if<boolean_ptr>(&node))
+        return Value{(*boolean)->value ? 1 : 0, registry._bool_()};
+    auto* integer = std::get_if<integer_ptr>(&node);
+    if(!integer)
+        return std::nullopt;
+
+    // literals that were never converted keep the type the analyzer gives them
+    auto type = (*integer)->type;
+    if(!type && (*integer)->above_i64)
+        type = registry._u64_();
+    else if(!type)
+        type = registry._int_()->can_represent((*integer)->value) ? registry._int_()
+                                                                  : registry._i64_();
+    return Value{(*integer)->value, type};
+}
+
+int64_t ConstantEvaluator::wrap(uint64_t bits, const type::BuiltinType& type)
+{
+    const size_t width = type.size() * 8;
+    if(width >= 64)
+        return static_cast<int64_t>(bits);
+    bits &= (uint64_t{1} << width) - 1;
+    if(type.is_signed() && (bits >> (width - 1)) != 0)
+        bits |= ~uint64_t{0} << width;
+    return static_cast<int64_t>(bits);
+}
+
+// Operands are converted to the operand type first, except the count of a shift which keeps
+// its own type
+std::optional<ConstantEvaluator::Value>
+ConstantEvaluator::evaluate(ASTExpression& expr, Value lhs, Value rhs) const
+{
+    auto& registry = type::TypeRegistry::instance();
+    auto& operand = *expr.operand_type;
+    if(expr.operand_type == registry._bool_())
+    {
+        const bool a = lhs.bits != 0;
+        const bool b = rhs.bits != 0;
+        switch(expr.op)
+        {
+        case Operator::AND:
+            return Value{a && b, expr.type};
+        case Operator::OR:
+            return Value{a || b, expr.type};
+        case Operator::XOR:
+            return Value{a != b, expr.type};
+        case Operator::NOT:
+            return Value{!a, expr.type};
+        default:
+            return std::nullopt;
+        }
+    }
+    if(!operand.is_integer())
+        return std::nullopt;
+
+    const int64_t a = wrap(static_cast<uint64_t>(lhs.bits), operand);
+    const int64_t b = wrap(static_cast<uint64_t>(rhs.bits), operand);
+    const uint64_t ua = static_cast<uint64_t>(a);
+    const uint64_t ub = static_cast<uint64_t>(b);
+    const bool is_signed = operand.is_signed();
+    // the count is masked like the hardware does, to 6 bits for 64-bit operands and 5 otherwise
+    const uint64_t count = static_cast<uint64_t>(rhs.bits) & (operand.size() == 8 ? 63 : 31);
+
+    std::optional<uint64_t> bits;
+    switch(expr.op)
+    {
+    case Operator::ADD:
+        bits = ua + ub;
+        break;
+    case Operator::SUB:
+        bits = ua - ub;
+        break;
+    case Operator::MUL:
+        bits = ua * ub;
+        break;
+    case Operator::DIV:
+    case Operator::MOD:
+        {
+            auto result = divide(expr, a, b);
+            if(!result.has_value())
+                return std::nullopt;
+            bits = static_cast<uint64_t>(result.value());
+            break;
+        }
+    case Operator::LSH:
+        bits = ua << count;
+        break;
+    case Operator::RSH:
+        bits = is_signed ? static_cast<uint64_t>(a >> count) : ua >> count;
+        break;
+    case Operator::BAND:
+        bits = ua & ub;
+        break;
+    case Operator::BOR:
+        bits = ua | ub;
+        break;
+    case Operator::XOR:
+        bits = ua ^ ub;
+        break;
+    case Operator::LESS:
+        bits = is_signed ? a < b : ua < ub;
+        break;
+    case Operator::GREATER:
+        bits = is_signed ? a > b : ua > ub;
+        break;
+    case Operator::LESSEQ:
+        bits = is_signed ? a <= b : ua <= ub;
+        break;
+    case Operator::GREATEREQ:
+        bits = is_signed ? a >= b : ua >= ub;
+        break;
+    case Operator::EQ:
+        bits = a == b;
+        break;
+    case Operator::NEQ:
+        bits = a != b;
+        break;
+    default:
+        return std::nullopt;
+    }
+    return Value{wrap(bits.value(), *expr.type), expr.type};
+}
+
+// Both operands are already wrapped to the operand type. Division by zero and the one signed
+// quotient that does not fit, MIN / -1, raise a divide error at runtime and are reported here
+// when there is a reporter
+std::optional<int64_t> ConstantEvaluator::divide(ASTExpression& expr, int64_t lhs, int64_t rhs) const
+{
+    const bool remainder = expr.op == Operator::MOD;
+    if(rhs == 0)
+    {
+        if(reporter_)
+            reporter_->report_error(expr.loc,
+                                    "Division by zero in constant expression on line " +
+                                        std::to_string(expr.loc.line),
+                                    ErrorType::SEMANTIC);
+        return std::nullopt;
+    }
+
+    auto& operand = *expr.operand_type;
+    if(!operand.is_signed())
+    {
+        const uint64_t a = static_cast<uint64_t>(lhs);
+        const uint64_t b = static_cast<uint64_t>(rhs);
+        return static_cast<int64_t>(remainder ? a % b : a / b);
+    }
+    if(rhs == -1)
+    {
+        if(lhs == operand.min_value())
+        {
+            if(reporter_)
+                reporter_->report_error(
+                    expr.loc,
+                    "Signed division overflow in constant expression on line " +
+                        std::to_string(expr.loc.line),
+                    ErrorType::SEMANTIC);
+            return std::nullopt;
+        }
+        return remainder ? 0 : -lhs;
+    }
+    return remainder ? lhs % rhs : lhs / rhs;
+}
+
+// A u64 above the int64_t range has no literal form and is left to be computed at runtime
+std::optional<expression_ptr_var> ConstantEvaluator::literal(SourceLocation& loc, Value value) const
+{
+    if(value.type == type::TypeRegistry::instance()._bool_())
+    {
+        auto boolean = builder_.build_boolean(loc, value.bits != 0);
+        boolean->type = value.type;
+        return boolean;
+    }
+    if(!value.type->can_represent(value.bits))
+        return std::nullopt;
+    auto integer = builder_.build_integer(loc, value.bits);
+    integer->type = value.type;
+    return integer;
+}
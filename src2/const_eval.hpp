@@ -0,0 +1,50 @@
+#ifndef CONST_EVAL_HPP
+#define CONST_EVAL_HPP
+
+#pragma once
+#include "ast_builder.hpp"
+#include "ast_def.hpp"
+#include "errors.hpp"
+#include <map>
+#include <optional>
+
+// Evaluates integer and boolean expressions at compile time. Every operation is done in the
+// operand type the semantic analyzer picked and wrapped to its width, so the result is the one
+// the x86-64 instruction would produce at runtime
+class ConstantEvaluator {
+  public:
+    struct Value {
+        int64_t bits; // sign or zero extended from the width of type, bools are 0 or 1
+        std::shared_ptr<type::BuiltinType> type;
+    };
+
+    using Constants = std::map<std::string_view, Value, std::less<>>;
+
+    ConstantEvaluator(const Constants& constants, ErrorReporter& reporter);
+
+    // Operations that would fault at runtime are left in place without being reported
+    explicit ConstantEvaluator(const Constants& constants);
+
+    // Replaces constant subexpressions of node by literals, bottom up. Operations that would
+    // fault at runtime are reported and left in place
+    void fold(expression_ptr_var& node) const;
+
+    // Value of a literal, nullopt for anything else
+    static std::optional<Value> value_of(expression_ptr_var& node);
+
+    // Truncates bits to the width of type and extends them back by its signedness
+    static int64_t wrap(uint64_t bits, const type::BuiltinType& type);
+
+    std::optional<expression_ptr_var> literal(SourceLocation& loc, Value value) const;
+
+  private:
+    const Constants& constants_;
+    ErrorReporter* reporter_;
+    ASTBuilder builder_;
+
+    std::optional<Value> evaluate(ASTExpression& expr, Value lhs, Value rhs) const;
+
+    std::optional<int64_t> divide(ASTExpression& expr, int64_t lhs, int64_t rhs) const;
+};
+
+#endif // CONST_EVAL_HPP
@@ -0,0 +1,402 @@
+#include "const_prop.hpp"
+
+ConstantPropagator::ConstantPropagator(program_ptr&& program)
+    : program_(std::move(program)), evaluator_(no_constants_)
+{
+}
+
+// Top level statements after a return are not reached, functions declared there still are
+program_ptr&& ConstantPropagator::run()
+{
+    bool reachable = true;
+    for(auto& stmt : program_->stmts)
+    {
+        if(reachable || std::holds_alternative<function_ptr>(stmt))
+            reachable = visit_stmt(stmt) && reachable;
+    }
+    return std::move(program_);
+}
+
+size_t ConstantPropagator::removed_branches() const
+{
+    return removed_branches_;
+}
+
+bool ConstantPropagator::visit_stmt(statements_ptr_var& node)
+{
+    if(auto* _if = std::get_if<if_ptr>(&node))
+        return visit_if(node, **_if);
+
+    if(auto* _while = std::get_if<while_ptr>(&node))
+    {
+        if(false_on_entry((*_while)->condition))
+        {
+            node = builder_.build_scope((*_while)->loc, std::vector<statements_ptr_var>{});
+            removed_branches_++;
+            return true;
+        }
+        std::set<std::string_view> assigned;
+        collect_assigned((*_while)->scope, assigned);
+        kill(assigned);
+        propagate((*_while)->condition);
+        // the state at the loop head holds on every iteration and after the loop
+        auto head = state_;
+        visit_scope((*_while)->scope);
+        state_ = std::move(head);
+        return true;
+    }
+
+    if(auto* loop = std::get_if<for_ptr>(&node))
+    {
+        auto& _for = **loop;
+        if(_for.init.has_value())
+            visit_stmt(_for.init.value());
+        if(false_on_entry(_for.condition))
+        {
+            if(_for.init.has_value())
+            {
+                // node owns init, move it out before replacing node
+                auto init = std::move(_for.init.value());
+                node = std::move(init);
+            }
+            else
+                node = builder_.build_scope(_for.loc, std::vector<statements_ptr_var>{});
+            removed_branches_++;
+            return true;
+        }
+        std::set<std::string_view> assigned;
+        collect_assigned(_for.scope, assigned);
+        if(_for.step.has_value())
+            collect_assigned(_for.step.value(), assigned);
+        kill(assigned);
+        propagate(_for.condition);
+        // continue reaches the step from anywhere in the body, only the head state is safe
+        auto head = state_;
+        visit_scope(_for.scope);
+        state_ = head;
+        if(_for.step.has_value())
+            visit_stmt(_for.step.value());
+        state_ = std::move(head);
+        return true;
+    }
+
+    return std::visit(
+        Overload{[this](scope_ptr& scope) { return visit_stmts(scope->stmts); },
+                 [this](return_ptr& _return)
+                 {
+                     propagate(_return->val);
+                     return false;
+                 },
+                 [](break_ptr&) { return false; },
+                 [](continue_ptr&) { return false; },
+                 [this](function_ptr& function)
+                 {
+                     visit_function(*function);
+                     return true;
+                 },
+                 [this](declareassign_ptr& declassign)
+                 {
+                     propagate(declassign->expr);
+                     types_[declassign->name] = declassign->type;
+                     define(declassign->name, declassign->expr);
+                     return true;
+                 },
+                 [this](declare_ptr& declaration)
+                 {
+                     types_[declaration->name] = declaration->type;
+                     kill(declaration->name);
+                     return true;
+                 },
+                 [this](assign_ptr& assign)
+                 {
+                     propagate(assign->expr);
+                     if(assign->index.has_value())
+                         propagate(assign->index.value());
+                     else
+                         define(assign->name, assign->expr);
+                     return true;
+                 },
+                 [this](callstmt_ptr& stmt)
+                 {
+                     propagate(stmt->call);
+                     return true;
+                 },
+                 [](auto&&) { return true; }},
+        node);
+}
+
+bool ConstantPropagator::visit_scope(scope_err_ptr_var& node)
+{
+    auto* scope = std::get_if<scope_ptr>(&node);
+    return !scope || visit_stmts((*scope)->stmts);
+}
+
+// Statements after one that does not fall through are dead and left alone
+bool ConstantPropagator::visit_stmts(scope_err_vec_ptr& node)
+{
+    auto* stmts = std::get_if<std::vector<statements_ptr_var>>(&node);
+    if(!stmts)
+        return true;
+    for(auto& stmt : *stmts)
+    {
+        if(!visit_stmt(stmt))
+            return false;
+    }
+    return true;
+}
+
+// A constant condition replaces the if by the branch that runs, which is then visited in its
+// place. if(false){} else(c){} becomes if(c){}
+bool ConstantPropagator::visit_if(statements_ptr_var& node, ASTIf& _if)
+{
+    propagate(_if.condition);
+    auto* _else = _if.else_clause.has_value() ? std::get_if<else_ptr>(&_if.else_clause.value())
+                                              : nullptr;
+    auto condition = condition_value(_if.condition);
+    if(condition.has_value())
+    {
+        removed_branches_++;
+        if(condition.value())
+            node = as_statement(std::move(_if.scope));
+        else if(!_else)
+            node = builder_.build_scope(_if.loc, std::vector<statements_ptr_var>{});
+        else if(!(*_else)->condition.has_value())
+            node = as_statement(std::move((*_else)->scope));
+        else
+        {
+            _if.condition = std::move((*_else)->condition.value());
+            _if.scope = std::move((*_else)->scope);
+            _if.else_clause.reset();
+        }
+        return visit_stmt(node);
+    }
+
+    auto entry = state_;
+    const bool then_reachable = visit_scope(_if.scope);
+    auto then_state = std::move(state_);
+    state_ = std::move(entry);
+
+    bool else_reachable = true;
+    if(_else && (*_else)->condition.has_value())
+    {
+        propagate((*_else)->condition.value());
+        auto else_condition = condition_value((*_else)->condition.value());
+        if(else_condition.has_value())
+        {
+            removed_branches_++;
+            if(else_condition.value())
+                (*_else)->condition.reset();
+            else
+            {
+                _if.else_clause.reset();
+                _else = nullptr;
+            }
+        }
+    }
+    if(_else)
+    {
+        // else(c) also falls through when c is false
+        auto skipped = state_;
+        else_reachable = visit_scope((*_else)->scope);
+        if((*_else)->condition.has_value())
+        {
+            state_ = else_reachable ? meet(state_, skipped) : std::move(skipped);
+            else_reachable = true;
+        }
+    }
+
+    if(then_reachable && else_reachable)
+        state_ = meet(then_state, state_);
+    else if(then_reachable)
+        state_ = std::move(then_state);
+    return then_reachable || else_reachable;
+}
+
+// Functions only see the top level constants, which are already folded into them
+void ConstantPropagator::visit_function(ASTFunction& function)
+{
+    auto outer_state = std::move(state_);
+    auto outer_types = std::move(types_);
+    state_ = {};
+    types_ = {};
+    for(auto& param : function.params) { types_[param.name] = param.type; }
+    visit_scope(function.body);
+    state_ = std::move(outer_state);
+    types_ = std::move(outer_types);
+}
+
+// The order of an atomic intrinsic names a memory order and is never replaced
+void ConstantPropagator::propagate(expression_ptr_var& node)
+{
+    if(auto* ident = std::get_if<identifier_ptr>(&node))
+    {
+        auto value = state_.values.find((*ident)->name);
+        if(value != state_.values.end())
+        {
+            auto folded = evaluator_.literal((*ident)->loc, value->second);
+            if(folded.has_value())
+                node = std::move(folded.value());
+            return;
+        }
+        auto copy = state_.copies.find((*ident)->name);
+        if(copy != state_.copies.end())
+            (*ident)->name = copy->second;
+        return;
+    }
+    if(auto* call = std::get_if<call_ptr>(&node))
+    {
+        auto& args = (*call)->args;
+        const bool atomic = (*call)->intrinsic >= Intrinsic::ATOMIC_LOAD;
+        for(size_t i = 0; i < args.size(); i++)
+        {
+            if(!(atomic && i == args.size() - 1))
+                propagate(args[i]);
+        }
+        return;
+    }
+    if(auto* index = std::get_if<index_ptr>(&node))
+    {
+        propagate((*index)->index);
+        return;
+    }
+    auto* expr = std::get_if<expression_ptr>(&node);
+    if(!expr || !*expr)
+        return;
+    propagate((*expr)->lhs);
+    propagate((*expr)->rhs);
+    evaluator_.fold(node);
+}
+
+// value is already propagated. Only integer and bool variables are tracked, a copy needs
+// both variables to have the same type
+void ConstantPropagator::define(std::string_view name, expression_ptr_var& value)
+{
+    kill(name);
+    auto type = types_.find(name);
+    if(type == types_.end() || !type->second)
+        return;
+    auto& registry = type::TypeRegistry::instance();
+    const bool is_bool = type->second == registry._bool_();
+    if(!is_bool && !type->second->is_integer())
+        return;
+
+    if(auto constant = ConstantEvaluator::value_of(value))
+    {
+        if(is_bool != (constant->type == registry._bool_()))
+            return;
+        state_.values[name] = {ConstantEvaluator::wrap(constant->bits, *type->second),
+                               type->second};
+        return;
+    }
+    auto* ident = std::get_if<identifier_ptr>(&value);
+    if(!ident || (*ident)->name == name)
+        return;
+    auto source = types_.find((*ident)->name);
+    if(source != types_.end() && source->second == type->second)
+        state_.copies[name] = (*ident)->name;
+}
+
+void ConstantPropagator::kill(std::string_view name)
+{
+    state_.values.erase(name);
+    state_.copies.erase(name);
+    std::erase_if(state_.copies, [name](const auto& copy) { return copy.second == name; });
+}
+
+void ConstantPropagator::kill(const std::set<std::string_view>& names)
+{
+    for(auto name : names) { kill(name); }
+}
+
+// What holds after a join is what holds on both incoming paths
+ConstantPropagator::State ConstantPropagator::meet(const State& lhs, const State& rhs)
+{
+    State result;
+    for(auto& [name, value] : lhs.values)
+    {
+        auto other = rhs.values.find(name);
+        if(other != rhs.values.end() && other->second.bits == value.bits &&
+           other->second.type == value.type)
+            result.values.emplace(name, value);
+    }
+    for(auto& [name, source] : lhs.copies)
+    {
+        auto other = rhs.copies.find(name);
+        if(other != rhs.copies.end() && other->second == source)
+            result.copies.emplace(name, source);
+    }
+    return result;
+}
+
+// The first check of a loop condition sees the values from before the loop, the body may
+// still change them for later checks. Works on a copy so the loop keeps its condition
+bool ConstantPropagator::false_on_entry(expression_ptr_var& condition)
+{
+    auto first = ASTCloner().clone(condition);
+    propagate(first);
+    return condition_value(first) == false;
+}
+
+std::optional<bool> ConstantPropagator::condition_value(expression_ptr_var& condition)
+{
+    if(auto* boolean = std::get_if<boolean_ptr>(&condition))
+        return (*boolean)->value;
+    return std::nullopt;
+}
+
+statements_ptr_var ConstantPropagator::as_statement(scope_err_ptr_var&& scope)
+{
+    return std::visit([](auto&& node) -> statements_ptr_var { return std::move(node); },
+                      std::move(scope));
+}
+
+void ConstantPropagator::collect_assigned(statements_ptr_var& node,
+                                          std::set<std::string_view>& names)
+{
+    std::visit(Overload{[&names](scope_ptr& scope)
+                        {
+                            auto* stmts =
+                                std::get_if<std::vector<statements_ptr_var>>(&scope->stmts);
+                            if(!stmts)
+                                return;
+                            for(auto& stmt : *stmts) { collect_assigned(stmt, names); }
+                        },
+                        [&names](if_ptr& _if)
+                        {
+                            collect_assigned(_if->scope, names);
+                            if(!_if->else_clause.has_value())
+                                return;
+                            if(auto* _else = std::get_if<else_ptr>(&_if->else_clause.value()))
+                                collect_assigned((*_else)->scope, names);
+                        },
+                        [&names](while_ptr& _while) { collect_assigned(_while->scope, names); },
+                        [&names](for_ptr& _for)
+                        {
+                            if(_for->init.has_value())
+                                collect_assigned(_for->init.value(), names);
+                            if(_for->step.has_value())
+                                collect_assigned(_for->step.value(), names);
+                            collect_assigned(_for->scope, names);
+                        },
+                        [&names](declareassign_ptr& declassign) { names.insert(declassign->name); },
+                        [&names](declare_ptr& declaration) { names.insert(declaration->name); },
+                        [&names](assign_ptr& assign)
+                        {
+                            if(!assign->index.has_value())
+                                names.insert(assign->name);
+                        },
+                        [](auto&&) {}},
+               node);
+}
+
+void ConstantPropagator::collect_assigned(scope_err_ptr_var& node,
+                                          std::set<std::string_view>& names)
+{
+    if(auto* scope = std::get_if<scope_ptr>(&node))
+    {
+        auto* stmts = std::get_if<std::vector<statements_ptr_var>>(&(*scope)->stmts);
+        if(!stmts)
+            return;
+        for(auto& stmt : *stmts) { collect_assigned(stmt, names); }
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef CONST_PROP_HPP
+#define CONST_PROP_HPP
+
+#pragma once
+#include "ast_builder.hpp"
+#include "ast_clone.hpp"
+#include "ast_def.hpp"
+#include "const_eval.hpp"
+#include "semantics.hpp"
+#include <set>
+
+// Runs after semantic analysis. Tracks the integer and bool variables holding a known value or
+// a copy of another variable, replaces their uses and folds what becomes constant. Branches
+// with a constant condition are replaced by the one that runs. At a join only what both paths
+// agree on is kept, a loop forgets every variable its body assigns
+class ConstantPropagator {
+  public:
+    ConstantPropagator(program_ptr&& program);
+
+    program_ptr&& run();
+
+    size_t removed_branches() const;
+
+    // Names assigned or declared anywhere in node, including nested scopes and loops
+    static void collect_assigned(statements_ptr_var& node, std::set<std::string_view>& names);
+
+    static void collect_assigned(scope_err_ptr_var& node, std::set<std::string_view>& names);
+
+    // Value of a condition that is a bool literal
+    static std::optional<bool> condition_value(expression_ptr_var& condition);
+
+    static statements_ptr_var as_statement(scope_err_ptr_var&& scope);
+
+  private:
+    struct State {
+        ConstantEvaluator::Constants values;
+        // name holds the same value as the variable it maps to
+        std::map<std::string_view, std::string_view, std::less<>> copies;
+    };
+
+    program_ptr program_;
+    ASTBuilder builder_;
+    ConstantEvaluator::Constants no_constants_;
+    ConstantEvaluator evaluator_;
+    State state_;
+    std::map<std::string_view, std::shared_ptr<type::BuiltinType>, std::less<>> types_;
+    size_t removed_branches_ = 0;
+
+    // Each returns false when control never reaches the statement after node
+    bool visit_stmt(statements_ptr_var& node);
+
+    bool visit_scope(scope_err_ptr_var& node);
+
+    bool visit_stmts(scope_err_vec_ptr& node);
+
+    bool visit_if(statements_ptr_var& node, ASTIf& _if);
+
+    void visit_function(ASTFunction& function);
+
+    void propagate(expression_ptr_var& node);
+
+    void define(std::string_view name, expression_ptr_var& value);
+
+    void kill(std::string_view name);
+
+    void kill(const std::set<std::string_view>& names);
+
+    bool false_on_entry(expression_ptr_var& condition);
+
+    static State meet(const State& lhs, const State& rhs);
+
+};
+
+#endif // CONST_PROP_HPP
@@ -0,0 +1,520 @@
+#include "dead_code.hpp"
+#include "const_prop.hpp"
+
+DeadCodeEliminator::DeadCodeEliminator(program_ptr&& program, ErrorReporter* warnings)
+    : program_(std::move(program)), warnings_(warnings)
+{
+}
+
+program_ptr&& DeadCodeEliminator::run()
+{
+    remove_unreachable(program_->stmts);
+    remove_dead_stores(program_->stmts);
+    for(auto& stmt : program_->stmts)
+    {
+        auto* function = std::get_if<function_ptr>(&stmt);
+        auto* body = function ? std::get_if<scope_ptr>(&(*function)->body) : nullptr;
+        auto* stmts =
+            body ? std::get_if<std::vector<statements_ptr_var>>(&(*body)->stmts) : nullptr;
+        if(stmts)
+            remove_dead_stores(*stmts);
+    }
+    return std::move(program_);
+}
+
+size_t DeadCodeEliminator::removed_statements() const
+{
+    return removed_;
+}
+
+bool DeadCodeEliminator::remove_unreachable(statements_ptr_var& node)
+{
+    if(fold_branch(node))
+        return remove_unreachable(node);
+
+    return std::visit(
+        Overload{[this](scope_ptr& scope)
+                 {
+                     auto* stmts = std::get_if<std::vector<statements_ptr_var>>(&scope->stmts);
+                     return !stmts || remove_unreachable(*stmts);
+                 },
+                 [this](if_ptr& _if)
+                 {
+                     const bool then_reachable = remove_unreachable(_if->scope);
+                     if(!_if->else_clause.has_value())
+                         return true;
+                     auto* _else = std::get_if<else_ptr>(&_if->else_clause.value());
+                     if(!_else)
+                         return true;
+                     // else(c) also falls through when c is false
+                     const bool else_reachable = remove_unreachable((*_else)->scope) ||
+                                                 (*_else)->condition.has_value();
+                     return then_reachable || else_reachable;
+                 },
+                 [this](while_ptr& _while)
+                 {
+                     remove_unreachable(_while->scope);
+                     return ConstantPropagator::condition_value(_while->condition) != true ||
+                            has_break(_while->scope);
+                 },
+                 [this](for_ptr& _for)
+                 {
+                     remove_unreachable(_for->scope);
+                     return ConstantPropagator::condition_value(_for->condition) != true ||
+                            has_break(_for->scope);
+                 },
+                 [this](function_ptr& function)
+                 {
+                     remove_unreachable(function->body);
+                     return true;
+                 },
+                 [](return_ptr&) { return false; },
+                 [](break_ptr&) { return false; },
+                 [](continue_ptr&) { return false; },
+                 [](auto&&) { return true; }},
+        node);
+}
+
+// Statements after one that does not fall through are removed, except the functions and
+// structs declared after a top level return. Empty scopes are left behind by removed branches
+bool DeadCodeEliminator::remove_unreachable(std::vector<statements_ptr_var>& stmts)
+{
+    bool reachable = true;
+    bool warned = false;
+    for(size_t i = 0; i < stmts.size();)
+    {
+        auto& stmt = stmts[i];
+        const bool declaration =
+            std::holds_alternative<function_ptr>(stmt) || std::holds_alternative<struct_ptr>(stmt);
+        if(!reachable && !declaration)
+        {
+            if(!warned)
+            {
+                auto& loc = std::visit([](auto& node) -> SourceLocation& { return node->loc; },
+                                       stmt);
+                warn(loc, "Unreachable code on line " + std::to_string(loc.line));
+                warned = true;
+            }
+            stmts.erase(stmts.begin() + i);
+            removed_++;
+            continue;
+        }
+
+        if(reachable)
+            reachable = remove_unreachable(stmt);
+        else
+            remove_unreachable(stmt);
+        if(is_empty_scope(stmt))
+            stmts.erase(stmts.begin() + i);
+        else
+            i++;
+    }
+    return reachable;
+}
+
+bool DeadCodeEliminator::remove_unreachable(scope_err_ptr_var& node)
+{
+    auto* scope = std::get_if<scope_ptr>(&node);
+    auto* stmts = scope ? std::get_if<std::vector<statements_ptr_var>>(&(*scope)->stmts)
+                        : nullptr;
+    return !stmts || remove_unreachable(*stmts);
+}
+
+// Replaces an if or a loop whose condition is a literal by what runs, returns whether node
+// was replaced. while(true) is kept, it is the usual way to write an endless loop
+bool DeadCodeEliminator::fold_branch(statements_ptr_var& node)
+{
+    if(auto* loop = std::get_if<while_ptr>(&node))
+    {
+        if(ConstantPropagator::condition_value((*loop)->condition) != false)
+            return false;
+        warn((*loop)->loc,
+             "Loop on line " + std::to_string((*loop)->loc.line) + " never runs");
+        node = builder_.build_scope((*loop)->loc, std::vector<statements_ptr_var>{});
+        removed_++;
+        return true;
+    }
+    if(auto* loop = std::get_if<for_ptr>(&node))
+    {
+        auto& _for = **loop;
+        if(ConstantPropagator::condition_value(_for.condition) != false)
+            return false;
+        warn(_for.loc, "Loop on line " + std::to_string(_for.loc.line) + " never runs");
+        removed_++;
+        if(!_for.init.has_value())
+        {
+            node = builder_.build_scope(_for.loc, std::vector<statements_ptr_var>{});
+            return true;
+        }
+        // node owns init, move it out before replacing node
+        auto init = std::move(_for.init.value());
+        node = std::move(init);
+        return true;
+    }
+
+    auto* if_node = std::get_if<if_ptr>(&node);
+    if(!if_node)
+        return false;
+    auto& _if = **if_node;
+    auto* _else = _if.else_clause.has_value() ? std::get_if<else_ptr>(&_if.else_clause.value())
+                                              : nullptr;
+    auto value = ConstantPropagator::condition_value(_if.condition);
+    if(value.has_value())
+    {
+        warn(_if.loc, "Condition on line " + std::to_string(_if.loc.line) + " is always " +
+                          (value.value() ? "true" : "false"));
+        removed_++;
+        if(value.value())
+            node = ConstantPropagator::as_statement(std::move(_if.scope));
+        else if(!_else)
+            node = builder_.build_scope(_if.loc, std::vector<statements_ptr_var>{});
+        else if(!(*_else)->condition.has_value())
+            node = ConstantPropagator::as_statement(std::move((*_else)->scope));
+        else
+        {
+            _if.condition = std::move((*_else)->condition.value());
+            _if.scope = std::move((*_else)->scope);
+            _if.else_clause.reset();
+        }
+        return true;
+    }
+
+    if(!_else || !(*_else)->condition.has_value())
+        return false;
+    value = ConstantPropagator::condition_value((*_else)->condition.value());
+    if(!value.has_value())
+        return false;
+    warn((*_else)->loc, "Condition on line " + std::to_string((*_else)->loc.line) +
+                            " is always " + (value.value() ? "true" : "false"));
+    removed_++;
+    if(value.value())
+        (*_else)->condition.reset();
+    else
+        _if.else_clause.reset();
+    return false;
+}
+
+// stmts is a function body or the top level statements. Repeats until nothing changes,
+// removing y = x can leave x unread
+void DeadCodeEliminator::remove_dead_stores(std::vector<statements_ptr_var>& stmts)
+{
+    while(true)
+    {
+        UseMap uses;
+        for(auto& stmt : stmts)
+        {
+            if(!std::holds_alternative<function_ptr>(stmt))
+                count_uses(stmt, uses);
+        }
+        std::set<std::string_view> dead;
+        for(auto& [name, use] : uses)
+        {
+            if(!use.declared || !use.removable || use.reads != 0)
+                continue;
+            dead.insert(name);
+            warn(use.loc, "Variable '" + std::string(name) + "' on line " +
+                              std::to_string(use.loc.line) + " is never read");
+        }
+        if(dead.empty())
+            return;
+        remove_stores(stmts, dead);
+    }
+}
+
+void DeadCodeEliminator::count_uses(statements_ptr_var& node, UseMap& uses) const
+{
+    std::visit(
+        Overload{[this, &uses](scope_ptr& scope)
+                 {
+                     auto* stmts = std::get_if<std::vector<statements_ptr_var>>(&scope->stmts);
+                     if(!stmts)
+                         return;
+                     for(auto& stmt : *stmts) { count_uses(stmt, uses); }
+                 },
+                 [this, &uses](if_ptr& _if)
+                 {
+                     count_reads(_if->condition, uses);
+                     count_uses(_if->scope, uses);
+                     if(!_if->else_clause.has_value())
+                         return;
+                     auto* _else = std::get_if<else_ptr>(&_if->else_clause.value());
+                     if(!_else)
+                         return;
+                     if((*_else)->condition.has_value())
+                         count_reads((*_else)->condition.value(), uses);
+                     count_uses((*_else)->scope, uses);
+                 },
+                 [this, &uses](while_ptr& _while)
+                 {
+                     count_reads(_while->condition, uses);
+                     count_uses(_while->scope, uses);
+                 },
+                 [this, &uses](for_ptr& _for)
+                 {
+                     if(_for->init.has_value())
+                         count_uses(_for->init.value(), uses);
+                     count_reads(_for->condition, uses);
+                     if(_for->step.has_value())
+                         count_uses(_for->step.value(), uses);
+                     count_uses(_for->scope, uses);
+                 },
+                 [this, &uses](return_ptr& _return) { count_reads(_return->val, uses); },
+                 [this, &uses](callstmt_ptr& stmt) { count_reads(stmt->call, uses); },
+                 [this, &uses](declareassign_ptr& declassign)
+                 {
+                     auto& use = uses[declassign->name];
+                     use.declared = true;
+                     use.loc = declassign->loc;
+                     use.removable = use.removable && is_pure(declassign->expr);
+                     count_reads(declassign->expr, uses, declassign->name);
+                 },
+                 [&uses](declare_ptr& declaration)
+                 {
+                     auto& use = uses[declaration->name];
+                     use.declared = true;
+                     use.loc = declaration->loc;
+                 },
+                 [this, &uses](assign_ptr& assign)
+                 {
+                     // a checked store can fail at runtime
+                     bool removable = is_pure(assign->expr);
+                     if(assign->index.has_value())
+                     {
+                         removable = removable && !assign->bounds_checked &&
+                                     is_pure(assign->index.value());
+                         count_reads(assign->index.value(), uses, assign->name);
+                     }
+                     count_reads(assign->expr, uses, assign->name);
+                     auto& use = uses[assign->name];
+                     use.removable = use.removable && removable;
+                 },
+                 [](auto&&) {}},
+        node);
+}
+
+void DeadCodeEliminator::count_uses(scope_err_ptr_var& node, UseMap& uses) const
+{
+    auto* scope = std::get_if<scope_ptr>(&node);
+    auto* stmts = scope ? std::get_if<std::vector<statements_ptr_var>>(&(*scope)->stmts)
+                        : nullptr;
+    if(!stmts)
+        return;
+    for(auto& stmt : *stmts) { count_uses(stmt, uses); }
+}
+
+void DeadCodeEliminator::count_reads(expression_ptr_var& node, UseMap& uses,
+                                     std::string_view except) const
+{
+    std::visit(Overload{[&uses, except](identifier_ptr& ident)
+                        {
+                            if(ident->name != except)
+                                uses[ident->name].reads++;
+                        },
+                        [this, &uses, except](index_ptr& index)
+                        {
+                            if(index->name != except)
+                                uses[index->name].reads++;
+                            count_reads(index->index, uses, except);
+                        },
+                        [this, &uses, except](call_ptr& call)
+                        {
+                            for(auto& arg : call->args) { count_reads(arg, uses, except); }
+                        },
+                        [this, &uses, except](expression_ptr& expr)
+                        {
+                            if(!expr)
+                                return;
+                            count_reads(expr->lhs, uses, except);
+                            count_reads(expr->rhs, uses, except);
+                        },
+                        [](auto&&) {}},
+               node);
+}
+
+void DeadCodeEliminator::remove_stores(std::vector<statements_ptr_var>& stmts,
+                                       const std::set<std::string_view>& dead)
+{
+    removed_ += std::erase_if(stmts, [this, &dead](statements_ptr_var& stmt)
+                              { return is_dead_store(stmt, dead); });
+    for(auto& stmt : stmts) { remove_stores(stmt, dead); }
+    std::erase_if(stmts, is_empty_scope);
+}
+
+// Functions are handled on their own, their variables are not the ones of the top level
+void DeadCodeEliminator::remove_stores(statements_ptr_var& node,
+                                       const std::set<std::string_view>& dead)
+{
+    std::visit(
+        Overload{[this, &dead](scope_ptr& scope)
+                 {
+                     auto* stmts = std::get_if<std::vector<statements_ptr_var>>(&scope->stmts);
+                     if(stmts)
+                         remove_stores(*stmts, dead);
+                 },
+                 [this, &dead](if_ptr& _if)
+                 {
+                     remove_stores(_if->scope, dead);
+                     if(!_if->else_clause.has_value())
+                         return;
+                     if(auto* _else = std::get_if<else_ptr>(&_if->else_clause.value()))
+                         remove_stores((*_else)->scope, dead);
+                 },
+                 [this, &dead](while_ptr& _while) { remove_stores(_while->scope, dead); },
+                 [this, &dead](for_ptr& _for)
+                 {
+                     if(_for->init.has_value() && is_dead_store(_for->init.value(), dead))
+                     {
+                         _for->init.reset();
+                         removed_++;
+                     }
+                     if(_for->step.has_value() && is_dead_store(_for->step.value(), dead))
+                     {
+                         _for->step.reset();
+                         removed_++;
+                     }
+                     if(_for->induction.has_value() && dead.contains(_for->induction->name))
+                         _for->induction.reset();
+                     std::erase_if(_for->reductions, [&dead](const Reduction& reduction)
+                                   { return dead.contains(reduction.name); });
+                     remove_stores(_for->scope, dead);
+                 },
+                 [](auto&&) {}},
+        node);
+}
+
+void DeadCodeEliminator::remove_stores(scope_err_ptr_var& node,
+                                       const std::set<std::string_view>& dead)
+{
+    auto* scope = std::get_if<scope_ptr>(&node);
+    auto* stmts = scope ? std::get_if<std::vector<statements_ptr_var>>(&(*scope)->stmts)
+                        : nullptr;
+    if(stmts)
+        remove_stores(*stmts, dead);
+}
+
+bool DeadCodeEliminator::is_dead_store(statements_ptr_var& node,
+                                       const std::set<std::string_view>& dead) const
+{
+    return std::visit(
+        Overload{[&dead](declareassign_ptr& declassign) { return dead.contains(declassign->name); },
+                 [&dead](declare_ptr& declaration) { return dead.contains(declaration->name); },
+                 [&dead](assign_ptr& assign) { return dead.contains(assign->name); },
+                 [](auto&&) { return false; }},
+        node);
+}
+
+void DeadCodeEliminator::warn(SourceLocation& loc, const std::string& message) const
+{
+    if(warnings_)
+        warnings_->report_warning(loc, message);
+}
+
+// Calls to functions and atomics have side effects, checked indexing and checked division by
+// anything but a constant other than 0 and -1 can fault
+bool DeadCodeEliminator::is_pure(expression_ptr_var& node)
+{
+    return std::visit(
+        Overload{[](call_ptr& call)
+                 {
+                     if(call->intrinsic == Intrinsic::NONE ||
+                        call->intrinsic >= Intrinsic::ATOMIC_LOAD)
+                         return false;
+                     return std::all_of(call->args.begin(), call->args.end(),
+                                        [](expression_ptr_var& arg) { return is_pure(arg); });
+                 },
+                 [](index_ptr& index) { return !index->bounds_checked && is_pure(index->index); },
+                 [](expression_ptr& expr)
+                 {
+                     if(!expr)
+                         return true;
+                     if((expr->op == Operator::DIV || expr->op == Operator::MOD) && expr->checked &&
+                        !(expr->operand_type && expr->operand_type->is_floating()))
+                     {
+                         auto* divisor = std::get_if<integer_ptr>(&expr->rhs);
+                         if(!divisor || (*divisor)->value == 0 || (*divisor)->value == -1)
+                             return false;
+                     }
+                     return is_pure(expr->lhs) && is_pure(expr->rhs);
+                 },
+                 [](auto&&) { return true; }},
+        node);
+}
+
+// An index or a division only made unchecked by a condition around it is pure under that
+// condition. Elsewhere only a literal index, which was checked against the length, and a
+// literal divisor other than 0 and -1 cannot fault
+bool DeadCodeEliminator::is_speculatable(expression_ptr_var& node)
+{
+    return std::visit(
+        Overload{[](call_ptr& call)
+                 {
+                     if(call->intrinsic == Intrinsic::NONE ||
+                        call->intrinsic >= Intrinsic::ATOMIC_LOAD)
+                         return false;
+                     return std::all_of(call->args.begin(), call->args.end(),
+                                        [](expression_ptr_var& arg)
+                                        { return is_speculatable(arg); });
+                 },
+                 [](index_ptr& index)
+                 {
+                     return !index->bounds_checked &&
+                            std::holds_alternative<integer_ptr>(index->index);
+                 },
+                 [](expression_ptr& expr)
+                 {
+                     if(!expr)
+                         return true;
+                     if((expr->op == Operator::DIV || expr->op == Operator::MOD) &&
+                        !(expr->operand_type && expr->operand_type->is_floating()))
+                     {
+                         auto* divisor = std::get_if<integer_ptr>(&expr->rhs);
+                         if(!divisor || (*divisor)->value == 0 || (*divisor)->value == -1)
+                             return false;
+                     }
+                     return is_speculatable(expr->lhs) && is_speculatable(expr->rhs);
+                 },
+                 [](auto&&) { return true; }},
+        node);
+}
+
+bool DeadCodeEliminator::is_empty_scope(statements_ptr_var& node)
+{
+    auto* scope = std::get_if<scope_ptr>(&node);
+    auto* stmts = scope ? std::get_if<std::vector<statements_ptr_var>>(&(*scope)->stmts)
+                        : nullptr;
+    return stmts && stmts->empty();
+}
+
+bool DeadCodeEliminator::has_break(statements_ptr_var& node)
+{
+    return std::visit(
+        Overload{[](break_ptr&) { return true; },
+                 [](scope_ptr& scope)
+                 {
+                     auto* stmts = std::get_if<std::vector<statements_ptr_var>>(&scope->stmts);
+                     return stmts && std::any_of(stmts->begin(), stmts->end(),
+                                                 [](statements_ptr_var& stmt)
+                                                 { return has_break(stmt); });
+                 },
+                 [](if_ptr& _if)
+                 {
+                     if(has_break(_if->scope))
+                         return true;
+                     if(!_if->else_clause.has_value())
+                         return false;
+                     auto* _else = std::get_if<else_ptr>(&_if->else_clause.value());
+                     return _else && has_break((*_else)->scope);
+                 },
+                 // a break in a nested loop leaves that loop
+                 [](auto&&) { return false; }},
+        node);
+}
+
+bool DeadCodeEliminator::has_break(scope_err_ptr_var& node)
+{
+    auto* scope = std::get_if<scope_ptr>(&node);
+    auto* stmts = scope ? std::get_if<std::vector<statements_ptr_var>>(&(*scope)->stmts)
+                        : nullptr;
+    return stmts && std::any_of(stmts->begin(), stmts->end(),
+                                [](statements_ptr_var& stmt) { return has_break(stmt); });
+}
@@ -0,0 +1,82 @@
+#ifndef DEAD_CODE_HPP
+#define DEAD_CODE_HPP
+
+#pragma once
+#include "ast_builder.hpp"
+#include "ast_def.hpp"
+#include "errors.hpp"
+#include "semantics.hpp"
+#include <set>
+
+// Runs after semantic analysis, best after constant propagation. Removes statements that are
+// never reached, branches and loops with a constant condition and variables whose value is
+// never read. Each removal is reported as a warning when a reporter is given
+class DeadCodeEliminator {
+  public:
+    DeadCodeEliminator(program_ptr&& program, ErrorReporter* warnings = nullptr);
+
+    program_ptr&& run();
+
+    size_t removed_statements() const;
+
+    // Evaluating node has no side effect and cannot fault
+    static bool is_pure(expression_ptr_var& node);
+
+    // Pure wherever node is evaluated, so code motion may move it above the branches around it
+    static bool is_speculatable(expression_ptr_var& node);
+
+  private:
+    // Uses of one variable within a function, the top level statements count as one
+    struct Uses {
+        size_t reads = 0; // not counting reads in its own assignments
+        bool removable = true; // no write has a side effect
+        bool declared = false; // parameters are never removed
+        SourceLocation loc{0, 0};
+    };
+
+    using UseMap = std::map<std::string_view, Uses, std::less<>>;
+
+    program_ptr program_;
+    ErrorReporter* warnings_;
+    ASTBuilder builder_;
+    size_t removed_ = 0;
+
+    // Each returns false when control never reaches the statement after node
+    bool remove_unreachable(statements_ptr_var& node);
+
+    bool remove_unreachable(std::vector<statements_ptr_var>& stmts);
+
+    bool remove_unreachable(scope_err_ptr_var& node);
+
+    bool fold_branch(statements_ptr_var& node);
+
+    void remove_dead_stores(std::vector<statements_ptr_var>& stmts);
+
+    void count_uses(statements_ptr_var& node, UseMap& uses) const;
+
+    void count_uses(scope_err_ptr_var& node, UseMap& uses) const;
+
+    // Counts the variables read by node, reads of except feed only except itself
+    void count_reads(expression_ptr_var& node, UseMap& uses, std::string_view except = {}) const;
+
+    void remove_stores(std::vector<statements_ptr_var>& stmts,
+                       const std::set<std::string_view>& dead);
+
+    void remove_stores(statements_ptr_var& node, const std::set<std::string_view>& dead);
+
+    void remove_stores(scope_err_ptr_var& node, const std::set<std::string_view>& dead);
+
+    bool is_dead_store(statements_ptr_var& node, const std::set<std::string_view>& dead) const;
+
+    void warn(SourceLocation& loc, const std::string& message) const;
+
+
+    static bool is_empty_scope(statements_ptr_var& node);
+
+    // A break in node leaves the loop node is the body of
+    static bool has_break(statements_ptr_var& node);
+
+    static bool has_break(scope_err_ptr_var& node);
+};
+
+#endif // DEAD_CODE_HPP
@@ -9,6 +9,7 @@ enum class ErrorType {
     SYNTAX,
     SEMANTIC,
     UNKNOWN,
+    WARNING, // does not count as an error
 
 };
 
@@ -25,12 +26,18 @@ class ErrorReporter {
         error_count_++;
     }
 
+    void report_warning(SourceLocation& loc, const std::string& msg) {
+        diagnostics_.emplace_back(msg, loc, ErrorType::WARNING);
+    }
+
     bool has_errors() const {
         return error_count_ > 0;
     }
 
     void print_diagnostics() const {
         for(auto& d : diagnostics_){
+            if(d.type == ErrorType::WARNING)
+                std::cerr << "Warning: ";
             std::cerr << d.message << std::endl;
         }
     }
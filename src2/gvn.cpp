@@ -0,0 +1,149 @@
+#include "gvn.hpp"
+#include <algorithm>
+
+GlobalValueNumbering::GlobalValueNumbering(ir::Function& function) : function_(function) {}
+
+size_t GlobalValueNumbering::run()
+{
+    function_.compute_cfg();
+    ir::DominatorTree tree(function_);
+    replace_.assign(function_.insts.size(), ir::NONE);
+    memory_.assign(function_.blocks.size(), 0);
+    visit(0, tree);
+
+    // phis read values of blocks visited after them
+    for(auto& block : function_.blocks)
+    {
+        for(auto value : block.insts)
+        {
+            function_.for_each_operand(value,
+                                       [this](uint32_t& operand) { operand = resolve(operand); });
+        }
+        std::erase_if(block.insts,
+                      [this](ir::Value value)
+                      { return function_.insts[value].op == ir::Opcode::NOP; });
+    }
+    return removed_;
+}
+
+size_t GlobalValueNumbering::KeyHash::operator()(const Key& key) const
+{
+    size_t hash = static_cast<size_t>(key.op) | static_cast<size_t>(key.flags) << 8 |
+                  static_cast<size_t>(key.type) << 16;
+    for(auto operand : key.operands) { hash = hash * 31 + operand; }
+    return hash;
+}
+
+// A block with one predecessor starts with the memory state that one ends with, the
+// predecessor is its immediate dominator and was visited before it
+void GlobalValueNumbering::visit(ir::Block block, const ir::DominatorTree& tree)
+{
+    auto& preds = function_.blocks[block].preds;
+    uint32_t memory = preds.size() == 1 ? memory_[preds[0]] : ++states_;
+    std::vector<Key> added;
+
+    for(auto value : function_.blocks[block].insts)
+    {
+        function_.for_each_operand(value,
+                                   [this](uint32_t& operand) { operand = resolve(operand); });
+        auto& inst = function_.insts[value];
+        if(inst.op == ir::Opcode::STORE || inst.op == ir::Opcode::CALL ||
+           (inst.op == ir::Opcode::INTRINSIC &&
+            static_cast<Intrinsic>(inst.c) >= Intrinsic::ATOMIC_LOAD))
+            memory = ++states_;
+        // the next load of the address reads the stored value
+        if(inst.op == ir::Opcode::STORE && is_plain_memory(inst.a))
+        {
+            Key load{ir::Opcode::LOAD, 0, function_.insts[inst.b].type, {inst.a, memory}};
+            table_.emplace(load, inst.b);
+            added.push_back(std::move(load));
+        }
+
+        auto key = key_of(value, memory);
+        if(!key)
+            continue;
+        auto [it, inserted] = table_.emplace(*key, value);
+        if(inserted)
+        {
+            added.push_back(std::move(*key));
+            continue;
+        }
+        replace_[value] = it->second;
+        inst.op = ir::Opcode::NOP;
+        removed_++;
+    }
+    memory_[block] = memory;
+
+    for(auto child : tree.children(block)) { visit(child, tree); }
+    for(auto& key : added) { table_.erase(key); }
+}
+
+// DIV, MOD and BOUNDS_CHECK fault, but not again when an equal one dominating them did not
+std::optional<GlobalValueNumbering::Key> GlobalValueNumbering::key_of(ir::Value value,
+                                                                      uint32_t memory) const
+{
+    auto& inst = function_.insts[value];
+    switch(inst.op)
+    {
+    case ir::Opcode::CONST:
+        return Key{inst.op, 0, inst.type, {inst.a, inst.b}};
+    case ir::Opcode::ADD:
+    case ir::Opcode::SUB:
+    case ir::Opcode::MUL:
+    case ir::Opcode::MULHI:
+    case ir::Opcode::DIV:
+    case ir::Opcode::MOD:
+    case ir::Opcode::SHL:
+    case ir::Opcode::SHR:
+    case ir::Opcode::AND:
+    case ir::Opcode::OR:
+    case ir::Opcode::XOR:
+    case ir::Opcode::EQ:
+    case ir::Opcode::NE:
+    case ir::Opcode::LT:
+    case ir::Opcode::LE:
+    case ir::Opcode::GT:
+    case ir::Opcode::GE:
+    case ir::Opcode::ELEMENT:
+        {
+            Key key{inst.op, 0, inst.type, {inst.a, inst.b}};
+            if(ir::is_commutative(inst.op))
+                std::sort(key.operands.begin(), key.operands.end());
+            return key;
+        }
+    case ir::Opcode::NOT:
+    case ir::Opcode::CONVERT:
+        return Key{inst.op, 0, inst.type, {inst.a}};
+    case ir::Opcode::BOUNDS_CHECK:
+        return Key{inst.op, 0, inst.type, {inst.a, inst.c}};
+    case ir::Opcode::SELECT:
+        return Key{inst.op, 0, inst.type, {inst.a, inst.b, inst.c}};
+    case ir::Opcode::LOAD:
+        if(!is_plain_memory(inst.a))
+            return std::nullopt;
+        return Key{inst.op, 0, inst.type, {inst.a, memory}};
+    case ir::Opcode::INTRINSIC:
+        {
+            if(static_cast<Intrinsic>(inst.c) >= Intrinsic::ATOMIC_LOAD)
+                return std::nullopt;
+            auto args = function_.list(value);
+            Key key{inst.op, inst.flags, inst.type, {args.begin(), args.end()}};
+            key.operands.push_back(inst.c);
+            return key;
+        }
+    default:
+        return std::nullopt;
+    }
+}
+
+// Another thread may write an atomic between two loads
+bool GlobalValueNumbering::is_plain_memory(ir::Value address) const
+{
+    return !function_.type_of(address)->is_atomic();
+}
+
+ir::Value GlobalValueNumbering::resolve(ir::Value value) const
+{
+    while(value < replace_.size() && replace_[value] != ir::NONE) { value = replace_[value]; }
+    return value;
+}
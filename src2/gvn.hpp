@@ -0,0 +1,51 @@
+#ifndef GVN_HPP
+#define GVN_HPP
+
+#pragma once
+#include "ir.hpp"
+#include <optional>
+#include <unordered_map>
+
+// Dominator based global value numbering, best run after Mem2Reg. Blocks are visited down
+// the dominator tree with a scoped table from the key of an instruction to the first value
+// computing it, a later instruction with the same key is replaced by that value. Loads are
+// keyed by the memory state too, every store, call and atomic starts a new one
+class GlobalValueNumbering {
+  public:
+    GlobalValueNumbering(ir::Function& function);
+
+    // Returns the number of instructions removed
+    size_t run();
+
+  private:
+    // opcode, result type and the value numbers of the operands
+    struct Key {
+        ir::Opcode op;
+        uint8_t flags;
+        uint16_t type;
+        std::vector<uint32_t> operands;
+
+        bool operator==(const Key& other) const = default;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    ir::Function& function_;
+    std::unordered_map<Key, ir::Value, KeyHash> table_;
+    std::vector<ir::Value> replace_;
+    std::vector<uint32_t> memory_; // memory state at the end of each block
+    uint32_t states_ = 0;
+    size_t removed_ = 0;
+
+    void visit(ir::Block block, const ir::DominatorTree& tree);
+
+    std::optional<Key> key_of(ir::Value value, uint32_t memory) const;
+
+    bool is_plain_memory(ir::Value address) const;
+
+    ir::Value resolve(ir::Value value) const;
+};
+
+#endif // GVN_HPP
@@ -0,0 +1,246 @@
+#include "if_convert.hpp"
+#include <algorithm>
+
+IfConversion::IfConversion(ir::Function& function) : function_(function) {}
+
+// Blocks are visited from the last one, so an inner if is converted before the one around it
+// and the outer one sees a single block arm
+size_t IfConversion::run()
+{
+    function_.compute_cfg();
+    bool changed = true;
+    while(changed)
+    {
+        changed = false;
+        for(auto head = static_cast<ir::Block>(function_.blocks.size()); head-- > 0;)
+        {
+            if(!convert(head))
+                continue;
+            converted_++;
+            changed = true;
+            function_.compute_cfg();
+        }
+    }
+
+    for(auto& block : function_.blocks)
+    {
+        for(auto value : block.insts)
+        {
+            function_.for_each_operand(value,
+                                       [this](uint32_t& operand) { operand = resolve(operand); });
+        }
+        std::erase_if(block.insts,
+                      [this](ir::Value value)
+                      { return function_.insts[value].op == ir::Opcode::NOP; });
+    }
+    function_.remove_unreachable();
+    return converted_;
+}
+
+bool IfConversion::convert(ir::Block head)
+{
+    auto& blocks = function_.blocks;
+    if(blocks[head].insts.empty())
+        return false;
+    const auto branch = function_.insts[blocks[head].insts.back()];
+    if(branch.op != ir::Opcode::CONDBR || branch.b == branch.c)
+        return false;
+
+    // an arm is entered from head only and jumps on to the join
+    auto target_of = [this, &blocks, head](ir::Block arm) -> ir::Block
+    {
+        if(arm == 0 || blocks[arm].preds.size() != 1 || blocks[arm].insts.empty())
+            return ir::NONE;
+        auto& last = function_.insts[blocks[arm].insts.back()];
+        return last.op == ir::Opcode::BR && last.a != head ? last.a : ir::NONE;
+    };
+    const ir::Block yes = branch.b;
+    const ir::Block no = branch.c;
+    ir::Block join;
+    bool yes_arm = false;
+    bool no_arm = false;
+    if(target_of(yes) != ir::NONE && target_of(yes) == target_of(no))
+    {
+        join = target_of(yes);
+        yes_arm = no_arm = true;
+    }
+    else if(target_of(yes) == no)
+    {
+        join = no;
+        yes_arm = true;
+    }
+    else if(target_of(no) == yes)
+    {
+        join = yes;
+        no_arm = true;
+    }
+    else
+        return false;
+
+    size_t cost = 0;
+    for(auto arm : {yes_arm ? yes : ir::NONE, no_arm ? no : ir::NONE})
+    {
+        if(arm == ir::NONE)
+            continue;
+        auto arm_cost = cost_of(arm);
+        if(!arm_cost)
+            return false;
+        cost += *arm_cost;
+    }
+
+    // the values each phi of the join gets along the two edges
+    const ir::Block from_yes = yes_arm ? yes : head;
+    const ir::Block from_no = no_arm ? no : head;
+    struct Merge {
+        ir::Value phi;
+        ir::Value yes = ir::NONE;
+        ir::Value no = ir::NONE;
+    };
+    std::vector<Merge> merges;
+    for(auto value : blocks[join].insts)
+    {
+        if(function_.insts[value].op != ir::Opcode::PHI)
+            break;
+        Merge merge{value};
+        auto pairs = function_.list(value);
+        for(size_t i = 0; i < pairs.size(); i += 2)
+        {
+            if(pairs[i] == from_yes)
+                merge.yes = resolve(pairs[i + 1]);
+            else if(pairs[i] == from_no)
+                merge.no = resolve(pairs[i + 1]);
+        }
+        if(merge.yes != merge.no)
+            cost++;
+        merges.push_back(merge);
+    }
+    if(cost > MAX_COST)
+        return false;
+
+    if(yes_arm)
+        hoist(yes, head);
+    if(no_arm)
+        hoist(no, head);
+    for(auto& merge : merges)
+    {
+        auto value = merge.yes == merge.no
+                         ? merge.yes
+                         : select(head, branch.a, merge.yes, merge.no,
+                                  function_.insts[merge.phi].type);
+        std::vector<uint32_t> incoming{head, value};
+        auto pairs = function_.list(merge.phi);
+        for(size_t i = 0; i < pairs.size(); i += 2)
+        {
+            if(pairs[i] != from_yes && pairs[i] != from_no)
+                incoming.insert(incoming.end(), {pairs[i], pairs[i + 1]});
+        }
+        auto& phi = function_.insts[merge.phi];
+        phi.a = function_.add_list(incoming);
+        phi.b = static_cast<uint32_t>(incoming.size());
+    }
+    auto& terminator = function_.insts[blocks[head].insts.back()];
+    terminator = {ir::Opcode::BR, 0, terminator.type, join};
+
+    function_.compute_cfg();
+    if(blocks[join].preds.size() == 1 && join != 0)
+        merge(head, join);
+    return true;
+}
+
+// Faulting instructions, loads and calls stay behind the branch
+std::optional<size_t> IfConversion::cost_of(ir::Block arm) const
+{
+    auto& insts = function_.blocks[arm].insts;
+    size_t cost = 0;
+    for(size_t i = 0; i + 1 < insts.size(); i++)
+    {
+        auto op = function_.insts[insts[i]].op;
+        if(!ir::is_pure(op) || op == ir::Opcode::PHI)
+            return std::nullopt;
+        if(op == ir::Opcode::MUL || op == ir::Opcode::MULHI)
+            cost += 3;
+        else if(op != ir::Opcode::CONST)
+            cost++;
+    }
+    return cost;
+}
+
+void IfConversion::hoist(ir::Block arm, ir::Block head)
+{
+    auto& from = function_.blocks[arm].insts;
+    auto& to = function_.blocks[head].insts;
+    function_.insts[from.back()].op = ir::Opcode::NOP;
+    from.pop_back();
+    // what was proven from the condition does not hold on the other side
+    for(auto value : from) { function_.insts[value].flags = 0; }
+    to.insert(to.end() - 1, from.begin(), from.end());
+    from.clear();
+}
+
+ir::Value IfConversion::select(ir::Block head, ir::Value condition, ir::Value yes, ir::Value no,
+                               uint16_t type)
+{
+    auto is_constant = [this](ir::Value value, int64_t constant)
+    {
+        return function_.insts[value].op == ir::Opcode::CONST &&
+               function_.constant(value) == constant;
+    };
+    const auto& builtin = function_.types[type];
+    const bool is_bool = builtin == type::TypeRegistry::instance()._bool_();
+    if(is_bool || builtin->is_integer())
+    {
+        if(is_constant(yes, 1) && is_constant(no, 0))
+            return is_bool ? condition : emit(head, {ir::Opcode::CONVERT, 0, type, condition});
+        if(is_bool && is_constant(yes, 0) && is_constant(no, 1))
+            return emit(head, {ir::Opcode::NOT, 0, type, condition});
+    }
+    return emit(head, {ir::Opcode::SELECT, 0, type, condition, yes, no});
+}
+
+void IfConversion::merge(ir::Block head, ir::Block join)
+{
+    auto& blocks = function_.blocks;
+    auto& to = blocks[head].insts;
+    function_.insts[to.back()].op = ir::Opcode::NOP;
+    to.pop_back();
+    for(auto value : blocks[join].insts)
+    {
+        auto& inst = function_.insts[value];
+        if(inst.op != ir::Opcode::PHI)
+        {
+            to.push_back(value);
+            continue;
+        }
+        if(replace_.size() <= value)
+            replace_.resize(value + 1, ir::NONE);
+        replace_[value] = function_.list(value)[1];
+        inst.op = ir::Opcode::NOP;
+    }
+    blocks[join].insts.clear();
+
+    for(auto succ : blocks[join].succs)
+    {
+        for(auto value : blocks[succ].insts)
+        {
+            if(function_.insts[value].op != ir::Opcode::PHI)
+                break;
+            auto pairs = function_.list(value);
+            for(size_t i = 0; i < pairs.size(); i += 2)
+            {
+                if(pairs[i] == join)
+                    pairs[i] = head;
+            }
+        }
+    }
+}
+
+ir::Value IfConversion::emit(ir::Block head, ir::Instruction inst)
+{
+    return function_.insert(head, function_.blocks[head].insts.size() - 1, inst);
+}
+
+ir::Value IfConversion::resolve(ir::Value value) const
+{
+    while(value < replace_.size() && replace_[value] != ir::NONE) { value = replace_[value]; }
+    return value;
+}
@@ -0,0 +1,47 @@
+#ifndef IF_CONVERT_HPP
+#define IF_CONVERT_HPP
+
+#pragma once
+#include "ir.hpp"
+#include <optional>
+
+// If-conversion, best run after Mem2Reg and GVN. A branch around a few pure instructions, the
+// diamond of an if with an else or the triangle of one without, is replaced by SELECTs of the
+// values the phis after it merge, a cmov, so data dependent min, max and clamps cannot be
+// mispredicted. A select of true and false is the condition itself, what setcc gives
+class IfConversion {
+  public:
+    IfConversion(ir::Function& function);
+
+    // Returns the number of branches removed
+    size_t run();
+
+  private:
+    // Both sides run every time once converted. A mispredicted branch costs 15 to 20 cycles
+    // and one on random data is mispredicted half the time, a handful of instructions is less
+    static constexpr size_t MAX_COST = 6;
+
+    ir::Function& function_;
+    std::vector<ir::Value> replace_;
+    size_t converted_ = 0;
+
+    bool convert(ir::Block head);
+
+    // Cost of running the instructions of arm unconditionally, nullopt when one may not run
+    std::optional<size_t> cost_of(ir::Block arm) const;
+
+    // Moves the instructions of arm but its branch before the terminator of head
+    void hoist(ir::Block arm, ir::Block head);
+
+    ir::Value select(ir::Block head, ir::Value condition, ir::Value yes, ir::Value no,
+                     uint16_t type);
+
+    // Appends join, whose only predecessor is head, to head
+    void merge(ir::Block head, ir::Block join);
+
+    ir::Value emit(ir::Block head, ir::Instruction inst);
+
+    ir::Value resolve(ir::Value value) const;
+};
+
+#endif // IF_CONVERT_HPP
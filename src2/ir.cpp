@@ -0,0 +1,615 @@
+#include "ir.hpp"
+#include <algorithm>
+#include <bit>
+
+ir::Block ir::Function::add_block()
+{
+    blocks.emplace_back();
+    return static_cast<Block>(blocks.size() - 1);
+}
+
+ir::Value ir::Function::append(Block block, Instruction inst)
+{
+    return insert(block, blocks[block].insts.size(), inst);
+}
+
+ir::Value ir::Function::insert(Block block, size_t position, Instruction inst)
+{
+    auto value = static_cast<Value>(insts.size());
+    insts.push_back(inst);
+    auto& block_insts = blocks[block].insts;
+    block_insts.insert(block_insts.begin() + position, value);
+    return value;
+}
+
+uint32_t ir::Function::add_list(std::span<const uint32_t> values)
+{
+    auto offset = static_cast<uint32_t>(operands.size());
+    operands.insert(operands.end(), values.begin(), values.end());
+    return offset;
+}
+
+std::span<uint32_t> ir::Function::list(Value value)
+{
+    auto& inst = insts[value];
+    return {operands.data() + inst.a, inst.b};
+}
+
+std::span<const uint32_t> ir::Function::list(Value value) const
+{
+    auto& inst = insts[value];
+    return {operands.data() + inst.a, inst.b};
+}
+
+// Types are shared by most instructions of a function, each one is stored once
+uint16_t ir::Function::intern(const std::shared_ptr<type::BuiltinType>& type)
+{
+    for(size_t i = 0; i < types.size(); i++)
+    {
+        if(types[i] == type)
+            return static_cast<uint16_t>(i);
+    }
+    types.push_back(type);
+    return static_cast<uint16_t>(types.size() - 1);
+}
+
+const std::shared_ptr<type::BuiltinType>& ir::Function::type_of(Value value) const
+{
+    return types[insts[value].type];
+}
+
+int64_t ir::Function::constant(Value value) const
+{
+    auto& inst = insts[value];
+    return static_cast<int64_t>(uint64_t{inst.b} << 32 | inst.a);
+}
+
+std::vector<ir::Block> ir::Function::successors(Block block) const
+{
+    auto& block_insts = blocks[block].insts;
+    if(block_insts.empty())
+        return {};
+    auto& terminator = insts[block_insts.back()];
+    if(terminator.op == Opcode::BR)
+        return {terminator.a};
+    if(terminator.op == Opcode::CONDBR && terminator.b == terminator.c)
+        return {terminator.b};
+    if(terminator.op == Opcode::CONDBR)
+        return {terminator.b, terminator.c};
+    if(terminator.op != Opcode::SWITCH)
+        return {};
+    // a target can be in a table many times, the edge is there once
+    std::vector<Block> targets;
+    for(auto target : list(block_insts.back()))
+    {
+        if(std::find(targets.begin(), targets.end(), target) == targets.end())
+            targets.push_back(target);
+    }
+    return targets;
+}
+
+// Rebuilds the edges from the terminators, predecessors are listed in block order
+void ir::Function::compute_cfg()
+{
+    for(auto& block : blocks)
+    {
+        block.preds.clear();
+        block.succs.clear();
+    }
+    for(Block block = 0; block < blocks.size(); block++)
+    {
+        blocks[block].succs = successors(block);
+        for(auto succ : blocks[block].succs) { blocks[succ].preds.push_back(block); }
+    }
+}
+
+// Drops the blocks the entry cannot reach, e.g. code after a return, and renumbers the rest
+// in their original order
+void ir::Function::remove_unreachable()
+{
+    compute_cfg();
+    std::vector<bool> reached(blocks.size(), false);
+    std::vector<Block> work{0};
+    reached[0] = true;
+    while(!work.empty())
+    {
+        auto block = work.back();
+        work.pop_back();
+        for(auto succ : blocks[block].succs)
+        {
+            if(reached[succ])
+                continue;
+            reached[succ] = true;
+            work.push_back(succ);
+        }
+    }
+
+    std::vector<Block> renumber(blocks.size(), NONE);
+    std::vector<BasicBlock> kept;
+    for(Block block = 0; block < blocks.size(); block++)
+    {
+        if(!reached[block])
+        {
+            for(auto value : blocks[block].insts) { insts[value].op = Opcode::NOP; }
+            continue;
+        }
+        renumber[block] = static_cast<Block>(kept.size());
+        kept.push_back(std::move(blocks[block]));
+    }
+    blocks = std::move(kept);
+
+    for(auto& block : blocks)
+    {
+        for(auto value : block.insts)
+        {
+            auto& inst = insts[value];
+            if(inst.op == Opcode::BR)
+                inst.a = renumber[inst.a];
+            else if(inst.op == Opcode::CONDBR)
+            {
+                inst.b = renumber[inst.b];
+                inst.c = renumber[inst.c];
+            }
+            else if(inst.op == Opcode::SWITCH)
+            {
+                for(auto& target : list(value)) { target = renumber[target]; }
+            }
+            else if(inst.op == Opcode::PHI)
+            {
+                std::vector<uint32_t> incoming;
+                auto pairs = list(value);
+                for(size_t i = 0; i < pairs.size(); i += 2)
+                {
+                    if(renumber[pairs[i]] == NONE)
+                        continue;
+                    incoming.push_back(renumber[pairs[i]]);
+                    incoming.push_back(pairs[i + 1]);
+                }
+                inst.a = add_list(incoming);
+                inst.b = static_cast<uint32_t>(incoming.size());
+            }
+        }
+    }
+    compute_cfg();
+}
+
+bool ir::is_terminator(Opcode op)
+{
+    return op == Opcode::BR || op == Opcode::CONDBR || op == Opcode::SWITCH || op == Opcode::RET;
+}
+
+bool ir::has_list(Opcode op)
+{
+    return op == Opcode::PHI || op == Opcode::CALL || op == Opcode::INTRINSIC ||
+           op == Opcode::SWITCH;
+}
+
+bool ir::is_commutative(Opcode op)
+{
+    switch(op)
+    {
+    case Opcode::ADD:
+    case Opcode::MUL:
+    case Opcode::MULHI:
+    case Opcode::AND:
+    case Opcode::OR:
+    case Opcode::XOR:
+    case Opcode::EQ:
+    case Opcode::NE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// DIV and MOD are left out, they trap on a zero divisor
+bool ir::is_pure(Opcode op)
+{
+    switch(op)
+    {
+    case Opcode::CONST:
+    case Opcode::PARAM:
+    case Opcode::UNDEF:
+    case Opcode::ADD:
+    case Opcode::SUB:
+    case Opcode::MUL:
+    case Opcode::MULHI:
+    case Opcode::SHL:
+    case Opcode::SHR:
+    case Opcode::AND:
+    case Opcode::OR:
+    case Opcode::XOR:
+    case Opcode::NOT:
+    case Opcode::EQ:
+    case Opcode::NE:
+    case Opcode::LT:
+    case Opcode::LE:
+    case Opcode::GT:
+    case Opcode::GE:
+    case Opcode::CONVERT:
+    case Opcode::SELECT:
+    case Opcode::ELEMENT:
+    case Opcode::PHI:
+        return true;
+    default:
+        return false;
+    }
+}
+
+std::string_view ir::opcode_name(Opcode op)
+{
+    switch(op)
+    {
+    case Opcode::NOP:
+        return "nop";
+    case Opcode::CONST:
+        return "const";
+    case Opcode::PARAM:
+        return "param";
+    case Opcode::UNDEF:
+        return "undef";
+    case Opcode::ADD:
+        return "add";
+    case Opcode::SUB:
+        return "sub";
+    case Opcode::MUL:
+        return "mul";
+    case Opcode::MULHI:
+        return "mulhi";
+    case Opcode::DIV:
+        return "div";
+    case Opcode::MOD:
+        return "mod";
+    case Opcode::SHL:
+        return "shl";
+    case Opcode::SHR:
+        return "shr";
+    case Opcode::AND:
+        return "and";
+    case Opcode::OR:
+        return "or";
+    case Opcode::XOR:
+        return "xor";
+    case Opcode::NOT:
+        return "not";
+    case Opcode::EQ:
+        return "eq";
+    case Opcode::NE:
+        return "ne";
+    case Opcode::LT:
+        return "lt";
+    case Opcode::LE:
+        return "le";
+    case Opcode::GT:
+        return "gt";
+    case Opcode::GE:
+        return "ge";
+    case Opcode::CONVERT:
+        return "convert";
+    case Opcode::SELECT:
+        return "select";
+    case Opcode::ALLOCA:
+        return "alloca";
+    case Opcode::LOAD:
+        return "load";
+    case Opcode::STORE:
+        return "store";
+    case Opcode::ELEMENT:
+        return "element";
+    case Opcode::BOUNDS_CHECK:
+        return "bounds_check";
+    case Opcode::CALL:
+        return "call";
+    case Opcode::INTRINSIC:
+        return "intrinsic";
+    case Opcode::PHI:
+        return "phi";
+    case Opcode::BR:
+        return "br";
+    case Opcode::CONDBR:
+        return "condbr";
+    case Opcode::SWITCH:
+        return "switch";
+    case Opcode::RET:
+        return "ret";
+    }
+    return "?";
+}
+
+ir::DominatorTree::DominatorTree(const Function& function)
+{
+    const size_t count = function.blocks.size();
+    idom_.assign(count, NONE);
+    children_.assign(count, {});
+    frontier_.assign(count, {});
+    enter_.assign(count, 0);
+    exit_.assign(count, 0);
+
+    // postorder numbers, unreachable blocks keep NONE
+    std::vector<uint32_t> order(count, NONE);
+    std::vector<bool> visited(count, false);
+    std::vector<std::pair<Block, size_t>> stack{{0, 0}};
+    visited[0] = true;
+    while(!stack.empty())
+    {
+        auto [block, next] = stack.back();
+        auto& succs = function.blocks[block].succs;
+        if(next < succs.size())
+        {
+            stack.back().second++;
+            if(!visited[succs[next]])
+            {
+                visited[succs[next]] = true;
+                stack.emplace_back(succs[next], 0);
+            }
+            continue;
+        }
+        order[block] = static_cast<uint32_t>(rpo_.size());
+        rpo_.push_back(block);
+        stack.pop_back();
+    }
+    std::reverse(rpo_.begin(), rpo_.end());
+
+    auto intersect = [this, &order](Block a, Block b)
+    {
+        while(a != b)
+        {
+            while(order[a] < order[b]) { a = idom_[a]; }
+            while(order[b] < order[a]) { b = idom_[b]; }
+        }
+        return a;
+    };
+    idom_[0] = 0;
+    bool changed = true;
+    while(changed)
+    {
+        changed = false;
+        for(auto block : rpo_)
+        {
+            if(block == 0)
+                continue;
+            Block dominator = NONE;
+            for(auto pred : function.blocks[block].preds)
+            {
+                if(idom_[pred] == NONE)
+                    continue;
+                dominator = dominator == NONE ? pred : intersect(pred, dominator);
+            }
+            if(dominator != idom_[block])
+            {
+                idom_[block] = dominator;
+                changed = true;
+            }
+        }
+    }
+
+    for(auto block : rpo_)
+    {
+        if(block != 0)
+            children_[idom_[block]].push_back(block);
+    }
+
+    uint32_t counter = 0;
+    std::vector<std::pair<Block, size_t>> walk{{0, 0}};
+    enter_[0] = counter++;
+    while(!walk.empty())
+    {
+        auto [block, next] = walk.back();
+        if(next < children_[block].size())
+        {
+            walk.back().second++;
+            auto child = children_[block][next];
+            enter_[child] = counter++;
+            walk.emplace_back(child, 0);
+            continue;
+        }
+        exit_[block] = counter++;
+        walk.pop_back();
+    }
+
+    // a join point is in the frontier of every block between its predecessors and its idom
+    for(auto block : rpo_)
+    {
+        auto& preds = function.blocks[block].preds;
+        if(preds.size() < 2)
+            continue;
+        for(auto pred : preds)
+        {
+            if(idom_[pred] == NONE)
+                continue;
+            for(auto runner = pred; runner != idom_[block]; runner = idom_[runner])
+            {
+                auto& frontier = frontier_[runner];
+                if(frontier.empty() || frontier.back() != block)
+                    frontier.push_back(block);
+                if(runner == 0)
+                    break;
+            }
+        }
+    }
+}
+
+ir::Block ir::DominatorTree::idom(Block block) const
+{
+    return block == 0 ? NONE : idom_[block];
+}
+
+bool ir::DominatorTree::dominates(Block a, Block b) const
+{
+    if(idom_[a] == NONE || idom_[b] == NONE)
+        return false;
+    return enter_[a] <= enter_[b] && exit_[b] <= exit_[a];
+}
+
+const std::vector<ir::Block>& ir::DominatorTree::children(Block block) const
+{
+    return children_[block];
+}
+
+const std::vector<ir::Block>& ir::DominatorTree::frontier(Block block) const
+{
+    return frontier_[block];
+}
+
+const std::vector<ir::Block>& ir::DominatorTree::reverse_postorder() const
+{
+    return rpo_;
+}
+
+static std::string_view intrinsic_name(uint32_t intrinsic)
+{
+    switch(static_cast<Intrinsic>(intrinsic))
+    {
+    case Intrinsic::VEC_SPLAT:
+        return "splat";
+    case Intrinsic::VEC_BUILD:
+        return "build";
+    case Intrinsic::VEC_EXTRACT:
+        return "extract";
+    case Intrinsic::VEC_INSERT:
+        return "insert";
+    case Intrinsic::VEC_REDUCE_ADD:
+        return "reduce_add";
+    case Intrinsic::VEC_REDUCE_MIN:
+        return "reduce_min";
+    case Intrinsic::VEC_REDUCE_MAX:
+        return "reduce_max";
+    case Intrinsic::VEC_REDUCE_AND:
+        return "reduce_and";
+    case Intrinsic::VEC_REDUCE_OR:
+        return "reduce_or";
+    case Intrinsic::VEC_REDUCE_XOR:
+        return "reduce_xor";
+    case Intrinsic::BIT_POPCOUNT:
+        return "popcount";
+    case Intrinsic::BIT_CLZ:
+        return "clz";
+    case Intrinsic::BIT_CTZ:
+        return "ctz";
+    case Intrinsic::BIT_BSWAP:
+        return "bswap";
+    case Intrinsic::BIT_ROTL:
+        return "rotl";
+    case Intrinsic::BIT_ROTR:
+        return "rotr";
+    case Intrinsic::ATOMIC_LOAD:
+        return "atomic_load";
+    case Intrinsic::ATOMIC_STORE:
+        return "atomic_store";
+    case Intrinsic::ATOMIC_FETCH_ADD:
+        return "atomic_fetch_add";
+    case Intrinsic::ATOMIC_EXCHANGE:
+        return "atomic_exchange";
+    case Intrinsic::ATOMIC_COMPARE_EXCHANGE:
+        return "atomic_compare_exchange";
+    default:
+        return "?";
+    }
+}
+
+void ir::print(std::ostream& out, const Module& module)
+{
+    for(const auto& function : module.functions) { print(out, module, function); }
+}
+
+void ir::print(std::ostream& out, const Module& module, const Function& function)
+{
+    out << "function " << function.name << "(";
+    for(size_t i = 0; i < function.params.size(); i++)
+        out << (i > 0 ? ", " : "") << function.params[i]->get_name();
+    out << ") -> " << function.return_type->get_name() << "\n";
+
+    for(Block block = 0; block < function.blocks.size(); block++)
+    {
+        out << "b" << block << ":";
+        if(!function.blocks[block].preds.empty())
+        {
+            out << "  ; preds";
+            for(auto pred : function.blocks[block].preds) { out << " b" << pred; }
+        }
+        out << "\n";
+        for(auto value : function.blocks[block].insts)
+        {
+            auto& inst = function.insts[value];
+            const auto& type = function.type_of(value);
+            out << "    ";
+            if(inst.op != Opcode::STORE && inst.op != Opcode::BOUNDS_CHECK &&
+               !is_terminator(inst.op) && type != type::TypeRegistry::instance()._void_())
+                out << "%" << value << " = " << opcode_name(inst.op) << " " << type->get_name();
+            else
+                out << opcode_name(inst.op);
+
+            switch(inst.op)
+            {
+            case Opcode::CONST:
+                if(type->is_floating())
+                    out << " " << std::bit_cast<double>(function.constant(value));
+                else
+                    out << " " << function.constant(value);
+                break;
+            case Opcode::PARAM:
+                out << " " << inst.c;
+                break;
+            case Opcode::BOUNDS_CHECK:
+                out << " %" << inst.a << ", " << inst.c;
+                break;
+            case Opcode::SELECT:
+                out << " %" << inst.a << ", %" << inst.b << ", %" << inst.c;
+                break;
+            case Opcode::PHI:
+                {
+                    auto pairs = function.list(value);
+                    for(size_t i = 0; i < pairs.size(); i += 2)
+                        out << (i > 0 ? ", " : " ") << "[b" << pairs[i] << ": %" << pairs[i + 1]
+                            << "]";
+                    break;
+                }
+            case Opcode::CALL:
+            case Opcode::INTRINSIC:
+                {
+                    if(inst.op == Opcode::CALL)
+                        out << " " << module.functions[inst.c].name << "(";
+                    else
+                        out << " " << intrinsic_name(inst.c) << "(";
+                    auto args = function.list(value);
+                    for(size_t i = 0; i < args.size(); i++)
+                        out << (i > 0 ? ", " : "") << "%" << args[i];
+                    out << ")";
+                    if(inst.op == Opcode::CALL && (inst.flags & CALL_TAIL))
+                        out << " tail";
+                    break;
+                }
+            case Opcode::BR:
+                out << " b" << inst.a;
+                break;
+            case Opcode::CONDBR:
+                out << " %" << inst.a << ", b" << inst.b << ", b" << inst.c;
+                break;
+            case Opcode::SWITCH:
+                {
+                    out << " %" << inst.c << " [";
+                    auto targets = function.list(value);
+                    for(size_t i = 0; i < targets.size(); i++)
+                        out << (i > 0 ? ", b" : "b") << targets[i];
+                    out << "]";
+                    break;
+                }
+            case Opcode::RET:
+                if(inst.a != NONE)
+                    out << " %" << inst.a;
+                break;
+            default:
+                if(inst.a != NONE)
+                    out << " %" << inst.a;
+                if(inst.b != NONE)
+                    out << ", %" << inst.b;
+                if(inst.flags & UNCHECKED)
+                    out << " unchecked";
+                if(inst.flags & NON_NEGATIVE)
+                    out << " nonneg";
+                break;
+            }
+            out << "\n";
+        }
+    }
+}
@@ -4,36 +4,207 @@
 #pragma once
 #include "ast_def.hpp"
 #include "type.hpp"
+#include <cstdint>
+#include <ostream>
+#include <span>
 
+// Mid-level IR in SSA form. The instructions of a function live in one array and a value is
+// the index of the instruction that defines it, so an instruction is 16 bytes, operands are
+// 32-bit indices and passes switch on the opcode instead of calling through a vtable
+namespace ir
+{
+    using Value = uint32_t;
+    using Block = uint32_t;
+    inline constexpr uint32_t NONE = UINT32_MAX;
 
+    // Operands are a, b and c unless noted. "list" means a is the offset of the operands in
+    // Function::operands and b their count
+    enum class Opcode : uint8_t {
+        NOP, // removed, the slot in the arena is not reused
+        CONST, // a holds the low and b the high 32 bits, floating point values as their bits
+        PARAM, // c is the parameter index
+        UNDEF,
+        // arithmetic on operands of the result type, signedness comes from the type
+        ADD,
+        SUB,
+        MUL,
+        MULHI, // high half of the product at twice the width, from strength reduction
+        DIV,
+        MOD,
+        SHL, // b keeps its own type
+        SHR, // arithmetic for signed types
+        AND,
+        OR,
+        XOR,
+        NOT, // a only, logical for bool and bitwise for integers
+        // comparisons produce a bool, signedness comes from the type of a
+        EQ,
+        NE,
+        LT,
+        LE,
+        GT,
+        GE,
+        CONVERT, // a extended, truncated or converted to the result type
+        SELECT, // b when the bool a is true, otherwise c, both are computed
+        // memory, the type of an alloca is the type it stores
+        ALLOCA,
+        LOAD, // a is the address
+        STORE, // a is the address, b the value
+        ELEMENT, // address of element b of the array at a
+        BOUNDS_CHECK, // traps unless 0 <= a < c
+        CALL, // list of arguments, c is the index of the callee in the module
+        INTRINSIC, // list of arguments, c is the Intrinsic and flags the MemoryOrder
+        PHI, // list of (block, value) pairs, one per predecessor
+        // terminators, the last instruction of every block
+        BR, // a is the target
+        CONDBR, // a is the condition, b the target when true and c when false
+        SWITCH, // list of targets, jumps to the one at index c, which must be in range
+        RET, // a is the value, NONE for void
+    };
 
+    struct Instruction {
+        Opcode op = Opcode::NOP;
+        // MemoryOrder of an intrinsic, CALL_TAIL of a call, UNCHECKED and NON_NEGATIVE of
+        // arithmetic
+        uint8_t flags = 0;
+        uint16_t type = 0; // index in Function::types
+        uint32_t a = NONE;
+        uint32_t b = NONE;
+        uint32_t c = NONE;
+    };
+    static_assert(sizeof(Instruction) == 16);
 
-class IRInstruction {
-    public:
-        virtual ~IRInstruction() = default;
-};
-
-class BinaryOpInstruction : public IRInstruction {
-    public:
-        enum class Op {
-            ADD,
-            SUB,
-            MUL,
-            DIV,
-            AND,
-            OR,
-            EQ,
-            NE,
-            LT,
-            LE,
-            GT,
-            GE,
-            XOR,
-            AND,
-            OR,
-        };
-
-        
-};
+    inline constexpr uint8_t CALL_TAIL = 1;
+    // DIV, MOD, SHL and SHR whose operands never need a runtime check
+    inline constexpr uint8_t UNCHECKED = 1;
+    // signed DIV, MOD and SHR of operands that are never negative, the unsigned instruction
+    // gives the same result
+    inline constexpr uint8_t NON_NEGATIVE = 2;
+
+    struct BasicBlock {
+        std::vector<Value> insts; // phis first, the terminator last
+        std::vector<Block> preds;
+        std::vector<Block> succs;
+    };
+
+    struct Function {
+        std::string_view name;
+        std::vector<std::shared_ptr<type::BuiltinType>> params;
+        std::shared_ptr<type::BuiltinType> return_type;
+        std::vector<Instruction> insts;
+        std::vector<uint32_t> operands;
+        std::vector<BasicBlock> blocks; // blocks[0] is the entry
+        std::vector<std::shared_ptr<type::BuiltinType>> types;
+
+        Block add_block();
+        Value append(Block block, Instruction inst);
+        Value insert(Block block, size_t position, Instruction inst);
+        uint32_t add_list(std::span<const uint32_t> values);
+        std::span<uint32_t> list(Value value);
+        std::span<const uint32_t> list(Value value) const;
+        uint16_t intern(const std::shared_ptr<type::BuiltinType>& type);
+        const std::shared_ptr<type::BuiltinType>& type_of(Value value) const;
+        int64_t constant(Value value) const;
+        std::vector<Block> successors(Block block) const;
+        void compute_cfg();
+        void remove_unreachable();
+
+        // f is called with a reference to every value operand of the instruction
+        template<class F> void for_each_operand(Value value, F&& f);
+    };
+
+    struct Module {
+        std::vector<Function> functions; // functions[0] runs the top level statements
+    };
+
+    bool is_terminator(Opcode op);
+
+    bool has_list(Opcode op);
+
+    bool is_commutative(Opcode op);
+
+    // no side effects and no memory access, unused results can be dropped
+    bool is_pure(Opcode op);
+
+    std::string_view opcode_name(Opcode op);
+
+    // Immediate dominators by the iterative algorithm of Cooper, Harvey and Kennedy over the
+    // reverse postorder, with the dominance frontiers phis are placed on
+    class DominatorTree {
+      public:
+        explicit DominatorTree(const Function& function);
+
+        Block idom(Block block) const;
+
+        bool dominates(Block a, Block b) const;
+
+        const std::vector<Block>& children(Block block) const;
+
+        const std::vector<Block>& frontier(Block block) const;
+
+        const std::vector<Block>& reverse_postorder() const;
+
+      private:
+        std::vector<Block> idom_;
+        std::vector<std::vector<Block>> children_;
+        std::vector<std::vector<Block>> frontier_;
+        std::vector<Block> rpo_;
+        // preorder entry and exit numbers in the tree, a dominates b when it encloses b
+        std::vector<uint32_t> enter_;
+        std::vector<uint32_t> exit_;
+    };
+
+    void print(std::ostream& out, const Module& module);
+
+    void print(std::ostream& out, const Module& module, const Function& function);
+
+    template<class F> void Function::for_each_operand(Value value, F&& f)
+    {
+        auto& inst = insts[value];
+        switch(inst.op)
+        {
+        case Opcode::NOP:
+        case Opcode::CONST:
+        case Opcode::PARAM:
+        case Opcode::UNDEF:
+        case Opcode::ALLOCA:
+        case Opcode::BR:
+            return;
+        case Opcode::NOT:
+        case Opcode::CONVERT:
+        case Opcode::LOAD:
+        case Opcode::BOUNDS_CHECK:
+        case Opcode::CONDBR:
+            f(inst.a);
+            return;
+        case Opcode::SWITCH:
+            f(inst.c);
+            return;
+        case Opcode::RET:
+            if(inst.a != NONE)
+                f(inst.a);
+            return;
+        case Opcode::PHI:
+            {
+                auto incoming = list(value);
+                for(size_t i = 1; i < incoming.size(); i += 2) { f(incoming[i]); }
+                return;
+            }
+        case Opcode::CALL:
+        case Opcode::INTRINSIC:
+            for(auto& arg : list(value)) { f(arg); }
+            return;
+        case Opcode::SELECT:
+            f(inst.a);
+            f(inst.b);
+            f(inst.c);
+            return;
+        default:
+            f(inst.a);
+            f(inst.b);
+            return;
+        }
+    }
+} // namespace ir
 
 #endif // IR_HPP
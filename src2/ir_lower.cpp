@@ -0,0 +1,731 @@
+#include "ir_lower.hpp"
+#include "dead_code.hpp"
+#include <algorithm>
+#include <bit>
+
+IRLowering::IRLowering(ASTProgram& program) : program_(program) {}
+
+ir::Module IRLowering::lower()
+{
+    auto& registry = type::TypeRegistry::instance();
+
+    // every signature is known before any body is lowered, calls may come first
+    std::vector<ASTFunction*> functions;
+    module_.functions.resize(1);
+    module_.functions[0].name = "main";
+    module_.functions[0].return_type = registry._int_();
+    for(auto& stmt : program_.stmts)
+    {
+        if(auto* declassign = std::get_if<declareassign_ptr>(&stmt);
+           declassign && (*declassign)->is_const)
+            constants_[(*declassign)->name] = declassign->get();
+        auto* function = std::get_if<function_ptr>(&stmt);
+        if(!function)
+            continue;
+        function_index_[(*function)->name] = static_cast<uint32_t>(module_.functions.size());
+        auto& lowered = module_.functions.emplace_back();
+        lowered.name = (*function)->name;
+        lowered.return_type = (*function)->return_type;
+        for(auto& param : (*function)->params) { lowered.params.push_back(param.type); }
+        functions.push_back(function->get());
+    }
+
+    lower_function(module_.functions[0], nullptr, nullptr);
+    for(size_t i = 0; i < functions.size(); i++)
+        lower_function(module_.functions[i + 1], &functions[i]->params, &functions[i]->body);
+    return std::move(module_);
+}
+
+// Without a body the top level statements are lowered. Falling off the end returns 0 from
+// main and an undefined value from other functions
+void IRLowering::lower_function(ir::Function& function, std::vector<ASTParameter>* params,
+                                scope_err_ptr_var* body)
+{
+    function_ = &function;
+    block_ = function.add_block();
+    allocas_ = 0;
+    slots_.clear();
+    loops_.clear();
+
+    if(params)
+    {
+        for(uint32_t i = 0; i < params->size(); i++)
+        {
+            auto& param = (*params)[i];
+            auto slot = new_slot(param.name, param.type);
+            emit(ir::Opcode::STORE, type::TypeRegistry::instance()._void_(), slot,
+                 emit(ir::Opcode::PARAM, param.type, ir::NONE, ir::NONE, i));
+        }
+    }
+    if(body)
+        lower_scope(*body);
+    else
+    {
+        for(auto& stmt : program_.stmts) { lower_stmt(stmt); }
+    }
+
+    if(!terminated())
+    {
+        auto& registry = type::TypeRegistry::instance();
+        if(function.return_type == registry._void_())
+            emit(ir::Opcode::RET, registry._void_());
+        else if(!body)
+            emit(ir::Opcode::RET, registry._void_(), constant(function.return_type, 0));
+        else
+            emit(ir::Opcode::RET, registry._void_(), emit(ir::Opcode::UNDEF, function.return_type));
+    }
+    function.remove_unreachable();
+}
+
+void IRLowering::lower_stmt(statements_ptr_var& node)
+{
+    auto& registry = type::TypeRegistry::instance();
+    // code after a return, break or continue goes to a block nothing jumps to
+    if(terminated())
+        block_ = function_->add_block();
+
+    std::visit(
+        Overload{[this](scope_ptr& scope)
+                 {
+                     auto* stmts = std::get_if<std::vector<statements_ptr_var>>(&scope->stmts);
+                     if(!stmts)
+                         return;
+                     for(auto& stmt : *stmts) { lower_stmt(stmt); }
+                 },
+                 [this](break_ptr&) { jump(loops_.back().break_target); },
+                 [this](continue_ptr&) { jump(loops_.back().continue_target); },
+                 [this, &registry](return_ptr& _return)
+                 {
+                     auto value = convert(lower_expr(_return->val), function_->return_type);
+                     emit(ir::Opcode::RET, registry._void_(), value);
+                 },
+                 [this](if_ptr& _if) { lower_if(*_if); },
+                 [this](while_ptr& _while)
+                 { lower_loop(_while->condition, _while->scope, nullptr); },
+                 [this](for_ptr& _for) { lower_for(*_for); },
+                 [this, &registry](declareassign_ptr& declassign)
+                 {
+                     // an atomic is initialized with a plain store before it can be shared
+                     auto value_type = declassign->type;
+                     if(value_type->is_atomic())
+                         value_type = static_cast<type::AtomicType&>(*value_type).element;
+                     auto value = convert(lower_expr(declassign->expr), value_type);
+                     auto slot = new_slot(declassign->name, declassign->type);
+                     emit(ir::Opcode::STORE, registry._void_(), slot, value);
+                 },
+                 [this](declare_ptr& declare) { new_slot(declare->name, declare->type); },
+                 [this, &registry](assign_ptr& assign)
+                 {
+                     auto value = lower_expr(assign->expr);
+                     ir::Value address = slots_.at(assign->name);
+                     if(assign->index.has_value())
+                         address = element(assign->name, assign->index.value(),
+                                           assign->bounds_checked);
+                     value = convert(value, function_->type_of(address));
+                     emit(ir::Opcode::STORE, registry._void_(), address, value);
+                 },
+                 [this](callstmt_ptr& stmt) { lower_expr(stmt->call); },
+                 [](auto&&) {}},
+        node);
+}
+
+void IRLowering::lower_scope(scope_err_ptr_var& node)
+{
+    auto* scope = std::get_if<scope_ptr>(&node);
+    if(!scope)
+        return;
+    auto* stmts = std::get_if<std::vector<statements_ptr_var>>(&(*scope)->stmts);
+    if(!stmts)
+        return;
+    for(auto& stmt : *stmts) { lower_stmt(stmt); }
+}
+
+// else (condition) { ... } is only taken when its own condition holds as well
+void IRLowering::lower_if(ASTIf& _if)
+{
+    if(lower_switch(_if))
+        return;
+    ASTElse* _else = nullptr;
+    if(_if.else_clause.has_value())
+    {
+        if(auto* clause = std::get_if<else_ptr>(&_if.else_clause.value()))
+            _else = clause->get();
+    }
+    auto then = function_->add_block();
+    auto otherwise = _else ? function_->add_block() : ir::NONE;
+    auto join = function_->add_block();
+    if(!_else)
+        otherwise = join;
+
+    lower_condition(_if.condition, then, otherwise);
+    block_ = then;
+    lower_scope(_if.scope);
+    jump(join);
+
+    if(_else)
+    {
+        block_ = otherwise;
+        if(_else->condition.has_value())
+        {
+            auto else_then = function_->add_block();
+            lower_condition(_else->condition.value(), else_then, join);
+            block_ = else_then;
+        }
+        lower_scope(_else->scope);
+        jump(join);
+    }
+    block_ = join;
+}
+
+// An if whose else holds nothing but another if continues the chain. When every condition
+// compares one variable with constants the variable is loaded once and dispatched with a
+// bounds checked jump table if the constants are dense, else with a binary search. The first
+// arm testing a value keeps it, like the chain tested in order would
+bool IRLowering::lower_switch(ASTIf& _if)
+{
+    struct Arm {
+        scope_err_ptr_var* scope;
+        std::vector<int64_t> values;
+    };
+    std::vector<Arm> arms;
+    expression_ptr_var* subject = nullptr;
+    statements_ptr_var* fallback = nullptr; // the if ending the chain
+    ASTElse* last = nullptr; // else (condition) that is not a case
+    scope_err_ptr_var* otherwise_scope = nullptr;
+
+    for(ASTIf* current = &_if; current;)
+    {
+        Arm arm{&current->scope, {}};
+        if(!case_values(current->condition, subject, arm.values))
+            return false;
+        arms.push_back(std::move(arm));
+        auto* clause = current->else_clause.has_value()
+                           ? std::get_if<else_ptr>(&current->else_clause.value())
+                           : nullptr;
+        current = nullptr;
+        if(!clause)
+            break;
+        auto& _else = **clause;
+        if(_else.condition.has_value())
+        {
+            Arm final{&_else.scope, {}};
+            if(case_values(_else.condition.value(), subject, final.values))
+                arms.push_back(std::move(final));
+            else
+                last = &_else;
+            break;
+        }
+        auto* scope = std::get_if<scope_ptr>(&_else.scope);
+        auto* stmts = scope ? std::get_if<std::vector<statements_ptr_var>>(&(*scope)->stmts)
+                            : nullptr;
+        auto* nested = stmts && stmts->size() == 1 ? std::get_if<if_ptr>(&stmts->front())
+                                                   : nullptr;
+        std::vector<int64_t> probe;
+        if(!nested)
+            otherwise_scope = &_else.scope;
+        else if(case_values((*nested)->condition, subject, probe))
+            current = nested->get();
+        else
+            fallback = &stmts->front();
+    }
+
+    size_t count = 0;
+    for(auto& arm : arms) { count += arm.values.size(); }
+    if(count < SWITCH_CASES)
+        return false;
+
+    auto& registry = type::TypeRegistry::instance();
+    auto value = lower_expr(*subject);
+    auto type = function_->type_of(value);
+    auto join = function_->add_block();
+    auto otherwise = fallback || last || otherwise_scope ? function_->add_block() : join;
+
+    std::vector<Case> cases;
+    std::vector<ir::Block> targets;
+    for(auto& arm : arms)
+    {
+        targets.push_back(function_->add_block());
+        for(auto case_value : arm.values)
+        {
+            auto same = [case_value](const Case& other) { return other.value == case_value; };
+            if(std::none_of(cases.begin(), cases.end(), same))
+                cases.push_back({case_value, targets.back()});
+        }
+    }
+    const bool is_signed = type->is_signed();
+    std::sort(cases.begin(), cases.end(),
+              [is_signed](const Case& a, const Case& b)
+              {
+                  return is_signed ? a.value < b.value
+                                   : static_cast<uint64_t>(a.value) <
+                                         static_cast<uint64_t>(b.value);
+              });
+
+    const uint64_t range =
+        static_cast<uint64_t>(cases.back().value) - static_cast<uint64_t>(cases.front().value);
+    if(range < JUMP_TABLE_SIZE && range < cases.size() * 3)
+    {
+        // x - min compared as unsigned covers both ends of the range at once
+        std::shared_ptr<type::BuiltinType> index_type;
+        switch(type->size())
+        {
+        case 1:
+            index_type = registry._u8_();
+            break;
+        case 2:
+            index_type = registry._u16_();
+            break;
+        case 4:
+            index_type = registry._u32_();
+            break;
+        default:
+            index_type = registry._u64_();
+            break;
+        }
+        auto offset = emit(ir::Opcode::SUB, type, value, constant(type, cases.front().value));
+        auto index = convert(offset, index_type);
+        auto table = function_->add_block();
+        branch(emit(ir::Opcode::LE, registry._bool_(), index,
+                    constant(index_type, static_cast<int64_t>(range))),
+               table, otherwise);
+        block_ = table;
+        std::vector<uint32_t> entries(range + 1, otherwise);
+        for(auto& entry : cases)
+            entries[static_cast<uint64_t>(entry.value) -
+                    static_cast<uint64_t>(cases.front().value)] = entry.target;
+        emit_list(ir::Opcode::SWITCH, registry._void_(), entries, index);
+    }
+    else
+        lower_search(value, cases, otherwise);
+
+    for(size_t i = 0; i < arms.size(); i++)
+    {
+        block_ = targets[i];
+        lower_scope(*arms[i].scope);
+        jump(join);
+    }
+    if(otherwise != join)
+    {
+        block_ = otherwise;
+        if(fallback)
+            lower_stmt(*fallback);
+        else if(otherwise_scope)
+            lower_scope(*otherwise_scope);
+        else
+        {
+            auto then = function_->add_block();
+            lower_condition(last->condition.value(), then, join);
+            block_ = then;
+            lower_scope(last->scope);
+        }
+        jump(join);
+    }
+    block_ = join;
+    return true;
+}
+
+// Halves the sorted cases until a few are left to test one by one
+void IRLowering::lower_search(ir::Value subject, std::span<const Case> cases, ir::Block otherwise)
+{
+    auto& registry = type::TypeRegistry::instance();
+    auto type = function_->type_of(subject);
+    if(cases.size() <= 3)
+    {
+        for(size_t i = 0; i < cases.size(); i++)
+        {
+            auto next = i + 1 < cases.size() ? function_->add_block() : otherwise;
+            branch(emit(ir::Opcode::EQ, registry._bool_(), subject,
+                        constant(type, cases[i].value)),
+                   cases[i].target, next);
+            block_ = next;
+        }
+        return;
+    }
+    const size_t middle = cases.size() / 2;
+    auto below = function_->add_block();
+    auto above = function_->add_block();
+    branch(emit(ir::Opcode::LT, registry._bool_(), subject, constant(type, cases[middle].value)),
+           below, above);
+    block_ = below;
+    lower_search(subject, cases.first(middle), otherwise);
+    block_ = above;
+    lower_search(subject, cases.subspan(middle), otherwise);
+}
+
+// continue runs the step before the condition is tested again. A parallel loop is lowered
+// like a sequential one, outlining its body for the runtime is left to the backend
+void IRLowering::lower_for(ASTFor& _for)
+{
+    if(_for.init.has_value())
+        lower_stmt(_for.init.value());
+    lower_loop(_for.condition, _for.scope, _for.step.has_value() ? &_for.step.value() : nullptr);
+}
+
+// Loops are rotated so an iteration ends in the one conditional branch back to the body. A
+// cheap condition is duplicated as a guard in front of the loop, otherwise the loop is entered
+// with a jump to the test at the bottom, past the step. continue goes to the step followed by
+// the test
+void IRLowering::lower_loop(expression_ptr_var& condition, scope_err_ptr_var& scope,
+                            statements_ptr_var* step)
+{
+    auto body = function_->add_block();
+    auto latch = function_->add_block();
+    auto test = step ? function_->add_block() : latch;
+    auto exit = function_->add_block();
+    if(cost(condition) <= ROTATE_COST)
+        lower_condition(condition, body, exit);
+    else
+        jump(test);
+
+    loops_.push_back({latch, exit});
+    block_ = body;
+    lower_scope(scope);
+    jump(latch);
+    loops_.pop_back();
+
+    block_ = latch;
+    if(step)
+    {
+        lower_stmt(*step);
+        jump(test);
+        block_ = test;
+    }
+    lower_condition(condition, body, exit);
+    block_ = exit;
+}
+
+// && and || branch on one operand at a time, the right one only runs when the left one does
+// not decide, and ! swaps the targets. Only the comparisons at the leaves produce a bool, each
+// read by the one branch after it, compare and jump
+void IRLowering::lower_condition(expression_ptr_var& node, ir::Block if_true, ir::Block if_false)
+{
+    if(auto* boolean = std::get_if<boolean_ptr>(&node))
+    {
+        jump((*boolean)->value ? if_true : if_false);
+        return;
+    }
+    auto* expr = std::get_if<expression_ptr>(&node);
+    if(!expr || !*expr || (*expr)->type != type::TypeRegistry::instance()._bool_())
+    {
+        branch(lower_expr(node), if_true, if_false);
+        return;
+    }
+    switch((*expr)->op)
+    {
+    case Operator::NOT:
+        lower_condition((*expr)->lhs, if_false, if_true);
+        return;
+    case Operator::AND:
+    case Operator::OR:
+        {
+            auto rhs = function_->add_block();
+            if((*expr)->op == Operator::AND)
+                lower_condition((*expr)->lhs, rhs, if_false);
+            else
+                lower_condition((*expr)->lhs, if_true, rhs);
+            block_ = rhs;
+            lower_condition((*expr)->rhs, if_true, if_false);
+            return;
+        }
+    default:
+        branch(lower_expr(node), if_true, if_false);
+        return;
+    }
+}
+
+// A stored && or || whose right operand can fault or has side effects branches as well, into
+// a bool slot Mem2Reg turns into a phi
+ir::Value IRLowering::lower_logical(expression_ptr_var& node)
+{
+    auto& registry = type::TypeRegistry::instance();
+    ir::Instruction inst{ir::Opcode::ALLOCA, 0, function_->intern(registry._bool_())};
+    auto slot = function_->insert(0, allocas_++, inst);
+    auto if_true = function_->add_block();
+    auto if_false = function_->add_block();
+    auto join = function_->add_block();
+    lower_condition(node, if_true, if_false);
+    for(auto [block, value] : {std::pair{if_true, 1}, std::pair{if_false, 0}})
+    {
+        block_ = block;
+        emit(ir::Opcode::STORE, registry._void_(), slot, constant(registry._bool_(), value));
+        jump(join);
+    }
+    block_ = join;
+    return emit(ir::Opcode::LOAD, registry._bool_(), slot);
+}
+
+ir::Value IRLowering::lower_expr(expression_ptr_var& node)
+{
+    auto& registry = type::TypeRegistry::instance();
+    return std::visit(
+        Overload{[this, &registry](integer_ptr& integer) -> ir::Value
+                 {
+                     auto type = integer->type;
+                     if(!type && integer->above_i64)
+                         type = registry._u64_();
+                     else if(!type)
+                         type = registry._int_()->can_represent(integer->value) ? registry._int_()
+                                                                                : registry._i64_();
+                     return constant(type, integer->value);
+                 },
+                 [this, &registry](boolean_ptr& boolean) -> ir::Value
+                 { return constant(registry._bool_(), boolean->value ? 1 : 0); },
+                 [this, &registry](float_ptr& floating) -> ir::Value
+                 {
+                     auto type = floating->type;
+                     if(!type)
+                         type = floating->single ? registry._float_() : registry._double_();
+                     return constant(type, std::bit_cast<int64_t>(floating->value));
+                 },
+                 [this](identifier_ptr& ident) -> ir::Value
+                 {
+                     auto slot = slots_.find(ident->name);
+                     if(slot != slots_.end())
+                         return emit(ir::Opcode::LOAD, ident->type, slot->second);
+                     auto constant = constants_.find(ident->name);
+                     if(constant != constants_.end())
+                         return convert(lower_expr(constant->second->expr), ident->type);
+                     return emit(ir::Opcode::UNDEF, ident->type);
+                 },
+                 [this, &node](expression_ptr& expr) -> ir::Value
+                 {
+                     if((expr->op == Operator::AND || expr->op == Operator::OR) &&
+                        !DeadCodeEliminator::is_speculatable(expr->rhs))
+                         return lower_logical(node);
+                     auto lhs = convert(lower_expr(expr->lhs), expr->operand_type);
+                     if(expr->op == Operator::NOT)
+                         return emit(ir::Opcode::NOT, expr->type, lhs);
+                     // the count of a shift keeps its own type
+                     auto rhs = lower_expr(expr->rhs);
+                     if(expr->op != Operator::LSH && expr->op != Operator::RSH)
+                         rhs = convert(rhs, expr->operand_type);
+                     auto result = emit(opcode(expr->op), expr->type, lhs, rhs);
+                     if(!expr->checked)
+                         function_->insts[result].flags |= ir::UNCHECKED;
+                     if(expr->non_negative)
+                         function_->insts[result].flags |= ir::NON_NEGATIVE;
+                     return result;
+                 },
+                 [this](call_ptr& call) -> ir::Value { return lower_call(*call); },
+                 [this](index_ptr& index) -> ir::Value
+                 {
+                     auto address = element(index->name, index->index, index->bounds_checked);
+                     return emit(ir::Opcode::LOAD, index->type, address);
+                 },
+                 [this, &registry](auto&&) -> ir::Value
+                 { return emit(ir::Opcode::UNDEF, registry._undefined_()); }},
+        node);
+}
+
+// Arguments convert to the parameter types like in an assignment. The atomic an atomic
+// intrinsic works on is passed by address and its order is kept in the flags
+ir::Value IRLowering::lower_call(ASTCall& call)
+{
+    std::vector<uint32_t> args;
+    if(call.intrinsic == Intrinsic::NONE)
+    {
+        auto callee = function_index_.at(call.callee);
+        auto& params = module_.functions[callee].params;
+        for(size_t i = 0; i < call.args.size(); i++)
+            args.push_back(convert(lower_expr(call.args[i]), params[i]));
+        auto result = emit_list(ir::Opcode::CALL, call.type, args, callee);
+        if(call.tail_call)
+            function_->insts[result].flags |= ir::CALL_TAIL;
+        return result;
+    }
+
+    std::shared_ptr<type::BuiltinType> element_type = nullptr;
+    size_t first = 0;
+    switch(call.intrinsic)
+    {
+    case Intrinsic::VEC_SPLAT:
+    case Intrinsic::VEC_BUILD:
+        element_type = static_cast<type::VectorType&>(*call.type).element;
+        break;
+    case Intrinsic::ATOMIC_LOAD:
+    case Intrinsic::ATOMIC_STORE:
+    case Intrinsic::ATOMIC_FETCH_ADD:
+    case Intrinsic::ATOMIC_EXCHANGE:
+    case Intrinsic::ATOMIC_COMPARE_EXCHANGE:
+        {
+            ir::Value address = ir::NONE;
+            if(auto* variable = std::get_if<identifier_ptr>(&call.args[0]))
+                address = slots_.at((*variable)->name);
+            else
+            {
+                auto& index = std::get<index_ptr>(call.args[0]);
+                address = element(index->name, index->index, index->bounds_checked);
+            }
+            element_type = static_cast<type::AtomicType&>(*function_->type_of(address)).element;
+            args.push_back(address);
+            first = 1;
+            break;
+        }
+    default:
+        break;
+    }
+    for(size_t i = first; i < call.args.size(); i++)
+    {
+        // the order of an atomic is an identifier the analyzer already resolved
+        if(call.intrinsic >= Intrinsic::ATOMIC_LOAD && i == call.args.size() - 1)
+            break;
+        auto arg = lower_expr(call.args[i]);
+        args.push_back(element_type ? convert(arg, element_type) : arg);
+    }
+    auto result = emit_list(ir::Opcode::INTRINSIC, call.type, args,
+                            static_cast<uint32_t>(call.intrinsic));
+    function_->insts[result].flags = static_cast<uint8_t>(call.order);
+    return result;
+}
+
+// Address of name[index], checked against the length unless the check was proven redundant
+ir::Value IRLowering::element(std::string_view name, expression_ptr_var& index, bool checked)
+{
+    auto base = slots_.at(name);
+    auto& array = static_cast<type::ArrayType&>(*function_->type_of(base));
+    auto position = lower_expr(index);
+    if(checked)
+        emit(ir::Opcode::BOUNDS_CHECK, type::TypeRegistry::instance()._void_(), position, ir::NONE,
+             static_cast<uint32_t>(array.length));
+    return emit(ir::Opcode::ELEMENT, array.element, base, position);
+}
+
+// Slots are allocated at the start of the entry block, whichever block declares them
+ir::Value IRLowering::new_slot(std::string_view name, const std::shared_ptr<type::BuiltinType>& type)
+{
+    ir::Instruction inst{ir::Opcode::ALLOCA, 0, function_->intern(type)};
+    auto slot = function_->insert(0, allocas_++, inst);
+    slots_[name] = slot;
+    return slot;
+}
+
+ir::Value IRLowering::convert(ir::Value value, const std::shared_ptr<type::BuiltinType>& type)
+{
+    if(!type || function_->type_of(value) == type)
+        return value;
+    return emit(ir::Opcode::CONVERT, type, value);
+}
+
+ir::Value IRLowering::constant(const std::shared_ptr<type::BuiltinType>& type, int64_t bits)
+{
+    auto value = static_cast<uint64_t>(bits);
+    return emit(ir::Opcode::CONST, type, static_cast<uint32_t>(value),
+                static_cast<uint32_t>(value >> 32));
+}
+
+ir::Value IRLowering::emit(ir::Opcode op, const std::shared_ptr<type::BuiltinType>& type,
+                           uint32_t a, uint32_t b, uint32_t c)
+{
+    return function_->append(block_, {op, 0, function_->intern(type), a, b, c});
+}
+
+ir::Value IRLowering::emit_list(ir::Opcode op, const std::shared_ptr<type::BuiltinType>& type,
+                                const std::vector<uint32_t>& operands, uint32_t c)
+{
+    auto offset = function_->add_list(operands);
+    return emit(op, type, offset, static_cast<uint32_t>(operands.size()), c);
+}
+
+void IRLowering::jump(ir::Block target)
+{
+    if(!terminated())
+        emit(ir::Opcode::BR, type::TypeRegistry::instance()._void_(), target);
+}
+
+void IRLowering::branch(ir::Value condition, ir::Block if_true, ir::Block if_false)
+{
+    emit(ir::Opcode::CONDBR, type::TypeRegistry::instance()._void_(), condition, if_true,
+         if_false);
+}
+
+bool IRLowering::terminated() const
+{
+    auto& insts = function_->blocks[block_].insts;
+    return !insts.empty() && ir::is_terminator(function_->insts[insts.back()].op);
+}
+
+// Roughly the instructions evaluating node takes, a call never counts as cheap
+size_t IRLowering::cost(expression_ptr_var& node)
+{
+    return std::visit(Overload{[](call_ptr&) { return ROTATE_COST + 1; },
+                               [](index_ptr& index) { return 2 + cost(index->index); },
+                               [](expression_ptr& expr)
+                               { return expr ? 1 + cost(expr->lhs) + cost(expr->rhs) : 0; },
+                               [](auto&&) -> size_t { return 0; }},
+                      node);
+}
+
+// x == 1 || x == 2 tests two values, the variable has to have the operand type
+bool IRLowering::case_values(expression_ptr_var& condition, expression_ptr_var*& subject,
+                             std::vector<int64_t>& values)
+{
+    auto* expr = std::get_if<expression_ptr>(&condition);
+    if(!expr || !*expr)
+        return false;
+    if((*expr)->op == Operator::OR)
+        return case_values((*expr)->lhs, subject, values) &&
+               case_values((*expr)->rhs, subject, values);
+    if((*expr)->op != Operator::EQ)
+        return false;
+
+    auto* side = &(*expr)->lhs;
+    auto* other = &(*expr)->rhs;
+    if(!std::holds_alternative<identifier_ptr>(*side))
+        std::swap(side, other);
+    auto* ident = std::get_if<identifier_ptr>(side);
+    auto* literal = std::get_if<integer_ptr>(other);
+    auto& type = (*expr)->operand_type;
+    if(!ident || !literal || !type || !type->is_integer() || (*ident)->type != type)
+        return false;
+    if(!subject)
+        subject = side;
+    else if(std::get<identifier_ptr>(*subject)->name != (*ident)->name)
+        return false;
+    values.push_back(ConstantEvaluator::wrap(static_cast<uint64_t>((*literal)->value), *type));
+    return true;
+}
+
+ir::Opcode IRLowering::opcode(Operator op)
+{
+    switch(op)
+    {
+    case Operator::MUL:
+        return ir::Opcode::MUL;
+    case Operator::DIV:
+        return ir::Opcode::DIV;
+    case Operator::MOD:
+        return ir::Opcode::MOD;
+    case Operator::ADD:
+        return ir::Opcode::ADD;
+    case Operator::SUB:
+        return ir::Opcode::SUB;
+    case Operator::LSH:
+        return ir::Opcode::SHL;
+    case Operator::RSH:
+        return ir::Opcode::SHR;
+    case Operator::LESS:
+        return ir::Opcode::LT;
+    case Operator::GREATER:
+        return ir::Opcode::GT;
+    case Operator::LESSEQ:
+        return ir::Opcode::LE;
+    case Operator::GREATEREQ:
+        return ir::Opcode::GE;
+    case Operator::BAND:
+    case Operator::AND:
+        return ir::Opcode::AND;
+    case Operator::XOR:
+        return ir::Opcode::XOR;
+    case Operator::BOR:
+    case Operator::OR:
+        return ir::Opcode::OR;
+    case Operator::EQ:
+        return ir::Opcode::EQ;
+    case Operator::NEQ:
+        return ir::Opcode::NE;
+    case Operator::NOT:
+        return ir::Opcode::NOT;
+    default:
+        return ir::Opcode::NOP;
+    }
+}
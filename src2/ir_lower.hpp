@@ -0,0 +1,106 @@
+#ifndef IR_LOWER_HPP
+#define IR_LOWER_HPP
+
+#pragma once
+#include "ast_def.hpp"
+#include "const_eval.hpp"
+#include "ir.hpp"
+#include "semantics.hpp"
+#include <map>
+
+// Lowers a program without semantic errors to IR. Every variable gets a stack slot that is
+// loaded and stored, Mem2Reg turns the slots whose address is never taken into SSA values.
+// The top level statements become a function named main returning int
+class IRLowering {
+  public:
+    IRLowering(ASTProgram& program);
+
+    ir::Module lower();
+
+  private:
+    // a loop condition is duplicated as a guard when it costs at most this much
+    static constexpr size_t ROTATE_COST = 4;
+    // if/else chains testing one variable against fewer constants are lowered test by test
+    static constexpr size_t SWITCH_CASES = 4;
+    // a jump table covers at most this many values, at least a third of them cases
+    static constexpr uint64_t JUMP_TABLE_SIZE = 4096;
+
+    struct Loop {
+        ir::Block continue_target;
+        ir::Block break_target;
+    };
+
+    struct Case {
+        int64_t value;
+        ir::Block target;
+    };
+
+    ASTProgram& program_;
+    ir::Module module_;
+    std::map<std::string_view, uint32_t, std::less<>> function_index_;
+    // top level constants, functions only see them folded except for u64 values above INT64_MAX
+    std::map<std::string_view, ASTDeclareAssign*, std::less<>> constants_;
+
+    ir::Function* function_ = nullptr;
+    ir::Block block_ = 0;
+    size_t allocas_ = 0; // slots at the start of the entry block
+    std::map<std::string_view, ir::Value, std::less<>> slots_;
+    std::vector<Loop> loops_;
+
+    void lower_function(ir::Function& function, std::vector<ASTParameter>* params,
+                        scope_err_ptr_var* body);
+
+    void lower_stmt(statements_ptr_var& node);
+
+    void lower_scope(scope_err_ptr_var& node);
+
+    void lower_if(ASTIf& _if);
+
+    bool lower_switch(ASTIf& _if);
+
+    void lower_search(ir::Value subject, std::span<const Case> cases, ir::Block otherwise);
+
+    void lower_for(ASTFor& _for);
+
+    void lower_loop(expression_ptr_var& condition, scope_err_ptr_var& scope,
+                    statements_ptr_var* step);
+
+    // Branches to if_true or if_false without materializing the value of node
+    void lower_condition(expression_ptr_var& node, ir::Block if_true, ir::Block if_false);
+
+    ir::Value lower_logical(expression_ptr_var& node);
+
+    ir::Value lower_expr(expression_ptr_var& node);
+
+    ir::Value lower_call(ASTCall& call);
+
+    ir::Value element(std::string_view name, expression_ptr_var& index, bool checked);
+
+    ir::Value new_slot(std::string_view name, const std::shared_ptr<type::BuiltinType>& type);
+
+    ir::Value convert(ir::Value value, const std::shared_ptr<type::BuiltinType>& type);
+
+    ir::Value constant(const std::shared_ptr<type::BuiltinType>& type, int64_t bits);
+
+    ir::Value emit(ir::Opcode op, const std::shared_ptr<type::BuiltinType>& type,
+                   uint32_t a = ir::NONE, uint32_t b = ir::NONE, uint32_t c = ir::NONE);
+
+    ir::Value emit_list(ir::Opcode op, const std::shared_ptr<type::BuiltinType>& type,
+                        const std::vector<uint32_t>& operands, uint32_t c);
+
+    void jump(ir::Block target);
+
+    void branch(ir::Value condition, ir::Block if_true, ir::Block if_false);
+
+    bool terminated() const;
+
+    static size_t cost(expression_ptr_var& node);
+
+    // Adds the constants condition compares subject with, it holds for exactly those values
+    static bool case_values(expression_ptr_var& condition, expression_ptr_var*& subject,
+                            std::vector<int64_t>& values);
+
+    static ir::Opcode opcode(Operator op);
+};
+
+#endif // IR_LOWER_HPP
@@ -8,8 +8,22 @@ const std::unordered_map<std::string_view, TokenType> Lexer::KEYWORDS = {
     {"return", TokenType::KW_RETURN},
     {"break", TokenType::KW_BREAK},
     {"continue", TokenType::KW_CONTINUE},
+    {"struct", TokenType::KW_STRUCT},
+    {"soa", TokenType::KW_SOA},
+    {"const", TokenType::KW_CONST},
+    {"parallel", TokenType::KW_PARALLEL},
     {"int", TokenType::TYPE_INT},
     {"bool", TokenType::TYPE_BOOL},
+    {"i8", TokenType::TYPE_I8},
+    {"i16", TokenType::TYPE_I16},
+    {"i32", TokenType::TYPE_I32},
+    {"i64", TokenType::TYPE_I64},
+    {"u8", TokenType::TYPE_U8},
+    {"u16", TokenType::TYPE_U16},
+    {"u32", TokenType::TYPE_U32},
+    {"u64", TokenType::TYPE_U64},
+    {"float", TokenType::TYPE_FLOAT},
+    {"double", TokenType::TYPE_DOUBLE},
     {"true", TokenType::BOOL_LITERAL},
     {"false", TokenType::BOOL_LITERAL},
 };
@@ -80,9 +94,14 @@ Token Lexer::next_token()
     case '}':
         advance();
         return {TokenType::BRACE_R, "}", {line_, column_ - 1}};
-    case '=':
+    case '[':
         advance();
-        return {TokenType::OP_ASSIGN, "=", {line_, column_ - 1}};
+        return {TokenType::BRACKET_L, "[", {line_, column_ - 1}};
+    case ']':
+        advance();
+        return {TokenType::BRACKET_R, "]", {line_, column_ - 1}};
+    case '=':
+        return equals();
     default:
         std::cerr << "Unexpected character: " << c << " on line " << line_ << ", column " << column_ << std::endl;
         advance();
@@ -112,8 +131,44 @@ Token Lexer::number_literal()
 {
     size_t start_index = index_;
     size_t start_column = column_;
-    while(!is_eof() && std::isdigit(view_.at(index_))) { advance(); }
+    bool is_float = false;
+    auto digits = [this]()
+    {
+        size_t count = 0;
+        for(; !is_eof() && std::isdigit(view_.at(index_)); count++) { advance(); }
+        return count;
+    };
+    digits();
+    // the fraction and the exponent need at least one digit each, 1. and 1e are malformed
+    bool malformed = false;
+    if(expect('.'))
+    {
+        is_float = true;
+        advance();
+        malformed = digits() == 0;
+    }
+    if(expect('e') || expect('E'))
+    {
+        is_float = true;
+        advance();
+        if(expect('+') || expect('-'))
+            advance();
+        malformed = digits() == 0 || malformed;
+    }
+    // 'f' marks a single precision literal, e.g. 1.5f
+    if(is_float && expect('f'))
+        advance();
+
     std::string_view num_str = view_.substr(start_index, index_ - start_index);
+    if(malformed)
+    {
+        std::cerr << "Malformed number: " << num_str << " on line " << line_ << ", column "
+                  << start_column << std::endl;
+        errors_++;
+        return {TokenType::ERROR, num_str, {line_, start_column}};
+    }
+    if(is_float)
+        return {TokenType::FLOAT_LITERAL, num_str, {line_, start_column}};
     return {TokenType::INT_LITERAL, num_str, {line_, start_column}};
 }
 
@@ -131,6 +186,20 @@ Token Lexer::excl_mark()
     }
 }
 
+Token Lexer::equals()
+{
+    advance();
+    if(!is_eof() && expect('='))
+    {
+        advance();
+        return {TokenType::OP_EQUAL, "==", {line_, column_ - 2}};
+    }
+    else
+    {
+        return {TokenType::OP_ASSIGN, "=", {line_, column_ - 1}};
+    }
+}
+
 Token Lexer::caret_left()
 {
     advance();
@@ -204,15 +273,19 @@ bool Lexer::is_eof()
 
 void Lexer::skip_insignificant()
 {
-    switch(view_.at(index_))
+    while(!is_eof())
     {
-    case '\t':
-    case '\n':
-    case ' ':
-        advance();
-        return;
-    default:
-        return;
+        switch(view_.at(index_))
+        {
+        case '\t':
+        case '\n':
+        case '\r':
+        case ' ':
+            advance();
+            break;
+        default:
+            return;
+        }
     }
 }
 
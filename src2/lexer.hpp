@@ -22,6 +22,7 @@ class Lexer {
     Token identifier_or_keyword();
     Token number_literal();
     Token excl_mark();
+    Token equals();
     Token caret_left();
     Token caret_right();
     Token ampersand();
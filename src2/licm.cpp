@@ -0,0 +1,290 @@
+#include "licm.hpp"
+#include "dead_code.hpp"
+#include <bit>
+
+LoopInvariantMotion::LoopInvariantMotion(program_ptr&& program) : program_(std::move(program)) {}
+
+program_ptr&& LoopInvariantMotion::run()
+{
+    visit_stmts(program_->stmts);
+    return std::move(program_);
+}
+
+size_t LoopInvariantMotion::hoisted() const
+{
+    return hoisted_;
+}
+
+void LoopInvariantMotion::visit_stmts(std::vector<statements_ptr_var>& stmts)
+{
+    for(size_t i = 0; i < stmts.size(); i++)
+    {
+        visit_stmt(stmts[i]);
+        auto* loop = std::get_if<while_ptr>(&stmts[i]);
+        if(!loop)
+            continue;
+        Preheader preheader;
+        hoist((*loop)->condition, **loop, preheader);
+        hoist((*loop)->scope, **loop, preheader);
+        const size_t count = preheader.stmts.size();
+        stmts.insert(stmts.begin() + i, std::make_move_iterator(preheader.stmts.begin()),
+                     std::make_move_iterator(preheader.stmts.end()));
+        i += count;
+    }
+}
+
+void LoopInvariantMotion::visit_stmt(statements_ptr_var& node)
+{
+    std::visit(Overload{[this](scope_ptr& scope)
+                        {
+                            auto* stmts =
+                                std::get_if<std::vector<statements_ptr_var>>(&scope->stmts);
+                            if(stmts)
+                                visit_stmts(*stmts);
+                        },
+                        [this](if_ptr& _if)
+                        {
+                            visit_scope(_if->scope);
+                            if(!_if->else_clause.has_value())
+                                return;
+                            if(auto* _else = std::get_if<else_ptr>(&_if->else_clause.value()))
+                                visit_scope((*_else)->scope);
+                        },
+                        [this](while_ptr& _while)
+                        {
+                            loops_.push_back(_while.get());
+                            visit_scope(_while->scope);
+                            loops_.pop_back();
+                        },
+                        [this](for_ptr& _for) { visit_scope(_for->scope); },
+                        [this](function_ptr& function) { visit_scope(function->body); },
+                        [](auto&&) {}},
+               node);
+}
+
+void LoopInvariantMotion::visit_scope(scope_err_ptr_var& node)
+{
+    auto* scope = std::get_if<scope_ptr>(&node);
+    auto* stmts = scope ? std::get_if<std::vector<statements_ptr_var>>(&(*scope)->stmts)
+                        : nullptr;
+    if(stmts)
+        visit_stmts(*stmts);
+}
+
+// Every expression in the body is a candidate, also those of nested branches and loops
+void LoopInvariantMotion::hoist(statements_ptr_var& node, ASTWhile& loop, Preheader& preheader)
+{
+    std::visit(Overload{[this, &loop, &preheader](scope_ptr& scope)
+                        {
+                            auto* stmts =
+                                std::get_if<std::vector<statements_ptr_var>>(&scope->stmts);
+                            if(stmts)
+                                hoist(*stmts, loop, preheader);
+                        },
+                        [this, &loop, &preheader](if_ptr& _if)
+                        {
+                            hoist(_if->condition, loop, preheader);
+                            hoist(_if->scope, loop, preheader);
+                            if(!_if->else_clause.has_value())
+                                return;
+                            auto* _else = std::get_if<else_ptr>(&_if->else_clause.value());
+                            if(!_else)
+                                return;
+                            if((*_else)->condition.has_value())
+                                hoist((*_else)->condition.value(), loop, preheader);
+                            hoist((*_else)->scope, loop, preheader);
+                        },
+                        [this, &loop, &preheader](while_ptr& _while)
+                        {
+                            hoist(_while->condition, loop, preheader);
+                            hoist(_while->scope, loop, preheader);
+                        },
+                        [this, &loop, &preheader](for_ptr& _for)
+                        {
+                            if(_for->init.has_value())
+                                hoist(_for->init.value(), loop, preheader);
+                            hoist(_for->condition, loop, preheader);
+                            if(_for->step.has_value())
+                                hoist(_for->step.value(), loop, preheader);
+                            hoist(_for->scope, loop, preheader);
+                        },
+                        [this, &loop, &preheader](return_ptr& _return)
+                        { hoist(_return->val, loop, preheader); },
+                        [this, &loop, &preheader](callstmt_ptr& stmt)
+                        { hoist(stmt->call, loop, preheader); },
+                        [this, &loop, &preheader](declareassign_ptr& declassign)
+                        { hoist(declassign->expr, loop, preheader); },
+                        [this, &loop, &preheader](assign_ptr& assign)
+                        {
+                            if(assign->index.has_value())
+                                hoist(assign->index.value(), loop, preheader);
+                            hoist(assign->expr, loop, preheader);
+                        },
+                        [](auto&&) {}},
+               node);
+}
+
+void LoopInvariantMotion::hoist(scope_err_ptr_var& node, ASTWhile& loop, Preheader& preheader)
+{
+    auto* scope = std::get_if<scope_ptr>(&node);
+    auto* stmts = scope ? std::get_if<std::vector<statements_ptr_var>>(&(*scope)->stmts)
+                        : nullptr;
+    if(stmts)
+        hoist(*stmts, loop, preheader);
+}
+
+// A temporary of an inner loop that is invariant here as well moves out whole
+void LoopInvariantMotion::hoist(std::vector<statements_ptr_var>& stmts, ASTWhile& loop,
+                                Preheader& preheader)
+{
+    for(size_t i = 0; i < stmts.size();)
+    {
+        auto* declassign = std::get_if<declareassign_ptr>(&stmts[i]);
+        if(declassign && temporaries_.contains((*declassign)->name) &&
+           is_invariant((*declassign)->expr, loop))
+        {
+            loop.assigned.erase((*declassign)->name);
+            preheader.stmts.push_back(std::move(stmts[i]));
+            stmts.erase(stmts.begin() + i);
+            continue;
+        }
+        hoist(stmts[i], loop, preheader);
+        i++;
+    }
+}
+
+// Replaces the largest invariant subexpressions of node. Literals and expressions of only
+// literals are left to constant folding
+void LoopInvariantMotion::hoist(expression_ptr_var& node, ASTWhile& loop, Preheader& preheader)
+{
+    auto* expr = std::get_if<expression_ptr>(&node);
+    if(expr && *expr && (*expr)->type && is_invariant(node, loop) && reads_variables(node))
+    {
+        auto loc = (*expr)->loc;
+        auto type = (*expr)->type;
+        auto name = temporary(std::move(node), preheader);
+        auto ident = builder_.build_identifier(loc, name);
+        ident->type = type;
+        node = std::move(ident);
+        return;
+    }
+
+    std::visit(Overload{[this, &loop, &preheader](call_ptr& call)
+                        {
+                            for(auto& arg : call->args) { hoist(arg, loop, preheader); }
+                        },
+                        [this, &loop, &preheader](index_ptr& index)
+                        { hoist(index->index, loop, preheader); },
+                        [this, &loop, &preheader](expression_ptr& expr)
+                        {
+                            if(!expr)
+                                return;
+                            hoist(expr->lhs, loop, preheader);
+                            hoist(expr->rhs, loop, preheader);
+                        },
+                        [](auto&&) {}},
+               node);
+}
+
+// The temporary is written once before the loop, every loop around it sees it as assigned
+// so it is not moved above its declaration
+std::string_view LoopInvariantMotion::temporary(expression_ptr_var&& value, Preheader& preheader)
+{
+    hoisted_++;
+    auto key = key_of(value);
+    auto existing = preheader.names.find(key);
+    if(existing != preheader.names.end())
+        return existing->second;
+
+    auto& expr = *std::get<expression_ptr>(value);
+    auto type = expr.type;
+    auto loc = expr.loc;
+    std::string_view name = program_->generated_names.emplace_back(
+        "inv." + std::to_string(program_->generated_names.size()));
+    auto declassign = builder_.build_declareassign(loc, type->get_name(), name, std::move(value));
+    declassign->type = type;
+    preheader.stmts.push_back(std::move(declassign));
+    preheader.names[key] = name;
+    temporaries_.insert(name);
+    for(auto* loop : loops_) { loop->assigned.insert(name); }
+    return name;
+}
+
+bool LoopInvariantMotion::is_invariant(expression_ptr_var& node, const ASTWhile& loop)
+{
+    if(!DeadCodeEliminator::is_speculatable(node))
+        return false;
+    return std::visit(Overload{[&loop](identifier_ptr& ident)
+                               { return !loop.assigned.contains(ident->name); },
+                               [&loop](index_ptr& index)
+                               {
+                                   return !loop.assigned.contains(index->name) &&
+                                          is_invariant(index->index, loop);
+                               },
+                               [&loop](call_ptr& call)
+                               {
+                                   return std::all_of(call->args.begin(), call->args.end(),
+                                                      [&loop](expression_ptr_var& arg)
+                                                      { return is_invariant(arg, loop); });
+                               },
+                               [&loop](expression_ptr& expr)
+                               {
+                                   return !expr || (is_invariant(expr->lhs, loop) &&
+                                                    is_invariant(expr->rhs, loop));
+                               },
+                               [](auto&&) { return true; }},
+                      node);
+}
+
+bool LoopInvariantMotion::reads_variables(expression_ptr_var& node)
+{
+    return std::visit(Overload{[](identifier_ptr&) { return true; },
+                               [](index_ptr&) { return true; },
+                               [](call_ptr& call)
+                               {
+                                   return std::any_of(call->args.begin(), call->args.end(),
+                                                      [](expression_ptr_var& arg)
+                                                      { return reads_variables(arg); });
+                               },
+                               [](expression_ptr& expr)
+                               {
+                                   return expr && (reads_variables(expr->lhs) ||
+                                                   reads_variables(expr->rhs));
+                               },
+                               [](auto&&) { return false; }},
+                      node);
+}
+
+std::string LoopInvariantMotion::key_of(expression_ptr_var& node)
+{
+    auto type_name = [](const std::shared_ptr<type::BuiltinType>& type)
+    { return type ? std::string(type->get_name()) : std::string("?"); };
+    return std::visit(
+        Overload{[](identifier_ptr& ident) { return std::string(ident->name); },
+                 [&type_name](integer_ptr& integer)
+                 { return std::to_string(integer->value) + ":" + type_name(integer->type); },
+                 [](boolean_ptr& boolean) { return std::string(boolean->value ? "true" : "false"); },
+                 [](float_ptr& number)
+                 {
+                     return std::to_string(std::bit_cast<uint64_t>(number->value)) +
+                            (number->single ? "f" : "d");
+                 },
+                 [](index_ptr& index)
+                 { return std::string(index->name) + "[" + key_of(index->index) + "]"; },
+                 [](call_ptr& call)
+                 {
+                     std::string key = std::string(call->callee) + "(";
+                     for(auto& arg : call->args) { key += key_of(arg) + ","; }
+                     return key + ")";
+                 },
+                 [&type_name](expression_ptr& expr)
+                 {
+                     if(!expr)
+                         return std::string();
+                     return "(" + std::to_string(static_cast<int>(expr->op)) + " " +
+                            key_of(expr->lhs) + " " + key_of(expr->rhs) + " " +
+                            type_name(expr->operand_type) + ")";
+                 },
+                 [](auto&&) { return std::string("!"); }},
+        node);
+}
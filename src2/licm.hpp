@@ -0,0 +1,59 @@
+#ifndef LICM_HPP
+#define LICM_HPP
+
+#pragma once
+#include "ast_builder.hpp"
+#include "ast_def.hpp"
+#include "semantics.hpp"
+
+// Runs after semantic analysis. Moves expressions of a while loop that read nothing the loop
+// writes into temporaries declared right before it, the preheader, so they are computed once.
+// Only expressions that cannot fault anywhere are moved, the loop may not run at all and an
+// index or division a branch proved safe is only safe behind it. Inner loops are done first
+// so what they hoist can move further out
+class LoopInvariantMotion {
+  public:
+    LoopInvariantMotion(program_ptr&& program);
+
+    program_ptr&& run();
+
+    size_t hoisted() const;
+
+  private:
+    // temporaries of one loop, equal expressions share one
+    struct Preheader {
+        std::vector<statements_ptr_var> stmts;
+        std::map<std::string, std::string_view> names;
+    };
+
+    program_ptr program_;
+    ASTBuilder builder_;
+    std::vector<ASTWhile*> loops_; // around the statement being visited
+    std::set<std::string_view> temporaries_;
+    size_t hoisted_ = 0;
+
+    void visit_stmts(std::vector<statements_ptr_var>& stmts);
+
+    void visit_stmt(statements_ptr_var& node);
+
+    void visit_scope(scope_err_ptr_var& node);
+
+    void hoist(statements_ptr_var& node, ASTWhile& loop, Preheader& preheader);
+
+    void hoist(scope_err_ptr_var& node, ASTWhile& loop, Preheader& preheader);
+
+    void hoist(std::vector<statements_ptr_var>& stmts, ASTWhile& loop, Preheader& preheader);
+
+    void hoist(expression_ptr_var& node, ASTWhile& loop, Preheader& preheader);
+
+    std::string_view temporary(expression_ptr_var&& value, Preheader& preheader);
+
+    static bool is_invariant(expression_ptr_var& node, const ASTWhile& loop);
+
+    static bool reads_variables(expression_ptr_var& node);
+
+    // Equal for expressions that compute the same value from the same variables
+    static std::string key_of(expression_ptr_var& node);
+};
+
+#endif // LICM_HPP
@@ -0,0 +1,460 @@
+#include "loop_unroll.hpp"
+
+LoopUnroller::LoopUnroller(program_ptr&& program, size_t factor, uint64_t full_unroll_limit)
+    : program_(std::move(program)), factor_(std::max<size_t>(factor, 1)),
+      full_unroll_limit_(full_unroll_limit)
+{
+}
+
+program_ptr&& LoopUnroller::run()
+{
+    for(auto& stmt : program_->stmts) { visit_stmt(stmt); }
+    return std::move(program_);
+}
+
+size_t LoopUnroller::unrolled_loops() const
+{
+    return unrolled_;
+}
+
+// Inner loops are unrolled first, so a fully unrolled outer loop copies the unrolled inner one
+void LoopUnroller::visit_stmt(statements_ptr_var& node)
+{
+    if(auto* loop = std::get_if<for_ptr>(&node))
+    {
+        visit_scope((*loop)->scope);
+        auto counted = recognize(**loop);
+        // parallel loops keep their shape for the runtime to split, the induction variable
+        // recorded by recognize gives the bounds of each chunk
+        if(!counted.has_value() || (*loop)->parallel)
+            return;
+        if(counted->start.has_value() && counted->trip_count.has_value() &&
+           counted->trip_count.value() <= full_unroll_limit_)
+            unroll_fully(node, **loop, counted.value());
+        else
+            unroll(node, **loop, counted.value());
+        return;
+    }
+
+    std::visit(Overload{[this](scope_ptr& scope)
+                        {
+                            auto* stmts =
+                                std::get_if<std::vector<statements_ptr_var>>(&scope->stmts);
+                            if(!stmts)
+                                return;
+                            for(auto& stmt : *stmts) { visit_stmt(stmt); }
+                        },
+                        [this](if_ptr& _if)
+                        {
+                            visit_scope(_if->scope);
+                            if(!_if->else_clause.has_value())
+                                return;
+                            if(auto* _else = std::get_if<else_ptr>(&_if->else_clause.value()))
+                                visit_scope((*_else)->scope);
+                        },
+                        [this](while_ptr& _while) { visit_scope(_while->scope); },
+                        [this](function_ptr& function) { visit_scope(function->body); },
+                        [](auto&&) {}},
+               node);
+}
+
+void LoopUnroller::visit_scope(scope_err_ptr_var& node)
+{
+    auto* scope = std::get_if<scope_ptr>(&node);
+    if(!scope)
+        return;
+    auto* stmts = std::get_if<std::vector<statements_ptr_var>>(&(*scope)->stmts);
+    if(!stmts)
+        return;
+    for(auto& stmt : *stmts) { visit_stmt(stmt); }
+}
+
+// Matches for(v = start; v op limit; v = v + step) where the body does not assign v or limit
+// and does not leave the iteration early. Records the induction variable on the loop
+std::optional<LoopUnroller::CountedLoop> LoopUnroller::recognize(ASTFor& loop) const
+{
+    if(!loop.step.has_value())
+        return std::nullopt;
+    auto* step = std::get_if<assign_ptr>(&loop.step.value());
+    auto* update = step ? std::get_if<expression_ptr>(&(*step)->expr) : nullptr;
+    if(!update || (*step)->index.has_value())
+        return std::nullopt;
+
+    CountedLoop counted{};
+    counted.name = (*step)->name;
+    auto is_self = [&counted](expression_ptr_var& operand)
+    {
+        auto* ident = std::get_if<identifier_ptr>(&operand);
+        return ident && (*ident)->name == counted.name;
+    };
+    auto constant = [](expression_ptr_var& operand) -> std::optional<int64_t>
+    {
+        auto* literal = std::get_if<integer_ptr>(&operand);
+        if(!literal)
+            return std::nullopt;
+        return (*literal)->value;
+    };
+
+    std::optional<int64_t> delta;
+    if((*update)->op == Operator::ADD && is_self((*update)->lhs))
+        delta = constant((*update)->rhs);
+    else if((*update)->op == Operator::ADD && is_self((*update)->rhs))
+        delta = constant((*update)->lhs);
+    else if((*update)->op == Operator::SUB && is_self((*update)->lhs) &&
+            constant((*update)->rhs).has_value() && constant((*update)->rhs) != INT64_MIN)
+        delta = -constant((*update)->rhs).value();
+    if(!delta.has_value() || delta.value() == 0 || delta.value() == INT64_MIN)
+        return std::nullopt;
+    counted.step = delta.value();
+
+    auto* cond = std::get_if<expression_ptr>(&loop.condition);
+    if(!cond)
+        return std::nullopt;
+    counted.op = (*cond)->op;
+    counted.compare_type = (*cond)->operand_type;
+    auto* ident = std::get_if<identifier_ptr>(&(*cond)->lhs);
+    counted.limit = &(*cond)->rhs;
+    if(!ident || (*ident)->name != counted.name)
+    {
+        ident = std::get_if<identifier_ptr>(&(*cond)->rhs);
+        counted.limit = &(*cond)->lhs;
+        counted.op = mirror_operator(counted.op);
+    }
+    if(!ident || (*ident)->name != counted.name || is_self(*counted.limit))
+        return std::nullopt;
+    counted.type = (*ident)->type;
+    if(!counted.type || !counted.type->is_integer() || !counted.compare_type ||
+       !counted.compare_type->is_integer())
+        return std::nullopt;
+    if(!std::holds_alternative<integer_ptr>(*counted.limit) &&
+       !std::holds_alternative<identifier_ptr>(*counted.limit))
+        return std::nullopt;
+
+    // the step has to move v towards the limit
+    switch(counted.op)
+    {
+    case Operator::LESS:
+    case Operator::LESSEQ:
+        if(counted.step < 0)
+            return std::nullopt;
+        break;
+    case Operator::GREATER:
+    case Operator::GREATEREQ:
+        if(counted.step > 0)
+            return std::nullopt;
+        break;
+    case Operator::NEQ:
+        break;
+    default:
+        return std::nullopt;
+    }
+
+    auto* body = std::get_if<scope_ptr>(&loop.scope);
+    auto* stmts = body ? std::get_if<std::vector<statements_ptr_var>>(&(*body)->stmts) : nullptr;
+    if(!stmts)
+        return std::nullopt;
+    for(auto& stmt : *stmts)
+    {
+        if(!can_unroll(stmt, counted, false))
+            return std::nullopt;
+    }
+
+    if(loop.init.has_value())
+    {
+        if(auto* declassign = std::get_if<declareassign_ptr>(&loop.init.value());
+           declassign && (*declassign)->name == counted.name)
+            counted.start = constant((*declassign)->expr);
+        else if(auto* assign = std::get_if<assign_ptr>(&loop.init.value());
+                assign && (*assign)->name == counted.name && !(*assign)->index.has_value())
+            counted.start = constant((*assign)->expr);
+    }
+    auto limit = constant(*counted.limit);
+    if(counted.start.has_value() && limit.has_value())
+        counted.trip_count = trip_count(counted, limit.value());
+
+    loop.induction = InductionVariable{counted.name, counted.step, counted.trip_count};
+    return counted;
+}
+
+// Replaces the loop by one copy of the body per iteration with v replaced by its value
+void LoopUnroller::unroll_fully(statements_ptr_var& node, ASTFor& loop,
+                                const CountedLoop& counted)
+{
+    std::vector<statements_ptr_var> stmts;
+    if(loop.init.has_value())
+        stmts.push_back(std::move(loop.init.value()));
+
+    const int64_t start = counted.start.value();
+    const uint64_t trips = counted.trip_count.value();
+    // every value up to the one that ends the loop fits v, only the product can overflow
+    auto value_at = [&](uint64_t i)
+    { return static_cast<int64_t>(start + static_cast<__int128>(i) * counted.step); };
+    for(uint64_t i = 0; i < trips; i++)
+    {
+        stmts.push_back(copy_body(loop, counted, value_at(i), false));
+    }
+
+    // v keeps the value that ended the loop
+    auto last = builder_.build_integer(loop.loc, value_at(trips));
+    last->type = counted.type;
+    stmts.push_back(builder_.build_assign(loop.loc, counted.name, std::move(last)));
+
+    node = builder_.build_scope(loop.loc, std::move(stmts));
+    unrolled_++;
+}
+
+// Rewrites the loop into
+//     init; for(; v op limit - (factor - 1) * step; v = v + factor * step) { body x factor }
+//     for(; v op limit; v = v + step) { body }
+// where copy i of the body reads v + i * step. With a variable limit the unrolled loop is
+// guarded so that limit - (factor - 1) * step cannot wrap around
+bool LoopUnroller::unroll(statements_ptr_var& node, ASTFor& loop, const CountedLoop& counted)
+{
+    const auto factor = static_cast<int64_t>(factor_);
+    if(factor < 2 || counted.op == Operator::NEQ ||
+       (counted.trip_count.has_value() && counted.trip_count.value() < factor_))
+        return false;
+
+    int64_t span;
+    int64_t stride;
+    if(__builtin_mul_overflow(counted.step, factor - 1, &span) ||
+       __builtin_mul_overflow(counted.step, factor, &stride) || stride == INT64_MIN ||
+       !counted.type->can_represent(stride > 0 ? stride : -stride))
+        return false;
+
+    SourceLocation& loc = loop.loc;
+    ASTCloner cloner;
+    expression_ptr_var adjusted;
+    std::optional<expression_ptr_var> guard = std::nullopt;
+    if(auto* literal = std::get_if<integer_ptr>(counted.limit))
+    {
+        int64_t value;
+        if(__builtin_sub_overflow((*literal)->value, span, &value) ||
+           !counted.compare_type->can_represent(value))
+            return false;
+        auto bound = builder_.build_integer(loc, value);
+        bound->type = counted.compare_type;
+        adjusted = std::move(bound);
+    }
+    else
+    {
+        auto bound = span > 0 ? counted.compare_type->min_value()
+                              : counted.compare_type->max_value();
+        int64_t threshold;
+        if(!bound.has_value() || __builtin_add_overflow(bound.value(), span, &threshold) ||
+           !counted.compare_type->can_represent(span > 0 ? span : -span))
+            return false;
+        auto threshold_literal = builder_.build_integer(loc, threshold);
+        threshold_literal->type = counted.compare_type;
+        auto check = builder_.build_expression(loc,
+                                               cloner.clone(*counted.limit),
+                                               std::move(threshold_literal),
+                                               span > 0 ? Operator::GREATEREQ
+                                                        : Operator::LESSEQ);
+        check->type = type::TypeRegistry::instance()._bool_();
+        check->operand_type = counted.compare_type;
+        guard = std::move(check);
+        adjusted = offset_expression(loc, cloner.clone(*counted.limit), -span,
+                                     counted.compare_type);
+    }
+
+    std::string_view name = counted.name;
+    auto induction = builder_.build_identifier(loc, name);
+    induction->type = counted.type;
+    auto cond = builder_.build_expression(loc, std::move(induction), std::move(adjusted),
+                                          counted.op);
+    cond->type = type::TypeRegistry::instance()._bool_();
+    cond->operand_type = counted.compare_type;
+
+    std::vector<statements_ptr_var> copies;
+    for(int64_t i = 0; i < factor; i++)
+    {
+        copies.push_back(copy_body(loop, counted, i * counted.step, true));
+    }
+
+    auto stepped = builder_.build_identifier(loc, name);
+    stepped->type = counted.type;
+    auto step = builder_.build_assign(loc,
+                                      name,
+                                      offset_expression(loc, std::move(stepped), stride,
+                                                        counted.type));
+
+    std::optional<uint64_t> main_trips = std::nullopt;
+    std::optional<uint64_t> remainder_trips = std::nullopt;
+    if(counted.trip_count.has_value())
+    {
+        main_trips = counted.trip_count.value() / factor_;
+        remainder_trips = counted.trip_count.value() % factor_;
+    }
+
+    auto unrolled = builder_.build_for(loc,
+                                       std::nullopt,
+                                       std::move(cond),
+                                       std::move(step),
+                                       builder_.build_scope(loc, std::move(copies)));
+    unrolled->induction = InductionVariable{counted.name, stride, main_trips};
+
+    auto remainder = builder_.build_for(loc,
+                                        std::nullopt,
+                                        std::move(loop.condition),
+                                        std::move(loop.step),
+                                        std::move(loop.scope));
+    remainder->induction = InductionVariable{counted.name, counted.step, remainder_trips};
+
+    std::vector<statements_ptr_var> stmts;
+    if(loop.init.has_value())
+        stmts.push_back(std::move(loop.init.value()));
+    if(guard.has_value())
+    {
+        std::vector<statements_ptr_var> guarded;
+        guarded.push_back(std::move(unrolled));
+        stmts.push_back(builder_.build_if(loc,
+                                          std::move(guard.value()),
+                                          builder_.build_scope(loc, std::move(guarded)),
+                                          std::nullopt));
+    }
+    else
+        stmts.push_back(std::move(unrolled));
+    stmts.push_back(std::move(remainder));
+
+    node = builder_.build_scope(loc, std::move(stmts));
+    unrolled_++;
+    return true;
+}
+
+statements_ptr_var LoopUnroller::copy_body(ASTFor& loop, const CountedLoop& counted,
+                                           int64_t offset, bool relative) const
+{
+    auto substitute = [this, &counted, offset, relative](
+                          ASTIdentifier& ident) -> std::optional<expression_ptr_var>
+    {
+        if(ident.name != counted.name || (relative && offset == 0))
+            return std::nullopt;
+        if(!relative)
+        {
+            auto value = builder_.build_integer(ident.loc, offset);
+            value->type = counted.type;
+            return value;
+        }
+        std::string_view name = ident.name;
+        auto base = builder_.build_identifier(ident.loc, name);
+        base->type = counted.type;
+        return offset_expression(ident.loc, std::move(base), offset, counted.type);
+    };
+    ASTCloner cloner(substitute);
+    auto copy = cloner.clone(loop.scope);
+    return std::move(std::get<scope_ptr>(copy));
+}
+
+// value + offset, written as a subtraction for negative offsets so unsigned types stay valid
+expression_ptr_var LoopUnroller::offset_expression(SourceLocation& loc, expression_ptr_var&& value,
+                                                   int64_t offset,
+                                                   std::shared_ptr<type::BuiltinType> type) const
+{
+    if(offset == 0)
+        return std::move(value);
+    auto magnitude = builder_.build_integer(loc, offset > 0 ? offset : -offset);
+    magnitude->type = type;
+    auto expr = builder_.build_expression(loc,
+                                          std::move(value),
+                                          std::move(magnitude),
+                                          offset > 0 ? Operator::ADD : Operator::SUB);
+    expr->type = type;
+    expr->operand_type = type;
+    return expr;
+}
+
+// Number of iterations from start to limit, nullopt when the value that ends the loop
+// does not fit the induction variable and the loop would wrap around instead
+std::optional<uint64_t> LoopUnroller::trip_count(const CountedLoop& counted, int64_t limit)
+{
+    const __int128 start = counted.start.value();
+    const __int128 step = counted.step;
+    const __int128 end = limit;
+    __int128 trips = 0;
+    switch(counted.op)
+    {
+    case Operator::LESS:
+        trips = end > start ? (end - start + step - 1) / step : 0;
+        break;
+    case Operator::LESSEQ:
+        trips = end >= start ? (end - start) / step + 1 : 0;
+        break;
+    case Operator::GREATER:
+        trips = start > end ? (start - end - step - 1) / -step : 0;
+        break;
+    case Operator::GREATEREQ:
+        trips = start >= end ? (start - end) / -step + 1 : 0;
+        break;
+    case Operator::NEQ:
+        if((end - start) % step != 0 || (end - start) / step < 0)
+            return std::nullopt;
+        trips = (end - start) / step;
+        break;
+    default:
+        return std::nullopt;
+    }
+
+    const __int128 last = start + trips * step;
+    if(last < INT64_MIN || last > INT64_MAX ||
+       !counted.type->can_represent(static_cast<int64_t>(last)))
+        return std::nullopt;
+    return static_cast<uint64_t>(trips);
+}
+
+// Will return false when node writes v or the limit, or leaves the iteration early
+bool LoopUnroller::can_unroll(statements_ptr_var& node, const CountedLoop& counted, bool nested)
+{
+    std::string_view limit_name;
+    if(auto* limit = std::get_if<identifier_ptr>(counted.limit))
+        limit_name = (*limit)->name;
+    auto writes = [&counted, limit_name](std::string_view name)
+    { return name == counted.name || (!limit_name.empty() && name == limit_name); };
+    auto stmts_ok = [&counted](scope_err_vec_ptr& stmts, bool nested)
+    {
+        auto* vec = std::get_if<std::vector<statements_ptr_var>>(&stmts);
+        if(!vec)
+            return false;
+        for(auto& stmt : *vec)
+        {
+            if(!can_unroll(stmt, counted, nested))
+                return false;
+        }
+        return true;
+    };
+    auto scope_ok = [&stmts_ok](scope_err_ptr_var& scope, bool nested)
+    {
+        auto* body = std::get_if<scope_ptr>(&scope);
+        return body && stmts_ok((*body)->stmts, nested);
+    };
+
+    return std::visit(
+        Overload{[&](scope_ptr& scope) -> bool { return stmts_ok(scope->stmts, nested); },
+                 [nested](break_ptr&) -> bool { return nested; },
+                 [nested](continue_ptr&) -> bool { return nested; },
+                 [](return_ptr&) -> bool { return true; },
+                 [&](if_ptr& _if) -> bool
+                 {
+                     if(!scope_ok(_if->scope, nested))
+                         return false;
+                     if(!_if->else_clause.has_value())
+                         return true;
+                     auto* _else = std::get_if<else_ptr>(&_if->else_clause.value());
+                     return _else && scope_ok((*_else)->scope, nested);
+                 },
+                 [&](while_ptr& _while) -> bool { return scope_ok(_while->scope, true); },
+                 [&](for_ptr& _for) -> bool
+                 {
+                     if(_for->init.has_value() && !can_unroll(_for->init.value(), counted, true))
+                         return false;
+                     if(_for->step.has_value() && !can_unroll(_for->step.value(), counted, true))
+                         return false;
+                     return scope_ok(_for->scope, true);
+                 },
+                 [&](declareassign_ptr& declassign) -> bool { return !writes(declassign->name); },
+                 [&](declare_ptr& declare) -> bool { return !writes(declare->name); },
+                 [&](assign_ptr& assign) -> bool { return !writes(assign->name); },
+                 [](callstmt_ptr&) -> bool { return true; },
+                 [](auto&&) -> bool { return false; }},
+        node);
+}
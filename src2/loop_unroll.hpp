@@ -0,0 +1,63 @@
+#ifndef LOOP_UNROLL_HPP
+#define LOOP_UNROLL_HPP
+
+#pragma once
+#include "ast_builder.hpp"
+#include "ast_clone.hpp"
+#include "ast_def.hpp"
+#include "semantics.hpp"
+
+// Runs after semantic analysis. Finds the induction variable and trip count of for loops,
+// unrolls loops with a small constant trip count completely and the rest by factor, leaving
+// a remainder loop for the last iterations. factor 1 only records the induction variables
+class LoopUnroller {
+  public:
+    LoopUnroller(program_ptr&& program, size_t factor = 4, uint64_t full_unroll_limit = 8);
+
+    program_ptr&& run();
+
+    size_t unrolled_loops() const;
+
+  private:
+    // a loop of the form for(v = start; v op limit; v = v + step)
+    struct CountedLoop {
+        std::string_view name;
+        std::shared_ptr<type::BuiltinType> type;
+        std::optional<int64_t> start;
+        int64_t step;
+        Operator op; // with v on the left hand side
+        expression_ptr_var* limit;
+        std::shared_ptr<type::BuiltinType> compare_type;
+        std::optional<uint64_t> trip_count;
+    };
+
+    program_ptr program_;
+    size_t factor_;
+    uint64_t full_unroll_limit_;
+    size_t unrolled_ = 0;
+    ASTBuilder builder_;
+
+    void visit_stmt(statements_ptr_var& node);
+
+    void visit_scope(scope_err_ptr_var& node);
+
+    std::optional<CountedLoop> recognize(ASTFor& loop) const;
+
+    void unroll_fully(statements_ptr_var& node, ASTFor& loop, const CountedLoop& counted);
+
+    bool unroll(statements_ptr_var& node, ASTFor& loop, const CountedLoop& counted);
+
+    // copy of the loop body with v replaced by v + offset, or by offset when relative is false
+    statements_ptr_var copy_body(ASTFor& loop, const CountedLoop& counted, int64_t offset,
+                                 bool relative) const;
+
+    expression_ptr_var offset_expression(SourceLocation& loc, expression_ptr_var&& value,
+                                         int64_t offset,
+                                         std::shared_ptr<type::BuiltinType> type) const;
+
+    static std::optional<uint64_t> trip_count(const CountedLoop& counted, int64_t limit);
+
+    static bool can_unroll(statements_ptr_var& node, const CountedLoop& counted, bool nested);
+};
+
+#endif // LOOP_UNROLL_HPP
@@ -1,4 +1,21 @@
+#include "ast_builder.hpp"
+#include "bounds_check.hpp"
+#include "calls.hpp"
+#include "const_prop.hpp"
+#include "dead_code.hpp"
+#include "gvn.hpp"
+#include "if_convert.hpp"
+#include "ir_lower.hpp"
 #include "lexer.hpp"
+#include "licm.hpp"
+#include "loop_unroll.hpp"
+#include "mem2reg.hpp"
+#include "parser.hpp"
+#include "reassociate.hpp"
+#include "scalar_replace.hpp"
+#include "semantics.hpp"
+#include "strength_reduce.hpp"
+#include "target.hpp"
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -32,13 +49,32 @@ int main(int argc, char* argv[])
 
     std::cout << "Rend Compiler v0.1.0\n";
     std::cout << "Using C++20\n";
-    if(argc != 2)
+    if(argc < 2)
     {
         std::cerr << "Error: Requires an input file." << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    std::string filename = argv[1];
+    // target flags come before the input file, e.g. -mavx2 or -march=native
+    auto& target_info = target::TargetInfo::instance();
+    for(int i = 1; i < argc - 1; i++)
+    {
+        std::string_view flag = argv[i];
+        if(flag == "-march=native")
+        {
+            target_info.detect_host();
+            continue;
+        }
+        auto feature = target::TargetInfo::parse_flag(flag);
+        if(!feature.has_value())
+        {
+            std::cerr << "Error: Unknown option '" << flag << "'" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        target_info.enable(feature.value());
+    }
+
+    std::string filename = argv[argc - 1];
     if(!filename.ends_with(".rd"))
     {
         std::cerr << "Error: file is not of type '.rd'" << std::endl;
@@ -48,17 +84,51 @@ int main(int argc, char* argv[])
     std::string to_compile;
 
     std::stringstream cstream;
-    std::fstream in(argv[1], std::ios::in);
+    std::fstream in(filename, std::ios::in);
     cstream << in.rdbuf();
     to_compile = cstream.str();
     in.close();
 
     std::vector<Token> tokens;
     lex_source(to_compile, tokens);
+    if(errors_found)
+        return EXIT_FAILURE;
+
+    TokenStream stream(tokens);
+    ErrorReporter reporter;
+    Parser parser(stream, reporter);
+    std::vector<statements_ptr_var> stmts;
+    while(stream.peek().has_value()) { stmts.push_back(parser.parse_statement()); }
+    SourceLocation loc{};
+    auto program = ASTBuilder().build_program(loc, std::move(stmts));
+    // the target flags decide which intrinsics semantic analysis accepts
+    program = SemanticAnalyzer(std::move(program), reporter).analyze();
+    if(reporter.has_errors())
+    {
+        reporter.print_diagnostics();
+        return EXIT_FAILURE;
+    }
+
+    program = ConstantPropagator(std::move(program)).run();
+    program = DeadCodeEliminator(std::move(program), &reporter).run();
+    program = LoopInvariantMotion(std::move(program)).run();
+    program = Reassociator(std::move(program)).run();
+    program = LoopUnroller(std::move(program)).run();
+    program = BoundsCheckEliminator(std::move(program)).run();
+    program = CallAnalyzer(std::move(program)).run();
+    reporter.print_diagnostics();
+
+    auto module = IRLowering(*program).lower();
+    for(auto& function : module.functions)
+    {
+        ScalarReplacement(function).run();
+        Mem2Reg(function).run();
+        GlobalValueNumbering(function).run();
+        StrengthReduction(function).run();
+        IfConversion(function).run();
+    }
 
-    int nasm_exitcode = system("nasm -felf64 -g rend.asm");
-    std::cout << "nasm exited assembling with code " << nasm_exitcode << std::endl;
-    int gcc_exitcode = system("gcc -g rend.o -o rend -lc");
-    std::cout << "gcc exited linking with code " << gcc_exitcode << std::endl;
-    return errors_found ? EXIT_FAILURE : EXIT_SUCCESS;
+    // there is no backend yet, the optimized IR is the output
+    ir::print(std::cout, module);
+    return EXIT_SUCCESS;
 }
@@ -0,0 +1,282 @@
+#include "mem2reg.hpp"
+#include <set>
+
+Mem2Reg::Mem2Reg(ir::Function& function) : function_(function) {}
+
+size_t Mem2Reg::run()
+{
+    function_.compute_cfg();
+    find_slots();
+    if(slots_.empty())
+        return 0;
+
+    ir::DominatorTree tree(function_);
+    stacks_.assign(slots_.size(), {});
+    place_phis(tree);
+    replace_.assign(function_.insts.size(), ir::NONE);
+    rename(0, tree);
+    simplify_phis();
+    remove_dead_phis();
+
+    for(auto slot : slots_) { function_.insts[slot].op = ir::Opcode::NOP; }
+    std::set<ir::Value> used;
+    for(auto& block : function_.blocks)
+    {
+        for(auto value : block.insts)
+        {
+            function_.for_each_operand(value,
+                                       [this, &used](uint32_t& operand)
+                                       {
+                                           operand = resolve(operand);
+                                           used.insert(operand);
+                                       });
+        }
+    }
+    // an undef can be left over from a phi that was removed
+    for(auto& [type, undef] : undefs_)
+    {
+        if(!used.contains(undef))
+            function_.insts[undef].op = ir::Opcode::NOP;
+    }
+    for(auto& block : function_.blocks)
+    {
+        std::erase_if(block.insts,
+                      [this](ir::Value value) { return function_.insts[value].op == ir::Opcode::NOP; });
+    }
+    return slots_.size();
+}
+
+// The address of a promoted slot may only be the address operand of a load or a store. Used
+// for an element, passed to a call or stored somewhere it can be reached through memory
+void Mem2Reg::find_slots()
+{
+    std::set<ir::Value> escaped;
+    for(auto& block : function_.blocks)
+    {
+        for(auto value : block.insts)
+        {
+            auto& inst = function_.insts[value];
+            function_.for_each_operand(
+                value,
+                [this, &inst, &escaped](uint32_t& operand)
+                {
+                    if(operand == ir::NONE || function_.insts[operand].op != ir::Opcode::ALLOCA)
+                        return;
+                    const bool is_address =
+                        (inst.op == ir::Opcode::LOAD || inst.op == ir::Opcode::STORE) &&
+                        &operand == &inst.a;
+                    if(!is_address)
+                        escaped.insert(operand);
+                });
+        }
+    }
+
+    for(auto value : function_.blocks[0].insts)
+    {
+        if(function_.insts[value].op != ir::Opcode::ALLOCA || escaped.contains(value))
+            continue;
+        const auto& type = function_.type_of(value);
+        if(type->is_array() || type->is_atomic() || dynamic_cast<type::UDType*>(type.get()))
+            continue;
+        slot_index_[value] = slots_.size();
+        slots_.push_back(value);
+    }
+}
+
+// Incoming values are left empty here and filled in by rename, one per predecessor
+void Mem2Reg::place_phis(const ir::DominatorTree& tree)
+{
+    std::vector<std::vector<ir::Block>> stored_in(slots_.size());
+    for(ir::Block block = 0; block < function_.blocks.size(); block++)
+    {
+        for(auto value : function_.blocks[block].insts)
+        {
+            auto& inst = function_.insts[value];
+            if(inst.op != ir::Opcode::STORE || !slot_index_.contains(inst.a))
+                continue;
+            auto& blocks = stored_in[slot_index_[inst.a]];
+            if(blocks.empty() || blocks.back() != block)
+                blocks.push_back(block);
+        }
+    }
+
+    for(size_t slot = 0; slot < slots_.size(); slot++)
+    {
+        std::vector<bool> has_phi(function_.blocks.size(), false);
+        std::vector<bool> queued(function_.blocks.size(), false);
+        auto work = stored_in[slot];
+        for(auto block : work) { queued[block] = true; }
+        while(!work.empty())
+        {
+            auto block = work.back();
+            work.pop_back();
+            for(auto join : tree.frontier(block))
+            {
+                if(has_phi[join])
+                    continue;
+                has_phi[join] = true;
+                std::vector<uint32_t> incoming;
+                for(auto pred : function_.blocks[join].preds)
+                {
+                    incoming.push_back(pred);
+                    incoming.push_back(ir::NONE);
+                }
+                auto offset = function_.add_list(incoming);
+                auto phi = function_.insert(join, 0,
+                                            {ir::Opcode::PHI, 0, function_.insts[slots_[slot]].type,
+                                             offset, static_cast<uint32_t>(incoming.size())});
+                phi_slot_[phi] = slot;
+                if(!queued[join])
+                {
+                    queued[join] = true;
+                    work.push_back(join);
+                }
+            }
+        }
+    }
+}
+
+// Walks the dominator tree keeping the value each slot holds on top of its stack
+void Mem2Reg::rename(ir::Block block, const ir::DominatorTree& tree)
+{
+    std::vector<size_t> pushed;
+    // current() may add an undef to the entry block, iterate over a copy
+    auto insts = function_.blocks[block].insts;
+    for(auto value : insts)
+    {
+        const auto inst = function_.insts[value];
+        if(inst.op == ir::Opcode::PHI && phi_slot_.contains(value))
+        {
+            auto slot = phi_slot_[value];
+            stacks_[slot].push_back(value);
+            pushed.push_back(slot);
+        }
+        else if(inst.op == ir::Opcode::LOAD && slot_index_.contains(inst.a))
+        {
+            auto read = current(slot_index_[inst.a]);
+            if(replace_.size() <= value)
+                replace_.resize(function_.insts.size(), ir::NONE);
+            replace_[value] = read;
+            function_.insts[value].op = ir::Opcode::NOP;
+        }
+        else if(inst.op == ir::Opcode::STORE && slot_index_.contains(inst.a))
+        {
+            auto slot = slot_index_[inst.a];
+            stacks_[slot].push_back(resolve(inst.b));
+            pushed.push_back(slot);
+            function_.insts[value].op = ir::Opcode::NOP;
+        }
+    }
+
+    for(auto succ : function_.blocks[block].succs)
+    {
+        for(auto value : function_.blocks[succ].insts)
+        {
+            if(function_.insts[value].op != ir::Opcode::PHI)
+                break;
+            if(!phi_slot_.contains(value))
+                continue;
+            auto incoming = current(phi_slot_[value]);
+            auto pairs = function_.list(value);
+            for(size_t i = 0; i < pairs.size(); i += 2)
+            {
+                if(pairs[i] == block)
+                    pairs[i + 1] = incoming;
+            }
+        }
+    }
+
+    for(auto child : tree.children(block)) { rename(child, tree); }
+    for(auto slot : pushed) { stacks_[slot].pop_back(); }
+}
+
+// A phi merging one value apart from itself is that value, removing it can make others
+// trivial as well
+void Mem2Reg::simplify_phis()
+{
+    bool changed = true;
+    while(changed)
+    {
+        changed = false;
+        for(auto& [phi, slot] : phi_slot_)
+        {
+            if(function_.insts[phi].op != ir::Opcode::PHI)
+                continue;
+            ir::Value same = ir::NONE;
+            bool unique = true;
+            auto pairs = function_.list(phi);
+            for(size_t i = 1; i < pairs.size(); i += 2)
+            {
+                auto value = resolve(pairs[i]);
+                if(value == phi || value == same)
+                    continue;
+                if(same != ir::NONE)
+                {
+                    unique = false;
+                    break;
+                }
+                same = value;
+            }
+            if(!unique || same == ir::NONE)
+                continue;
+            if(replace_.size() <= phi)
+                replace_.resize(function_.insts.size(), ir::NONE);
+            replace_[phi] = same;
+            function_.insts[phi].op = ir::Opcode::NOP;
+            changed = true;
+        }
+    }
+}
+
+// Phis are placed wherever a slot could merge, the ones nothing reads are dropped
+void Mem2Reg::remove_dead_phis()
+{
+    std::set<ir::Value> live;
+    std::vector<ir::Value> work;
+    auto mark = [this, &live, &work](uint32_t& operand)
+    {
+        auto value = resolve(operand);
+        if(phi_slot_.contains(value) && live.insert(value).second)
+            work.push_back(value);
+    };
+    for(auto& block : function_.blocks)
+    {
+        for(auto value : block.insts)
+        {
+            if(!phi_slot_.contains(value))
+                function_.for_each_operand(value, mark);
+        }
+    }
+    while(!work.empty())
+    {
+        auto phi = work.back();
+        work.pop_back();
+        function_.for_each_operand(phi, mark);
+    }
+
+    for(auto& [phi, slot] : phi_slot_)
+    {
+        if(!live.contains(phi))
+            function_.insts[phi].op = ir::Opcode::NOP;
+    }
+}
+
+// Reading a slot before anything was stored in it reads an undefined value
+ir::Value Mem2Reg::current(size_t slot)
+{
+    if(!stacks_[slot].empty())
+        return stacks_[slot].back();
+    auto type = function_.insts[slots_[slot]].type;
+    auto it = undefs_.find(type);
+    if(it != undefs_.end())
+        return it->second;
+    auto undef = function_.insert(0, 0, {ir::Opcode::UNDEF, 0, type});
+    undefs_[type] = undef;
+    return undef;
+}
+
+ir::Value Mem2Reg::resolve(ir::Value value)
+{
+    while(value < replace_.size() && replace_[value] != ir::NONE) { value = replace_[value]; }
+    return value;
+}
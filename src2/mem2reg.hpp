@@ -0,0 +1,43 @@
+#ifndef MEM2REG_HPP
+#define MEM2REG_HPP
+
+#pragma once
+#include "ir.hpp"
+#include <map>
+
+// Promotes stack slots that are only loaded and stored as a whole to SSA values. Phis go on
+// the iterated dominance frontier of the blocks storing a slot, then loads are renamed to
+// the value stored last on the dominator tree path. Phis that end up unused or merging a
+// single value are removed again
+class Mem2Reg {
+  public:
+    Mem2Reg(ir::Function& function);
+
+    // Returns the number of slots promoted
+    size_t run();
+
+  private:
+    ir::Function& function_;
+    std::vector<ir::Value> slots_;
+    std::map<ir::Value, size_t> slot_index_;
+    std::map<ir::Value, size_t> phi_slot_;
+    std::vector<std::vector<ir::Value>> stacks_;
+    std::vector<ir::Value> replace_; // what a removed load or phi is replaced with
+    std::map<uint16_t, ir::Value> undefs_;
+
+    void find_slots();
+
+    void place_phis(const ir::DominatorTree& tree);
+
+    void rename(ir::Block block, const ir::DominatorTree& tree);
+
+    void simplify_phis();
+
+    void remove_dead_phis();
+
+    ir::Value current(size_t slot);
+
+    ir::Value resolve(ir::Value value);
+};
+
+#endif // MEM2REG_HPP
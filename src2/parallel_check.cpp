@@ -0,0 +1,274 @@
+#include "parallel_check.hpp"
+
+ParallelLoopChecker::ParallelLoopChecker(const Shared& shared, ErrorReporter& reporter)
+    : shared_(shared), reporter_(reporter)
+{
+}
+
+bool ParallelLoopChecker::check(ASTFor& loop)
+{
+    auto variable = loop_variable(loop);
+    if(!variable.has_value())
+    {
+        error(loop.loc,
+              "Parallel for needs a loop variable declared in its init, a constant step and a "
+              "condition comparing it, e.g. parallel for(int i = 0; i < n; i = i + 1)");
+        return false;
+    }
+    variable_ = variable.value();
+
+    visit_expr(loop.condition);
+    visit_scope(loop.scope, 0);
+
+    for(auto& [name, ops] : reductions_)
+    {
+        auto type = shared_.at(name);
+        if(reads_.contains(name))
+            error(loop.loc,
+                  "Reduction '" + std::string(name) +
+                      "' cannot be read in the body of a parallel loop");
+        else if(std::any_of(ops.begin(), ops.end(), [&ops](Operator op) { return op != ops[0]; }))
+            error(loop.loc,
+                  "Reduction '" + std::string(name) + "' must use the same operator everywhere");
+        else if(!type->is_integer() && type != type::TypeRegistry::instance()._bool_())
+            error(loop.loc,
+                  "Reduction '" + std::string(name) +
+                      "' must be an integer or bool, floating point arithmetic is not associative");
+        else
+            loop.reductions.push_back({name, ops[0]});
+    }
+    for(auto name : written_arrays_)
+    {
+        if(scattered_reads_.contains(name))
+            error(loop.loc,
+                  "Shared array '" + std::string(name) +
+                      "' is written in the parallel loop and can only be read at index '" +
+                      std::string(variable_) + "'");
+    }
+    return valid_;
+}
+
+// Chunks are computed from the trip count, so the loop has to be counted: a fresh integer
+// variable stepped by a constant and compared in the condition
+std::optional<std::string_view> ParallelLoopChecker::loop_variable(ASTFor& loop) const
+{
+    if(!loop.init.has_value() || !loop.step.has_value())
+        return std::nullopt;
+    auto* init = std::get_if<declareassign_ptr>(&loop.init.value());
+    if(!init || !(*init)->type || !(*init)->type->is_integer())
+        return std::nullopt;
+    auto name = (*init)->name;
+
+    auto is_name = [name](expression_ptr_var& node)
+    {
+        auto* ident = std::get_if<identifier_ptr>(&node);
+        return ident && (*ident)->name == name;
+    };
+    auto* step = std::get_if<assign_ptr>(&loop.step.value());
+    if(!step || (*step)->name != name || (*step)->index.has_value())
+        return std::nullopt;
+    auto* update = std::get_if<expression_ptr>(&(*step)->expr);
+    if(!update || ((*update)->op != Operator::ADD && (*update)->op != Operator::SUB))
+        return std::nullopt;
+    const bool forward = is_name((*update)->lhs) &&
+                         std::holds_alternative<integer_ptr>((*update)->rhs);
+    const bool reverse = (*update)->op == Operator::ADD && is_name((*update)->rhs) &&
+                         std::holds_alternative<integer_ptr>((*update)->lhs);
+    if(!forward && !reverse)
+        return std::nullopt;
+
+    auto* cond = std::get_if<expression_ptr>(&loop.condition);
+    if(!cond)
+        return std::nullopt;
+    switch((*cond)->op)
+    {
+    case Operator::LESS:
+    case Operator::GREATER:
+    case Operator::LESSEQ:
+    case Operator::GREATEREQ:
+    case Operator::NEQ:
+        break;
+    default:
+        return std::nullopt;
+    }
+    if(!is_name((*cond)->lhs) && !is_name((*cond)->rhs))
+        return std::nullopt;
+    return name;
+}
+
+// depth counts the loops nested in the parallel body, a break inside them stays in the chunk
+void ParallelLoopChecker::visit_stmt(statements_ptr_var& node, int depth)
+{
+    std::visit(
+        Overload{[this, depth](scope_ptr& scope)
+                 {
+                     auto* stmts = std::get_if<std::vector<statements_ptr_var>>(&scope->stmts);
+                     if(!stmts)
+                         return;
+                     for(auto& stmt : *stmts) { visit_stmt(stmt, depth); }
+                 },
+                 [this, depth](break_ptr& _break)
+                 {
+                     if(depth == 0)
+                         error(_break->loc, "Break cannot leave a parallel loop");
+                 },
+                 [this](return_ptr& _return)
+                 {
+                     error(_return->loc, "Return cannot leave a parallel loop");
+                     visit_expr(_return->val);
+                 },
+                 [this, depth](if_ptr& _if)
+                 {
+                     visit_expr(_if->condition);
+                     visit_scope(_if->scope, depth);
+                     if(!_if->else_clause.has_value())
+                         return;
+                     auto* _else = std::get_if<else_ptr>(&_if->else_clause.value());
+                     if(!_else)
+                         return;
+                     if((*_else)->condition.has_value())
+                         visit_expr((*_else)->condition.value());
+                     visit_scope((*_else)->scope, depth);
+                 },
+                 [this, depth](while_ptr& _while)
+                 {
+                     visit_expr(_while->condition);
+                     visit_scope(_while->scope, depth + 1);
+                 },
+                 [this, depth](for_ptr& _for)
+                 {
+                     if(_for->init.has_value())
+                         visit_stmt(_for->init.value(), depth + 1);
+                     visit_expr(_for->condition);
+                     if(_for->step.has_value())
+                         visit_stmt(_for->step.value(), depth + 1);
+                     visit_scope(_for->scope, depth + 1);
+                 },
+                 [this](declareassign_ptr& declassign) { visit_expr(declassign->expr); },
+                 [this](assign_ptr& assign) { visit_assign(*assign); },
+                 [this](callstmt_ptr& stmt) { visit_expr(stmt->call); },
+                 [](auto&&) {}},
+        node);
+}
+
+void ParallelLoopChecker::visit_scope(scope_err_ptr_var& node, int depth)
+{
+    auto* scope = std::get_if<scope_ptr>(&node);
+    if(!scope)
+        return;
+    auto* stmts = std::get_if<std::vector<statements_ptr_var>>(&(*scope)->stmts);
+    if(!stmts)
+        return;
+    for(auto& stmt : *stmts) { visit_stmt(stmt, depth); }
+}
+
+void ParallelLoopChecker::visit_expr(expression_ptr_var& node)
+{
+    std::visit(Overload{[this](identifier_ptr& ident)
+                        {
+                            if(shared_.contains(ident->name))
+                                reads_.insert(ident->name);
+                        },
+                        [this](expression_ptr& expr)
+                        {
+                            visit_expr(expr->lhs);
+                            visit_expr(expr->rhs);
+                        },
+                        [this](call_ptr& call)
+                        {
+                            for(auto& arg : call->args) { visit_expr(arg); }
+                        },
+                        [this](index_ptr& index)
+                        {
+                            visit_expr(index->index);
+                            if(shared_.contains(index->name) && !is_variable(index->index))
+                                scattered_reads_.insert(index->name);
+                        },
+                        [](auto&&) {}},
+               node);
+}
+
+// Iterations touch disjoint elements when a shared array is only written at a[i]. A shared
+// scalar is written by every iteration, which is only safe when it is a reduction
+void ParallelLoopChecker::visit_assign(ASTAssign& assign)
+{
+    const bool is_shared = shared_.contains(assign.name);
+    if(assign.index.has_value())
+    {
+        visit_expr(assign.index.value());
+        visit_expr(assign.expr);
+        if(!is_shared)
+            return;
+        written_arrays_.insert(assign.name);
+        if(!is_variable(assign.index.value()))
+            error(assign.loc,
+                  "Shared array '" + std::string(assign.name) +
+                      "' can only be written at index '" + std::string(variable_) +
+                      "' in a parallel loop");
+        return;
+    }
+
+    if(assign.name == variable_)
+        error(assign.loc,
+              "Loop variable '" + std::string(variable_) +
+                  "' cannot be changed in the body of a parallel loop");
+    if(!is_shared)
+    {
+        visit_expr(assign.expr);
+        return;
+    }
+
+    auto is_self = [&assign](expression_ptr_var& node)
+    {
+        auto* ident = std::get_if<identifier_ptr>(&node);
+        return ident && (*ident)->name == assign.name;
+    };
+    auto* expr = std::get_if<expression_ptr>(&assign.expr);
+    if(expr && is_reduction_operator((*expr)->op) && is_self((*expr)->lhs))
+    {
+        visit_expr((*expr)->rhs);
+        reductions_[assign.name].push_back((*expr)->op);
+        return;
+    }
+    if(expr && is_reduction_operator((*expr)->op) && is_self((*expr)->rhs))
+    {
+        visit_expr((*expr)->lhs);
+        reductions_[assign.name].push_back((*expr)->op);
+        return;
+    }
+    error(assign.loc,
+          "Shared variable '" + std::string(assign.name) +
+              "' can only be written as a reduction in a parallel loop, e.g. " +
+              std::string(assign.name) + " = " + std::string(assign.name) + " + x");
+    visit_expr(assign.expr);
+}
+
+bool ParallelLoopChecker::is_variable(expression_ptr_var& node) const
+{
+    auto* ident = std::get_if<identifier_ptr>(&node);
+    return ident && (*ident)->name == variable_;
+}
+
+void ParallelLoopChecker::error(SourceLocation& loc, const std::string& msg)
+{
+    reporter_.report_error(loc, msg, ErrorType::SEMANTIC);
+    valid_ = false;
+}
+
+// Associative and commutative, so chunks can be combined in any order
+bool ParallelLoopChecker::is_reduction_operator(Operator op)
+{
+    switch(op)
+    {
+    case Operator::ADD:
+    case Operator::MUL:
+    case Operator::BAND:
+    case Operator::BOR:
+    case Operator::XOR:
+    case Operator::AND:
+    case Operator::OR:
+        return true;
+    default:
+        return false;
+    }
+}
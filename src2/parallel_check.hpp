@@ -0,0 +1,53 @@
+#ifndef PARALLEL_CHECK_HPP
+#define PARALLEL_CHECK_HPP
+
+#pragma once
+#include "ast_def.hpp"
+#include "errors.hpp"
+#include "semantics.hpp"
+#include <algorithm>
+#include <map>
+#include <set>
+
+// Run by the semantic analyzer on every parallel for. Variables of the enclosing scope are
+// shared by all iterations: they may be read, arrays may be written at the index of the loop
+// variable, and other variables only as reductions such as sum = sum + a[i]
+class ParallelLoopChecker {
+  public:
+    using Shared = std::map<std::string_view, std::shared_ptr<type::BuiltinType>, std::less<>>;
+
+    ParallelLoopChecker(const Shared& shared, ErrorReporter& reporter);
+
+    // Reports every race in the loop and records its reductions, true when there are none
+    bool check(ASTFor& loop);
+
+  private:
+    using Names = std::set<std::string_view, std::less<>>;
+
+    const Shared& shared_;
+    ErrorReporter& reporter_;
+    std::string_view variable_;
+    std::map<std::string_view, std::vector<Operator>, std::less<>> reductions_;
+    Names reads_;
+    Names written_arrays_;
+    Names scattered_reads_; // arrays read at an index other than the loop variable
+    bool valid_ = true;
+
+    std::optional<std::string_view> loop_variable(ASTFor& loop) const;
+
+    void visit_stmt(statements_ptr_var& node, int depth);
+
+    void visit_scope(scope_err_ptr_var& node, int depth);
+
+    void visit_expr(expression_ptr_var& node);
+
+    void visit_assign(ASTAssign& assign);
+
+    bool is_variable(expression_ptr_var& node) const;
+
+    void error(SourceLocation& loc, const std::string& msg);
+
+    static bool is_reduction_operator(Operator op);
+};
+
+#endif // PARALLEL_CHECK_HPP
@@ -40,6 +40,7 @@ const std::unordered_map<TokenType, Operator> Parser::TOKEN_OP{
     {TokenType::OP_MUL, Operator::MUL},
     {TokenType::OP_DIV, Operator::DIV},
     {TokenType::OP_MOD, Operator::MOD},
+    {TokenType::OP_NOT, Operator::NOT},
 };
 
 Parser::Parser(TokenStream& stream, ErrorReporter& reporter)
@@ -63,15 +64,33 @@ statements_ptr_var Parser::parse_statement() const
     switch(token.value().type)
     {
     case TokenType::KW_BREAK:
-        return builder_.build_break(token.value().loc);
     case TokenType::KW_CONTINUE:
-        return builder_.build_continue(token.value().loc);
-    // case tokentype::KW_FOR: this isnt implemented yet
+        {
+            stream_.consume();
+            if(!stream_.expect(TokenType::DELIMITER_SEMICOLON).has_value())
+            {
+                reporter_.report_error(token.value().loc,
+                                       "Expected ';' after '" + std::string(token.value().value) +
+                                           "' on line " + std::to_string(token.value().loc.line),
+                                       ErrorType::SYNTAX);
+                synchronize_tokens();
+                return builder_.build_stmt_err(token.value().loc);
+            }
+            if(token.value().type == TokenType::KW_BREAK)
+                return builder_.build_break(token.value().loc);
+            return builder_.build_continue(token.value().loc);
+        }
+    case TokenType::KW_CONST:
+        return parse_const();
+    case TokenType::KW_FOR:
+        return parse_for();
+    case TokenType::KW_PARALLEL:
+        return parse_parallel();
     case TokenType::KW_IF:
         return parse_if();
-    // case TokenType::KW_STRUCT:
-    // This is an incomplete implementation so itll remain disabled for now
-    //     return parse_struct();
+    case TokenType::KW_STRUCT:
+    case TokenType::KW_SOA:
+        return parse_struct();
     case TokenType::KW_RETURN:
         return parse_return();
     case TokenType::KW_WHILE:
@@ -80,6 +99,26 @@ statements_ptr_var Parser::parse_statement() const
         return parse_builtin_var(BuiltinType::BOOL);
     case TokenType::TYPE_INT:
         return parse_builtin_var(BuiltinType::INT);
+    case TokenType::TYPE_I8:
+        return parse_builtin_var(BuiltinType::I8);
+    case TokenType::TYPE_I16:
+        return parse_builtin_var(BuiltinType::I16);
+    case TokenType::TYPE_I32:
+        return parse_builtin_var(BuiltinType::I32);
+    case TokenType::TYPE_I64:
+        return parse_builtin_var(BuiltinType::I64);
+    case TokenType::TYPE_U8:
+        return parse_builtin_var(BuiltinType::U8);
+    case TokenType::TYPE_U16:
+        return parse_builtin_var(BuiltinType::U16);
+    case TokenType::TYPE_U32:
+        return parse_builtin_var(BuiltinType::U32);
+    case TokenType::TYPE_U64:
+        return parse_builtin_var(BuiltinType::U64);
+    case TokenType::TYPE_FLOAT:
+        return parse_builtin_var(BuiltinType::FLOAT);
+    case TokenType::TYPE_DOUBLE:
+        return parse_builtin_var(BuiltinType::DOUBLE);
     case TokenType::IDENTIFIER:
         return parse_from_ident();
         break;
@@ -118,11 +157,29 @@ statements_ptr_var Parser::parse_from_ident() const
 
     switch(token.value().type)
     {
-    case TokenType::OP_EQUAL:
-        {
-        }
+    case TokenType::OP_ASSIGN:
+        return parse_assign();
     case TokenType::IDENTIFIER:
         return parse_declassign();
+    case TokenType::PAREN_L:
+        return parse_call_statement();
+    case TokenType::OP_LESS:
+        return std::visit([](auto&& var) -> statements_ptr_var { return std::move(var); },
+                          parse_generic_var());
+    case TokenType::BRACKET_L:
+        {
+            // Type[N] name declares an array, name[index] = assigns to an element. The length
+            // is always a literal, an index like b[i] or (b & 7) is not
+            auto is = [this](size_t offset, TokenType type)
+            {
+                auto token = stream_.peek(offset);
+                return token.has_value() && token.value().type == type;
+            };
+            if(is(2, TokenType::INT_LITERAL) && is(3, TokenType::BRACKET_R) &&
+               is(4, TokenType::IDENTIFIER))
+                return parse_array_var();
+            return parse_assign();
+        }
     default:
         {
             auto loc = stream_.peek().value().loc;
@@ -133,13 +190,51 @@ statements_ptr_var Parser::parse_from_ident() const
     }
 }
 
-// Expects tokens: IDENT OP_EQUAL
+// Expects tokens: IDENT PAREN_L
 // Will continue parsing assuming that those tokens were confirmed
-// Will return an assignment
+// Will return a call whose result is discarded
+statements_ptr_var Parser::parse_call_statement() const
+{
+    auto callee = stream_.consume().value();
+    auto call = parse_call(callee);
+    if(!stream_.expect(TokenType::DELIMITER_SEMICOLON).has_value())
+    {
+        reporter_.report_error(callee.loc,
+                               "Expected ';' after call to '" + std::string(callee.value) +
+                                   "' on line " + std::to_string(callee.loc.line),
+                               ErrorType::SYNTAX);
+        synchronize_tokens();
+        return builder_.build_stmt_err(callee.loc);
+    }
+    return builder_.build_call_statement(callee.loc, std::move(call));
+}
+
+// Expects tokens: IDENT OP_ASSIGN or IDENT BRACKET_L
+// Will continue parsing assuming that those tokens were confirmed
+// Will return an assignment to a variable or an array element
 statements_ptr_var Parser::parse_assign() const
 {
     auto name = stream_.consume().value();
-    stream_.consume();
+
+    std::optional<expression_ptr_var> index = std::nullopt;
+    if(stream_.expect(TokenType::BRACKET_L).has_value())
+    {
+        index = parse_expression();
+        if(!stream_.expect(TokenType::BRACKET_R).has_value())
+        {
+            reporter_.report_error(name.loc, "Expected ']' after array index.", ErrorType::SYNTAX);
+            synchronize_tokens();
+            return builder_.build_stmt_err(name.loc);
+        }
+    }
+
+    if(!stream_.expect(TokenType::OP_ASSIGN).has_value())
+    {
+        reporter_.report_error(name.loc, "Expected '=' in assignment.", ErrorType::SYNTAX);
+        synchronize_tokens();
+        return builder_.build_stmt_err(name.loc);
+    }
+
     auto expr = parse_expression();
     auto semi = stream_.expect(TokenType::DELIMITER_SEMICOLON);
     if(!semi.has_value())
@@ -151,7 +246,7 @@ statements_ptr_var Parser::parse_assign() const
 
     auto ast_name = name.value;
 
-    return builder_.build_assign(name.loc, ast_name, std::move(expr));
+    return builder_.build_assign(name.loc, ast_name, std::move(expr), std::move(index));
 }
 
 // IDENT IDENT ...
@@ -172,7 +267,7 @@ statements_ptr_var Parser::parse_declassign() const
 
     switch(token.value().type)
     {
-    case TokenType::OP_EQUAL:
+    case TokenType::OP_ASSIGN:
         {
             auto ident_type = stream_.consume().value();
             auto ident_name = stream_.consume().value();
@@ -220,6 +315,111 @@ statements_ptr_var Parser::parse_declassign() const
 }
 
 // whatever an expression is mhm
+// Expects tokens: IDENT OP_LESS
+// Will continue parsing assuming that those tokens were confirmed
+// Will return a declaration of a generic struct instance, e.g. Pair<int, bool> p;
+struct_body_var Parser::parse_generic_var() const
+{
+    auto type = stream_.consume().value();
+    std::vector<type::TypeName> args;
+    bool closed_outer = false;
+    if(!parse_type_args(args, closed_outer) || closed_outer)
+    {
+        reporter_.report_error(type.loc,
+                               "Invalid type arguments for '" + std::string(type.value) +
+                                   "' on line " + std::to_string(type.loc.line),
+                               ErrorType::SYNTAX);
+        synchronize_tokens();
+        return builder_.build_stmt_err(type.loc);
+    }
+
+    auto name = stream_.expect(TokenType::IDENTIFIER);
+    if(!name.has_value())
+    {
+        reporter_.report_error(type.loc,
+                               "Expected identifier after type '" + std::string(type.value) +
+                                   "<...>' on line " + std::to_string(type.loc.line),
+                               ErrorType::SYNTAX);
+        synchronize_tokens();
+        return builder_.build_stmt_err(type.loc);
+    }
+    if(stream_.expect(TokenType::DELIMITER_SEMICOLON).has_value())
+    {
+        auto declare = builder_.build_declare(type.loc, type.value, name->value);
+        declare->type_args = std::move(args);
+        return declare;
+    }
+    if(!stream_.expect(TokenType::OP_ASSIGN).has_value())
+    {
+        reporter_.report_error(name->loc,
+                               "Expected ';' or '=' after declaration.",
+                               ErrorType::SYNTAX);
+        synchronize_tokens();
+        return builder_.build_stmt_err(name->loc);
+    }
+
+    auto expr = parse_expression();
+    if(!stream_.expect(TokenType::DELIMITER_SEMICOLON).has_value())
+    {
+        reporter_.report_error(name->loc,
+                               "Expected ';' after declaration and assignment.",
+                               ErrorType::SYNTAX);
+        synchronize_tokens();
+        return builder_.build_stmt_err(name->loc);
+    }
+    auto declassign = builder_.build_declareassign(name->loc, type.value, name->value,
+                                                   std::move(expr));
+    declassign->type_args = std::move(args);
+    return declassign;
+}
+
+// Expects tokens: OP_LESS
+// Will parse type names separated by ',' up to the closing '>'. A '>>' closes this list and
+// the one it is nested in, closed_outer is set when that happens
+// Will return false when the list is malformed
+bool Parser::parse_type_args(std::vector<type::TypeName>& args, bool& closed_outer) const
+{
+    stream_.consume();
+    while(true)
+    {
+        auto token = stream_.consume();
+        if(!token.has_value() ||
+           (token->type != TokenType::IDENTIFIER &&
+            (token->type < TokenType::TYPE_INT || token->type > TokenType::TYPE_DOUBLE)))
+            return false;
+
+        type::TypeName arg{token->value, {}};
+        if(stream_.peek().has_value() && stream_.peek()->type == TokenType::OP_LESS)
+        {
+            bool closed = false;
+            if(!parse_type_args(arg.args, closed))
+                return false;
+            if(closed)
+            {
+                args.push_back(std::move(arg));
+                return true;
+            }
+        }
+        args.push_back(std::move(arg));
+
+        auto next = stream_.consume();
+        if(!next.has_value())
+            return false;
+        switch(next->type)
+        {
+        case TokenType::DELIMITER_COMMA:
+            continue;
+        case TokenType::OP_GREATER:
+            return true;
+        case TokenType::OP_RSH:
+            closed_outer = true;
+            return true;
+        default:
+            return false;
+        }
+    }
+}
+
 expression_ptr_var Parser::parse_expression() const
 {
     auto token = stream_.peek();
@@ -241,18 +441,71 @@ expression_ptr_var Parser::parse_expression() const
     switch(token.value().type)
     {
     case TokenType::IDENTIFIER:
-        lhs = builder_.build_identifier(token.value().loc, token.value().value);
+        if(stream_.peek().has_value() && stream_.peek().value().type == TokenType::PAREN_L)
+            lhs = parse_call(token.value());
+        else if(stream_.peek().has_value() &&
+                stream_.peek().value().type == TokenType::BRACKET_L)
+        {
+            stream_.consume();
+            auto index = parse_expression();
+            if(!stream_.expect(TokenType::BRACKET_R).has_value())
+            {
+                reporter_.report_error(token.value().loc,
+                                       "Expected ']' after array index.",
+                                       ErrorType::SYNTAX);
+                synchronize_tokens();
+                return builder_.build_expr_err(token.value().loc);
+            }
+            lhs = builder_.build_index(token.value().loc, token.value().value, std::move(index));
+        }
+        else
+            lhs = builder_.build_identifier(token.value().loc, token.value().value);
         break;
     case TokenType::INT_LITERAL:
-        lhs = builder_.build_integer(token.value().loc, std::stoi(token.value().value.data()));
-        break;
+        {
+            // the type it has to fit is only known to semantic analysis
+            auto text = token.value().value;
+            uint64_t value = 0;
+            auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+            if(ec != std::errc())
+            {
+                reporter_.report_error(token.value().loc,
+                                       "Integer literal out of range on line " +
+                                           std::to_string(token.value().loc.line),
+                                       ErrorType::SYNTAX);
+                return builder_.build_expr_err(token.value().loc);
+            }
+            auto integer = builder_.build_integer(token.value().loc, static_cast<int64_t>(value));
+            integer->above_i64 = value > static_cast<uint64_t>(INT64_MAX);
+            lhs = std::move(integer);
+            break;
+        }
+    case TokenType::FLOAT_LITERAL:
+        {
+            auto text = token.value().value;
+            bool single = text.ends_with('f');
+            if(single)
+                text.remove_suffix(1);
+            double value = 0;
+            auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+            if(ec != std::errc())
+            {
+                reporter_.report_error(token.value().loc,
+                                       "Invalid floating point literal on line " +
+                                           std::to_string(token.value().loc.line),
+                                       ErrorType::SYNTAX);
+                return builder_.build_expr_err(token.value().loc);
+            }
+            lhs = builder_.build_float(token.value().loc, value, single);
+            break;
+        }
     case TokenType::BOOL_LITERAL:
         lhs = builder_.build_boolean(token.value().loc, string_to_bool(token.value().value));
         break;
-    case TokenType::PAREN_R:
+    case TokenType::PAREN_L:
         {
             auto expr = parse_expression();
-            auto close = stream_.expect(TokenType::PAREN_L);
+            auto close = stream_.expect(TokenType::PAREN_R);
 
             if(!close.has_value())
             {
@@ -307,11 +560,47 @@ expression_ptr_var Parser::parse_expression() const
     return lhs;
 }
 
+// Expects tokens: PAREN_L, the callee identifier has already been consumed
+// Will return a call expression
+expression_ptr_var Parser::parse_call(Token callee) const
+{
+    stream_.consume();
+
+    std::vector<expression_ptr_var> args;
+    if(stream_.expect(TokenType::PAREN_R).has_value())
+        return builder_.build_call(callee.loc, callee.value, std::move(args));
+
+    while(true)
+    {
+        args.push_back(parse_expression());
+        if(stream_.expect(TokenType::DELIMITER_COMMA).has_value())
+            continue;
+        if(stream_.expect(TokenType::PAREN_R).has_value())
+            break;
+
+        reporter_.report_error(callee.loc,
+                               "Expected ',' or ')' in call to '" + std::string(callee.value) +
+                                   "' on line " + std::to_string(callee.loc.line),
+                               ErrorType::SYNTAX);
+        synchronize_tokens();
+        return builder_.build_expr_err(callee.loc);
+    }
+
+    return builder_.build_call(callee.loc, callee.value, std::move(args));
+}
+
 // Expects tokens: BUILTIN_TYPE IDENT
 // Will continue parsing assuming that those tokens were confirmed
 // Will return either a declaration or a declaration+assignment
 statements_ptr_var Parser::parse_builtin_var(BuiltinType type) const
 {
+    auto bracket = stream_.peek(1);
+    if(bracket.has_value() && bracket.value().type == TokenType::BRACKET_L)
+        return parse_array_var();
+    auto paren = stream_.peek(2);
+    if(paren.has_value() && paren.value().type == TokenType::PAREN_L)
+        return parse_function();
+
     auto token = stream_.peek(2);
 
     if(!token.has_value())
@@ -329,7 +618,7 @@ statements_ptr_var Parser::parse_builtin_var(BuiltinType type) const
 
     switch(token.value().type)
     {
-    case TokenType::OP_EQUAL:
+    case TokenType::OP_ASSIGN:
         {
             stream_.consume();
             auto expr = parse_expression();
@@ -364,6 +653,120 @@ statements_ptr_var Parser::parse_builtin_var(BuiltinType type) const
     }
 }
 
+// Expects tokens: TYPE BRACKET_L
+// Will continue parsing assuming that those tokens were confirmed
+// Will return either a declaration or a declaration+assignment of a fixed size array
+statements_ptr_var Parser::parse_array_var() const
+{
+    auto element_type = stream_.consume().value();
+    stream_.consume();
+
+    auto length = stream_.expect(TokenType::INT_LITERAL);
+    size_t size = 0;
+    if(length.has_value())
+    {
+        auto text = length.value().value;
+        std::from_chars(text.data(), text.data() + text.size(), size);
+    }
+    if(!length.has_value() || size == 0 || !stream_.expect(TokenType::BRACKET_R).has_value())
+    {
+        reporter_.report_error(element_type.loc,
+                               "Expected a positive constant array length on line " +
+                                   std::to_string(element_type.loc.line),
+                               ErrorType::SYNTAX);
+        synchronize_tokens();
+        return builder_.build_stmt_err(element_type.loc);
+    }
+
+    auto name = stream_.expect(TokenType::IDENTIFIER);
+    if(!name.has_value())
+    {
+        reporter_.report_error(element_type.loc,
+                               "Expected identifier after array type.",
+                               ErrorType::SYNTAX);
+        synchronize_tokens();
+        return builder_.build_stmt_err(element_type.loc);
+    }
+
+    if(stream_.expect(TokenType::DELIMITER_SEMICOLON).has_value())
+        return builder_.build_declare(element_type.loc, element_type.value, name->value, size);
+
+    if(!stream_.expect(TokenType::OP_ASSIGN).has_value())
+    {
+        reporter_.report_error(name->loc, "Invalid statement after identifier.", ErrorType::SYNTAX);
+        synchronize_tokens();
+        return builder_.build_stmt_err(name->loc);
+    }
+
+    auto expr = parse_expression();
+    if(!stream_.expect(TokenType::DELIMITER_SEMICOLON).has_value())
+    {
+        reporter_.report_error(name->loc,
+                               "Expected ';' after declaration and assignment.",
+                               ErrorType::SYNTAX);
+        synchronize_tokens();
+        return builder_.build_stmt_err(name->loc);
+    }
+
+    return builder_.build_declareassign(element_type.loc,
+                                        element_type.value,
+                                        name->value,
+                                        std::move(expr),
+                                        size);
+}
+
+// Expects tokens: TYPE IDENT PAREN_L
+// Will continue parsing assuming that those tokens were confirmed
+// Will return a function declaration with its parameters and body
+statements_ptr_var Parser::parse_function() const
+{
+    auto return_type = stream_.consume().value();
+    auto name = stream_.consume().value();
+    stream_.consume();
+
+    std::vector<ASTParameter> params;
+    if(!stream_.expect(TokenType::PAREN_R).has_value())
+    {
+        while(true)
+        {
+            auto param_type = stream_.consume();
+            auto param_name = stream_.expect(TokenType::IDENTIFIER);
+            if(!param_type.has_value() || !param_name.has_value())
+            {
+                reporter_.report_error(name.loc,
+                                       "Expected parameter type and name in '" +
+                                           std::string(name.value) + "' on line " +
+                                           std::to_string(name.loc.line),
+                                       ErrorType::SYNTAX);
+                synchronize_tokens();
+                return builder_.build_stmt_err(name.loc);
+            }
+            params.emplace_back(param_type->loc, param_type->value, param_name->value);
+
+            if(stream_.expect(TokenType::DELIMITER_COMMA).has_value())
+                continue;
+            if(stream_.expect(TokenType::PAREN_R).has_value())
+                break;
+
+            reporter_.report_error(name.loc,
+                                   "Expected ',' or ')' in parameters of '" +
+                                       std::string(name.value) + "' on line " +
+                                       std::to_string(name.loc.line),
+                                   ErrorType::SYNTAX);
+            synchronize_tokens();
+            return builder_.build_stmt_err(name.loc);
+        }
+    }
+
+    auto body = parse_scope();
+
+    return builder_.build_function(name.loc,
+                                   return_type.value,
+                                   name.value,
+                                   std::move(params),
+                                   std::move(body));
+}
+
 // KW_RETURN ...
 // Expects tokens: KW_RETURN
 // Will continue parsing assuming that those tokens were confirmed
@@ -421,6 +824,122 @@ statements_ptr_var Parser::parse_while() const
     return builder_.build_while(token.loc, std::move(expr), std::move(scope));
 }
 
+// Expects tokens: KW_CONST
+// Will continue parsing assuming that those tokens were confirmed
+// Will return a declaration+assignment marked constant
+statements_ptr_var Parser::parse_const() const
+{
+    auto token = stream_.consume().value();
+    auto stmt = parse_statement();
+    if(std::holds_alternative<stmt_err_ptr>(stmt))
+        return stmt;
+
+    auto* declassign = std::get_if<declareassign_ptr>(&stmt);
+    if(!declassign || (*declassign)->array_size.has_value())
+    {
+        reporter_.report_error(token.loc,
+                               "Expected an initialized variable after 'const' on line " +
+                                   std::to_string(token.loc.line),
+                               ErrorType::SYNTAX);
+        return builder_.build_stmt_err(token.loc);
+    }
+    (*declassign)->is_const = true;
+    return stmt;
+}
+
+// Expects tokens: KW_FOR
+// Will continue parsing assuming that those tokens were confirmed
+// Will return a for statement, init and step may be left empty
+statements_ptr_var Parser::parse_for() const
+{
+    auto token = stream_.consume().value();
+    if(!stream_.expect(TokenType::PAREN_L).has_value())
+    {
+        auto loc = stream_.peek().value().loc;
+        reporter_.report_error(loc,
+                               "Expected '(' after 'for' on line " + std::to_string(token.loc.line),
+                               ErrorType::SYNTAX);
+        synchronize_tokens();
+        return builder_.build_stmt_err(loc);
+    }
+
+    // the init statement consumes its own ';'
+    std::optional<statements_ptr_var> init = std::nullopt;
+    if(!stream_.expect(TokenType::DELIMITER_SEMICOLON).has_value())
+        init = parse_statement();
+
+    auto cond = parse_expression();
+    if(!stream_.expect(TokenType::DELIMITER_SEMICOLON).has_value())
+    {
+        auto loc = stream_.peek().value().loc;
+        reporter_.report_error(loc,
+                               "Expected ';' after for condition on line " +
+                                   std::to_string(token.loc.line),
+                               ErrorType::SYNTAX);
+        synchronize_tokens();
+        return builder_.build_stmt_err(loc);
+    }
+
+    std::optional<statements_ptr_var> step = std::nullopt;
+    auto next = stream_.peek();
+    if(next.has_value() && next.value().type != TokenType::PAREN_R)
+    {
+        auto name = stream_.expect(TokenType::IDENTIFIER);
+        if(!name.has_value() || !stream_.expect(TokenType::OP_ASSIGN).has_value())
+        {
+            reporter_.report_error(token.loc,
+                                   "Expected assignment as for step on line " +
+                                       std::to_string(token.loc.line),
+                                   ErrorType::SYNTAX);
+            synchronize_tokens();
+            return builder_.build_stmt_err(token.loc);
+        }
+        step = builder_.build_assign(name->loc, name->value, parse_expression());
+    }
+
+    if(!stream_.expect(TokenType::PAREN_R).has_value())
+    {
+        auto loc = stream_.peek().value().loc;
+        reporter_.report_error(loc,
+                               "Expected ')' after for step on line " +
+                                   std::to_string(token.loc.line),
+                               ErrorType::SYNTAX);
+        synchronize_tokens();
+        return builder_.build_stmt_err(loc);
+    }
+
+    auto scope = parse_scope();
+
+    return builder_.build_for(token.loc,
+                              std::move(init),
+                              std::move(cond),
+                              std::move(step),
+                              std::move(scope));
+}
+
+// Expects tokens: KW_PARALLEL
+// Will continue parsing assuming that those tokens were confirmed
+// Will return a for statement marked parallel
+statements_ptr_var Parser::parse_parallel() const
+{
+    auto token = stream_.consume().value();
+    auto next = stream_.peek();
+    if(!next.has_value() || next.value().type != TokenType::KW_FOR)
+    {
+        reporter_.report_error(token.loc,
+                               "Expected 'for' after 'parallel' on line " +
+                                   std::to_string(token.loc.line),
+                               ErrorType::SYNTAX);
+        synchronize_tokens();
+        return builder_.build_stmt_err(token.loc);
+    }
+
+    auto stmt = parse_for();
+    if(auto* loop = std::get_if<for_ptr>(&stmt))
+        (*loop)->parallel = true;
+    return stmt;
+}
+
 // Expects tokens: KW_IF
 // Will continue parsing assuming that those tokens were confirmed
 // Will return an if statement
@@ -469,6 +988,14 @@ std::optional<else_ptr_var> Parser::parse_else() const
 
     std::optional<expression_ptr_var> cond = std::nullopt;
     auto next_token = stream_.peek();
+    // else if continues the chain as an else holding nothing but the next if
+    if(next_token.has_value() && next_token.value().type == TokenType::KW_IF)
+    {
+        std::vector<statements_ptr_var> stmts;
+        stmts.push_back(parse_if());
+        auto scope = builder_.build_scope(else_kw->loc, std::move(stmts));
+        return builder_.build_else(else_kw->loc, std::move(cond), std::move(scope));
+    }
     if(next_token.has_value() && next_token.value().type == TokenType::PAREN_L)
     {
         stream_.consume();
@@ -529,11 +1056,27 @@ scope_err_ptr_var Parser::parse_scope() const
     return builder_.build_scope(open_br->loc, std::move(stmts));
 }
 
-// Expects tokens: KW_STRUCT
+// Expects tokens: KW_STRUCT or KW_SOA
 // Will continue parsing assuming that those tokens were confirmed
 // Will return a struct statement
 statements_ptr_var Parser::parse_struct() const
 {
+    auto layout = type::StructLayout::AOS;
+    if(stream_.peek().value().type == TokenType::KW_SOA)
+    {
+        auto qualifier = stream_.consume().value();
+        if(!stream_.peek().has_value() || stream_.peek().value().type != TokenType::KW_STRUCT)
+        {
+            reporter_.report_error(qualifier.loc,
+                                   "Expected 'struct' after 'soa' on line " +
+                                       std::to_string(qualifier.loc.line),
+                                   ErrorType::SYNTAX);
+            synchronize_tokens();
+            return builder_.build_stmt_err(qualifier.loc);
+        }
+        layout = type::StructLayout::SOA;
+    }
+
     auto token = stream_.peek(1);
 
     if(!token.has_value())
@@ -549,6 +1092,31 @@ statements_ptr_var Parser::parse_struct() const
     stream_.consume();                          // keyword
     auto type_name = stream_.consume().value(); // struct name
 
+    // struct Name<T, U> declares a template, its instances are created where they are used
+    std::vector<std::string_view> type_params;
+    if(stream_.expect(TokenType::OP_LESS).has_value())
+    {
+        while(true)
+        {
+            auto param = stream_.expect(TokenType::IDENTIFIER);
+            if(!param.has_value())
+                break;
+            type_params.push_back(param->value);
+            if(!stream_.expect(TokenType::DELIMITER_COMMA).has_value())
+                break;
+        }
+        if(type_params.empty() || !stream_.expect(TokenType::OP_GREATER).has_value())
+        {
+            reporter_.report_error(type_name.loc,
+                                   "Expected type parameters in '<...>' after '" +
+                                       std::string(type_name.value) + "' on line " +
+                                       std::to_string(type_name.loc.line),
+                                   ErrorType::SYNTAX);
+            synchronize_tokens();
+            return builder_.build_stmt_err(type_name.loc);
+        }
+    }
+
     auto brace_l = stream_.expect(TokenType::BRACE_L);
     if(!brace_l.has_value())
     {
@@ -590,10 +1158,13 @@ statements_ptr_var Parser::parse_struct() const
         return builder_.build_stmt_err(loc);
     }
 
-    // register type
-    type_registry_.declare_type(type_name.value);
+    // register type, templates are registered by the semantic analyzer
+    if(type_params.empty())
+        type_registry_.declare_type(type_name.value, layout);
 
-    return builder_.build_struct(token->loc, type_name.value, std::move(members));
+    auto _struct = builder_.build_struct(token->loc, type_name.value, std::move(members), layout);
+    _struct->type_params = std::move(type_params);
+    return _struct;
 }
 
 struct_body_var Parser::parse_struct_declassign() const
@@ -610,7 +1181,7 @@ struct_body_var Parser::parse_struct_declassign() const
 
     switch(token.value().type)
     {
-    case TokenType::OP_EQUAL:
+    case TokenType::OP_ASSIGN:
         {
             auto ident_type = stream_.consume().value();
             auto ident_name = stream_.consume().value();
@@ -672,6 +1243,8 @@ std::optional<struct_body_var> Parser::struct_helper() const
                                ErrorType::SYNTAX);
         return std::nullopt;
     }
+    if(stream_.peek(1).has_value() && stream_.peek(1).value().type == TokenType::OP_LESS)
+        return parse_generic_var();
     return parse_struct_declassign();
 }
 
@@ -704,8 +1277,10 @@ void Parser::synchronize_tokens() const
 
         // --- Success Condition (Can Resume) ---
         // If we find a token that can start a new top-level statement, stop skipping.
-        if(type == TokenType::KW_IF || type == TokenType::KW_WHILE ||
-           type == TokenType::KW_RETURN || type == TokenType::KW_STRUCT)
+        if(type == TokenType::KW_IF || type == TokenType::KW_WHILE || type == TokenType::KW_FOR ||
+           type == TokenType::KW_RETURN || type == TokenType::KW_STRUCT ||
+           type == TokenType::KW_SOA || type == TokenType::KW_CONST ||
+           type == TokenType::KW_PARALLEL)
         {
             return; // We are now positioned safely to parse the next construct
         }
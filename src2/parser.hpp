@@ -6,6 +6,7 @@
 #include "errors.hpp"
 #include "tokens.hpp"
 #include "tokenstream.hpp"
+#include <charconv>
 #include <iostream>
 #include <memory>
 #include <unordered_map>
@@ -18,18 +19,36 @@ class Parser {
 
     expression_ptr_var parse_expression() const;
 
+    expression_ptr_var parse_call(Token callee) const;
+
     statements_ptr_var parse_from_ident() const;
 
     statements_ptr_var parse_assign() const;
 
+    statements_ptr_var parse_call_statement() const;
+
     statements_ptr_var parse_declassign() const;
 
+    struct_body_var parse_generic_var() const;
+
+    bool parse_type_args(std::vector<type::TypeName>& args, bool& closed_outer) const;
+
     statements_ptr_var parse_builtin_var(const BuiltinType type) const;
 
+    statements_ptr_var parse_array_var() const;
+
+    statements_ptr_var parse_function() const;
+
     statements_ptr_var parse_return() const;
 
     statements_ptr_var parse_while() const;
 
+    statements_ptr_var parse_for() const;
+
+    statements_ptr_var parse_const() const;
+
+    statements_ptr_var parse_parallel() const;
+
     statements_ptr_var parse_if() const;
 
     std::optional<else_ptr_var> parse_else() const;
@@ -0,0 +1,217 @@
+#include "reassociate.hpp"
+
+namespace
+{
+    int64_t combine(Operator op, int64_t a, int64_t b, const type::BuiltinType& type)
+    {
+        const auto x = static_cast<uint64_t>(a);
+        const auto y = static_cast<uint64_t>(b);
+        switch(op)
+        {
+        case Operator::ADD:
+            return ConstantEvaluator::wrap(x + y, type);
+        case Operator::MUL:
+            return ConstantEvaluator::wrap(x * y, type);
+        case Operator::BAND:
+            return ConstantEvaluator::wrap(x & y, type);
+        case Operator::BOR:
+            return ConstantEvaluator::wrap(x | y, type);
+        default:
+            return ConstantEvaluator::wrap(x ^ y, type);
+        }
+    }
+
+    bool is_identity(Operator op, int64_t value, const type::BuiltinType& type)
+    {
+        switch(op)
+        {
+        case Operator::MUL:
+            return value == 1;
+        case Operator::BAND:
+            return value == ConstantEvaluator::wrap(~uint64_t{0}, type);
+        default:
+            return value == 0;
+        }
+    }
+} // namespace
+
+Reassociator::Reassociator(program_ptr&& program) : program_(std::move(program)) {}
+
+program_ptr&& Reassociator::run()
+{
+    for(auto& stmt : program_->stmts) { visit_stmt(stmt); }
+    return std::move(program_);
+}
+
+size_t Reassociator::reassociated() const
+{
+    return reassociated_;
+}
+
+void Reassociator::visit_stmt(statements_ptr_var& node)
+{
+    std::visit(Overload{[this](scope_ptr& scope)
+                        {
+                            auto* stmts =
+                                std::get_if<std::vector<statements_ptr_var>>(&scope->stmts);
+                            if(!stmts)
+                                return;
+                            for(auto& stmt : *stmts) { visit_stmt(stmt); }
+                        },
+                        [this](if_ptr& _if)
+                        {
+                            visit_expr(_if->condition);
+                            visit_scope(_if->scope);
+                            if(!_if->else_clause.has_value())
+                                return;
+                            auto* _else = std::get_if<else_ptr>(&_if->else_clause.value());
+                            if(!_else)
+                                return;
+                            if((*_else)->condition.has_value())
+                                visit_expr((*_else)->condition.value());
+                            visit_scope((*_else)->scope);
+                        },
+                        [this](while_ptr& _while)
+                        {
+                            visit_expr(_while->condition);
+                            visit_scope(_while->scope);
+                        },
+                        [this](for_ptr& _for)
+                        {
+                            if(_for->init.has_value())
+                                visit_stmt(_for->init.value());
+                            visit_expr(_for->condition);
+                            if(_for->step.has_value())
+                                visit_stmt(_for->step.value());
+                            visit_scope(_for->scope);
+                        },
+                        [this](function_ptr& function) { visit_scope(function->body); },
+                        [this](return_ptr& _return) { visit_expr(_return->val); },
+                        [this](callstmt_ptr& stmt) { visit_expr(stmt->call); },
+                        [this](declareassign_ptr& declassign) { visit_expr(declassign->expr); },
+                        [this](assign_ptr& assign)
+                        {
+                            if(assign->index.has_value())
+                                visit_expr(assign->index.value());
+                            visit_expr(assign->expr);
+                        },
+                        [](auto&&) {}},
+               node);
+}
+
+void Reassociator::visit_scope(scope_err_ptr_var& node)
+{
+    auto* scope = std::get_if<scope_ptr>(&node);
+    auto* stmts = scope ? std::get_if<std::vector<statements_ptr_var>>(&(*scope)->stmts)
+                        : nullptr;
+    if(!stmts)
+        return;
+    for(auto& stmt : *stmts) { visit_stmt(stmt); }
+}
+
+// Operands are paired up level by level, n operands end up ceil(log2(n)) deep
+void Reassociator::visit_expr(expression_ptr_var& node)
+{
+    auto* expr = std::get_if<expression_ptr>(&node);
+    if(!expr || !*expr || !is_reassociable(**expr))
+    {
+        std::visit(Overload{[this](call_ptr& call)
+                            {
+                                for(auto& arg : call->args) { visit_expr(arg); }
+                            },
+                            [this](index_ptr& index) { visit_expr(index->index); },
+                            [this](expression_ptr& expr)
+                            {
+                                if(!expr)
+                                    return;
+                                visit_expr(expr->lhs);
+                                visit_expr(expr->rhs);
+                            },
+                            [](auto&&) {}},
+                   node);
+        return;
+    }
+
+    Operator op = (*expr)->op;
+    auto type = (*expr)->operand_type;
+    auto loc = (*expr)->loc;
+    const size_t before = depth(node, op);
+    std::vector<expression_ptr_var> leaves;
+    flatten((*expr)->lhs, op, type, leaves);
+    flatten((*expr)->rhs, op, type, leaves);
+
+    std::vector<expression_ptr_var> operands;
+    std::optional<int64_t> folded;
+    size_t literals = 0;
+    for(auto& leaf : leaves)
+    {
+        visit_expr(leaf);
+        auto value = ConstantEvaluator::value_of(leaf);
+        if(!value.has_value() || !value->type->is_integer())
+        {
+            operands.push_back(std::move(leaf));
+            continue;
+        }
+        const auto bits = ConstantEvaluator::wrap(static_cast<uint64_t>(value->bits), *type);
+        folded = folded.has_value() ? combine(op, *folded, bits, *type) : bits;
+        literals++;
+    }
+    if(folded.has_value() && (operands.empty() || !is_identity(op, *folded, *type)))
+    {
+        auto literal = builder_.build_integer(loc, *folded);
+        literal->type = type;
+        operands.push_back(std::move(literal));
+    }
+
+    while(operands.size() > 1)
+    {
+        std::vector<expression_ptr_var> level;
+        for(size_t i = 0; i + 1 < operands.size(); i += 2)
+        {
+            auto pair = builder_.build_expression(loc, std::move(operands[i]),
+                                                  std::move(operands[i + 1]), op);
+            pair->type = type;
+            pair->operand_type = type;
+            level.push_back(std::move(pair));
+        }
+        if(operands.size() % 2 != 0)
+            level.push_back(std::move(operands.back()));
+        operands = std::move(level);
+    }
+    node = std::move(operands.front());
+    if(literals > 1 || depth(node, op) < before)
+        reassociated_++;
+}
+
+// An operand of another type is converted first and ends the chain
+void Reassociator::flatten(expression_ptr_var& node, Operator op,
+                           const std::shared_ptr<type::BuiltinType>& type,
+                           std::vector<expression_ptr_var>& leaves)
+{
+    auto* expr = std::get_if<expression_ptr>(&node);
+    if(!expr || !*expr || (*expr)->op != op || (*expr)->operand_type != type ||
+       !is_reassociable(**expr))
+    {
+        leaves.push_back(std::move(node));
+        return;
+    }
+    flatten((*expr)->lhs, op, type, leaves);
+    flatten((*expr)->rhs, op, type, leaves);
+}
+
+// Integer arithmetic wraps, so these are associative and commutative. Floating point is not
+bool Reassociator::is_reassociable(const ASTExpression& expr)
+{
+    if(expr.op != Operator::ADD && expr.op != Operator::MUL && expr.op != Operator::BAND &&
+       expr.op != Operator::BOR && expr.op != Operator::XOR)
+        return false;
+    return expr.operand_type && expr.operand_type->is_integer() && expr.type == expr.operand_type;
+}
+
+size_t Reassociator::depth(expression_ptr_var& node, Operator op)
+{
+    auto* expr = std::get_if<expression_ptr>(&node);
+    if(!expr || !*expr || (*expr)->op != op)
+        return 0;
+    return 1 + std::max(depth((*expr)->lhs, op), depth((*expr)->rhs, op));
+}
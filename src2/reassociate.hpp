@@ -0,0 +1,43 @@
+#ifndef REASSOCIATE_HPP
+#define REASSOCIATE_HPP
+
+#pragma once
+#include "ast_builder.hpp"
+#include "ast_def.hpp"
+#include "const_eval.hpp"
+#include "semantics.hpp"
+
+// Runs after semantic analysis. The parser builds a + b + c + d as a chain one operation deep
+// per operand, this rebuilds chains of integer ADD, MUL, BAND, BOR and XOR as balanced trees
+// so independent operations can run in parallel. Literals in a chain are folded into one,
+// the other operands keep their order so side effects happen in the same order
+class Reassociator {
+  public:
+    Reassociator(program_ptr&& program);
+
+    program_ptr&& run();
+
+    size_t reassociated() const;
+
+  private:
+    program_ptr program_;
+    ASTBuilder builder_;
+    size_t reassociated_ = 0;
+
+    void visit_stmt(statements_ptr_var& node);
+
+    void visit_scope(scope_err_ptr_var& node);
+
+    void visit_expr(expression_ptr_var& node);
+
+    // Moves the operands of the chain of op at node into leaves, left to right
+    static void flatten(expression_ptr_var& node, Operator op,
+                        const std::shared_ptr<type::BuiltinType>& type,
+                        std::vector<expression_ptr_var>& leaves);
+
+    static bool is_reassociable(const ASTExpression& expr);
+
+    static size_t depth(expression_ptr_var& node, Operator op);
+};
+
+#endif // REASSOCIATE_HPP
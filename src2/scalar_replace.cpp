@@ -0,0 +1,112 @@
+#include "scalar_replace.hpp"
+#include <map>
+
+ScalarReplacement::ScalarReplacement(ir::Function& function) : function_(function) {}
+
+size_t ScalarReplacement::run()
+{
+    auto escaped = find_escaped();
+
+    // the element slots go where the aggregates were, elements never used get none
+    std::vector<std::pair<ir::Value, int64_t>> elements;
+    for(auto& block : function_.blocks)
+    {
+        for(auto value : block.insts)
+        {
+            auto& inst = function_.insts[value];
+            if(inst.op == ir::Opcode::ELEMENT && is_aggregate(inst.a) && !escaped[inst.a])
+                elements.emplace_back(value, function_.constant(inst.b));
+        }
+    }
+    if(elements.empty())
+        return 0;
+
+    replace_.assign(function_.insts.size(), ir::NONE);
+    std::map<std::pair<ir::Value, int64_t>, ir::Value> slots;
+    for(auto [element, index] : elements)
+    {
+        auto aggregate = function_.insts[element].a;
+        auto [slot, inserted] = slots.try_emplace({aggregate, index}, ir::NONE);
+        if(inserted)
+        {
+            ir::Instruction alloca{ir::Opcode::ALLOCA, 0, function_.insts[element].type};
+            slot->second = function_.insert(0, 0, alloca);
+            if(function_.insts[aggregate].op != ir::Opcode::NOP)
+            {
+                function_.insts[aggregate].op = ir::Opcode::NOP;
+                split_++;
+            }
+        }
+        replace_[element] = slot->second;
+        function_.insts[element].op = ir::Opcode::NOP;
+    }
+
+    for(auto& block : function_.blocks)
+    {
+        for(auto value : block.insts)
+        {
+            function_.for_each_operand(value,
+                                       [this](uint32_t& operand) { operand = resolve(operand); });
+        }
+        std::erase_if(block.insts,
+                      [this](ir::Value value)
+                      { return function_.insts[value].op == ir::Opcode::NOP; });
+    }
+    return split_;
+}
+
+std::vector<bool> ScalarReplacement::find_escaped()
+{
+    std::vector<bool> escaped(function_.insts.size(), false);
+    for(auto& block : function_.blocks)
+    {
+        for(auto value : block.insts)
+        {
+            auto& inst = function_.insts[value];
+            function_.for_each_operand(
+                value,
+                [this, &inst, &escaped](uint32_t& operand)
+                {
+                    if(operand == ir::NONE)
+                        return;
+                    auto& used = function_.insts[operand];
+                    if(is_aggregate(operand))
+                    {
+                        // a variable index can reach any element, an out of range one traps
+                        auto& array = static_cast<type::ArrayType&>(*function_.type_of(operand));
+                        const bool constant_element =
+                            inst.op == ir::Opcode::ELEMENT && &operand == &inst.a &&
+                            function_.insts[inst.b].op == ir::Opcode::CONST &&
+                            function_.constant(inst.b) >= 0 &&
+                            static_cast<uint64_t>(function_.constant(inst.b)) < array.length;
+                        if(!constant_element)
+                            escaped[operand] = true;
+                    }
+                    else if(used.op == ir::Opcode::ELEMENT && is_aggregate(used.a))
+                    {
+                        const bool is_address =
+                            (inst.op == ir::Opcode::LOAD || inst.op == ir::Opcode::STORE) &&
+                            &operand == &inst.a;
+                        if(!is_address)
+                            escaped[used.a] = true;
+                    }
+                });
+        }
+    }
+    return escaped;
+}
+
+// Atomic elements are only accessed through intrinsics
+bool ScalarReplacement::is_aggregate(ir::Value value) const
+{
+    auto& inst = function_.insts[value];
+    if(inst.op != ir::Opcode::ALLOCA || !function_.type_of(value)->is_array())
+        return false;
+    auto& array = static_cast<type::ArrayType&>(*function_.type_of(value));
+    return !array.element->is_atomic();
+}
+
+ir::Value ScalarReplacement::resolve(ir::Value value) const
+{
+    return value < replace_.size() && replace_[value] != ir::NONE ? replace_[value] : value;
+}
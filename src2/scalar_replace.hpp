@@ -0,0 +1,33 @@
+#ifndef SCALAR_REPLACE_HPP
+#define SCALAR_REPLACE_HPP
+
+#pragma once
+#include "ir.hpp"
+
+// Scalar replacement of aggregates, run before Mem2Reg. An aggregate on the stack whose
+// address does not escape, every element it is used for has a constant index in range and is
+// only loaded and stored, is split into one slot per element used, which Mem2Reg then turns
+// into SSA values. Arrays are the only aggregates that can be instantiated so far, a struct
+// whose members are addressed the same way is split alike
+class ScalarReplacement {
+  public:
+    ScalarReplacement(ir::Function& function);
+
+    // Returns the number of aggregates split
+    size_t run();
+
+  private:
+    ir::Function& function_;
+    std::vector<ir::Value> replace_;
+    size_t split_ = 0;
+
+    // Aggregates whose address is used other than for a constant element that is loaded and
+    // stored
+    std::vector<bool> find_escaped();
+
+    bool is_aggregate(ir::Value value) const;
+
+    ir::Value resolve(ir::Value value) const;
+};
+
+#endif // SCALAR_REPLACE_HPP
@@ -1,45 +1,158 @@
 #include "semantics.hpp"
+#include "parallel_check.hpp"
 
 using semantics::OperatorMatrixIndex;
 
 type::TypeRegistry& SemanticAnalyzer::typeregistry_ = type::TypeRegistry::instance();
 
 const std::unordered_map<OperatorMatrixIndex, SemanticAnalyzer::OperatorResult>
-    SemanticAnalyzer::OPERATOR_MATRIX = {
-        // INT RESULTS
-        {{typeregistry_._int_(), Operator::ADD, typeregistry_._int_()}, {typeregistry_._int_()}},
-        {{typeregistry_._int_(), Operator::SUB, typeregistry_._int_()}, {typeregistry_._int_()}},
-        {{typeregistry_._int_(), Operator::MUL, typeregistry_._int_()}, {typeregistry_._int_()}},
-        {{typeregistry_._int_(), Operator::DIV, typeregistry_._int_()}, {typeregistry_._int_()}},
-        {{typeregistry_._int_(), Operator::MOD, typeregistry_._int_()}, {typeregistry_._int_()}},
-        {{typeregistry_._int_(), Operator::LSH, typeregistry_._int_()}, {typeregistry_._int_()}},
-        {{typeregistry_._int_(), Operator::RSH, typeregistry_._int_()}, {typeregistry_._int_()}},
-        {{typeregistry_._int_(), Operator::BAND, typeregistry_._int_()}, {typeregistry_._int_()}},
-        {{typeregistry_._int_(), Operator::XOR, typeregistry_._int_()}, {typeregistry_._int_()}},
-        {{typeregistry_._int_(), Operator::BOR, typeregistry_._int_()}, {typeregistry_._int_()}},
+    SemanticAnalyzer::OPERATOR_MATRIX = SemanticAnalyzer::build_operator_matrix();
+
+std::unordered_map<OperatorMatrixIndex, SemanticAnalyzer::OperatorResult>
+SemanticAnalyzer::build_operator_matrix()
+{
+    auto _bool = typeregistry_._bool_();
+    std::unordered_map<OperatorMatrixIndex, OperatorResult> matrix = {
         // BOOL RESULTS
-        {{typeregistry_._int_(), Operator::LESS, typeregistry_._int_()}, {typeregistry_._bool_()}},
-        {{typeregistry_._int_(), Operator::GREATER, typeregistry_._int_()},
-         {typeregistry_._bool_()}},
-        {{typeregistry_._int_(), Operator::LESSEQ, typeregistry_._int_()},
-         {typeregistry_._bool_()}},
-        {{typeregistry_._int_(), Operator::GREATEREQ, typeregistry_._int_()},
-         {typeregistry_._bool_()}},
-        {{typeregistry_._int_(), Operator::EQ, typeregistry_._int_()}, {typeregistry_._bool_()}},
-        {{typeregistry_._int_(), Operator::NEQ, typeregistry_._int_()}, {typeregistry_._bool_()}},
-        {{typeregistry_._bool_(), Operator::AND, typeregistry_._bool_()}, {typeregistry_._bool_()}},
-        {{typeregistry_._bool_(), Operator::OR, typeregistry_._bool_()}, {typeregistry_._bool_()}},
-        {{typeregistry_._bool_(), Operator::XOR, typeregistry_._bool_()}, {typeregistry_._bool_()}},
-        {{typeregistry_._bool_(), Operator::NOT, typeregistry_._bool_()}, {typeregistry_._bool_()}},
+        {{_bool, Operator::AND, _bool}, {_bool, _bool}},
+        {{_bool, Operator::OR, _bool}, {_bool, _bool}},
+        {{_bool, Operator::XOR, _bool}, {_bool, _bool}},
+        {{_bool, Operator::NOT, _bool}, {_bool, _bool}},
+    };
+
+    const auto integers = typeregistry_.integer_types();
+    for(const auto& lhs : integers)
+    {
+        for(const auto& rhs : integers)
+        {
+            // shifts keep the type of the shifted value, the count may be any integer
+            for(auto op : {Operator::LSH, Operator::RSH}) { matrix[{lhs, op, rhs}] = {lhs, lhs}; }
+
+            auto common = typeregistry_.promote_integers(lhs, rhs);
+            if(common == typeregistry_._undefined_())
+                continue;
+
+            // INT RESULTS
+            for(auto op : {Operator::ADD,
+                           Operator::SUB,
+                           Operator::MUL,
+                           Operator::DIV,
+                           Operator::MOD,
+                           Operator::BAND,
+                           Operator::XOR,
+                           Operator::BOR})
+            {
+                matrix[{lhs, op, rhs}] = {common, common};
+            }
+            // BOOL RESULTS
+            for(auto op : {Operator::LESS,
+                           Operator::GREATER,
+                           Operator::LESSEQ,
+                           Operator::GREATEREQ,
+                           Operator::EQ,
+                           Operator::NEQ})
+            {
+                matrix[{lhs, op, rhs}] = {_bool, common};
+            }
+        }
+    }
+
+    // FLOATING RESULTS, an integer operand is converted to the floating point type
+    std::vector<std::shared_ptr<type::BuiltinType>> arithmetic = integers;
+    for(const auto& floating : typeregistry_.floating_types()) { arithmetic.push_back(floating); }
+    for(const auto& floating : typeregistry_.floating_types())
+    {
+        for(const auto& other : arithmetic)
+        {
+            auto common = typeregistry_.promote_arithmetic(floating, other);
+            for(auto op : {Operator::ADD, Operator::SUB, Operator::MUL, Operator::DIV})
+            {
+                matrix[{floating, op, other}] = {common, common};
+                matrix[{other, op, floating}] = {common, common};
+            }
+            for(auto op : {Operator::LESS,
+                           Operator::GREATER,
+                           Operator::LESSEQ,
+                           Operator::GREATEREQ,
+                           Operator::EQ,
+                           Operator::NEQ})
+            {
+                matrix[{floating, op, other}] = {_bool, common};
+                matrix[{other, op, floating}] = {_bool, common};
+            }
+        }
+    }
+
+    // VECTOR RESULTS, only where x86-64 has a single instruction for the lane width
+    for(const auto& vector : typeregistry_.vector_types())
+    {
+        for(auto op : {Operator::ADD,
+                       Operator::SUB,
+                       Operator::MUL,
+                       Operator::BAND,
+                       Operator::BOR,
+                       Operator::XOR,
+                       Operator::EQ,
+                       Operator::GREATER,
+                       Operator::LESS})
+        {
+            if(target::select_vector_instruction(op, *vector).has_value())
+                matrix[{vector, op, vector}] = {vector, vector};
+        }
+        // every lane is shifted by the same scalar count
+        for(auto op : {Operator::LSH, Operator::RSH})
+        {
+            if(!target::select_vector_instruction(op, *vector).has_value())
+                continue;
+            for(const auto& count : integers) { matrix[{vector, op, count}] = {vector, vector}; }
+        }
+    }
+    return matrix;
+}
+
+const std::unordered_map<std::string_view, Intrinsic> SemanticAnalyzer::INTRINSICS = {
+    {"extract", Intrinsic::VEC_EXTRACT},
+    {"insert", Intrinsic::VEC_INSERT},
+    {"reduce_add", Intrinsic::VEC_REDUCE_ADD},
+    {"reduce_min", Intrinsic::VEC_REDUCE_MIN},
+    {"reduce_max", Intrinsic::VEC_REDUCE_MAX},
+    {"reduce_and", Intrinsic::VEC_REDUCE_AND},
+    {"reduce_or", Intrinsic::VEC_REDUCE_OR},
+    {"reduce_xor", Intrinsic::VEC_REDUCE_XOR},
+    {"popcount", Intrinsic::BIT_POPCOUNT},
+    {"clz", Intrinsic::BIT_CLZ},
+    {"ctz", Intrinsic::BIT_CTZ},
+    {"bswap", Intrinsic::BIT_BSWAP},
+    {"rotl", Intrinsic::BIT_ROTL},
+    {"rotr", Intrinsic::BIT_ROTR},
+    {"atomic_load", Intrinsic::ATOMIC_LOAD},
+    {"atomic_store", Intrinsic::ATOMIC_STORE},
+    {"atomic_fetch_add", Intrinsic::ATOMIC_FETCH_ADD},
+    {"atomic_exchange", Intrinsic::ATOMIC_EXCHANGE},
+    {"atomic_compare_exchange", Intrinsic::ATOMIC_COMPARE_EXCHANGE},
+};
+
+const std::unordered_map<std::string_view, MemoryOrder> SemanticAnalyzer::MEMORY_ORDERS = {
+    {"relaxed", MemoryOrder::RELAXED},
+    {"acquire", MemoryOrder::ACQUIRE},
+    {"release", MemoryOrder::RELEASE},
+    {"acq_rel", MemoryOrder::ACQ_REL},
+    {"seq_cst", MemoryOrder::SEQ_CST},
 };
 
 SemanticAnalyzer::SemanticAnalyzer(program_ptr&& program, ErrorReporter& reporter)
-    : program_(std::move(program)), reporter_(reporter)
+    : program_(std::move(program)), reporter_(reporter), evaluator_(constants_, reporter)
 {
 }
 
 program_ptr&& SemanticAnalyzer::analyze()
 {
+    // signatures first so functions can call functions declared after them
+    for(auto& stmt : program_->stmts)
+    {
+        if(auto* function = std::get_if<function_ptr>(&stmt))
+            declare_function(*function);
+    }
     for(auto& stmt : program_->stmts) { analyze_stmt(stmt); }
     return std::move(program_);
 }
@@ -85,9 +198,13 @@ void SemanticAnalyzer::analyze_stmt(statements_ptr_var& node)
             [this](return_ptr& _return)
             {
                 auto type = _typeof_(_return->val);
-                auto _int = typeregistry_._int_();
-                if(type != _int)
-                    reporter_.report_error(_return->loc, "Return type mismatch, expected int", ErrorType::SEMANTIC);
+                evaluator_.fold(_return->val);
+                auto expected = return_type_ ? return_type_ : typeregistry_._int_();
+                if(!is_assignable(_return->val, type, expected))
+                    reporter_.report_error(_return->loc,
+                                           "Return type mismatch, expected " +
+                                               std::string(expected->get_name()),
+                                           ErrorType::SEMANTIC);
             },
             [this](else_ptr& _else) 
             {
@@ -95,6 +212,7 @@ void SemanticAnalyzer::analyze_stmt(statements_ptr_var& node)
                 {
                     auto& cond = _else->condition.value();
                     auto cond_type = _typeof_(cond);
+                    evaluator_.fold(cond);
                     if(cond_type != typeregistry_._bool_())
                         reporter_.report_error(_else->loc, "Else if condition must be of type bool", ErrorType::SEMANTIC);
                 }
@@ -104,6 +222,7 @@ void SemanticAnalyzer::analyze_stmt(statements_ptr_var& node)
             [this](if_ptr& _if)
             {
                 auto cond_type = _typeof_(_if->condition);
+                evaluator_.fold(_if->condition);
                 if(cond_type != typeregistry_._bool_())
                     reporter_.report_error(_if->loc, "If condition must be of type bool", ErrorType::SEMANTIC);
                 
@@ -116,46 +235,112 @@ void SemanticAnalyzer::analyze_stmt(statements_ptr_var& node)
             {
                 loop_depth_++;
                 auto cond_type = _typeof_(_while->condition);
+                evaluator_.fold(_while->condition);
                 if(cond_type != typeregistry_._bool_())
                     reporter_.report_error(_while->loc, "While condition must be of type bool", ErrorType::SEMANTIC);
+                _while->assigned.clear();
+                whiles_.push_back(_while.get());
                 analyze_scope_var(_while->scope);
+                whiles_.pop_back();
                 loop_depth_--;
             }, 
-            [](struct_ptr& _struct) 
+            [this](for_ptr& _for)
+            {
+                // everything declared before a parallel loop is shared by its iterations
+                ParallelLoopChecker::Shared shared;
+                if(_for->parallel)
+                    for(auto& [name, var] : variables) { shared[name] = var.type; }
+                // the init, the step and the body are a scope of their own, so the next loop
+                // can declare the same counter
+                auto outer = variables;
+                auto outer_constants = constants_;
+                if(_for->init.has_value())
+                    analyze_stmt(_for->init.value());
+                loop_depth_++;
+                auto cond_type = _typeof_(_for->condition);
+                evaluator_.fold(_for->condition);
+                if(cond_type != typeregistry_._bool_())
+                    reporter_.report_error(_for->loc, "For condition must be of type bool", ErrorType::SEMANTIC);
+                if(_for->step.has_value())
+                    analyze_stmt(_for->step.value());
+                analyze_scope_var(_for->scope);
+                loop_depth_--;
+                variables = std::move(outer);
+                constants_ = std::move(outer_constants);
+                if(_for->parallel)
+                    ParallelLoopChecker(shared, reporter_).check(*_for);
+            },
+            [this](struct_ptr& _struct)
+            {
+                if(return_type_ || loop_depth_ > 0)
+                    reporter_.report_error(_struct->loc, "Structs can only be declared at the top level", ErrorType::SEMANTIC);
+                else if(_struct->type_params.empty())
+                    define_struct(_struct);
+                else
+                    declare_template(_struct);
+            },
+            [this](function_ptr& function)
             {
-            
+                if(return_type_ || loop_depth_ > 0)
+                    reporter_.report_error(function->loc, "Functions can only be declared at the top level", ErrorType::SEMANTIC);
+                else
+                    analyze_function(function);
             },
             [this](declareassign_ptr& declassign)
             {
                 auto type = _typeof_(declassign->expr);
-                auto declared_type = typeregistry_.find_type(declassign->type_name);
+                evaluator_.fold(declassign->expr);
+                auto declared_type = resolve_type(declassign->type_name, declassign->type_args, declassign->array_size, declassign->loc);
                 if(type == typeregistry_._undefined_())
                     reporter_.report_error(declassign->loc, "Undefined type in declaration", ErrorType::SEMANTIC);
-                if(declared_type == typeregistry_._undefined_())
+                if(declared_type == typeregistry_._undefined_() && declassign->type_args.empty())
                     reporter_.report_error(declassign->loc, "Undefined declared type in declaration", ErrorType::SEMANTIC);
-                if(type != declared_type)
+                // an atomic is initialized before it can be shared, with a plain store
+                auto value_type = declared_type;
+                if(declared_type->is_atomic())
+                    value_type = static_cast<type::AtomicType&>(*declared_type).element;
+                if(!is_assignable(declassign->expr, type, value_type))
                     reporter_.report_error(declassign->loc, "Type mismatch in declaration", ErrorType::SEMANTIC);
-                    if(!declare_variable(declassign->name, type))
+                    if(!declare_variable(declassign->name, declared_type))
                     reporter_.report_error(declassign->loc, "This variable has already been defined", ErrorType::SEMANTIC);
-                declassign->type = type;
+                check_target_support(declared_type, declassign->loc);
+                declassign->type = declared_type;
+                record_write(declassign->name);
+                if(declassign->is_const)
+                    declare_constant(declassign);
             },
             [this](declare_ptr& declare)
             {
-                auto type = typeregistry_.find_type(declare->type_name);
-                if(type == typeregistry_._undefined_())
+                auto type = resolve_type(declare->type_name, declare->type_args, declare->array_size, declare->loc);
+                if(type == typeregistry_._undefined_() && declare->type_args.empty())
                     reporter_.report_error(declare->loc, "Undefined type in declaration", ErrorType::SEMANTIC);
                     if(!declare_variable(declare->name, type))
                     reporter_.report_error(declare->loc, "This variable has already been defined", ErrorType::SEMANTIC);
+                check_target_support(type, declare->loc);
                 declare->type = type;
+                record_write(declare->name);
             },
             [this](assign_ptr& assign)
             {
                 auto var_type = find_variable_type(assign->name);
+                if(constants_.contains(assign->name))
+                    reporter_.report_error(assign->loc, "Cannot assign to constant '" + std::string(assign->name) + "'", ErrorType::SEMANTIC);
+                if(assign->index.has_value())
+                    var_type = typeof_index(assign->name, assign->index.value(), assign->loc);
+                if(var_type->is_atomic())
+                    reporter_.report_error(assign->loc, "Atomic '" + std::string(assign->name) + "' can only be written with atomic_store", ErrorType::SEMANTIC);
                 auto expr_type = _typeof_(assign->expr);
-                if(var_type != expr_type)
+                evaluator_.fold(assign->expr);
+                if(!is_assignable(assign->expr, expr_type, var_type))
                     reporter_.report_error(assign->loc, "Type mismatch in assignment", ErrorType::SEMANTIC);
                 if(expr_type == typeregistry_._undefined_())
                     reporter_.report_error(assign->loc, "Undefined type in assignment", ErrorType::SEMANTIC);
+                record_write(assign->name);
+            },
+            [this](callstmt_ptr& stmt)
+            {
+                _typeof_(stmt->call);
+                evaluator_.fold(stmt->call);
             },
             [this](stmt_err_ptr& err) 
             {
@@ -177,6 +362,7 @@ void SemanticAnalyzer::analyze_else_var(else_ptr_var& node)
                             {
                                 auto& cond = _else->condition.value();
                                 auto cond_type = _typeof_(cond);
+                                evaluator_.fold(cond);
                                 if(cond_type != typeregistry_._bool_())
                                     reporter_.report_error(_else->loc,
                                                            "Else if condition must be of type bool",
@@ -246,23 +432,67 @@ std::shared_ptr<type::BuiltinType> SemanticAnalyzer::_typeof_(expression_ptr_var
 {
     return std::visit(
         Overload{[](integer_ptr& integer) -> std::shared_ptr<type::BuiltinType>
-                 { return typeregistry_._int_(); },
+                 {
+                     if(integer->above_i64)
+                         return typeregistry_._u64_();
+                     if(typeregistry_._int_()->can_represent(integer->value))
+                         return typeregistry_._int_();
+                     return typeregistry_._i64_();
+                 },
                  [](boolean_ptr& boolean) -> std::shared_ptr<type::BuiltinType>
                  { return typeregistry_._bool_(); },
+                 [](float_ptr& floating) -> std::shared_ptr<type::BuiltinType>
+                 {
+                     if(floating->single)
+                         return typeregistry_._float_();
+                     return typeregistry_._double_();
+                 },
                  [this](identifier_ptr& ident) -> std::shared_ptr<type::BuiltinType>
-                 { return find_variable_type(ident->name); },
+                 {
+                     ident->type = find_variable_type(ident->name);
+                     return ident->type;
+                 },
                  [this](expression_ptr& expr) -> std::shared_ptr<type::BuiltinType>
                  {
-                     auto rhs = _typeof_(expr->rhs);
                      auto lhs = _typeof_(expr->lhs);
+                     // NOT is unary and looked up with its operand on both sides
+                     auto rhs = expr->op == Operator::NOT ? lhs : _typeof_(expr->rhs);
+                     lhs = literal_type(expr->lhs, lhs, rhs);
+                     rhs = literal_type(expr->rhs, rhs, lhs);
 
-                     OperatorMatrixIndex idx = {rhs, expr->op, lhs};
+                     OperatorMatrixIndex idx = {lhs, expr->op, rhs};
                      auto it = OPERATOR_MATRIX.find(idx);
                      if(it == OPERATOR_MATRIX.end())
                          return typeregistry_._undefined_();
 
+                     if(it->second.operand->is_vector())
+                     {
+                         auto& vector = static_cast<type::VectorType&>(*it->second.operand);
+                         auto instruction = target::select_vector_instruction(expr->op, vector);
+                         auto& target_info = target::TargetInfo::instance();
+                         if(!target_info.has(instruction->feature))
+                         {
+                             auto name = target::TargetInfo::feature_name(instruction->feature);
+                             reporter_.report_error(expr->loc,
+                                                    "Vector operation '" +
+                                                        std::string(instruction->mnemonic) +
+                                                        "' requires " + std::string(name) +
+                                                        ", enable it with -m" + std::string(name),
+                                                    ErrorType::SEMANTIC);
+                         }
+                     }
+
+                     expr->type = it->second.result;
+                     expr->operand_type = it->second.operand;
                      return it->second.result;
                  },
+                 [this](call_ptr& call) -> std::shared_ptr<type::BuiltinType>
+                 { return typeof_call(call); },
+                 [this](index_ptr& index) -> std::shared_ptr<type::BuiltinType>
+                 {
+                     index->type = typeof_index(index->name, index->index, index->loc);
+                     return index->type;
+                 },
                  [](expr_err_ptr& err) -> std::shared_ptr<type::BuiltinType>
                  { return typeregistry_._undefined_(); },
                  [](auto&&) -> std::shared_ptr<type::BuiltinType>
@@ -275,16 +505,644 @@ bool SemanticAnalyzer::declare_variable(std::string_view name,
                                         std::shared_ptr<type::BuiltinType> type)
 {
     auto it = variables.find(name);
-    if(it == variables.end())
+    if(it != variables.end() || constants_.contains(name))
         return false;
     variables[name] = Var{name, type};
     return true;
 }
 
+// A write to an array element counts as a write to the array
+void SemanticAnalyzer::record_write(std::string_view name)
+{
+    for(auto* loop : whiles_) { loop->assigned.insert(name); }
+}
+
 std::shared_ptr<type::BuiltinType> SemanticAnalyzer::find_variable_type(std::string_view name) const
 {
     auto it = variables.find(name);
-    if(it == variables.end())
+    if(it != variables.end())
+        return it->second.type;
+    // constants declared at the top level are visible in function bodies
+    auto constant = constants_.find(name);
+    if(constant != constants_.end())
+        return constant->second.type;
+    return typeregistry_._undefined_();
+}
+
+// An integer literal takes the type of the other operand when its value fits in it,
+// numeric literals next to a floating point operand take its type
+bool SemanticAnalyzer::fits(const ASTInteger& literal, const type::BuiltinType& type)
+{
+    if(literal.above_i64)
+        return type.is_integer() && !type.is_signed() && type.size() >= 8;
+    return type.can_represent(literal.value);
+}
+
+std::shared_ptr<type::BuiltinType> SemanticAnalyzer::literal_type(
+    expression_ptr_var& node,
+    std::shared_ptr<type::BuiltinType> type,
+    std::shared_ptr<type::BuiltinType> other) const
+{
+    auto* literal = std::get_if<integer_ptr>(&node);
+    if(literal && other->is_integer() && fits(**literal, *other))
+    {
+        (*literal)->type = other;
+        return other;
+    }
+    if(literal && other->is_floating())
+    {
+        (*literal)->type = other;
+        return other;
+    }
+    auto* floating = std::get_if<float_ptr>(&node);
+    if(floating && other->is_floating())
+    {
+        (*floating)->type = other;
+        return other;
+    }
+    return type;
+}
+
+// Integers convert implicitly only when no value is lost, literals when they fit the target.
+// Integers and narrower floating point values convert to floating point, never the reverse
+bool SemanticAnalyzer::is_assignable(expression_ptr_var& expr,
+                                     std::shared_ptr<type::BuiltinType> expr_type,
+                                     std::shared_ptr<type::BuiltinType> target) const
+{
+    if(expr_type == target)
+        return true;
+    if(target->is_floating())
+    {
+        if(auto* floating = std::get_if<float_ptr>(&expr))
+        {
+            (*floating)->type = target;
+            return true;
+        }
+        return expr_type->is_integer() ||
+               (expr_type->is_floating() && expr_type->size() <= target->size());
+    }
+    if(!expr_type->is_integer() || !target->is_integer())
+        return false;
+
+    if(auto* literal = std::get_if<integer_ptr>(&expr))
+    {
+        if(!fits(**literal, *target))
+            return false;
+        (*literal)->type = target;
+        return true;
+    }
+    return typeregistry_.promote_integers(expr_type, target) == target;
+}
+
+// Resolves a call to a vector constructor or a builtin intrinsic and type checks its arguments.
+// Calling a vector type with one argument splats it, with one argument per lane builds it
+std::shared_ptr<type::BuiltinType> SemanticAnalyzer::typeof_call(call_ptr& call) const
+{
+    auto undefined = typeregistry_._undefined_();
+    std::vector<std::shared_ptr<type::BuiltinType>> arg_types;
+    for(auto& arg : call->args)
+    {
+        arg_types.push_back(_typeof_(arg));
+        evaluator_.fold(arg);
+    }
+
+    std::shared_ptr<type::BuiltinType> callee_type = typeregistry_.find_type(call->callee);
+    if(callee_type != undefined && callee_type->is_vector())
+    {
+        auto& vector = static_cast<type::VectorType&>(*callee_type);
+        if(call->args.size() == 1)
+            call->intrinsic = Intrinsic::VEC_SPLAT;
+        else if(call->args.size() == vector.lanes)
+            call->intrinsic = Intrinsic::VEC_BUILD;
+        else
+        {
+            reporter_.report_error(call->loc,
+                                   "Vector constructor '" + std::string(call->callee) +
+                                       "' takes 1 or " + std::to_string(vector.lanes) +
+                                       " arguments",
+                                   ErrorType::SEMANTIC);
+            return undefined;
+        }
+
+        for(size_t i = 0; i < call->args.size(); i++)
+        {
+            if(!is_assignable(call->args[i], arg_types[i], vector.element))
+            {
+                reporter_.report_error(call->loc,
+                                       "Vector lane type mismatch in '" +
+                                           std::string(call->callee) + "'",
+                                       ErrorType::SEMANTIC);
+                return undefined;
+            }
+        }
+        check_target_support(callee_type, call->loc);
+        call->type = callee_type;
+        return callee_type;
+    }
+
+    auto function = functions_.find(call->callee);
+    if(function != functions_.end())
+        return typeof_function_call(call, function->second, arg_types);
+
+    auto it = INTRINSICS.find(call->callee);
+    if(it == INTRINSICS.end())
+    {
+        reporter_.report_error(call->loc,
+                               "Unknown function '" + std::string(call->callee) + "'",
+                               ErrorType::SEMANTIC);
+        return undefined;
+    }
+
+    if(it->second >= Intrinsic::BIT_POPCOUNT && it->second <= Intrinsic::BIT_ROTR)
+        return typeof_bit_intrinsic(call, it->second, arg_types);
+    if(it->second >= Intrinsic::ATOMIC_LOAD && it->second <= Intrinsic::ATOMIC_COMPARE_EXCHANGE)
+        return typeof_atomic_intrinsic(call, it->second, arg_types);
+
+    size_t arity = 1;
+    if(it->second == Intrinsic::VEC_EXTRACT)
+        arity = 2;
+    else if(it->second == Intrinsic::VEC_INSERT)
+        arity = 3;
+
+    if(call->args.size() != arity || !arg_types[0]->is_vector())
+    {
+        reporter_.report_error(call->loc,
+                               "'" + std::string(call->callee) + "' expects a vector and " +
+                                   std::to_string(arity - 1) + " more arguments",
+                               ErrorType::SEMANTIC);
+        return undefined;
+    }
+
+    auto& vector = static_cast<type::VectorType&>(*arg_types[0]);
+    if(arity > 1)
+    {
+        // lane indices are encoded as instruction immediates
+        auto* lane = std::get_if<integer_ptr>(&call->args[1]);
+        if(!lane || (*lane)->value < 0 || static_cast<size_t>((*lane)->value) >= vector.lanes)
+        {
+            reporter_.report_error(call->loc,
+                                   "Lane index must be a constant between 0 and " +
+                                       std::to_string(vector.lanes - 1),
+                                   ErrorType::SEMANTIC);
+            return undefined;
+        }
+    }
+
+    call->intrinsic = it->second;
+    if(it->second == Intrinsic::VEC_INSERT)
+    {
+        if(!is_assignable(call->args[2], arg_types[2], vector.element))
+        {
+            reporter_.report_error(call->loc,
+                                   "Inserted value does not match the vector lane type",
+                                   ErrorType::SEMANTIC);
+            return undefined;
+        }
+        call->type = arg_types[0];
+        return arg_types[0];
+    }
+
+    call->type = vector.element;
+    return vector.element;
+}
+
+std::shared_ptr<type::BuiltinType> SemanticAnalyzer::typeof_function_call(
+    call_ptr& call,
+    const Signature& signature,
+    std::vector<std::shared_ptr<type::BuiltinType>>& arg_types) const
+{
+    if(call->args.size() != signature.params.size())
+    {
+        reporter_.report_error(call->loc,
+                               "'" + std::string(call->callee) + "' expects " +
+                                   std::to_string(signature.params.size()) + " arguments",
+                               ErrorType::SEMANTIC);
+        return typeregistry_._undefined_();
+    }
+    for(size_t i = 0; i < call->args.size(); i++)
+    {
+        if(!is_assignable(call->args[i], arg_types[i], signature.params[i]))
+        {
+            reporter_.report_error(call->loc,
+                                   "Argument " + std::to_string(i + 1) + " of '" +
+                                       std::string(call->callee) + "' must be " +
+                                       std::string(signature.params[i]->get_name()),
+                                   ErrorType::SEMANTIC);
+            return typeregistry_._undefined_();
+        }
+    }
+    call->type = signature.result;
+    return signature.result;
+}
+
+// popcount, clz and ctz count bits of any integer and return int. bswap, rotl and rotr
+// return the operand type, the rotate count may be any integer
+std::shared_ptr<type::BuiltinType> SemanticAnalyzer::typeof_bit_intrinsic(
+    call_ptr& call,
+    Intrinsic intrinsic,
+    std::vector<std::shared_ptr<type::BuiltinType>>& arg_types) const
+{
+    const bool is_rotate = intrinsic == Intrinsic::BIT_ROTL || intrinsic == Intrinsic::BIT_ROTR;
+    const size_t arity = is_rotate ? 2 : 1;
+    if(call->args.size() != arity || !arg_types[0]->is_integer() ||
+       (is_rotate && !arg_types[1]->is_integer()))
+    {
+        reporter_.report_error(call->loc,
+                               "'" + std::string(call->callee) + "' expects " +
+                                   (is_rotate ? "an integer and a count" : "one integer"),
+                               ErrorType::SEMANTIC);
+        return typeregistry_._undefined_();
+    }
+
+    if(!target::select_bit_instruction(intrinsic, arg_types[0]->size()).has_value())
+    {
+        reporter_.report_error(call->loc,
+                               "'" + std::string(call->callee) +
+                                   "' is not defined for 8-bit integers",
+                               ErrorType::SEMANTIC);
+        return typeregistry_._undefined_();
+    }
+
+    call->intrinsic = intrinsic;
+    if(intrinsic == Intrinsic::BIT_POPCOUNT || intrinsic == Intrinsic::BIT_CLZ ||
+       intrinsic == Intrinsic::BIT_CTZ)
+        call->type = typeregistry_._int_();
+    else
+        call->type = arg_types[0];
+    return call->type;
+}
+
+// The first argument is an atomic variable or array element and the last the memory order.
+// Loads take relaxed, acquire or seq_cst and stores relaxed, release or seq_cst.
+// atomic_compare_exchange(a, expected, desired, order) stores desired only when a holds
+// expected and returns the value a held, like the other read-modify-writes
+std::shared_ptr<type::BuiltinType> SemanticAnalyzer::typeof_atomic_intrinsic(
+    call_ptr& call,
+    Intrinsic intrinsic,
+    std::vector<std::shared_ptr<type::BuiltinType>>& arg_types) const
+{
+    auto undefined = typeregistry_._undefined_();
+    size_t arity = 3;
+    if(intrinsic == Intrinsic::ATOMIC_LOAD)
+        arity = 2;
+    else if(intrinsic == Intrinsic::ATOMIC_COMPARE_EXCHANGE)
+        arity = 4;
+
+    const bool is_variable = !call->args.empty() &&
+                             (std::holds_alternative<identifier_ptr>(call->args[0]) ||
+                              std::holds_alternative<index_ptr>(call->args[0]));
+    if(call->args.size() != arity || !is_variable || !arg_types[0]->is_atomic())
+    {
+        std::string values = ", " + std::to_string(arity - 2) + " values";
+        if(arity == 2)
+            values = "";
+        reporter_.report_error(call->loc,
+                               "'" + std::string(call->callee) + "' expects an atomic variable" +
+                                   values + " and a memory order",
+                               ErrorType::SEMANTIC);
+        return undefined;
+    }
+    auto& atomic = static_cast<type::AtomicType&>(*arg_types[0]);
+
+    auto* order_name = std::get_if<identifier_ptr>(&call->args.back());
+    auto order = order_name ? MEMORY_ORDERS.find((*order_name)->name) : MEMORY_ORDERS.end();
+    if(order == MEMORY_ORDERS.end())
+    {
+        reporter_.report_error(call->loc,
+                               "Last argument of '" + std::string(call->callee) +
+                                   "' must be relaxed, acquire, release, acq_rel or seq_cst",
+                               ErrorType::SEMANTIC);
+        return undefined;
+    }
+    const bool is_load = intrinsic == Intrinsic::ATOMIC_LOAD;
+    const bool is_store = intrinsic == Intrinsic::ATOMIC_STORE;
+    const bool releases = order->second == MemoryOrder::RELEASE ||
+                          order->second == MemoryOrder::ACQ_REL;
+    const bool acquires = order->second == MemoryOrder::ACQUIRE ||
+                          order->second == MemoryOrder::ACQ_REL;
+    if((is_load && releases) || (is_store && acquires))
+    {
+        reporter_.report_error(call->loc,
+                               "Memory order '" + std::string(order->first) +
+                                   "' cannot be used with '" + std::string(call->callee) + "'",
+                               ErrorType::SEMANTIC);
+        return undefined;
+    }
+
+    if(intrinsic == Intrinsic::ATOMIC_FETCH_ADD && !atomic.element->is_integer())
+    {
+        reporter_.report_error(call->loc,
+                               "'atomic_fetch_add' expects an atomic integer",
+                               ErrorType::SEMANTIC);
+        return undefined;
+    }
+    for(size_t i = 1; i + 1 < arity; i++)
+    {
+        if(!is_assignable(call->args[i], arg_types[i], atomic.element))
+        {
+            reporter_.report_error(call->loc,
+                                   "Argument " + std::to_string(i + 1) + " of '" +
+                                       std::string(call->callee) + "' must be " +
+                                       std::string(atomic.element->get_name()),
+                                   ErrorType::SEMANTIC);
+            return undefined;
+        }
+    }
+
+    call->intrinsic = intrinsic;
+    call->order = order->second;
+    call->type = intrinsic == Intrinsic::ATOMIC_STORE ? typeregistry_._void_() : atomic.element;
+    return call->type;
+}
+
+// Resolves the parameter and return types of a top level function and registers its signature
+void SemanticAnalyzer::declare_function(function_ptr& function)
+{
+    auto undefined = typeregistry_._undefined_();
+    function->return_type = typeregistry_.find_type(function->return_type_name);
+    // atomics are shared in place and never copied into or out of a call
+    if(function->return_type == undefined || function->return_type->is_atomic())
+        reporter_.report_error(function->loc,
+                               "Invalid return type for '" + std::string(function->name) + "'",
+                               ErrorType::SEMANTIC);
+
+    Signature signature{{}, function->return_type};
+    for(auto& param : function->params)
+    {
+        param.type = typeregistry_.find_type(param.type_name);
+        if(param.type == undefined)
+            reporter_.report_error(param.loc,
+                                   "Undefined type for parameter '" + std::string(param.name) +
+                                       "'",
+                                   ErrorType::SEMANTIC);
+        else if(param.type->is_atomic())
+            reporter_.report_error(param.loc,
+                                   "Parameter '" + std::string(param.name) +
+                                       "' cannot be atomic",
+                                   ErrorType::SEMANTIC);
+        signature.params.push_back(param.type);
+    }
+
+    if(INTRINSICS.contains(function->name) || functions_.contains(function->name))
+    {
+        reporter_.report_error(function->loc,
+                               "Function '" + std::string(function->name) +
+                                   "' has already been defined",
+                               ErrorType::SEMANTIC);
+        return;
+    }
+    functions_[function->name] = std::move(signature);
+}
+
+// Function bodies only see their own parameters and locals, and the top level constants
+void SemanticAnalyzer::analyze_function(function_ptr& function)
+{
+    auto outer_constants = constants_;
+    auto outer = std::move(variables);
+    variables.clear();
+    for(auto& param : function->params)
+    {
+        if(!declare_variable(param.name, param.type))
+            reporter_.report_error(param.loc,
+                                   "Duplicate parameter '" + std::string(param.name) + "'",
+                                   ErrorType::SEMANTIC);
+    }
+
+    return_type_ = function->return_type;
+    analyze_scope_var(function->body);
+    return_type_ = nullptr;
+    variables = std::move(outer);
+    constants_ = std::move(outer_constants);
+}
+
+// Constants hold an integer or bool whose value is known once the initializer is folded.
+// A value that does not fit the declared type was already reported as a type mismatch
+void SemanticAnalyzer::declare_constant(declareassign_ptr& declassign)
+{
+    auto type = declassign->type;
+    if(!type->is_integer() && type != typeregistry_._bool_())
+    {
+        reporter_.report_error(declassign->loc,
+                               "Constant '" + std::string(declassign->name) +
+                                   "' must be an integer or bool",
+                               ErrorType::SEMANTIC);
+        return;
+    }
+    auto value = ConstantEvaluator::value_of(declassign->expr);
+    if(!value.has_value())
+    {
+        reporter_.report_error(declassign->loc,
+                               "Value of constant '" + std::string(declassign->name) +
+                                   "' is not known at compile time",
+                               ErrorType::SEMANTIC);
+        return;
+    }
+    if(value->type == type || (type->is_integer() && type->can_represent(value->bits)))
+        constants_[declassign->name] = {value->bits, type};
+}
+
+// Reports types the target cannot hold in registers, e.g. 256-bit vectors without AVX2
+bool SemanticAnalyzer::check_target_support(std::shared_ptr<type::BuiltinType> type,
+                                            SourceLocation& loc) const
+{
+    if(!type->is_vector() || type->size() <= 16)
+        return true;
+    if(target::TargetInfo::instance().has(target::Feature::AVX2))
+        return true;
+
+    reporter_.report_error(loc,
+                           "256-bit vector types require avx2, enable it with -mavx2",
+                           ErrorType::SEMANTIC);
+    return false;
+}
+
+// The registered type, or an array of it when the declaration has a length. Errors in type
+// arguments are reported here, a plain undefined name is left to the caller
+std::shared_ptr<type::BuiltinType>
+SemanticAnalyzer::resolve_type(std::string_view type_name,
+                               const std::vector<type::TypeName>& type_args,
+                               std::optional<size_t> array_size, SourceLocation& loc) const
+{
+    std::shared_ptr<type::BuiltinType> type = typeregistry_._undefined_();
+    if(type_args.empty())
+        type = typeregistry_.find_type(type_name);
+    else if(check_type_name({type_name, type_args}, loc))
+    {
+        type = typeregistry_.resolve({type_name, type_args});
+        if(type == typeregistry_._undefined_())
+            reporter_.report_error(loc,
+                                   "Cannot instantiate '" + std::string(type_name) +
+                                       "', a member has no size or contains the struct itself",
+                                   ErrorType::SEMANTIC);
+    }
+    if(!array_size.has_value() || type == typeregistry_._undefined_())
+        return type;
+    return typeregistry_.array_of(type, array_size.value());
+}
+
+// Names and argument counts are checked before anything is instantiated
+bool SemanticAnalyzer::check_type_name(const type::TypeName& type, SourceLocation& loc) const
+{
+    const auto* generic = typeregistry_.find_template(type.name);
+    if(type.args.empty())
+    {
+        if(typeregistry_.find_type(type.name) != typeregistry_._undefined_())
+            return true;
+        reporter_.report_error(loc,
+                               generic ? "Generic struct '" + std::string(type.name) +
+                                             "' needs type arguments"
+                                       : "Undefined type '" + std::string(type.name) + "'",
+                               ErrorType::SEMANTIC);
+        return false;
+    }
+    if(!generic)
+    {
+        reporter_.report_error(loc,
+                               "'" + std::string(type.name) + "' is not a generic struct",
+                               ErrorType::SEMANTIC);
+        return false;
+    }
+    if(generic->params.size() != type.args.size())
+    {
+        reporter_.report_error(loc,
+                               "Generic struct '" + std::string(type.name) + "' expects " +
+                                   std::to_string(generic->params.size()) +
+                                   " type arguments, got " + std::to_string(type.args.size()),
+                               ErrorType::SEMANTIC);
+        return false;
+    }
+    bool valid = true;
+    for(const auto& arg : type.args) { valid = check_type_name(arg, loc) && valid; }
+    return valid;
+}
+
+// The parser registered the name, members are laid out once their types are known. A member
+// of the struct's own type has no size yet and is reported
+void SemanticAnalyzer::define_struct(struct_ptr& _struct)
+{
+    auto* members = std::get_if<std::vector<struct_body_var>>(&_struct->members);
+    if(!members)
+        return;
+
+    std::map<std::string_view, std::shared_ptr<type::BuiltinType>, std::less<>> types;
+    bool valid = true;
+    auto add_member = [&](SourceLocation& loc, std::string_view name, std::string_view type_name,
+                          const std::vector<type::TypeName>& type_args)
+    {
+        auto type = resolve_type(type_name, type_args, std::nullopt, loc);
+        if(type == typeregistry_._undefined_() || type->size() == 0)
+        {
+            reporter_.report_error(loc,
+                                   "Member '" + std::string(name) + "' of struct '" +
+                                       std::string(_struct->name) + "' has no size",
+                                   ErrorType::SEMANTIC);
+            valid = false;
+        }
+        else if(!types.emplace(name, type).second)
+        {
+            reporter_.report_error(loc,
+                                   "Duplicate member '" + std::string(name) + "' in struct '" +
+                                       std::string(_struct->name) + "'",
+                                   ErrorType::SEMANTIC);
+            valid = false;
+        }
+    };
+    for(auto& member : *members)
+    {
+        std::visit(Overload{[&](declare_ptr& declare)
+                            {
+                                add_member(declare->loc, declare->name, declare->type_name,
+                                           declare->type_args);
+                            },
+                            [&](declareassign_ptr& declassign)
+                            {
+                                add_member(declassign->loc, declassign->name,
+                                           declassign->type_name, declassign->type_args);
+                            },
+                            [](auto&&) {}},
+                   member);
+    }
+    if(valid && !types.empty())
+        typeregistry_.define_type(_struct->name, std::move(types));
+}
+
+// Member types may name the parameters, they are resolved when the template is instantiated
+void SemanticAnalyzer::declare_template(struct_ptr& _struct)
+{
+    auto* members = std::get_if<std::vector<struct_body_var>>(&_struct->members);
+    if(!members)
+        return;
+
+    type::StructTemplate generic{_struct->name, _struct->type_params, {}, _struct->layout};
+    std::set<std::string_view> params(generic.params.begin(), generic.params.end());
+    if(params.size() != generic.params.size())
+        reporter_.report_error(_struct->loc,
+                               "Duplicate type parameter in generic struct '" +
+                                   std::string(_struct->name) + "'",
+                               ErrorType::SEMANTIC);
+
+    std::set<std::string_view> names;
+    auto add_member = [&](SourceLocation& loc, std::string_view name, type::TypeName type)
+    {
+        if(!names.insert(name).second)
+            reporter_.report_error(loc,
+                                   "Duplicate member '" + std::string(name) +
+                                       "' in generic struct '" + std::string(_struct->name) + "'",
+                                   ErrorType::SEMANTIC);
+        generic.members.emplace_back(name, std::move(type));
+    };
+    for(auto& member : *members)
+    {
+        std::visit(Overload{[&](declare_ptr& declare)
+                            {
+                                add_member(declare->loc, declare->name,
+                                           {declare->type_name, declare->type_args});
+                            },
+                            [&](declareassign_ptr& declassign)
+                            {
+                                add_member(declassign->loc, declassign->name,
+                                           {declassign->type_name, declassign->type_args});
+                            },
+                            [](auto&&) {}},
+                   member);
+    }
+
+    if(!typeregistry_.declare_template(std::move(generic)))
+        reporter_.report_error(_struct->loc,
+                               "Type '" + std::string(_struct->name) + "' has already been defined",
+                               ErrorType::SEMANTIC);
+}
+
+// Element type of name[index], constant indices are checked against the length here
+std::shared_ptr<type::BuiltinType> SemanticAnalyzer::typeof_index(std::string_view name,
+                                                                  expression_ptr_var& index,
+                                                                  SourceLocation& loc) const
+{
+    auto array_type = find_variable_type(name);
+    auto index_type = _typeof_(index);
+    evaluator_.fold(index);
+    if(!array_type->is_array())
+    {
+        reporter_.report_error(loc,
+                               "Cannot index '" + std::string(name) + "', it is not an array",
+                               ErrorType::SEMANTIC);
         return typeregistry_._undefined_();
-    return it->second.type;
+    }
+    if(!index_type->is_integer())
+    {
+        reporter_.report_error(loc, "Array index must be an integer", ErrorType::SEMANTIC);
+        return typeregistry_._undefined_();
+    }
+
+    auto& array = static_cast<type::ArrayType&>(*array_type);
+    auto* literal = std::get_if<integer_ptr>(&index);
+    if(literal && ((*literal)->value < 0 || static_cast<size_t>((*literal)->value) >= array.length))
+    {
+        reporter_.report_error(loc,
+                               "Array index " + std::to_string((*literal)->value) +
+                                   " is out of bounds for '" + std::string(name) + "' of length " +
+                                   std::to_string(array.length),
+                               ErrorType::SEMANTIC);
+    }
+    return array.element;
 }
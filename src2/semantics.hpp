@@ -2,8 +2,10 @@
 #define SEMANTICS_HPP
 
 #include "ast_def.hpp"
+#include "const_eval.hpp"
 #include "operator_matrix_index.hpp"
 #include "errors.hpp"
+#include "target.hpp"
 #include <unordered_map>
 using semantics::OperatorMatrixIndex;
 
@@ -23,12 +25,17 @@ class SemanticAnalyzer {
     struct OperatorResult {
         std::shared_ptr<type::BuiltinType> result;
         // coerce rules here, e.g. type promotion (int -> float) or division type (integer div)
+        // both operands are sign or zero extended to this type, its signedness picks
+        // signed or unsigned compares, division and right shifts
+        std::shared_ptr<type::BuiltinType> operand;
     };
 
   private:
     static type::TypeRegistry& typeregistry_;
     program_ptr program_;
     int loop_depth_ = 0;
+    // while loops around the statement being analyzed, every write is added to their assigned
+    std::vector<ASTWhile*> whiles_;
     ErrorReporter& reporter_;
     
     struct Var {
@@ -36,6 +43,14 @@ class SemanticAnalyzer {
         std::shared_ptr<type::BuiltinType> type;
     };
 
+    struct Signature {
+        std::vector<std::shared_ptr<type::BuiltinType>> params;
+        std::shared_ptr<type::BuiltinType> result;
+    };
+
+    // return type of the function being analyzed, nullptr for top level statements
+    std::shared_ptr<type::BuiltinType> return_type_ = nullptr;
+
     void analyze_stmt(statements_ptr_var& node);
 
     void analyze_scope_var(scope_err_ptr_var& node);
@@ -46,10 +61,72 @@ class SemanticAnalyzer {
     
     std::map<std::string_view, Var, std::less<>> variables;
 
+    std::map<std::string_view, Signature, std::less<>> functions_;
+
+    // values of const declarations in scope, uses are folded to literals
+    ConstantEvaluator::Constants constants_;
+
+    ConstantEvaluator evaluator_;
+
+    void declare_constant(declareassign_ptr& declassign);
+
+    void declare_function(function_ptr& function);
+
+    void define_struct(struct_ptr& _struct);
+
+    void declare_template(struct_ptr& _struct);
+
+    void analyze_function(function_ptr& function);
+
+    std::shared_ptr<type::BuiltinType>
+    typeof_function_call(call_ptr& call, const Signature& signature,
+                         std::vector<std::shared_ptr<type::BuiltinType>>& arg_types) const;
+
     static const std::unordered_map<OperatorMatrixIndex, OperatorResult> OPERATOR_MATRIX;
 
+    static std::unordered_map<OperatorMatrixIndex, OperatorResult> build_operator_matrix();
+
+    static const std::unordered_map<std::string_view, Intrinsic> INTRINSICS;
+
+    static const std::unordered_map<std::string_view, MemoryOrder> MEMORY_ORDERS;
+
+    std::shared_ptr<type::BuiltinType> typeof_call(call_ptr& call) const;
+
+    std::shared_ptr<type::BuiltinType>
+    typeof_bit_intrinsic(call_ptr& call, Intrinsic intrinsic,
+                         std::vector<std::shared_ptr<type::BuiltinType>>& arg_types) const;
+
+    std::shared_ptr<type::BuiltinType>
+    typeof_atomic_intrinsic(call_ptr& call, Intrinsic intrinsic,
+                            std::vector<std::shared_ptr<type::BuiltinType>>& arg_types) const;
+
+    std::shared_ptr<type::BuiltinType> resolve_type(std::string_view type_name,
+                                                    const std::vector<type::TypeName>& type_args,
+                                                    std::optional<size_t> array_size,
+                                                    SourceLocation& loc) const;
+
+    bool check_type_name(const type::TypeName& type, SourceLocation& loc) const;
+
+    std::shared_ptr<type::BuiltinType> typeof_index(std::string_view name,
+                                                    expression_ptr_var& index,
+                                                    SourceLocation& loc) const;
+
+    bool check_target_support(std::shared_ptr<type::BuiltinType> type, SourceLocation& loc) const;
+
+    // A literal above INT64_MAX only fits u64
+    static bool fits(const ASTInteger& literal, const type::BuiltinType& type);
+
+    std::shared_ptr<type::BuiltinType> literal_type(expression_ptr_var& node,
+                                                    std::shared_ptr<type::BuiltinType> type,
+                                                    std::shared_ptr<type::BuiltinType> other) const;
+
+    bool is_assignable(expression_ptr_var& expr, std::shared_ptr<type::BuiltinType> expr_type,
+                       std::shared_ptr<type::BuiltinType> target) const;
+
     bool declare_variable(std::string_view name, std::shared_ptr<type::BuiltinType> type);
 
+    void record_write(std::string_view name);
+
     std::shared_ptr<type::BuiltinType> find_variable_type(std::string_view name) const;
 
 };
@@ -0,0 +1,296 @@
+#include "strength_reduce.hpp"
+#include <bit>
+
+namespace
+{
+    uint64_t mask_of(int bits)
+    {
+        return bits == 64 ? ~uint64_t{0} : (uint64_t{1} << bits) - 1;
+    }
+
+    int64_t sign_extend(uint64_t value, int bits)
+    {
+        const int unused = 64 - bits;
+        return static_cast<int64_t>(value << unused) >> unused;
+    }
+
+    struct SignedMagic {
+        uint64_t multiplier;
+        int shift;
+    };
+
+    // Hacker's Delight 10-1 for any width, 2 <= |divisor| < 2^(bits - 1)
+    SignedMagic signed_magic(int64_t divisor, int bits)
+    {
+        const uint64_t mask = mask_of(bits);
+        const uint64_t two = uint64_t{1} << (bits - 1);
+        const uint64_t abs = divisor < 0 ? -static_cast<uint64_t>(divisor) : divisor;
+        const uint64_t t = two + (divisor < 0 ? 1 : 0);
+        const uint64_t anc = t - 1 - t % abs;
+        int p = bits - 1;
+        uint64_t q1 = two / anc, r1 = two - q1 * anc;
+        uint64_t q2 = two / abs, r2 = two - q2 * abs;
+        uint64_t delta;
+        do
+        {
+            p++;
+            q1 = (q1 * 2) & mask;
+            r1 = (r1 * 2) & mask;
+            if(r1 >= anc)
+            {
+                q1 = (q1 + 1) & mask;
+                r1 -= anc;
+            }
+            q2 = (q2 * 2) & mask;
+            r2 = (r2 * 2) & mask;
+            if(r2 >= abs)
+            {
+                q2 = (q2 + 1) & mask;
+                r2 -= abs;
+            }
+            delta = abs - r2;
+        } while(q1 < delta || (q1 == delta && r1 == 0));
+
+        uint64_t multiplier = (q2 + 1) & mask;
+        if(divisor < 0)
+            multiplier = -multiplier & mask;
+        return {multiplier, p - bits};
+    }
+
+    struct UnsignedMagic {
+        uint64_t multiplier;
+        int shift;
+        bool add; // the multiplier needs bits + 1 bits, the top one is added back as x
+    };
+
+    // Smallest shift p with 2^(bits + p) <= m * d <= 2^(bits + p) + 2^p, for which
+    // x * m >> (bits + p) is x / d for every x of the width, 2 <= divisor < 2^(bits - 1)
+    UnsignedMagic unsigned_magic(uint64_t divisor, int bits)
+    {
+        using u128 = unsigned __int128;
+        const int log = 64 - std::countl_zero(divisor - 1);
+        for(int p = 0;; p++)
+        {
+            const u128 two = u128{1} << (bits + p);
+            const u128 m = (two + divisor - 1) / divisor;
+            if(p < log && m * divisor - two > (u128{1} << p))
+                continue;
+            if(m < (u128{1} << bits))
+                return {static_cast<uint64_t>(m), p, false};
+            return {static_cast<uint64_t>(m - (u128{1} << bits)), p, true};
+        }
+    }
+} // namespace
+
+StrengthReduction::StrengthReduction(ir::Function& function) : function_(function) {}
+
+size_t StrengthReduction::run()
+{
+    for(block_ = 0; block_ < function_.blocks.size(); block_++)
+    {
+        for(size_t i = 0; i < function_.blocks[block_].insts.size(); i++)
+        {
+            position_ = i;
+            if(reduce(function_.blocks[block_].insts[i]))
+            {
+                reduced_++;
+                i = position_;
+            }
+        }
+    }
+    return reduced_;
+}
+
+bool StrengthReduction::reduce(ir::Value value)
+{
+    const auto inst = function_.insts[value];
+    if(inst.op != ir::Opcode::MUL && inst.op != ir::Opcode::DIV && inst.op != ir::Opcode::MOD)
+        return false;
+    const auto& type = function_.types[inst.type];
+    if(!type->is_integer())
+        return false;
+    const int bits = static_cast<int>(type->size() * 8);
+
+    ir::Value result = ir::NONE;
+    if(inst.op == ir::Opcode::MUL)
+    {
+        auto factor = constant_of(inst.b, bits);
+        ir::Value x = inst.a;
+        if(!factor)
+        {
+            factor = constant_of(inst.a, bits);
+            x = inst.b;
+        }
+        if(factor)
+            result = multiply(x, *factor, inst.type, bits);
+    }
+    else if(auto divisor = constant_of(inst.b, bits))
+    {
+        const bool modulo = inst.op == ir::Opcode::MOD;
+        if(type->is_signed())
+            result = divide_signed(inst.a, sign_extend(*divisor, bits), inst.type, bits, modulo,
+                                   inst.flags & ir::NON_NEGATIVE);
+        else
+            result = divide_unsigned(inst.a, *divisor, inst.type, bits, modulo);
+    }
+    if(result == ir::NONE)
+        return false;
+    replace(value, result);
+    return true;
+}
+
+// Factors 0 and 1 are left to constant folding, other ones without a short sequence to imul
+ir::Value StrengthReduction::multiply(ir::Value x, uint64_t factor, uint16_t type, int bits)
+{
+    const uint64_t mask = mask_of(bits);
+    const uint64_t negated = -factor & mask;
+    auto shifted = [this, x, type](int count)
+    { return count == 0 ? x : emit(ir::Opcode::SHL, type, x, constant(type, count)); };
+
+    if(factor <= 1)
+        return ir::NONE;
+    if(std::has_single_bit(factor))
+        return shifted(std::countr_zero(factor));
+    if(std::popcount(factor) == 2)
+    {
+        auto high = shifted(63 - std::countl_zero(factor));
+        auto low = shifted(std::countr_zero(factor));
+        return emit(ir::Opcode::ADD, type, high, low);
+    }
+    if(factor != mask && std::has_single_bit(factor + 1))
+        return emit(ir::Opcode::SUB, type, shifted(std::countr_zero(factor + 1)), x);
+    if(std::has_single_bit(negated))
+    {
+        auto product = shifted(std::countr_zero(negated));
+        return emit(ir::Opcode::SUB, type, constant(type, 0), product);
+    }
+    return ir::NONE;
+}
+
+ir::Value StrengthReduction::divide_unsigned(ir::Value x, uint64_t divisor, uint16_t type,
+                                             int bits, bool modulo)
+{
+    if(divisor <= 1)
+        return ir::NONE;
+    if(std::has_single_bit(divisor))
+    {
+        if(modulo)
+            return emit(ir::Opcode::AND, type, x, constant(type, divisor - 1));
+        return emit(ir::Opcode::SHR, type, x, constant(type, std::countr_zero(divisor)));
+    }
+    // the quotient is 0 or 1 once the top bit is set
+    if(divisor >> (bits - 1))
+    {
+        auto& registry = type::TypeRegistry::instance();
+        auto above = emit(ir::Opcode::GE, function_.intern(registry._bool_()), x,
+                          constant(type, divisor));
+        auto quotient = emit(ir::Opcode::CONVERT, type, above);
+        return modulo ? remainder(x, quotient, divisor, type, bits) : quotient;
+    }
+
+    auto magic = unsigned_magic(divisor, bits);
+    auto quotient = emit(ir::Opcode::MULHI, type, x, constant(type, magic.multiplier));
+    if(magic.add)
+    {
+        // (x + high) >> shift without overflowing
+        auto half = emit(ir::Opcode::SHR, type, emit(ir::Opcode::SUB, type, x, quotient),
+                         constant(type, 1));
+        quotient = emit(ir::Opcode::ADD, type, quotient, half);
+        magic.shift--;
+    }
+    if(magic.shift > 0)
+        quotient = emit(ir::Opcode::SHR, type, quotient, constant(type, magic.shift));
+    return modulo ? remainder(x, quotient, divisor, type, bits) : quotient;
+}
+
+// Division truncates, so a negative dividend is biased by |d| - 1 before shifting and the
+// magic quotient is incremented when it is negative. Neither is needed for a non-negative
+// dividend and divisor. 1 and -1 are left alone, MIN / -1 traps
+ir::Value StrengthReduction::divide_signed(ir::Value x, int64_t divisor, uint16_t type, int bits,
+                                           bool modulo, bool non_negative)
+{
+    if(divisor == 0 || divisor == 1 || divisor == -1)
+        return ir::NONE;
+    const uint64_t mask = mask_of(bits);
+    const uint64_t abs = (divisor < 0 ? -static_cast<uint64_t>(divisor) : divisor) & mask;
+
+    if(std::has_single_bit(abs))
+    {
+        const int shift = std::countr_zero(abs);
+        if(non_negative && divisor > 0)
+            return modulo ? emit(ir::Opcode::AND, type, x, constant(type, abs - 1))
+                          : emit(ir::Opcode::SHR, type, x, constant(type, shift));
+        auto sign = emit(ir::Opcode::SHR, type, x, constant(type, bits - 1));
+        auto bias = emit(ir::Opcode::AND, type, sign, constant(type, abs - 1));
+        auto biased = emit(ir::Opcode::ADD, type, x, bias);
+        // the remainder keeps the sign of the dividend whatever the sign of the divisor
+        if(modulo)
+            return emit(ir::Opcode::SUB, type, x,
+                        emit(ir::Opcode::AND, type, biased, constant(type, -abs & mask)));
+        auto quotient = emit(ir::Opcode::SHR, type, biased, constant(type, shift));
+        return divisor > 0 ? quotient
+                           : emit(ir::Opcode::SUB, type, constant(type, 0), quotient);
+    }
+
+    auto magic = signed_magic(divisor, bits);
+    const int64_t multiplier = sign_extend(magic.multiplier, bits);
+    auto quotient = emit(ir::Opcode::MULHI, type, x, constant(type, magic.multiplier));
+    if(divisor > 0 && multiplier < 0)
+        quotient = emit(ir::Opcode::ADD, type, quotient, x);
+    else if(divisor < 0 && multiplier > 0)
+        quotient = emit(ir::Opcode::SUB, type, quotient, x);
+    if(magic.shift > 0)
+        quotient = emit(ir::Opcode::SHR, type, quotient, constant(type, magic.shift));
+    if(!non_negative || divisor < 0)
+    {
+        auto sign = emit(ir::Opcode::SHR, type, quotient, constant(type, bits - 1));
+        quotient = emit(ir::Opcode::SUB, type, quotient, sign);
+    }
+    return modulo ? remainder(x, quotient, static_cast<uint64_t>(divisor), type, bits)
+                  : quotient;
+}
+
+// x - x / d * d, the product reduced as well when it can be
+ir::Value StrengthReduction::remainder(ir::Value x, ir::Value quotient, uint64_t divisor,
+                                       uint16_t type, int bits)
+{
+    auto product = multiply(quotient, divisor & mask_of(bits), type, bits);
+    if(product == ir::NONE)
+        product = emit(ir::Opcode::MUL, type, quotient, constant(type, divisor));
+    return emit(ir::Opcode::SUB, type, x, product);
+}
+
+// A literal converted to the type of the other operand counts as well
+std::optional<uint64_t> StrengthReduction::constant_of(ir::Value value, int bits) const
+{
+    auto& inst = function_.insts[value];
+    if(inst.op == ir::Opcode::CONVERT && function_.insts[inst.a].op == ir::Opcode::CONST &&
+       function_.type_of(inst.a)->is_integer())
+        return static_cast<uint64_t>(function_.constant(inst.a)) & mask_of(bits);
+    if(inst.op != ir::Opcode::CONST)
+        return std::nullopt;
+    return static_cast<uint64_t>(function_.constant(value)) & mask_of(bits);
+}
+
+ir::Value StrengthReduction::emit(ir::Opcode op, uint16_t type, uint32_t a, uint32_t b)
+{
+    return function_.insert(block_, position_++, {op, 0, type, a, b});
+}
+
+// Constants are kept sign extended like the ones lowering creates
+ir::Value StrengthReduction::constant(uint16_t type, uint64_t bits)
+{
+    const auto& builtin = function_.types[type];
+    const int width = static_cast<int>(builtin->size() * 8);
+    auto value = builtin->is_signed() ? static_cast<uint64_t>(sign_extend(bits, width)) : bits;
+    return emit(ir::Opcode::CONST, type, static_cast<uint32_t>(value),
+                static_cast<uint32_t>(value >> 32));
+}
+
+void StrengthReduction::replace(ir::Value value, ir::Value with)
+{
+    auto& insts = function_.blocks[block_].insts;
+    function_.insts[value] = function_.insts[with];
+    function_.insts[with].op = ir::Opcode::NOP;
+    insts.erase(insts.begin() + static_cast<std::ptrdiff_t>(--position_));
+}
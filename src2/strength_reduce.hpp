@@ -0,0 +1,51 @@
+#ifndef STRENGTH_REDUCE_HPP
+#define STRENGTH_REDUCE_HPP
+
+#pragma once
+#include "ir.hpp"
+#include <optional>
+
+// Replaces integer MUL, DIV and MOD by a constant with cheaper instructions, best run after
+// Mem2Reg so the constants reach their uses. Multiplications with at most two bits set, or
+// one below a power of two, become shifts and adds, what lea does on x86. Division by a power
+// of two becomes a shift with a fix-up for negative dividends and any other division a
+// multiplication by a magic number keeping the high half, MULHI, after Granlund and Montgomery
+class StrengthReduction {
+  public:
+    StrengthReduction(ir::Function& function);
+
+    // Returns the number of instructions replaced
+    size_t run();
+
+  private:
+    ir::Function& function_;
+    ir::Block block_ = 0;
+    size_t position_ = 0; // where the next instruction is inserted, before the one replaced
+    size_t reduced_ = 0;
+
+    bool reduce(ir::Value value);
+
+    ir::Value multiply(ir::Value x, uint64_t factor, uint16_t type, int bits);
+
+    // Each returns the remainder instead of the quotient when modulo is set
+    ir::Value divide_unsigned(ir::Value x, uint64_t divisor, uint16_t type, int bits,
+                              bool modulo);
+
+    ir::Value divide_signed(ir::Value x, int64_t divisor, uint16_t type, int bits, bool modulo,
+                            bool non_negative);
+
+    ir::Value remainder(ir::Value x, ir::Value quotient, uint64_t divisor, uint16_t type,
+                        int bits);
+
+    // Bits of a constant operand truncated to the width of the operation
+    std::optional<uint64_t> constant_of(ir::Value value, int bits) const;
+
+    ir::Value emit(ir::Opcode op, uint16_t type, uint32_t a, uint32_t b = ir::NONE);
+
+    ir::Value constant(uint16_t type, uint64_t bits);
+
+    // value takes over the instruction of with, the last one emitted
+    void replace(ir::Value value, ir::Value with);
+};
+
+#endif // STRENGTH_REDUCE_HPP
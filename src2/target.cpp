@@ -0,0 +1,263 @@
+#include "target.hpp"
+#include <algorithm>
+
+target::TargetInfo& target::TargetInfo::instance()
+{
+    static TargetInfo info;
+    return info;
+}
+
+target::TargetInfo::TargetInfo() : features_(0)
+{
+    enable(Feature::SSE2);
+}
+
+bool target::TargetInfo::has(Feature feature) const
+{
+    return (features_ & (1u << static_cast<unsigned>(feature))) != 0;
+}
+
+// Enabling an extension also enables the extensions it implies
+void target::TargetInfo::enable(Feature feature)
+{
+    features_ |= 1u << static_cast<unsigned>(feature);
+    switch(feature)
+    {
+    case Feature::AVX2:
+        enable(Feature::SSE42);
+        break;
+    case Feature::SSE42:
+        enable(Feature::SSE41);
+        enable(Feature::POPCNT);
+        break;
+    default:
+        break;
+    }
+}
+
+// Enables every extension the compiling machine supports, like -march=native
+void target::TargetInfo::detect_host()
+{
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse4.1"))
+        enable(Feature::SSE41);
+    if(__builtin_cpu_supports("sse4.2"))
+        enable(Feature::SSE42);
+    if(__builtin_cpu_supports("avx2"))
+        enable(Feature::AVX2);
+    if(__builtin_cpu_supports("popcnt"))
+        enable(Feature::POPCNT);
+    if(__builtin_cpu_supports("abm"))
+        enable(Feature::LZCNT);
+    if(__builtin_cpu_supports("bmi"))
+        enable(Feature::BMI1);
+#endif
+}
+
+std::string_view target::TargetInfo::feature_name(Feature feature)
+{
+    switch(feature)
+    {
+    case Feature::SSE2:
+        return "sse2";
+    case Feature::SSE41:
+        return "sse4.1";
+    case Feature::SSE42:
+        return "sse4.2";
+    case Feature::AVX2:
+        return "avx2";
+    case Feature::POPCNT:
+        return "popcnt";
+    case Feature::LZCNT:
+        return "lzcnt";
+    case Feature::BMI1:
+        return "bmi";
+    }
+    return "unknown";
+}
+
+// Maps a command line flag such as -mavx2 to the feature it enables
+std::optional<target::Feature> target::TargetInfo::parse_flag(std::string_view flag)
+{
+    if(!flag.starts_with("-m"))
+        return std::nullopt;
+    flag.remove_prefix(2);
+    for(auto feature : {Feature::SSE2,
+                        Feature::SSE41,
+                        Feature::SSE42,
+                        Feature::AVX2,
+                        Feature::POPCNT,
+                        Feature::LZCNT,
+                        Feature::BMI1})
+    {
+        if(flag == feature_name(feature))
+            return feature;
+    }
+    return std::nullopt;
+}
+
+namespace
+{
+    struct VectorRow {
+        Operator op;
+        size_t element_bytes;
+        std::string_view sse;
+        std::string_view avx;
+        target::Feature feature;
+    };
+
+    // element_bytes of 0 matches any lane width
+    constexpr VectorRow VECTOR_TABLE[] = {
+        {Operator::ADD, 1, "paddb", "vpaddb", target::Feature::SSE2},
+        {Operator::ADD, 2, "paddw", "vpaddw", target::Feature::SSE2},
+        {Operator::ADD, 4, "paddd", "vpaddd", target::Feature::SSE2},
+        {Operator::ADD, 8, "paddq", "vpaddq", target::Feature::SSE2},
+        {Operator::SUB, 1, "psubb", "vpsubb", target::Feature::SSE2},
+        {Operator::SUB, 2, "psubw", "vpsubw", target::Feature::SSE2},
+        {Operator::SUB, 4, "psubd", "vpsubd", target::Feature::SSE2},
+        {Operator::SUB, 8, "psubq", "vpsubq", target::Feature::SSE2},
+        {Operator::MUL, 2, "pmullw", "vpmullw", target::Feature::SSE2},
+        {Operator::MUL, 4, "pmulld", "vpmulld", target::Feature::SSE41},
+        {Operator::BAND, 0, "pand", "vpand", target::Feature::SSE2},
+        {Operator::BOR, 0, "por", "vpor", target::Feature::SSE2},
+        {Operator::XOR, 0, "pxor", "vpxor", target::Feature::SSE2},
+        {Operator::LSH, 2, "psllw", "vpsllw", target::Feature::SSE2},
+        {Operator::LSH, 4, "pslld", "vpslld", target::Feature::SSE2},
+        {Operator::LSH, 8, "psllq", "vpsllq", target::Feature::SSE2},
+        {Operator::RSH, 2, "psraw", "vpsraw", target::Feature::SSE2},
+        {Operator::RSH, 4, "psrad", "vpsrad", target::Feature::SSE2},
+        {Operator::EQ, 1, "pcmpeqb", "vpcmpeqb", target::Feature::SSE2},
+        {Operator::EQ, 2, "pcmpeqw", "vpcmpeqw", target::Feature::SSE2},
+        {Operator::EQ, 4, "pcmpeqd", "vpcmpeqd", target::Feature::SSE2},
+        {Operator::EQ, 8, "pcmpeqq", "vpcmpeqq", target::Feature::SSE41},
+        // LESS swaps the operands of pcmpgt
+        {Operator::GREATER, 1, "pcmpgtb", "vpcmpgtb", target::Feature::SSE2},
+        {Operator::GREATER, 2, "pcmpgtw", "vpcmpgtw", target::Feature::SSE2},
+        {Operator::GREATER, 4, "pcmpgtd", "vpcmpgtd", target::Feature::SSE2},
+        {Operator::GREATER, 8, "pcmpgtq", "vpcmpgtq", target::Feature::SSE42},
+        {Operator::LESS, 1, "pcmpgtb", "vpcmpgtb", target::Feature::SSE2},
+        {Operator::LESS, 2, "pcmpgtw", "vpcmpgtw", target::Feature::SSE2},
+        {Operator::LESS, 4, "pcmpgtd", "vpcmpgtd", target::Feature::SSE2},
+        {Operator::LESS, 8, "pcmpgtq", "vpcmpgtq", target::Feature::SSE42},
+    };
+} // namespace
+
+namespace
+{
+    constexpr std::string_view INTEGER_REGISTERS[] = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
+    constexpr std::string_view XMM_REGISTERS[] =
+        {"xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"};
+    constexpr std::string_view YMM_REGISTERS[] =
+        {"ymm0", "ymm1", "ymm2", "ymm3", "ymm4", "ymm5", "ymm6", "ymm7"};
+} // namespace
+
+// Integers and bools take the next free general purpose register, floating point and vector
+// values the next free vector register. The rest goes on the stack in 8 byte slots, vectors
+// in slots aligned to their size
+target::CallLayout
+target::assign_arguments(const std::vector<std::shared_ptr<type::BuiltinType>>& params,
+                         const std::shared_ptr<type::BuiltinType>& result)
+{
+    CallLayout layout{{}, "rax", 0};
+    if(result->is_floating() || result->is_vector())
+        layout.result = result->size() == 32 ? YMM_REGISTERS[0] : XMM_REGISTERS[0];
+
+    size_t next_integer = 0;
+    size_t next_vector = 0;
+    size_t offset = 0;
+    for(const auto& param : params)
+    {
+        const bool in_vector = param->is_floating() || param->is_vector();
+        if(in_vector && next_vector < std::size(XMM_REGISTERS))
+        {
+            auto& registers = param->size() == 32 ? YMM_REGISTERS : XMM_REGISTERS;
+            layout.arguments.push_back({registers[next_vector++], 0});
+            continue;
+        }
+        if(!in_vector && next_integer < std::size(INTEGER_REGISTERS))
+        {
+            layout.arguments.push_back({INTEGER_REGISTERS[next_integer++], 0});
+            continue;
+        }
+
+        const size_t slot = std::max<size_t>(param->size(), 8);
+        offset = (offset + slot - 1) / slot * slot;
+        layout.arguments.push_back({"", offset});
+        offset += slot;
+    }
+    layout.stack_bytes = (offset + 15) / 16 * 16;
+    return layout;
+}
+
+// popcnt, lzcnt and tzcnt need extensions; bsr/bsf leave the result undefined for 0, so
+// their fallbacks branch on zero. 16-bit byte swaps are a rotate since bswap needs 32 bits.
+// 8-bit operands are zero extended to 32 bits first and the count is corrected afterwards
+std::optional<target::BitInstruction> target::select_bit_instruction(Intrinsic intrinsic,
+                                                                     size_t bytes)
+{
+    switch(intrinsic)
+    {
+    case Intrinsic::BIT_POPCOUNT:
+        return BitInstruction{"popcnt", Feature::POPCNT, "swar-popcount"};
+    case Intrinsic::BIT_CLZ:
+        return BitInstruction{"lzcnt", Feature::LZCNT, "bsr-xor"};
+    case Intrinsic::BIT_CTZ:
+        return BitInstruction{"tzcnt", Feature::BMI1, "bsf"};
+    case Intrinsic::BIT_BSWAP:
+        if(bytes == 1)
+            return std::nullopt;
+        if(bytes == 2)
+            return BitInstruction{"rol", std::nullopt, ""};
+        return BitInstruction{"bswap", std::nullopt, ""};
+    case Intrinsic::BIT_ROTL:
+        return BitInstruction{"rol", std::nullopt, ""};
+    case Intrinsic::BIT_ROTR:
+        return BitInstruction{"ror", std::nullopt, ""};
+    default:
+        return std::nullopt;
+    }
+}
+
+// x86-64 keeps loads in order with loads and stores in order with stores, so relaxed,
+// acquire and release accesses are plain movs and need no fence. Only a sequentially
+// consistent store has to wait for earlier stores to drain, xchg does that without the
+// separate mfence. Read-modify-writes are always locked, whatever the ordering; a fetch_add
+// whose result is discarded is a lock add instead of lock xadd
+std::optional<target::AtomicInstruction>
+target::select_atomic_instruction(Intrinsic intrinsic, MemoryOrder order, bool result_used)
+{
+    switch(intrinsic)
+    {
+    case Intrinsic::ATOMIC_LOAD:
+        return AtomicInstruction{"mov", false};
+    case Intrinsic::ATOMIC_STORE:
+        if(order == MemoryOrder::SEQ_CST)
+            return AtomicInstruction{"xchg", true};
+        return AtomicInstruction{"mov", false};
+    case Intrinsic::ATOMIC_FETCH_ADD:
+        return AtomicInstruction{result_used ? "lock xadd" : "lock add", true};
+    case Intrinsic::ATOMIC_EXCHANGE:
+        return AtomicInstruction{"xchg", true};
+    case Intrinsic::ATOMIC_COMPARE_EXCHANGE:
+        return AtomicInstruction{"lock cmpxchg", true};
+    default:
+        return std::nullopt;
+    }
+}
+
+std::optional<target::VectorInstruction>
+target::select_vector_instruction(Operator op, const type::VectorType& type)
+{
+    const size_t element_bytes = type.element->size();
+    const bool wide = type.size() == 32;
+    for(const auto& row : VECTOR_TABLE)
+    {
+        if(row.op != op || (row.element_bytes != 0 && row.element_bytes != element_bytes))
+            continue;
+        if(wide)
+            return VectorInstruction{row.avx, Feature::AVX2};
+        return VectorInstruction{row.sse, row.feature};
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,90 @@
+#ifndef TARGET_HPP
+#define TARGET_HPP
+
+#pragma once
+#include "ast_def.hpp"
+#include "type.hpp"
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace target
+{
+    // x86-64 instruction set extensions the backend may emit, SSE2 is always available
+    enum class Feature : char {
+        SSE2,
+        SSE41,
+        SSE42,
+        AVX2,
+        POPCNT,
+        LZCNT,
+        BMI1,
+    };
+
+    class TargetInfo {
+      public:
+        static TargetInfo& instance();
+        bool has(Feature feature) const;
+        void enable(Feature feature);
+        void detect_host();
+        static std::string_view feature_name(Feature feature);
+        static std::optional<Feature> parse_flag(std::string_view flag);
+        TargetInfo(const TargetInfo& other) = delete;
+        TargetInfo& operator=(const TargetInfo& other) = delete;
+
+      private:
+        TargetInfo();
+        ~TargetInfo() = default;
+        unsigned features_;
+    };
+
+    struct VectorInstruction {
+        std::string_view mnemonic;
+        Feature feature;
+    };
+
+    // How a bit manipulation intrinsic is emitted. Without `feature` the backend emits
+    // `fallback`, a sequence that only uses baseline x86-64 instructions
+    struct BitInstruction {
+        std::string_view mnemonic;
+        std::optional<Feature> feature;
+        std::string_view fallback;
+    };
+
+    // How an atomic intrinsic is emitted. `locked` instructions carry a lock prefix, or imply
+    // it like xchg, and act as a full barrier; the rest are ordinary movs
+    struct AtomicInstruction {
+        std::string_view mnemonic;
+        bool locked;
+    };
+
+    // Where a value is passed under the System V x86-64 calling convention, an empty register
+    // means it is passed on the stack at stack_offset above the return address
+    struct ArgumentLocation {
+        std::string_view reg;
+        size_t stack_offset;
+    };
+
+    struct CallLayout {
+        std::vector<ArgumentLocation> arguments;
+        std::string_view result;
+        size_t stack_bytes; // stack argument area, a multiple of 16
+    };
+
+    CallLayout assign_arguments(const std::vector<std::shared_ptr<type::BuiltinType>>& params,
+                                const std::shared_ptr<type::BuiltinType>& result);
+
+    std::optional<BitInstruction> select_bit_instruction(Intrinsic intrinsic, size_t bytes);
+
+    std::optional<AtomicInstruction> select_atomic_instruction(Intrinsic intrinsic,
+                                                               MemoryOrder order,
+                                                               bool result_used);
+
+    // Picks the SSE/AVX instruction for an element-wise operator on a vector type,
+    // nullopt when x86-64 has no single instruction for it
+    std::optional<VectorInstruction> select_vector_instruction(Operator op,
+                                                               const type::VectorType& type);
+} // namespace target
+
+#endif // TARGET_HPP
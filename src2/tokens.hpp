@@ -6,7 +6,7 @@
 enum class TokenType : char { 
     // Literals
     INT_LITERAL,     
-    //FLOAT_LITERAL,   
+    FLOAT_LITERAL,   
     //STRING_LITERAL,
     BOOL_LITERAL,
 
@@ -20,10 +20,23 @@ enum class TokenType : char {
     KW_BREAK,
     KW_RETURN,
     KW_STRUCT,
+    KW_SOA,
+    KW_CONST,
+    KW_PARALLEL,
 
     // Types
     TYPE_INT,        
     TYPE_BOOL,
+    TYPE_I8,
+    TYPE_I16,
+    TYPE_I32,
+    TYPE_I64,
+    TYPE_U8,
+    TYPE_U16,
+    TYPE_U32,
+    TYPE_U64,
+    TYPE_FLOAT,
+    TYPE_DOUBLE,
 
     // Operators & Punctuation
     OP_ASSIGN,          // =
@@ -55,6 +68,8 @@ enum class TokenType : char {
     PAREN_R,             // )
     BRACE_L,             // {
     BRACE_R,             // }
+    BRACKET_L,           // [
+    BRACKET_R,           // ]
     
     // Sentinel & Special
     IGNORE,              // For comments or whitespace if the lexer passes them through
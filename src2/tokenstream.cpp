@@ -2,7 +2,7 @@
 
 std::optional<Token> TokenStream::peek(size_t offset) const
 {
-    if(index_ < tokens_.size())
+    if(index_ + offset < tokens_.size())
         return {tokens_.at(index_ + offset)};
     return std::nullopt;
 }
@@ -21,17 +21,171 @@ bool type::BuiltinType::is_compatible(const std::shared_ptr<BuiltinType>& other)
     return false;
 }
 
+size_t type::BuiltinType::size() const
+{
+    return bytes;
+}
+
+std::string_view type::BuiltinType::get_name() const
+{
+    return name;
+}
+
+bool type::BuiltinType::is_integer() const
+{
+    return type_class == TypeClass::SIGNED_INT || type_class == TypeClass::UNSIGNED_INT;
+}
+
+bool type::BuiltinType::is_signed() const
+{
+    return type_class == TypeClass::SIGNED_INT;
+}
+
+bool type::BuiltinType::is_floating() const
+{
+    return type_class == TypeClass::FLOATING;
+}
+
+bool type::BuiltinType::is_arithmetic() const
+{
+    return is_integer() || is_floating();
+}
+
+bool type::BuiltinType::is_vector() const
+{
+    return type_class == TypeClass::VECTOR;
+}
+
+bool type::BuiltinType::is_array() const
+{
+    return type_class == TypeClass::ARRAY;
+}
+
+bool type::BuiltinType::is_atomic() const
+{
+    return type_class == TypeClass::ATOMIC;
+}
+
+bool type::BuiltinType::can_represent(int64_t value) const
+{
+    if(!is_integer())
+        return false;
+    if(is_signed())
+    {
+        if(bytes >= 8)
+            return true;
+        int64_t limit = int64_t{1} << (bytes * 8 - 1);
+        return value >= -limit && value < limit;
+    }
+    if(value < 0)
+        return false;
+    if(bytes >= 8)
+        return true;
+    return value < (int64_t{1} << (bytes * 8));
+}
+
+std::optional<int64_t> type::BuiltinType::min_value() const
+{
+    if(!is_integer())
+        return std::nullopt;
+    if(!is_signed())
+        return 0;
+    if(bytes >= 8)
+        return INT64_MIN;
+    return -(int64_t{1} << (bytes * 8 - 1));
+}
+
+std::optional<int64_t> type::BuiltinType::max_value() const
+{
+    if(!is_integer() || (!is_signed() && bytes >= 8))
+        return std::nullopt;
+    if(bytes >= 8)
+        return INT64_MAX;
+    if(is_signed())
+        return (int64_t{1} << (bytes * 8 - 1)) - 1;
+    return (int64_t{1} << (bytes * 8)) - 1;
+}
+
 type::BuiltinType::BuiltinType(std::string_view name, int bytes) : name(name), bytes(bytes)
 {
     id = id_count++;
 }
 
-type::BuiltinType::BuiltinType(std::string_view name) : name(name)
+type::BuiltinType::BuiltinType(std::string_view name, int bytes, TypeClass type_class)
+    : name(name), bytes(bytes), type_class(type_class)
 {
     id = id_count++;
 }
 
-type::UDType::UDType(std::string_view) : BuiltinType(name) {}
+type::BuiltinType::BuiltinType(std::string_view name) : name(name), bytes(0)
+{
+    id = id_count++;
+}
+
+type::VectorType::VectorType(std::string_view name, std::shared_ptr<BuiltinType> element,
+                             size_t lanes)
+    : BuiltinType(name, element->bytes * lanes, TypeClass::VECTOR), element(element), lanes(lanes)
+{
+}
+
+type::AtomicType::AtomicType(std::string_view name, std::shared_ptr<BuiltinType> element)
+    : BuiltinType(name, element->bytes, TypeClass::ATOMIC), element(element)
+{
+}
+
+type::ArrayType::ArrayType(std::shared_ptr<BuiltinType> element, size_t length)
+    : BuiltinType("", 0, TypeClass::ARRAY), element(element), length(length)
+{
+    full_name = std::string(element->name) + "[" + std::to_string(length) + "]";
+    name = full_name;
+
+    auto udtype = std::dynamic_pointer_cast<UDType>(element);
+    if(udtype)
+        bytes = udtype->collection_bytes(length);
+    else
+        bytes = element->bytes * length;
+}
+
+// Byte offset of element `index`. Elements of an SOA struct are not contiguous, their
+// members are addressed with member_offset instead
+size_t type::ArrayType::element_offset(size_t index) const
+{
+    return index * element->bytes;
+}
+
+size_t type::ArrayType::member_offset(size_t index, std::string_view member) const
+{
+    auto udtype = std::dynamic_pointer_cast<UDType>(element);
+    if(!udtype)
+    {
+        std::cerr << "Error: Elements of '" << this->name << "' have no member '" << member
+                  << "'." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return udtype->element_offset(member, index, length);
+}
+
+type::UDType::UDType(std::string_view name) : BuiltinType(name) {}
+
+type::StructInstance::StructInstance(const StructTemplate& origin,
+                                     const std::vector<std::shared_ptr<BuiltinType>>& args)
+    : UDType("", origin.layout), origin(origin.name), args(args)
+{
+    full_name = std::string(origin.name) + "<";
+    for(size_t i = 0; i < args.size(); i++)
+    {
+        if(i > 0)
+            full_name += ", ";
+        full_name += args[i]->name;
+    }
+    full_name += ">";
+    name = full_name;
+}
+
+type::UDType::UDType(std::string_view name, StructLayout layout)
+    : BuiltinType(name), layout(layout)
+{
+}
 
 type::UDType::UDType(
     std::string_view name,
@@ -50,46 +204,84 @@ type::UDType::UDType(
     calculate_offsets();
 }
 
+// Scalars, vectors and atomics are aligned to their size, aggregates to their widest member
+size_t type::UDType::alignment_of(const BuiltinType& type)
+{
+    if(const auto* udtype = dynamic_cast<const UDType*>(&type))
+        return udtype->alignment > 0 ? udtype->alignment : 1;
+    if(const auto* array = dynamic_cast<const ArrayType*>(&type))
+        return alignment_of(*array->element);
+    return type.bytes > 0 ? type.bytes : 1;
+}
+
+// Every member starts on a multiple of its alignment and the size is padded to the widest
+// one, so consecutive elements of an array stay aligned as well
 void type::UDType::calculate_offsets()
 {
-    // find largest offset:
-    int total_offset = 0;
+    member_names.clear();
+    offsets.clear();
+    alignment = 1;
+    size_t total_offset = 0;
     for(const auto& [name, type] : members)
     {
         member_names.emplace_back(name);
-        const UDType* udtype = dynamic_cast<const UDType*>(type.get());
-        if(udtype)
-        {
-
-            alignment = udtype->alignment >= alignment ? alignment : udtype->alignment;
-            if(total_offset % alignment == 0)
-            {
-                offsets[name] = total_offset;
-            }
-            else
-            {
-                total_offset += alignment - (total_offset % alignment);
-                offsets[name] = total_offset;
-            }
-        }
-        else
-        {
-            alignment = type->bytes >= alignment ? alignment : type->bytes;
-            if(total_offset % type->bytes == 0)
-            {
-                offsets[name] = total_offset;
-            }
-            else
-            {
-                total_offset += type->bytes - (total_offset % type->bytes);
-                offsets[name] = total_offset;
-            }
-            total_offset += type->bytes;
-        }
+        const size_t member_alignment = alignment_of(*type);
+        if(total_offset % member_alignment != 0)
+            total_offset += member_alignment - (total_offset % member_alignment);
+        offsets[name] = total_offset;
+        total_offset += type->bytes;
+        alignment = std::max(alignment, member_alignment);
     }
+    if(total_offset % alignment != 0)
+        total_offset += alignment - (total_offset % alignment);
     bytes = total_offset;
 }
 
+bool type::UDType::is_soa() const
+{
+    return layout == StructLayout::SOA;
+}
+
+// Byte offset of the array holding `member` inside an SOA collection of `count` elements
+size_t type::UDType::column_offset(std::string_view member, size_t count) const
+{
+    size_t offset = 0;
+    for(const auto& [name, type] : members)
+    {
+        if(offset % SOA_COLUMN_ALIGNMENT != 0)
+            offset += SOA_COLUMN_ALIGNMENT - (offset % SOA_COLUMN_ALIGNMENT);
+        if(name == member)
+            return offset;
+        offset += type->bytes * count;
+    }
+    std::cerr << "Error: Type '" << this->name << "' has no member '" << member << "'."
+              << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+// Byte offset of `member` of element `index` in a collection of `count` elements
+size_t type::UDType::element_offset(std::string_view member, size_t index, size_t count) const
+{
+    if(is_soa())
+        return column_offset(member, count) + index * members.at(member)->bytes;
+    return index * bytes + offsets.at(member);
+}
+
+size_t type::UDType::collection_bytes(size_t count) const
+{
+    if(!is_soa())
+        return bytes * count;
+
+    size_t total = 0;
+    for(const auto& [name, type] : members)
+    {
+        if(total % SOA_COLUMN_ALIGNMENT != 0)
+            total += SOA_COLUMN_ALIGNMENT - (total % SOA_COLUMN_ALIGNMENT);
+        total += type->bytes * count;
+    }
+    return total;
+}
+
 type::TypeRegistry* type::TypeRegistry::instance_ = nullptr;
 std::mutex type::TypeRegistry::mutex_;
 
@@ -103,12 +295,12 @@ type::TypeRegistry& type::TypeRegistry::instance()
     return *instance_;
 }
 
-void type::TypeRegistry::declare_type(std::string_view name)
+void type::TypeRegistry::declare_type(std::string_view name, StructLayout layout)
 {
     struct temp : type::UDType {
-        temp(std::string_view name) : type::UDType(name) {}
+        temp(std::string_view name, StructLayout layout) : type::UDType(name, layout) {}
     };
-    typenames_[name.data()] = std::make_shared<temp>(name);
+    typenames_[name] = std::make_shared<temp>(name, layout);
 }
 
 std::shared_ptr<type::UDType> type::TypeRegistry::define_type(
@@ -138,12 +330,11 @@ bool type::TypeRegistry::unregister_type(const std::shared_ptr<UDType> type)
 
 bool type::TypeRegistry::unregister_type(std::string_view name)
 {
-    if(typenames_.count(name.data()) > 0)
-    {
-        typenames_.erase(name.data());
-        return true;
-    }
-    return false;
+    auto it = typenames_.find(name);
+    if(it == typenames_.end())
+        return false;
+    typenames_.erase(it);
+    return true;
 }
 
 std::shared_ptr<type::UDType> type::TypeRegistry::find_type(std::string_view name) const
@@ -152,28 +343,58 @@ std::shared_ptr<type::UDType> type::TypeRegistry::find_type(std::string_view nam
     if(builtin != undefined_)
         return std::static_pointer_cast<UDType>(builtin);
 
-    if(typenames_.count(name.data()) > 0)
+    auto it = typenames_.find(name);
+    if(it != typenames_.end())
     {
-        return typenames_.at(name.data());
+        return it->second;
     }
     return std::static_pointer_cast<UDType>(undefined_);
 }
 
 std::shared_ptr<type::BuiltinType> type::TypeRegistry::find_builtin(std::string_view name) const
 {
-    if(name == "int")
+    if(name == "int" || name == "i32")
         return int_;
     else if(name == "bool")
         return bool_;
+    else if(name == "i8")
+        return i8_;
+    else if(name == "i16")
+        return i16_;
+    else if(name == "i64")
+        return i64_;
+    else if(name == "u8")
+        return u8_;
+    else if(name == "u16")
+        return u16_;
+    else if(name == "u32")
+        return u32_;
+    else if(name == "u64")
+        return u64_;
+    else if(name == "float")
+        return float_;
+    else if(name == "double")
+        return double_;
     else if(name == "void")
         return void_;
-    else
-        return undefined_;
+
+    for(const auto& vector : vector_types_)
+    {
+        if(vector->name == name)
+            return vector;
+    }
+    for(const auto& atomic : atomic_types_)
+    {
+        if(atomic->name == name || (name == "atomic_i32" && atomic->element == int_))
+            return atomic;
+    }
+    return undefined_;
 }
 
 bool type::TypeRegistry::is_builtin(std::shared_ptr<BuiltinType> type) const
 {
-    return (type == int_ || type == bool_ || type == void_ || type == undefined_);
+    return (type == int_ || type == bool_ || type == void_ || type == undefined_ ||
+            type->is_arithmetic() || type->is_vector() || type->is_atomic());
 }
 
 std::shared_ptr<type::BuiltinType> type::TypeRegistry::_int_()
@@ -186,6 +407,56 @@ std::shared_ptr<type::BuiltinType> type::TypeRegistry::_bool_()
     return bool_;
 }
 
+std::shared_ptr<type::BuiltinType> type::TypeRegistry::_i8_()
+{
+    return i8_;
+}
+
+std::shared_ptr<type::BuiltinType> type::TypeRegistry::_i16_()
+{
+    return i16_;
+}
+
+std::shared_ptr<type::BuiltinType> type::TypeRegistry::_i32_()
+{
+    return int_;
+}
+
+std::shared_ptr<type::BuiltinType> type::TypeRegistry::_i64_()
+{
+    return i64_;
+}
+
+std::shared_ptr<type::BuiltinType> type::TypeRegistry::_u8_()
+{
+    return u8_;
+}
+
+std::shared_ptr<type::BuiltinType> type::TypeRegistry::_u16_()
+{
+    return u16_;
+}
+
+std::shared_ptr<type::BuiltinType> type::TypeRegistry::_u32_()
+{
+    return u32_;
+}
+
+std::shared_ptr<type::BuiltinType> type::TypeRegistry::_u64_()
+{
+    return u64_;
+}
+
+std::shared_ptr<type::BuiltinType> type::TypeRegistry::_float_()
+{
+    return float_;
+}
+
+std::shared_ptr<type::BuiltinType> type::TypeRegistry::_double_()
+{
+    return double_;
+}
+
 std::shared_ptr<type::BuiltinType> type::TypeRegistry::_void_()
 {
     return void_;
@@ -196,14 +467,225 @@ std::shared_ptr<type::BuiltinType> type::TypeRegistry::_undefined_()
     return undefined_;
 }
 
+std::vector<std::shared_ptr<type::BuiltinType>> type::TypeRegistry::integer_types() const
+{
+    return {i8_, i16_, int_, i64_, u8_, u16_, u32_, u64_};
+}
+
+std::vector<std::shared_ptr<type::BuiltinType>> type::TypeRegistry::floating_types() const
+{
+    return {float_, double_};
+}
+
+const std::vector<std::shared_ptr<type::VectorType>>& type::TypeRegistry::vector_types() const
+{
+    return vector_types_;
+}
+
+const std::vector<std::shared_ptr<type::AtomicType>>& type::TypeRegistry::atomic_types() const
+{
+    return atomic_types_;
+}
+
+// Array types are interned so every int[8] is the same type object
+std::shared_ptr<type::ArrayType>
+type::TypeRegistry::array_of(const std::shared_ptr<BuiltinType>& element, size_t length)
+{
+    auto key = std::make_pair(element->id, length);
+    auto it = array_types_.find(key);
+    if(it != array_types_.end())
+        return it->second;
+
+    struct temp : type::ArrayType {
+        temp(std::shared_ptr<BuiltinType> element, size_t length)
+            : type::ArrayType(element, length)
+        {
+        }
+    };
+    auto array = std::make_shared<temp>(element, length);
+    array_types_[key] = array;
+    return array;
+}
+
+bool type::TypeRegistry::declare_template(StructTemplate&& generic)
+{
+    if(templates_.contains(generic.name) || find_type(generic.name) != undefined_)
+        return false;
+    auto name = generic.name;
+    templates_.emplace(name, std::move(generic));
+    return true;
+}
+
+const type::StructTemplate* type::TypeRegistry::find_template(std::string_view name) const
+{
+    auto it = templates_.find(name);
+    if(it == templates_.end())
+        return nullptr;
+    return &it->second;
+}
+
+// Instances are cached by template and argument ids, so every Pair<int> in the program is the
+// same type, Pair<i32> included, and its layout is computed once. Undefined when the template
+// does not exist, the arguments do not fit or a member cannot be laid out
+std::shared_ptr<type::UDType>
+type::TypeRegistry::instantiate(std::string_view name,
+                                const std::vector<std::shared_ptr<BuiltinType>>& args)
+{
+    auto undefined = std::static_pointer_cast<UDType>(undefined_);
+    const auto* generic = find_template(name);
+    if(!generic || generic->params.size() != args.size())
+        return undefined;
+
+    InstanceKey key{generic->name, {}};
+    for(const auto& arg : args)
+    {
+        if(arg->bytes == 0)
+            return undefined;
+        key.second.push_back(arg->id);
+    }
+    auto it = instances_.find(key);
+    if(it != instances_.end())
+        return it->second;
+    if(instantiating_.contains(key))
+        return undefined;
+
+    Bindings bindings;
+    for(size_t i = 0; i < args.size(); i++) { bindings[generic->params[i]] = args[i]; }
+
+    instantiating_.insert(key);
+    std::map<std::string_view, std::shared_ptr<BuiltinType>, std::less<>> members;
+    bool valid = true;
+    for(const auto& [member, type_name] : generic->members)
+    {
+        auto type = resolve(type_name, bindings);
+        valid = valid && type != undefined_ && type->bytes > 0;
+        members[member] = type;
+    }
+    instantiating_.erase(key);
+    if(!valid)
+        return undefined;
+
+    struct temp : type::StructInstance {
+        temp(const StructTemplate& origin, const std::vector<std::shared_ptr<BuiltinType>>& args)
+            : type::StructInstance(origin, args)
+        {
+        }
+    };
+    auto instance = std::make_shared<temp>(*generic, args);
+    instance->members = std::move(members);
+    instance->calculate_offsets();
+    instances_[key] = instance;
+    return instance;
+}
+
+// Template parameters are replaced by their bindings, arguments are resolved before the
+// template that takes them
+std::shared_ptr<type::BuiltinType> type::TypeRegistry::resolve(const TypeName& type,
+                                                               const Bindings& bindings)
+{
+    if(type.args.empty())
+    {
+        auto bound = bindings.find(type.name);
+        if(bound != bindings.end())
+            return bound->second;
+        return find_type(type.name);
+    }
+    std::vector<std::shared_ptr<BuiltinType>> args;
+    for(const auto& arg : type.args) { args.push_back(resolve(arg, bindings)); }
+    return instantiate(type.name, args);
+}
+
+// Returns the type both operands are converted to before a binary operation.
+// Only lossless conversions are implicit: the narrower operand is sign or zero extended,
+// and mixing signedness is only allowed when the signed side is strictly wider.
+std::shared_ptr<type::BuiltinType> type::TypeRegistry::promote_integers(
+    const std::shared_ptr<BuiltinType>& lhs, const std::shared_ptr<BuiltinType>& rhs)
+{
+    if(!lhs->is_integer() || !rhs->is_integer())
+        return undefined_;
+    if(lhs == rhs)
+        return lhs;
+
+    if(lhs->is_signed() == rhs->is_signed())
+        return lhs->bytes >= rhs->bytes ? lhs : rhs;
+
+    auto& sign = lhs->is_signed() ? lhs : rhs;
+    auto& unsign = lhs->is_signed() ? rhs : lhs;
+    if(sign->bytes > unsign->bytes)
+        return sign;
+    return undefined_;
+}
+
+// Like promote_integers, but an integer mixed with a floating point type converts to the
+// floating point type, and float mixed with double converts to double
+std::shared_ptr<type::BuiltinType> type::TypeRegistry::promote_arithmetic(
+    const std::shared_ptr<BuiltinType>& lhs, const std::shared_ptr<BuiltinType>& rhs)
+{
+    if(!lhs->is_arithmetic() || !rhs->is_arithmetic())
+        return undefined_;
+    if(!lhs->is_floating() && !rhs->is_floating())
+        return promote_integers(lhs, rhs);
+    if(lhs->is_floating() && rhs->is_floating())
+        return lhs->bytes >= rhs->bytes ? lhs : rhs;
+    return lhs->is_floating() ? lhs : rhs;
+}
+
 type::TypeRegistry::TypeRegistry()
 {
     struct temp : type::BuiltinType {
         temp(std::string_view name, int bytes) : type::BuiltinType(name, bytes) {}
+        temp(std::string_view name, int bytes, TypeClass type_class)
+            : type::BuiltinType(name, bytes, type_class)
+        {
+        }
     };
     std::cout << "size of derived temp:gtype: " << sizeof(temp) << "\n";
-    int_ = std::make_shared<temp>("int", 4);
-    bool_ = std::make_shared<temp>("bool", 8);
+    int_ = std::make_shared<temp>("int", 4, TypeClass::SIGNED_INT);
+    bool_ = std::make_shared<temp>("bool", 1, TypeClass::BOOLEAN);
+    i8_ = std::make_shared<temp>("i8", 1, TypeClass::SIGNED_INT);
+    i16_ = std::make_shared<temp>("i16", 2, TypeClass::SIGNED_INT);
+    i64_ = std::make_shared<temp>("i64", 8, TypeClass::SIGNED_INT);
+    u8_ = std::make_shared<temp>("u8", 1, TypeClass::UNSIGNED_INT);
+    u16_ = std::make_shared<temp>("u16", 2, TypeClass::UNSIGNED_INT);
+    u32_ = std::make_shared<temp>("u32", 4, TypeClass::UNSIGNED_INT);
+    u64_ = std::make_shared<temp>("u64", 8, TypeClass::UNSIGNED_INT);
+    float_ = std::make_shared<temp>("float", 4, TypeClass::FLOATING);
+    double_ = std::make_shared<temp>("double", 8, TypeClass::FLOATING);
+
+    struct vector_temp : type::VectorType {
+        vector_temp(std::string_view name, std::shared_ptr<BuiltinType> element, size_t lanes)
+            : type::VectorType(name, element, lanes)
+        {
+        }
+    };
+    vector_types_ = {
+        std::make_shared<vector_temp>("i8x16", i8_, 16),
+        std::make_shared<vector_temp>("i16x8", i16_, 8),
+        std::make_shared<vector_temp>("i32x4", int_, 4),
+        std::make_shared<vector_temp>("i64x2", i64_, 2),
+        std::make_shared<vector_temp>("i8x32", i8_, 32),
+        std::make_shared<vector_temp>("i16x16", i16_, 16),
+        std::make_shared<vector_temp>("i32x8", int_, 8),
+        std::make_shared<vector_temp>("i64x4", i64_, 4),
+    };
+
+    struct atomic_temp : type::AtomicType {
+        atomic_temp(std::string_view name, std::shared_ptr<BuiltinType> element)
+            : type::AtomicType(name, element)
+        {
+        }
+    };
+    atomic_types_ = {
+        std::make_shared<atomic_temp>("atomic_bool", bool_),
+        std::make_shared<atomic_temp>("atomic_i8", i8_),
+        std::make_shared<atomic_temp>("atomic_i16", i16_),
+        std::make_shared<atomic_temp>("atomic_int", int_),
+        std::make_shared<atomic_temp>("atomic_i64", i64_),
+        std::make_shared<atomic_temp>("atomic_u8", u8_),
+        std::make_shared<atomic_temp>("atomic_u16", u16_),
+        std::make_shared<atomic_temp>("atomic_u32", u32_),
+        std::make_shared<atomic_temp>("atomic_u64", u64_),
+    };
     void_ = std::make_shared<temp>("void", 0);
     undefined_ = std::make_shared<temp>("undefined", 0);
 }
@@ -3,40 +3,128 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <optional>
+#include <set>
 #include <string>
 #include <vector>
 namespace type
 {
+    // AOS stores each instance contiguously, SOA stores a collection as one array per member
+    enum class StructLayout : char {
+        AOS,
+        SOA,
+    };
+
+    // Decides how values of a type are extended, compared and divided
+    enum class TypeClass : char {
+        NONE,
+        BOOLEAN,
+        SIGNED_INT,
+        UNSIGNED_INT,
+        FLOATING,
+        VECTOR,
+        ARRAY,
+        ATOMIC,
+    };
+
     struct BuiltinType {
 
         int ID();
         bool operator==(const std::shared_ptr<BuiltinType>& other) const;
         virtual ~BuiltinType() = default;
         bool is_compatible(const std::shared_ptr<BuiltinType>& other) const;
+        size_t size() const;
+        std::string_view get_name() const;
+        bool is_integer() const;
+        bool is_signed() const;
+        bool is_floating() const;
+        bool is_arithmetic() const;
+        bool is_vector() const;
+        bool is_array() const;
+        bool is_atomic() const;
+        bool can_represent(int64_t value) const;
+        // range of an integer type, nullopt when int64_t cannot hold the bound
+        std::optional<int64_t> min_value() const;
+        std::optional<int64_t> max_value() const;
 
       protected:
         BuiltinType(std::string_view name, int bytes);
+        BuiltinType(std::string_view name, int bytes, TypeClass type_class);
         BuiltinType(std::string_view name);
         std::string_view name;
         size_t bytes;
         size_t id;
+        TypeClass type_class = TypeClass::NONE;
         inline static int id_count = 0;
         friend class TypeRegistry;
         friend class UDType;
+        friend class VectorType;
+        friend class ArrayType;
+        friend class AtomicType;
+        friend class StructInstance;
+    };
+
+    // Fixed width SIMD vector of integer lanes, 16 bytes maps to SSE2 and 32 bytes to AVX2
+    struct VectorType : BuiltinType {
+        std::shared_ptr<BuiltinType> element;
+        size_t lanes;
+
+      protected:
+        VectorType(std::string_view name, std::shared_ptr<BuiltinType> element, size_t lanes);
+        friend class TypeRegistry;
+    };
+
+    // Fixed length array, elements of an SOA struct are laid out one member array at a time
+    struct ArrayType : BuiltinType {
+        std::shared_ptr<BuiltinType> element;
+        size_t length;
+
+        size_t element_offset(size_t index) const;
+
+        // Byte offset of `member` of element `index` of an array of structs, in either layout
+        size_t member_offset(size_t index, std::string_view member) const;
+
+      protected:
+        std::string full_name;
+        ArrayType(std::shared_ptr<BuiltinType> element, size_t length);
+        friend class TypeRegistry;
+    };
+
+    // Integer or bool that is only accessed through the atomic intrinsics, it has the size and
+    // alignment of its element so every access is a single naturally aligned instruction
+    struct AtomicType : BuiltinType {
+        std::shared_ptr<BuiltinType> element;
+
+      protected:
+        AtomicType(std::string_view name, std::shared_ptr<BuiltinType> element);
+        friend class TypeRegistry;
     };
 
     struct UDType : BuiltinType {
         std::vector<std::string_view> member_names;
         std::map<std::string_view, std::shared_ptr<BuiltinType>, std::less<>> members;
         std::map<std::string_view, int, std::less<>> offsets;
+        StructLayout layout = StructLayout::AOS;
+
+        bool is_soa() const;
+        size_t column_offset(std::string_view member, size_t count) const;
+        size_t element_offset(std::string_view member, size_t index, size_t count) const;
+        size_t collection_bytes(size_t count) const;
+
+        // SOA columns start on this boundary so field-wise loops can use aligned vector loads
+        static constexpr size_t SOA_COLUMN_ALIGNMENT = 32;
 
       protected:
         size_t alignment = 0;
+        static size_t alignment_of(const BuiltinType& type);
         UDType(std::string_view name);
+        UDType(std::string_view name, StructLayout layout);
         UDType(
             std::string_view name,
             std::map<std::string_view, std::shared_ptr<BuiltinType>, std::less<>>&& members);
@@ -44,10 +132,38 @@ namespace type
         friend class TypeRegistry;
     };
 
+    // A type as written in the source, Pair<int, Box<T>> has two arguments
+    struct TypeName {
+        std::string_view name;
+        std::vector<TypeName> args;
+    };
+
+    // struct Pair<T, U> { T first; U second; }, only its instances are types
+    struct StructTemplate {
+        std::string_view name;
+        std::vector<std::string_view> params;
+        std::vector<std::pair<std::string_view, TypeName>> members;
+        StructLayout layout = StructLayout::AOS;
+    };
+
+    // A struct template with concrete type arguments. There is one object per template and
+    // argument list, so code specialized for an instance can be keyed on its id
+    struct StructInstance : UDType {
+        std::string_view origin;
+        std::vector<std::shared_ptr<BuiltinType>> args;
+
+      protected:
+        std::string full_name;
+        StructInstance(const StructTemplate& origin,
+                       const std::vector<std::shared_ptr<BuiltinType>>& args);
+        friend class TypeRegistry;
+    };
+
     class TypeRegistry {
       public:
+        using Bindings = std::map<std::string_view, std::shared_ptr<BuiltinType>, std::less<>>;
         static TypeRegistry& instance();
-        void declare_type(std::string_view name);
+        void declare_type(std::string_view name, StructLayout layout = StructLayout::AOS);
         std::shared_ptr<UDType> define_type(
             std::string_view name,
             std::map<std::string_view, std::shared_ptr<BuiltinType>, std::less<>>&& members);
@@ -59,9 +175,34 @@ namespace type
         TypeRegistry& operator=(const TypeRegistry& other) = delete;
         std::shared_ptr<BuiltinType> _int_();
         std::shared_ptr<BuiltinType> _bool_();
+        std::shared_ptr<BuiltinType> _i8_();
+        std::shared_ptr<BuiltinType> _i16_();
+        std::shared_ptr<BuiltinType> _i32_();
+        std::shared_ptr<BuiltinType> _i64_();
+        std::shared_ptr<BuiltinType> _u8_();
+        std::shared_ptr<BuiltinType> _u16_();
+        std::shared_ptr<BuiltinType> _u32_();
+        std::shared_ptr<BuiltinType> _u64_();
+        std::shared_ptr<BuiltinType> _float_();
+        std::shared_ptr<BuiltinType> _double_();
         std::shared_ptr<BuiltinType> _void_();
         std::shared_ptr<BuiltinType> _undefined_();
-        
+        std::vector<std::shared_ptr<BuiltinType>> integer_types() const;
+        std::vector<std::shared_ptr<BuiltinType>> floating_types() const;
+        const std::vector<std::shared_ptr<VectorType>>& vector_types() const;
+        const std::vector<std::shared_ptr<AtomicType>>& atomic_types() const;
+        std::shared_ptr<ArrayType> array_of(const std::shared_ptr<BuiltinType>& element,
+                                            size_t length);
+        bool declare_template(StructTemplate&& generic);
+        const StructTemplate* find_template(std::string_view name) const;
+        std::shared_ptr<UDType> instantiate(std::string_view name,
+                                            const std::vector<std::shared_ptr<BuiltinType>>& args);
+        std::shared_ptr<BuiltinType> resolve(const TypeName& type, const Bindings& bindings = {});
+        std::shared_ptr<BuiltinType> promote_integers(const std::shared_ptr<BuiltinType>& lhs,
+                                                      const std::shared_ptr<BuiltinType>& rhs);
+        std::shared_ptr<BuiltinType> promote_arithmetic(const std::shared_ptr<BuiltinType>& lhs,
+                                                        const std::shared_ptr<BuiltinType>& rhs);
+
         private:
         static TypeRegistry* instance_;
         TypeRegistry();
@@ -69,6 +210,22 @@ namespace type
         std::map<std::string_view, std::shared_ptr<UDType>, std::less<>> typenames_;
         std::shared_ptr<BuiltinType> int_;
         std::shared_ptr<BuiltinType> bool_;
+        std::shared_ptr<BuiltinType> i8_;
+        std::shared_ptr<BuiltinType> i16_;
+        std::shared_ptr<BuiltinType> i64_;
+        std::shared_ptr<BuiltinType> u8_;
+        std::shared_ptr<BuiltinType> u16_;
+        std::shared_ptr<BuiltinType> u32_;
+        std::shared_ptr<BuiltinType> u64_;
+        std::shared_ptr<BuiltinType> float_;
+        std::shared_ptr<BuiltinType> double_;
+        std::vector<std::shared_ptr<VectorType>> vector_types_;
+        std::vector<std::shared_ptr<AtomicType>> atomic_types_;
+        std::map<std::pair<size_t, size_t>, std::shared_ptr<ArrayType>> array_types_;
+        using InstanceKey = std::pair<std::string_view, std::vector<size_t>>;
+        std::map<std::string_view, StructTemplate, std::less<>> templates_;
+        std::map<InstanceKey, std::shared_ptr<StructInstance>> instances_;
+        std::set<InstanceKey> instantiating_; // a struct cannot contain itself by value
         std::shared_ptr<BuiltinType> void_;
         std::shared_ptr<BuiltinType> undefined_;
         static std::mutex mutex_;
@@ -0,0 +1,161 @@
+#define _POSIX_C_SOURCE 200809L
+#include "parallel.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Runs the thread pool directly, ctest starts it with REND_THREADS=4
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                           \
+    do                                                                                             \
+    {                                                                                              \
+        if(!(cond))                                                                                \
+        {                                                                                          \
+            fprintf(stderr, __VA_ARGS__);                                                          \
+            fprintf(stderr, "\n");                                                                 \
+            failures++;                                                                            \
+        }                                                                                          \
+    } while(0)
+
+#define MAX_COUNT 100000
+
+// every iteration counts how often it ran and which thread ran it
+typedef struct {
+    _Atomic int runs[MAX_COUNT];
+    pthread_t ran_on[MAX_COUNT];
+    int64_t slow_below; // iterations below it sleep
+} visits;
+
+static int64_t value_of(int64_t i)
+{
+    return i * 2654435761 + 7;
+}
+
+static void reduce_body(int64_t begin, int64_t end, void* context, int64_t* partials)
+{
+    visits* seen = context;
+    for(int64_t i = begin; i < end; i++)
+    {
+        atomic_fetch_add(&seen->runs[i], 1);
+        seen->ran_on[i] = pthread_self();
+        if(i < seen->slow_below)
+            nanosleep(&(struct timespec){0, 200000}, NULL);
+        int64_t value = value_of(i);
+        partials[0] = (int64_t)((uint64_t)partials[0] + (uint64_t)value);
+        partials[1] = (int64_t)((uint64_t)partials[1] * (uint64_t)(value | 1));
+        partials[2] &= value | (int64_t)((uint64_t)1 << (i % 64));
+        partials[3] |= (int64_t)1 << (i % 61);
+        partials[4] ^= value;
+    }
+}
+
+static const rend_reduce_op ops[] = {
+    REND_REDUCE_ADD, REND_REDUCE_MUL, REND_REDUCE_AND, REND_REDUCE_OR, REND_REDUCE_XOR,
+};
+
+// Runs [0, count) on the pool and checks every iteration ran once and every reduction has the
+// value a serial loop gives
+static void run_reductions(const char* name, int64_t count, int64_t slow_below, visits* seen)
+{
+    for(int64_t i = 0; i < count; i++) { atomic_store(&seen->runs[i], 0); }
+    seen->slow_below = slow_below;
+
+    int64_t initial[5] = {5, 3, -1, 0, 11};
+    int64_t expected[5] = {5, 3, -1, 0, 11};
+    int64_t serial[5] = {0, 1, -1, 0, 0};
+    visits* scratch = calloc(1, sizeof(visits));
+    reduce_body(0, count, scratch, serial);
+    free(scratch);
+    expected[0] = (int64_t)((uint64_t)expected[0] + (uint64_t)serial[0]);
+    expected[1] = (int64_t)((uint64_t)expected[1] * (uint64_t)serial[1]);
+    expected[2] &= serial[2];
+    expected[3] |= serial[3];
+    expected[4] ^= serial[4];
+
+    int64_t results[5];
+    for(int r = 0; r < 5; r++) { results[r] = initial[r]; }
+    rend_parallel_for(count, reduce_body, seen, ops, results, 5);
+
+    for(int64_t i = 0; i < count; i++)
+    {
+        int runs = atomic_load(&seen->runs[i]);
+        CHECK(runs == 1, "%s: iteration %lld ran %d times", name, (long long)i, runs);
+    }
+    for(int r = 0; r < 5; r++)
+    {
+        CHECK(results[r] == expected[r], "%s: reduction %d is %lld, expected %lld", name, r,
+              (long long)results[r], (long long)expected[r]);
+    }
+}
+
+typedef struct {
+    _Atomic int64_t sum;
+    _Atomic int off_thread; // inner iterations run on another thread than their outer one
+} nested;
+
+static void inner_body(int64_t begin, int64_t end, void* context, int64_t* partials)
+{
+    pthread_t* outer = context;
+    for(int64_t i = begin; i < end; i++) { partials[0] += i; }
+    if(!pthread_equal(*outer, pthread_self()))
+        partials[1] = 1;
+}
+
+static void outer_body(int64_t begin, int64_t end, void* context, int64_t* partials)
+{
+    nested* state = context;
+    (void)partials;
+    for(int64_t i = begin; i < end; i++)
+    {
+        pthread_t self = pthread_self();
+        rend_reduce_op inner_ops[] = {REND_REDUCE_ADD, REND_REDUCE_OR};
+        int64_t inner[2] = {0, 0};
+        rend_parallel_for(100, inner_body, &self, inner_ops, inner, 2);
+        atomic_fetch_add(&state->sum, inner[0]);
+        if(inner[1])
+            atomic_store(&state->off_thread, 1);
+    }
+}
+
+int main(void)
+{
+    size_t threads = rend_thread_count();
+    CHECK(threads > 1, "the pool has %zu threads, run with REND_THREADS > 1", threads);
+
+    visits* seen = calloc(1, sizeof(visits));
+    run_reductions("even split", MAX_COUNT, 0, seen);
+    run_reductions("fewer iterations than threads", (int64_t)threads - 1, 0, seen);
+    run_reductions("one iteration", 1, 0, seen);
+
+    // the caller's share is slow, the other threads run out of work and steal from it
+    const int64_t count = 4000;
+    const int64_t share = count / (int64_t)threads;
+    run_reductions("uneven split", count, share, seen);
+    int stolen = 0;
+    for(int64_t i = 0; i < share; i++)
+    {
+        stolen += !pthread_equal(seen->ran_on[i], pthread_self());
+    }
+    CHECK(stolen > 0, "uneven split: no iteration of the caller's share was stolen");
+    free(seen);
+
+    int64_t untouched = 42;
+    rend_reduce_op add = REND_REDUCE_ADD;
+    rend_parallel_for(0, reduce_body, NULL, &add, &untouched, 1);
+    CHECK(untouched == 42, "an empty loop changed its reduction to %lld", (long long)untouched);
+
+    // a loop inside a chunk runs serially on the thread that reaches it
+    nested state = {0, 0};
+    rend_parallel_for(64, outer_body, &state, NULL, NULL, 0);
+    CHECK(atomic_load(&state.sum) == 64 * 4950, "nested: sum is %lld, expected %d",
+          (long long)atomic_load(&state.sum), 64 * 4950);
+    CHECK(!atomic_load(&state.off_thread), "nested: an inner loop ran on another thread");
+
+    if(failures == 0)
+        printf("parallel runtime passed on %zu threads\n", threads);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
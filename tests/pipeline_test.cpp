@@ -0,0 +1,893 @@
+#include "ast_builder.hpp"
+#include "bounds_check.hpp"
+#include "calls.hpp"
+#include "const_prop.hpp"
+#include "dead_code.hpp"
+#include "gvn.hpp"
+#include "if_convert.hpp"
+#include "ir_lower.hpp"
+#include "lexer.hpp"
+#include "licm.hpp"
+#include "loop_unroll.hpp"
+#include "mem2reg.hpp"
+#include "parser.hpp"
+#include "reassociate.hpp"
+#include "scalar_replace.hpp"
+#include "semantics.hpp"
+#include "strength_reduce.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+// Runs sample programs through the front end, the AST passes, the lowering and the IR passes,
+// and interprets the IR. Each program has to give the result worked out by hand with and without
+// the passes, and the passes have to report the work the program was written to give them
+
+struct Trap : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// Integer and bool IR only, memory is one byte array addressed by offsets
+class Interpreter {
+  public:
+    Interpreter(ir::Module& module) : module_(module) {}
+
+    uint64_t call(uint32_t index, const std::vector<uint64_t>& args)
+    {
+        auto& function = module_.functions.at(index);
+        std::vector<uint64_t> values(function.insts.size(), 0);
+        ir::Block block = 0;
+        ir::Block from = ir::NONE;
+        while(true)
+        {
+            auto& insts = function.blocks[block].insts;
+            // the phis of a block take their values at once
+            std::vector<std::pair<ir::Value, uint64_t>> incoming;
+            for(auto value : insts)
+            {
+                if(function.insts[value].op != ir::Opcode::PHI)
+                    continue;
+                auto pairs = function.list(value);
+                size_t i = 0;
+                while(i < pairs.size() && pairs[i] != from) { i += 2; }
+                if(i == pairs.size())
+                    throw Trap("phi without a value from its predecessor");
+                incoming.emplace_back(value, values[pairs[i + 1]]);
+            }
+            for(auto [phi, value] : incoming) { values[phi] = value; }
+
+            std::optional<ir::Block> next;
+            for(auto value : insts)
+            {
+                if(++steps_ > MAX_STEPS)
+                    throw Trap("step limit");
+                auto& inst = function.insts[value];
+                if(ir::is_terminator(inst.op))
+                {
+                    if(inst.op == ir::Opcode::RET)
+                        return inst.a == ir::NONE ? 0 : values[inst.a];
+                    next = target(function, value, values);
+                    break;
+                }
+                if(inst.op == ir::Opcode::PARAM)
+                    values[value] = args.at(inst.c);
+                else if(inst.op != ir::Opcode::PHI)
+                    values[value] = execute(function, value, values);
+            }
+            if(!next)
+                throw Trap("block without a terminator");
+            from = block;
+            block = *next;
+        }
+    }
+
+  private:
+    static constexpr size_t MAX_STEPS = 10'000'000;
+
+    ir::Module& module_;
+    std::vector<uint8_t> memory_;
+    size_t steps_ = 0;
+
+    static uint64_t mask(const type::BuiltinType& type)
+    {
+        return type.size() >= 8 ? ~0ull : (1ull << (type.size() * 8)) - 1;
+    }
+
+    // The value as the type holds it, sign extended for signed types
+    static uint64_t wrap(uint64_t value, const type::BuiltinType& type)
+    {
+        if(type.size() >= 8)
+            return value;
+        value &= mask(type);
+        if(type.is_signed() && (value >> (type.size() * 8 - 1)) & 1)
+            value |= ~mask(type);
+        return value;
+    }
+
+    static bool compare(ir::Opcode op, uint64_t a, uint64_t b, const type::BuiltinType& type)
+    {
+        if(type.is_signed())
+        {
+            auto x = static_cast<int64_t>(wrap(a, type));
+            auto y = static_cast<int64_t>(wrap(b, type));
+            return op == ir::Opcode::EQ   ? x == y
+                   : op == ir::Opcode::NE ? x != y
+                   : op == ir::Opcode::LT ? x < y
+                   : op == ir::Opcode::LE ? x <= y
+                   : op == ir::Opcode::GT ? x > y
+                                          : x >= y;
+        }
+        a &= mask(type);
+        b &= mask(type);
+        return op == ir::Opcode::EQ   ? a == b
+               : op == ir::Opcode::NE ? a != b
+               : op == ir::Opcode::LT ? a < b
+               : op == ir::Opcode::LE ? a <= b
+               : op == ir::Opcode::GT ? a > b
+                                      : a >= b;
+    }
+
+    // An access outside of every alloca is a miscompilation, not a trap of the program
+    uint8_t* at(uint64_t address, size_t size)
+    {
+        if(address + size > memory_.size())
+            throw std::out_of_range("access outside of memory at " + std::to_string(address));
+        return &memory_[address];
+    }
+
+    uint64_t execute(ir::Function& function, ir::Value value, std::vector<uint64_t>& values)
+    {
+        auto& inst = function.insts[value];
+        auto& type = *function.types[inst.type];
+        const uint64_t a = inst.a < values.size() ? values[inst.a] : 0;
+        const uint64_t b = inst.b < values.size() ? values[inst.b] : 0;
+        const size_t bits = type.size() * 8;
+        switch(inst.op)
+        {
+        case ir::Opcode::CONST:
+            return static_cast<uint64_t>(function.constant(value));
+        case ir::Opcode::ADD:
+            return wrap(a + b, type);
+        case ir::Opcode::SUB:
+            return wrap(a - b, type);
+        case ir::Opcode::MUL:
+            return wrap(a * b, type);
+        case ir::Opcode::MULHI:
+        {
+            if(type.is_signed())
+            {
+                auto product = static_cast<__int128>(static_cast<int64_t>(wrap(a, type))) *
+                               static_cast<int64_t>(wrap(b, type));
+                return wrap(static_cast<uint64_t>(product >> bits), type);
+            }
+            auto product = static_cast<unsigned __int128>(a & mask(type)) * (b & mask(type));
+            return wrap(static_cast<uint64_t>(product >> bits), type);
+        }
+        case ir::Opcode::DIV:
+        case ir::Opcode::MOD:
+        {
+            if((b & mask(type)) == 0)
+                throw Trap("division by zero");
+            const bool div = inst.op == ir::Opcode::DIV;
+            if(type.is_signed())
+            {
+                auto x = static_cast<int64_t>(wrap(a, type));
+                auto y = static_cast<int64_t>(wrap(b, type));
+                if(y == -1)
+                    return div ? wrap(0 - static_cast<uint64_t>(x), type) : 0;
+                return wrap(static_cast<uint64_t>(div ? x / y : x % y), type);
+            }
+            return div ? (a & mask(type)) / (b & mask(type)) : (a & mask(type)) % (b & mask(type));
+        }
+        case ir::Opcode::SHL:
+            return wrap(a << (b & (bits == 64 ? 63 : 31)), type);
+        case ir::Opcode::SHR:
+        {
+            auto count = b & (bits == 64 ? 63 : 31);
+            if(type.is_signed())
+                return wrap(static_cast<uint64_t>(static_cast<int64_t>(wrap(a, type)) >> count),
+                            type);
+            return wrap((a & mask(type)) >> count, type);
+        }
+        case ir::Opcode::AND:
+            return a & b;
+        case ir::Opcode::OR:
+            return a | b;
+        case ir::Opcode::XOR:
+            return a ^ b;
+        case ir::Opcode::NOT:
+            return type.is_integer() ? wrap(~a, type) : !a;
+        case ir::Opcode::EQ:
+        case ir::Opcode::NE:
+        case ir::Opcode::LT:
+        case ir::Opcode::LE:
+        case ir::Opcode::GT:
+        case ir::Opcode::GE:
+            return compare(inst.op, a, b, *function.type_of(inst.a));
+        case ir::Opcode::CONVERT:
+        {
+            auto& from = *function.type_of(inst.a);
+            auto extended = from.is_signed() ? wrap(a, from) : a & mask(from);
+            return type.is_integer() ? wrap(extended, type) : extended != 0;
+        }
+        case ir::Opcode::SELECT:
+            return a ? b : values[inst.c];
+        case ir::Opcode::ALLOCA:
+        {
+            auto address = memory_.size();
+            memory_.resize(address + std::max<size_t>(type.size(), 8) + 8);
+            return address;
+        }
+        case ir::Opcode::LOAD:
+        {
+            uint64_t loaded = 0;
+            std::memcpy(&loaded, at(a, type.size()), std::min<size_t>(type.size(), 8));
+            return wrap(loaded, type);
+        }
+        case ir::Opcode::STORE:
+        {
+            auto size = std::min<size_t>(function.type_of(inst.b)->size(), 8);
+            std::memcpy(at(a, size), &b, size);
+            return 0;
+        }
+        case ir::Opcode::ELEMENT:
+            return a + static_cast<int64_t>(b) * type.size();
+        case ir::Opcode::BOUNDS_CHECK:
+            if(a >= inst.c)
+                throw Trap("index out of bounds");
+            return 0;
+        case ir::Opcode::CALL:
+        {
+            auto list = function.list(value);
+            std::vector<uint64_t> args;
+            for(auto arg : list) { args.push_back(values[arg]); }
+            return call(inst.c, args);
+        }
+        default:
+            return 0;
+        }
+    }
+
+    ir::Block target(ir::Function& function, ir::Value value, std::vector<uint64_t>& values)
+    {
+        auto& inst = function.insts[value];
+        if(inst.op == ir::Opcode::BR)
+            return inst.a;
+        if(inst.op == ir::Opcode::CONDBR)
+            return values[inst.a] ? inst.b : inst.c;
+        return function.list(value)[values[inst.c]];
+    }
+};
+
+// What the passes of the full pipeline report, summed over the functions
+struct Counts {
+    std::optional<size_t> removed_branches;   // ConstantPropagator
+    std::optional<size_t> removed_statements; // DeadCodeEliminator
+    std::optional<size_t> hoisted;            // LoopInvariantMotion
+    std::optional<size_t> reassociated;       // Reassociator
+    std::optional<size_t> unrolled_loops;     // LoopUnroller
+    std::optional<size_t> removed_checks;     // BoundsCheckEliminator
+    std::optional<size_t> removed_guards;
+    std::optional<size_t> split;              // ScalarReplacement
+    std::optional<size_t> promoted;           // Mem2Reg
+    std::optional<size_t> numbered;           // GlobalValueNumbering
+    std::optional<size_t> reduced;            // StrengthReduction
+    std::optional<size_t> converted;          // IfConversion
+};
+
+static const std::pair<std::string_view, std::optional<size_t> Counts::*> counters[] = {
+    {"removed_branches", &Counts::removed_branches},
+    {"removed_statements", &Counts::removed_statements},
+    {"hoisted", &Counts::hoisted},
+    {"reassociated", &Counts::reassociated},
+    {"unrolled_loops", &Counts::unrolled_loops},
+    {"removed_checks", &Counts::removed_checks},
+    {"removed_guards", &Counts::removed_guards},
+    {"split", &Counts::split},
+    {"promoted", &Counts::promoted},
+    {"numbered", &Counts::numbered},
+    {"reduced", &Counts::reduced},
+    {"converted", &Counts::converted},
+};
+
+using Opcodes = std::map<ir::Opcode, size_t>;
+
+struct Sample {
+    std::string_view name;
+    std::string_view source;
+    std::optional<int64_t> result; // nullopt when it traps
+    Counts counts = {};            // only the counters given are checked
+    Opcodes lowered = {};          // instructions in the blocks right after the lowering
+};
+
+// Regression cases first, each one failed at some point
+static const Sample samples[] = {
+    // a for loop whose condition is too long to duplicate is entered at its test, not its step
+    {"for_expensive_condition",
+     R"(int f(int n) {
+    int x = 0;
+    for(int i = 0; (i != (((n * 3) + n) / (n + 1))); i = i + 1) {
+        x = x + 1;
+    }
+    return x;
+}
+return (f(0) * 10) + f(2);
+)",
+     2},
+    // a division guarded by its divisor stays behind the guard
+    {"licm_guarded_division",
+     R"(int f(int d, int a, int n) {
+    int x = 0;
+    int j = 0;
+    while(j < n) {
+        if(d > 0) {
+            x = x + (a / d);
+        }
+        j = j + 1;
+    }
+    return x;
+}
+return f(0, 5, 3) + f(2, 5, 3);
+)",
+     6},
+    // as does an index that is only in range under the guard
+    {"licm_guarded_index",
+     R"(int g(int i, int n) {
+    int[8] arr;
+    arr[0] = 1;
+    int x = 0;
+    int j = 0;
+    while(j < n) {
+        if(i >= 0) {
+            if(i < 8) {
+                x = x + (arr[i] * 2);
+            }
+        }
+        j = j + 1;
+    }
+    return x;
+}
+return g(1000000, 3) + g(0, 3);
+)",
+     6},
+    // the shift count is masked, x >> 33 on an int is x >> 1 and out of range here. Only the
+    // check of arr[0] goes
+    {"bounds_check_shift",
+     R"(int f(int x) {
+    int[8] arr;
+    arr[0] = 1;
+    return arr[((x & 2147483647) >> 33)];
+}
+return f(2147483647);
+)",
+     std::nullopt,
+     {.removed_checks = 1}},
+    // a nested or parenthesized index is an assignment to an element, not a declaration
+    {"parser_element_assignment",
+     R"(int f(int v, int x) {
+    int[8] arr;
+    int[8] b;
+    int i = 1;
+    b[i] = 4;
+    b[(v & 7)] = 6;
+    arr[b[i]] = 3;
+    arr[((v & 7))] = x;
+    arr[((v + 3) & 7)] = 9;
+    return ((arr[4] + arr[5]) + arr[0]) + b[5];
+}
+return f(5, 2);
+)",
+     20},
+    {"u64_literals",
+     R"(int f(u64 k) {
+    u64 a = 18446744073709551615;
+    u64 b = 9223372036854775808;
+    u64 c = (a - b) + k;
+    int r = 0;
+    if(c == 9223372036854775808) { r = 1; }
+    if(b > 5) { r = r + 2; }
+    return r;
+}
+return f(1);
+)",
+     3},
+    {"loops_and_calls",
+     R"(int sum(int n) {
+    int s = 0;
+    for(int i = 1; (i <= n); i = i + 1) {
+        if((i % 3) == 0) { s = s + i; }
+        else { s = s - 1; }
+    }
+    return s;
+}
+int clamp(int v, int lo, int hi) {
+    int r = v;
+    if(v < lo) { r = lo; }
+    if(v > hi) { r = hi; }
+    return r;
+}
+return (sum(10) + clamp(50, 0, 20)) + clamp(0 - 4, 0, 20);
+)",
+     31},
+    {"array_sum",
+     R"(int f(int k) {
+    int[16] arr;
+    for(int i = 0; (i < 16); i = i + 1) {
+        arr[i] = (i * k) / 4;
+    }
+    int s = 0;
+    for(int i = 0; (i < 16); i = i + 1) {
+        s = s + arr[i];
+    }
+    return s;
+}
+return f(3);
+)",
+     84},
+    // a for loop is a scope, the next one can declare the same counter with another type
+    {"for_sequential_counters",
+     R"(int f(int n) {
+    int s = 0;
+    for(int i = 0; (i < 3); i = i + 1) {
+        int t = i * 2;
+        s = s + t;
+    }
+    for(u8 i = 250; (i != 4); i = i + 1) {
+        i64 t = 1;
+        s = s + 100;
+    }
+    for(int i = n; (i > 0); i = i - 1) {
+        s = s + i;
+    }
+    return s;
+}
+return f(4);
+)",
+     1016},
+    // the length of an array local to a function is not the length of the one outside, the two
+    // checks of a[50] in f go and the two on the outer a stay
+    {"bounds_check_function_local_array",
+     R"(int[4] a;
+int f() {
+    int[100] a;
+    a[50] = 1;
+    return a[50];
+}
+int i = 50;
+a[i] = 7;
+return a[i];
+)",
+     std::nullopt,
+     {.removed_checks = 2}},
+    // only the check of a[0] goes
+    {"bounds_check_function_local_array_loop",
+     R"(int[4] a;
+int f(int k) {
+    int[100] a;
+    a[k] = 1;
+    return a[k];
+}
+int i = 0;
+while(i < 50) {
+    a[i] = 7;
+    i = i + 1;
+}
+return a[0];
+)",
+     std::nullopt,
+     {.removed_checks = 1}},
+    // i stays in [0, 8) in the loop so the store loses its check, k is not known and keeps it
+    {"bounds_check_loop_index",
+     R"(int f(int k) {
+    int[8] arr;
+    int i = 0;
+    while(i < 8) {
+        arr[i] = i * i;
+        i = i + 1;
+    }
+    return arr[k];
+}
+return f(3) + f(7);
+)",
+     58,
+     {.removed_checks = 1},
+     {{ir::Opcode::BOUNDS_CHECK, 2}}},
+    // five and seven constant iterations are unrolled completely, n iterations by four with
+    // the rest left to a remainder loop, which f(2) runs alone
+    {"for_unroll",
+     R"(int f(int n) {
+    int s = 0;
+    for(int i = 0; (i < 5); i = i + 1) {
+        s = s + (i * 10);
+    }
+    for(int i = 0; (i < n); i = i + 1) {
+        s = s + i;
+    }
+    for(int i = 20; (i > 0); i = i - 3) {
+        s = s + 1000;
+    }
+    return s;
+}
+return f(7) + f(2);
+)",
+     14222,
+     {.unrolled_loops = 3}},
+    // m folds to 42 and y is a copy of x, so both conditions are constant and one side of each
+    // branch goes
+    {"constant_branches",
+     R"(int f(int x) {
+    int k = 6;
+    int m = k * 7;
+    int y = x;
+    int r = 0;
+    if(m == 42) { r = y + m; }
+    else { r = 0 - 1; }
+    if(k > 10) { r = r * 100; }
+    return r;
+}
+return f(8);
+)",
+     50,
+     {.removed_branches = 2}},
+    // constant propagation already drops the loop that never runs, dead code elimination the
+    // unused variable and the store after the return
+    {"dead_code",
+     R"(int f(int x) {
+    int unused = x * 3;
+    int r = x + 1;
+    r = r * 2;
+    while(false) { r = 0; }
+    return r;
+    r = 5;
+}
+return f(4);
+)",
+     10,
+     {.removed_branches = 1, .removed_statements = 2}},
+    // t depends on the parameters only and moves in front of the loop
+    {"licm_invariant",
+     R"(int f(int a, int b, int n) {
+    int s = 0;
+    int j = 0;
+    while(j < n) {
+        int t = (a * b) + 3;
+        s = s + (t * j);
+        j = j + 1;
+    }
+    return s;
+}
+return f(2, 5, 4) + f(2, 5, 0);
+)",
+     78,
+     {.hoisted = 1}},
+    // rotated loops test at the bottom and every body jumps to its test. The cheap test of the
+    // first loop is also copied into a guard in front of it, the test of the second one calls
+    // lim and the loop is entered by a jump to it instead
+    {"loop_rotation",
+     R"(int lim(int n) {
+    return n;
+}
+int f(int n) {
+    int s = 0;
+    int i = 0;
+    while(i < n) {
+        s = s + i;
+        i = i + 1;
+    }
+    int j = 0;
+    while(j < lim(n)) {
+        s = s + 10;
+        j = j + 1;
+    }
+    return s;
+}
+return f(4) + f(0);
+)",
+     46,
+     {},
+     {{ir::Opcode::CONDBR, 3}, {ir::Opcode::BR, 3}}},
+    // the branch computes (a + b) * 2 again, the block in front of it dominates it and already
+    // has the constant, the sum and the product. The second 0 in f and 4 in the top level are
+    // the other two
+    {"gvn_dominated",
+     R"(int f(int a, int b) {
+    int x = (a + b) * 2;
+    int y = 0;
+    if(a > 0) { y = (a + b) * 2; }
+    return x + y;
+}
+return f(3, 4) + f(0 - 1, 4);
+)",
+     34,
+     {.numbered = 5}},
+    // d is in [1, 8] and s in [0, 15], the division cannot divide by zero and the shift count
+    // is below the width, so neither keeps its guard. x can be 0 and 50 / x keeps it
+    {"range_guards",
+     R"(int f(int x) {
+    int d = (x & 7) + 1;
+    int s = x & 15;
+    return ((100 / d) + (1 << s)) + (50 / x);
+}
+return f(10);
+)",
+     1062,
+     {.removed_guards = 2}},
+    // the multiplication becomes a shift and an add, the divisions a shift and a multiplication
+    // by a magic number and the modulo one as well, each rounding toward zero for x = -53
+    {"strength_reduction",
+     R"(int f(int x) {
+    return (((x * 9) + (x / 8)) + (x / 7)) + (x % 10);
+}
+return f(0 - 53) + f(1000);
+)",
+     8774,
+     {.reduced = 4}},
+    // three chains are rebuilt as balanced trees, the literals of the product fold into 6
+    {"reassociation",
+     R"(int f(int a, int b, int c, int d) {
+    int s = a + b + c + d + 5;
+    int p = a * 2 * b * 3;
+    int x = a ^ b ^ c ^ d;
+    return (s + p) + x;
+}
+return f(1, 2, 3, 4);
+)",
+     31,
+     {.reassociated = 3}},
+    // the values 1 to 6 are dense and dispatched by one jump table, the six sparse ones by a
+    // binary search, one less than and three equality tests on each side
+    {"switch_lowering",
+     R"(int dense(int x) {
+    int r = 0;
+    if(x == 1) { r = 10; }
+    else if(x == 2) { r = 20; }
+    else if((x == 3) || (x == 4)) { r = 30; }
+    else if(x == 6) { r = 60; }
+    else { r = 0 - 1; }
+    return r;
+}
+int sparse(int x) {
+    int r = 0;
+    if(x == 5) { r = 1; }
+    else if(x == 100) { r = 2; }
+    else if(x == 1000) { r = 3; }
+    else if(x == 20000) { r = 4; }
+    else if(x == 300000) { r = 5; }
+    else if(x == 4000000) { r = 6; }
+    return r;
+}
+int d = (((dense(1) + dense(2)) + (dense(4) + dense(5))) + dense(6)) + dense(9);
+int s = ((sparse(100) + sparse(20000)) + (sparse(7) + sparse(4000000))) + (sparse(1000) * 10);
+return (d * 1000) + s;
+)",
+     118042,
+     {},
+     {{ir::Opcode::SWITCH, 1}, {ir::Opcode::LT, 1}, {ir::Opcode::EQ, 6}}},
+    // the max and the clamp become selects, the division may trap and stays behind its branch
+    {"if_conversion",
+     R"(int f(int a, int b) {
+    int m = 0;
+    if(a > b) { m = a; }
+    else { m = b; }
+    int c = m;
+    if(c > 100) { c = 100; }
+    int q = 0;
+    if(b != 0) { q = a / b; }
+    return (c * 1000) + q;
+}
+return f(7, 3) + f(500, 0);
+)",
+     107002,
+     {.converted = 2}},
+    // each operand of && and || gets its own branch and no and or or is computed, the divisions
+    // only run when the left side does not decide, f(0, 9) divides by zero otherwise
+    {"short_circuit",
+     R"(int f(int d, int k) {
+    int r = 0;
+    if((d != 0) && ((10 / d) > 1)) { r = 1; }
+    if((k > 5) || ((100 / d) > 1)) { r = r + 10; }
+    return r;
+}
+return (f(0, 9) + f(2, 0)) + (f(20, 0) * 100);
+)",
+     1021,
+     {},
+     {{ir::Opcode::CONDBR, 4}, {ir::Opcode::AND, 0}, {ir::Opcode::OR, 0}}},
+    // v is only used at constant indexes and split into scalars, w is read at k and stays in
+    // memory
+    {"scalar_replacement",
+     R"(int f(int x, int k) {
+    int[4] v;
+    v[0] = x;
+    v[1] = x * 2;
+    v[3] = v[0] + v[1];
+    int[4] w;
+    w[0] = 1;
+    w[1] = 2;
+    w[2] = 3;
+    w[3] = 4;
+    return v[3] + w[k];
+}
+return f(5, 2);
+)",
+     18,
+     {.split = 1}},
+};
+
+// CHECKS_FIRST removes bounds checks before the loop passes see the indexes as well
+enum class Pipeline { NONE, ALL, CHECKS_FIRST };
+
+struct Outcome {
+    std::optional<int64_t> result;
+    Counts counts;
+    Opcodes opcodes;
+};
+
+static Opcodes count_opcodes(const ir::Module& module)
+{
+    Opcodes opcodes;
+    for(auto& function : module.functions)
+    {
+        for(auto& block : function.blocks)
+        {
+            for(auto value : block.insts) { opcodes[function.insts[value].op]++; }
+        }
+    }
+    return opcodes;
+}
+
+static Outcome run(const Sample& sample, Pipeline pipeline)
+{
+    Lexer lexer(sample.source);
+    std::vector<Token> tokens;
+    for(Token token = lexer.next_token(); !token.is(TokenType::EOF_); token = lexer.next_token())
+    {
+        if(token.is_error())
+            throw std::runtime_error("lexing failed");
+        if(!token.is(TokenType::IGNORE))
+            tokens.push_back(token);
+    }
+
+    TokenStream stream(tokens);
+    ErrorReporter reporter;
+    Parser parser(stream, reporter);
+    std::vector<statements_ptr_var> stmts;
+    while(stream.peek().has_value()) { stmts.push_back(parser.parse_statement()); }
+    SourceLocation loc{};
+    auto program = ASTBuilder().build_program(loc, std::move(stmts));
+    program = SemanticAnalyzer(std::move(program), reporter).analyze();
+    if(reporter.has_errors())
+    {
+        reporter.print_diagnostics();
+        throw std::runtime_error("semantic analysis failed");
+    }
+
+    Outcome outcome;
+    auto& counts = outcome.counts;
+    if(pipeline == Pipeline::CHECKS_FIRST)
+        program = BoundsCheckEliminator(std::move(program)).run();
+    if(pipeline != Pipeline::NONE)
+    {
+        ConstantPropagator propagator(std::move(program));
+        program = propagator.run();
+        counts.removed_branches = propagator.removed_branches();
+        DeadCodeEliminator eliminator(std::move(program));
+        program = eliminator.run();
+        counts.removed_statements = eliminator.removed_statements();
+        LoopInvariantMotion motion(std::move(program));
+        program = motion.run();
+        counts.hoisted = motion.hoisted();
+        Reassociator reassociator(std::move(program));
+        program = reassociator.run();
+        counts.reassociated = reassociator.reassociated();
+        LoopUnroller unroller(std::move(program));
+        program = unroller.run();
+        counts.unrolled_loops = unroller.unrolled_loops();
+        BoundsCheckEliminator checks(std::move(program));
+        program = checks.run();
+        counts.removed_checks = checks.removed_checks();
+        counts.removed_guards = checks.removed_guards();
+        program = CallAnalyzer(std::move(program)).run();
+    }
+    auto module = IRLowering(*program).lower();
+    if(pipeline == Pipeline::NONE)
+        outcome.opcodes = count_opcodes(module);
+    else
+    {
+        counts.split = counts.promoted = counts.numbered = counts.reduced = counts.converted = 0;
+        for(auto& function : module.functions)
+        {
+            *counts.split += ScalarReplacement(function).run();
+            *counts.promoted += Mem2Reg(function).run();
+            *counts.numbered += GlobalValueNumbering(function).run();
+            *counts.reduced += StrengthReduction(function).run();
+            *counts.converted += IfConversion(function).run();
+        }
+    }
+
+    try
+    {
+        outcome.result = static_cast<int32_t>(Interpreter(module).call(0, {}));
+    }
+    catch(Trap&)
+    {
+        outcome.result = std::nullopt;
+    }
+    return outcome;
+}
+
+// Counters of the full pipeline and instructions right after the lowering that differ from
+// what the sample expects
+static size_t check_work(const Sample& sample, Pipeline pipeline, const Outcome& outcome)
+{
+    size_t failures = 0;
+    if(pipeline == Pipeline::ALL)
+    {
+        for(auto [name, counter] : counters)
+        {
+            auto& expected = sample.counts.*counter;
+            auto& got = outcome.counts.*counter;
+            if(!expected || expected == got)
+                continue;
+            std::cerr << sample.name << ": " << name << " is " << got.value_or(0) << ", expected "
+                      << *expected << std::endl;
+            failures++;
+        }
+    }
+    if(pipeline == Pipeline::NONE)
+    {
+        for(auto [op, expected] : sample.lowered)
+        {
+            auto found = outcome.opcodes.find(op);
+            size_t got = found == outcome.opcodes.end() ? 0 : found->second;
+            if(got == expected)
+                continue;
+            std::cerr << sample.name << ": the lowering gives " << got << " "
+                      << ir::opcode_name(op) << ", expected " << expected << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+int main()
+{
+    size_t failed = 0;
+    for(auto& sample : samples)
+    {
+        size_t failures = 0;
+        for(auto pipeline : {Pipeline::NONE, Pipeline::ALL, Pipeline::CHECKS_FIRST})
+        {
+            const char* passes = pipeline == Pipeline::NONE  ? "no passes"
+                                 : pipeline == Pipeline::ALL ? "all passes"
+                                                             : "bounds checks first";
+            Outcome outcome;
+            try
+            {
+                outcome = run(sample, pipeline);
+            }
+            catch(std::exception& error)
+            {
+                std::cerr << sample.name << " (" << passes << "): " << error.what() << std::endl;
+                failures++;
+                continue;
+            }
+            failures += check_work(sample, pipeline, outcome);
+            if(outcome.result == sample.result)
+                continue;
+            auto show = [](std::optional<int64_t> value)
+            { return value ? std::to_string(*value) : std::string("trap"); };
+            std::cerr << sample.name << " (" << passes << "): expected " << show(sample.result)
+                      << ", got " << show(outcome.result) << std::endl;
+            failures++;
+        }
+        failed += failures > 0;
+    }
+    std::cout << std::size(samples) - failed << " of " << std::size(samples)
+              << " samples passed" << std::endl;
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
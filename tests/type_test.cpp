@@ -0,0 +1,149 @@
+#include "ast_builder.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "semantics.hpp"
+#include <iostream>
+#include <stdexcept>
+
+// Declares struct types through the front end and checks the layouts and instances the
+// registry gives them
+
+static size_t failures = 0;
+
+static void check(bool condition, const std::string& what)
+{
+    if(condition)
+        return;
+    std::cerr << what << std::endl;
+    failures++;
+}
+
+static void check_equal(size_t value, size_t expected, const std::string& what)
+{
+    check(value == expected,
+          what + " is " + std::to_string(value) + ", expected " + std::to_string(expected));
+}
+
+static program_ptr analyze(std::string_view source)
+{
+    Lexer lexer(source);
+    std::vector<Token> tokens;
+    for(Token token = lexer.next_token(); !token.is(TokenType::EOF_); token = lexer.next_token())
+    {
+        if(token.is_error())
+            throw std::runtime_error("lexing failed");
+        if(!token.is(TokenType::IGNORE))
+            tokens.push_back(token);
+    }
+
+    TokenStream stream(tokens);
+    ErrorReporter reporter;
+    Parser parser(stream, reporter);
+    std::vector<statements_ptr_var> stmts;
+    while(stream.peek().has_value()) { stmts.push_back(parser.parse_statement()); }
+    SourceLocation loc{};
+    auto program = ASTBuilder().build_program(loc, std::move(stmts));
+    program = SemanticAnalyzer(std::move(program), reporter).analyze();
+    if(reporter.has_errors())
+    {
+        reporter.print_diagnostics();
+        throw std::runtime_error("semantic analysis failed");
+    }
+    return program;
+}
+
+// Type the declaration at index of the top level statements was given
+static std::shared_ptr<type::BuiltinType> declared_type(program_ptr& program, size_t index)
+{
+    auto* declare = std::get_if<declare_ptr>(&program->stmts.at(index));
+    if(!declare)
+        throw std::runtime_error("statement " + std::to_string(index) + " is no declaration");
+    return (*declare)->type;
+}
+
+// Members are laid out in name order, i64 id, u8 kind and float x give 16 bytes per element.
+// The columns of an soa collection start on 32 byte boundaries
+static void soa_layout()
+{
+    auto program = analyze(R"(struct Point { i64 id; u8 kind; float x; }
+soa struct Particle { i64 id; u8 kind; float x; }
+Point[10] points;
+Particle[10] particles;
+return 0;
+)");
+    auto& registry = type::TypeRegistry::instance();
+    auto point = registry.find_type("Point");
+    auto particle = registry.find_type("Particle");
+    check(!point->is_soa() && particle->is_soa(), "only Particle is soa");
+    check_equal(point->size(), 16, "size of Point");
+    check_equal(point->offsets.at("x"), 12, "offset of Point.x");
+    check_equal(particle->size(), 16, "size of one Particle");
+
+    auto& points = static_cast<type::ArrayType&>(*declared_type(program, 2));
+    check_equal(points.size(), 160, "size of Point[10]");
+    check_equal(points.member_offset(3, "kind"), 56, "offset of points[3].kind");
+    check_equal(points.member_offset(3, "x"), 60, "offset of points[3].x");
+
+    // id fills [0, 80), kind starts at 96 and fills [96, 106), x starts at 128
+    auto& particles = static_cast<type::ArrayType&>(*declared_type(program, 3));
+    check_equal(particle->column_offset("id", 10), 0, "column of Particle.id");
+    check_equal(particle->column_offset("kind", 10), 96, "column of Particle.kind");
+    check_equal(particle->column_offset("x", 10), 128, "column of Particle.x");
+    check_equal(particle->collection_bytes(10), 168, "size of 10 Particles");
+    check_equal(particles.size(), 168, "size of Particle[10]");
+    check_equal(particles.member_offset(3, "kind"), 99, "offset of particles[3].kind");
+    check_equal(particles.member_offset(3, "x"), 140, "offset of particles[3].x");
+    check_equal(particles.member_offset(9, "id"), 72, "offset of particles[9].id");
+}
+
+// Instances are cached by template and argument ids, int and i32 are the same type so both
+// spellings give one instance
+static void generic_instances()
+{
+    auto program = analyze(R"(struct Pair<T, U> { T first; U second; }
+Pair<int, bool> a;
+Pair<i32, bool> b;
+Pair<i64, bool> c;
+Pair<Pair<int, bool>, u8> d;
+return 0;
+)");
+    auto& registry = type::TypeRegistry::instance();
+    auto a = declared_type(program, 1);
+    auto b = declared_type(program, 2);
+    auto c = declared_type(program, 3);
+    auto d = declared_type(program, 4);
+    check(std::dynamic_pointer_cast<type::StructInstance>(a) != nullptr,
+          "Pair<int, bool> is no struct instance");
+    check(a == b, "Pair<int, bool> and Pair<i32, bool> are different instances");
+    check(a != c, "Pair<int, bool> and Pair<i64, bool> are the same instance");
+    check(registry.instantiate("Pair", {registry._i32_(), registry._bool_()}) == a,
+          "instantiating Pair<i32, bool> again gives another instance");
+    check(registry.resolve({"Pair", {{"int", {}}, {"bool", {}}}}) == a,
+          "resolving Pair<int, bool> gives another instance");
+
+    auto& outer = static_cast<type::UDType&>(*d);
+    check(outer.members.at("first") == a, "the first member of d is not Pair<int, bool>");
+    check_equal(a->size(), 8, "size of Pair<int, bool>");
+    check_equal(c->size(), 16, "size of Pair<i64, bool>");
+    check_equal(d->size(), 12, "size of Pair<Pair<int, bool>, u8>");
+    check_equal(outer.offsets.at("second"), 8, "offset of d.second");
+}
+
+int main()
+{
+    for(auto test : {soa_layout, generic_instances})
+    {
+        try
+        {
+            test();
+        }
+        catch(std::exception& error)
+        {
+            std::cerr << error.what() << std::endl;
+            failures++;
+        }
+    }
+    if(failures == 0)
+        std::cout << "types passed" << std::endl;
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}